@@ -0,0 +1,1670 @@
+//Standalone microbenchmark for the math headers (vectors.h, matrix.h, simd_math.h, camera.h)
+//and the batched kernels in matrix_kernels.cpp, frustum.cpp, packing.cpp, transforms.cpp
+//and animation.cpp, and the thread scaling of the job system in jobs.cpp. It needs no
+//window, GPU or Vulkan SDK, so it also runs on Linux:
+//
+//  g++ -std=c++17 -O2 -Iinclude bench/math_bench.cpp src/matrix_kernels.cpp src/frustum.cpp src/packing.cpp src/transforms.cpp src/animation.cpp src/jobs.cpp src/cpu_features.cpp -o math_bench
+//  cl /std:c++17 /O2 /EHsc /Iinclude bench\math_bench.cpp src\matrix_kernels.cpp src\frustum.cpp src\packing.cpp src\transforms.cpp src\animation.cpp src\jobs.cpp src\cpu_features.cpp
+//
+//Add -mavx2 -mfma (/arch:AVX2) to measure the AVX2 header paths, -DVEC_FORCE_SCALAR for the
+//scalar backend (see simd_backend.h).
+//
+//Usage: math_bench [filter]    only runs the cases whose name contains filter
+//
+//Prints one JSON object to stdout. Per case:
+//  ns_per_op       throughput: independent operations over a small, L1 resident array of
+//                  random inputs
+//  ops_per_cycle   the same in operations per TSC cycle. The TSC ticks at the nominal clock,
+//                  so under turbo this overstates the work done per core cycle. null when
+//                  there is no TSC.
+//  latency_ns      one operation whose input depends on the result of the previous one. The
+//                  dependency is carried with an and + or against a zero the compiler can't
+//                  see, which adds ~2 cycles (3 for matrix results). null for the batch
+//                  kernels.
+//  ref_ns_per_op   throughput of a naive scalar implementation of the same operation
+//  speedup         ref_ns_per_op / ns_per_op
+//  max_error       largest |result - reference| / max(1, |reference|) over all the inputs
+//                  (for the inverse and normal matrix cases: the largest |result - reference|
+//                  over the largest |reference| of each matrix, with a double precision
+//                  reference,
+//                  for decompose_trs: the scale relative to itself,
+//                  for the soa cases: the reference is the same loop over AoS vec3s,
+//                  for the culling cases: the number of objects classified differently
+//                  from a brute force clip space corner test,
+//                  for the packing cases: the number of outputs that differ from the
+//                  single value functions)
+//  ok              max_error <= the case's tolerance
+//The process exits with 1 if any case is not ok. Cases slower than their reference are
+//listed on stderr.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "vectors.h"
+#include "matrix.h"
+#include "simd_math.h"
+#include "camera.h"
+#include "matrix_kernels.h"
+#include "frustum.h"
+#include "packing.h"
+#include "transforms.h"
+#include "animation.h"
+#include "jobs.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#elif defined(VEC_BACKEND_SSE)
+#include <x86intrin.h>
+#endif
+
+static const size_t CASE_SIZE = 256;    //inputs per case, small enough to stay in L1
+static const size_t BATCH_SIZE = 1024;  //elements per call for the batch kernels
+static const int SAMPLES = 15;          //best of
+static const double SAMPLE_NS = 2e6;    //minimum duration of a sample
+
+//============================ optimization barriers ===============================
+//escape(p): the compiler must assume *p is read. clobber(): ...and that all memory changed,
+//so work can't be hoisted out of the sample loop.
+
+#if defined(_MSC_VER) && !defined(__clang__)
+static const void *volatile escapeSink;
+__declspec(noinline) static void escape(const void *p) { escapeSink = p; }
+static FORCE_INLINE void clobber() { _ReadWriteBarrier(); }
+#else
+static FORCE_INLINE void escape(const void *p) { asm volatile("" : : "r"(p) : "memory"); }
+static FORCE_INLINE void clobber() { asm volatile("" : : : "memory"); }
+#endif
+
+//zero as far as the optimizer knows, for carrying dependencies between iterations
+static volatile float opaqueZero = 0.0f;
+
+//============================ dependency carrying ===============================
+//inject(x, r, z) makes x depend on r without changing it (z is all zeros).
+
+static FORCE_INLINE void inject(vec3 &x, __m128 r, __m128 z) { x.m = _mm_or_ps(x.m, _mm_and_ps(r, z)); }
+static FORCE_INLINE void inject(vec4 &x, __m128 r, __m128 z) { x.m = _mm_or_ps(x.m, _mm_and_ps(r, z)); }
+static FORCE_INLINE void inject(quat &x, __m128 r, __m128 z) { x.m = _mm_or_ps(x.m, _mm_and_ps(r, z)); }
+static FORCE_INLINE void inject(float &x, __m128 r, __m128 z) { x = _mm_cvtss_f32(_mm_or_ps(_mm_set_ss(x), _mm_and_ps(r, z))); }
+static FORCE_INLINE void inject(mat4 &x, __m128 r, __m128 z)
+{
+    for(int i = 0; i < 4; i++) inject(x.row[i], r, z);
+}
+
+struct SinCos { vec4 s, c; };
+
+//the register a result is carried through. For matrices the first and last rows, so both the
+//projections (diagonal) and the view/inverse matrices (translation) are on the chain.
+static FORCE_INLINE __m128 reg(float f) { return _mm_set_ss(f); }
+static FORCE_INLINE __m128 reg(vec3 v) { return v.m; }
+static FORCE_INLINE __m128 reg(vec4 v) { return v.m; }
+static FORCE_INLINE __m128 reg(quat q) { return q.m; }
+static FORCE_INLINE __m128 reg(const mat4 &m) { return _mm_or_ps(m.row[0].m, m.row[3].m); }
+static FORCE_INLINE __m128 reg(const SinCos &r) { return _mm_add_ps(r.s.m, r.c.m); }
+static FORCE_INLINE __m128 reg(const Camera &c) { return c.fwd.m; }
+struct DecomposeOut { vec3 t; mat4 r; vec3 s; };
+static FORCE_INLINE __m128 reg(const DecomposeOut &d) { return _mm_or_ps(_mm_or_ps(d.t.m, d.s.m), d.r.row[0].m); }
+
+//============================ scalar reference ===============================
+//Textbook implementations, written for clarity rather than speed. Same conventions as the
+//headers: row vectors, v * M, reverse Z.
+
+struct RefVec { float v[4]; };
+struct RefMat { float m[4][4]; };
+struct RefMatD { double m[4][4]; };
+struct RefDecompose { double t[3], r[3][3], s[3]; };
+struct RefSinCos { RefVec s, c; };
+struct RefQuat { float x, y, z, w; };
+
+static RefVec toRef(vec3 a) { RefVec r = {{a[0], a[1], a[2], 0.0f}}; return r; }
+static RefVec toRef(vec4 a) { RefVec r = {{a[0], a[1], a[2], a[3]}}; return r; }
+static RefQuat toRef(quat q) { RefQuat r = {vlane(q.m, 0), vlane(q.m, 1), vlane(q.m, 2), vlane(q.m, 3)}; return r; }
+static RefMat toRef(const mat4 &a)
+{
+    RefMat r;
+    for(int i = 0; i < 4; i++)
+        for(int j = 0; j < 4; j++)
+            r.m[i][j] = a(i, j);
+    return r;
+}
+
+static RefMat refMul(const RefMat &a, const RefMat &b)
+{
+    RefMat r;
+    for(int i = 0; i < 4; i++)
+    {
+        for(int j = 0; j < 4; j++)
+        {
+            float s = 0.0f;
+            for(int k = 0; k < 4; k++) s += a.m[i][k] * b.m[k][j];
+            r.m[i][j] = s;
+        }
+    }
+    return r;
+}
+
+static RefVec refMul(const RefVec &a, const RefMat &b)
+{
+    RefVec r;
+    for(int j = 0; j < 4; j++)
+    {
+        float s = 0.0f;
+        for(int k = 0; k < 4; k++) s += a.v[k] * b.m[k][j];
+        r.v[j] = s;
+    }
+    return r;
+}
+
+static RefMat refTranspose(const RefMat &a)
+{
+    RefMat r;
+    for(int i = 0; i < 4; i++)
+        for(int j = 0; j < 4; j++)
+            r.m[i][j] = a.m[j][i];
+    return r;
+}
+
+//Gauss-Jordan with partial pivoting, in double: near singular inputs lose digits in float
+static RefMatD refInverse(const RefMat &in)
+{
+    RefMatD a, r = {};
+    for(int i = 0; i < 4; i++)
+    {
+        for(int j = 0; j < 4; j++) a.m[i][j] = in.m[i][j];
+        r.m[i][i] = 1.0;
+    }
+
+    for(int c = 0; c < 4; c++)
+    {
+        int p = c;
+        for(int i = c + 1; i < 4; i++)
+            if(fabs(a.m[i][c]) > fabs(a.m[p][c])) p = i;
+
+        for(int j = 0; j < 4; j++)
+        {
+            double t = a.m[c][j]; a.m[c][j] = a.m[p][j]; a.m[p][j] = t;
+            t = r.m[c][j]; r.m[c][j] = r.m[p][j]; r.m[p][j] = t;
+        }
+
+        double d = 1.0 / a.m[c][c];
+        for(int j = 0; j < 4; j++) { a.m[c][j] *= d; r.m[c][j] *= d; }
+
+        for(int i = 0; i < 4; i++)
+        {
+            if(i == c) continue;
+            double f = a.m[i][c];
+            for(int j = 0; j < 4; j++) { a.m[i][j] -= f * a.m[c][j]; r.m[i][j] -= f * r.m[c][j]; }
+        }
+    }
+    return r;
+}
+
+//inverse-transpose of the upper 3x3, rest of the identity
+static RefMatD refNormalMatrix(RefMat a)
+{
+    for(int i = 0; i < 3; i++) { a.m[i][3] = 0.0f; a.m[3][i] = 0.0f; }
+    a.m[3][3] = 1.0f;
+
+    RefMatD inv = refInverse(a), r;
+    for(int i = 0; i < 4; i++)
+        for(int j = 0; j < 4; j++)
+            r.m[i][j] = inv.m[j][i];
+    return r;
+}
+
+//in double, with the mirroring folded into the X scale like decomposeTRS
+static RefDecompose refDecomposeTRS(const RefMat &a)
+{
+    RefDecompose d;
+    for(int i = 0; i < 3; i++)
+    {
+        d.t[i] = a.m[3][i];
+        d.s[i] = sqrt((double)a.m[i][0] * a.m[i][0] + (double)a.m[i][1] * a.m[i][1] + (double)a.m[i][2] * a.m[i][2]);
+    }
+
+    double det = a.m[0][0] * ((double)a.m[1][1] * a.m[2][2] - (double)a.m[1][2] * a.m[2][1])
+               - a.m[0][1] * ((double)a.m[1][0] * a.m[2][2] - (double)a.m[1][2] * a.m[2][0])
+               + a.m[0][2] * ((double)a.m[1][0] * a.m[2][1] - (double)a.m[1][1] * a.m[2][0]);
+    if(det < 0.0) d.s[0] = -d.s[0];
+
+    for(int i = 0; i < 3; i++)
+        for(int j = 0; j < 3; j++)
+            d.r[i][j] = a.m[i][j] / d.s[i];
+    return d;
+}
+
+static float refDot3(const RefVec &a, const RefVec &b) { return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2]; }
+
+static RefVec refCross(const RefVec &a, const RefVec &b)
+{
+    RefVec r = {{a.v[1] * b.v[2] - a.v[2] * b.v[1],
+                 a.v[2] * b.v[0] - a.v[0] * b.v[2],
+                 a.v[0] * b.v[1] - a.v[1] * b.v[0],
+                 0.0f}};
+    return r;
+}
+
+static RefVec refNormalize(const RefVec &a)
+{
+    float l = sqrtf(refDot3(a, a));
+    RefVec r = {{a.v[0] / l, a.v[1] / l, a.v[2] / l, 0.0f}};
+    return r;
+}
+
+static RefVec refSub(const RefVec &a, const RefVec &b)
+{
+    RefVec r = {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], 0.0f}};
+    return r;
+}
+
+static RefVec refAdd(const RefVec &a, const RefVec &b)
+{
+    RefVec r = {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], 0.0f}};
+    return r;
+}
+
+static RefMat refLookAt(const RefVec &from, const RefVec &to, const RefVec &worldUp)
+{
+    RefVec f = refNormalize(refSub(from, to));
+    RefVec r = refNormalize(refCross(worldUp, f));
+    RefVec u = refCross(f, r);
+
+    RefMat m = {};
+    for(int i = 0; i < 3; i++)
+    {
+        m.m[i][0] = r.v[i];
+        m.m[i][1] = u.v[i];
+        m.m[i][2] = f.v[i];
+    }
+    m.m[3][0] = -refDot3(from, r);
+    m.m[3][1] = -refDot3(from, u);
+    m.m[3][2] = -refDot3(from, f);
+    m.m[3][3] = 1.0f;
+    return m;
+}
+
+static RefMat refPerspective(float l, float r, float b, float t, float n, float f)
+{
+    RefMat m = {};
+    m.m[0][0] = 2.0f * n / (r - l);
+    m.m[1][1] = 2.0f * n / (b - t);
+    m.m[2][0] = (r + l) / (r - l);
+    m.m[2][1] = (b + t) / (b - t);
+    m.m[2][2] = n / (f - n);
+    m.m[2][3] = -1.0f;
+    m.m[3][2] = n * f / (f - n);
+    return m;
+}
+
+static RefMat refPerspectiveSymmetric(float w, float h, float n, float f)
+{
+    return refPerspective(-0.5f * w, 0.5f * w, -0.5f * h, 0.5f * h, n, f);
+}
+
+static RefMat refPerspectiveFov(float aspect, float yFov, float n, float f)
+{
+    float t = n * tanf(yFov * 0.5f * (float)M_PI / 180.0f);
+    return refPerspective(-t * aspect, t * aspect, -t, t, n, f);
+}
+
+static float refHmin(const RefVec &a) { return fminf(a.v[0], fminf(a.v[1], a.v[2])); }
+static float refHmax(const RefVec &a) { return fmaxf(a.v[0], fmaxf(a.v[1], a.v[2])); }
+
+static RefQuat refSlerp(RefQuat a, RefQuat b, float t)
+{
+    float d = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    if(d < 0.0f) { d = -d; b.x = -b.x; b.y = -b.y; b.z = -b.z; b.w = -b.w; }
+
+    float wa = 1.0f - t, wb = t;
+    if(d <= 0.9995f)
+    {
+        float theta = acosf(d);
+        wa = sinf((1.0f - t) * theta) / sinf(theta);
+        wb = sinf(t * theta) / sinf(theta);
+    }
+
+    RefQuat r = {wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z, wa * a.w + wb * b.w};
+    float l = sqrtf(r.x * r.x + r.y * r.y + r.z * r.z + r.w * r.w);
+    r.x /= l; r.y /= l; r.z /= l; r.w /= l;
+    return r;
+}
+
+//scale, then rotate, then translate
+static RefMat refTRS(const float t[3], RefQuat q, const float s[3])
+{
+    float x = q.x, y = q.y, z = q.z, w = q.w;
+    RefMat r = {{{(1.0f - 2.0f * (y * y + z * z)) * s[0], 2.0f * (x * y + w * z) * s[0], 2.0f * (x * z - w * y) * s[0], 0.0f},
+                 {2.0f * (x * y - w * z) * s[1], (1.0f - 2.0f * (x * x + z * z)) * s[1], 2.0f * (y * z + w * x) * s[1], 0.0f},
+                 {2.0f * (x * z + w * y) * s[2], 2.0f * (y * z - w * x) * s[2], (1.0f - 2.0f * (x * x + y * y)) * s[2], 0.0f},
+                 {t[0], t[1], t[2], 1.0f}}};
+    return r;
+}
+
+struct RefCamera
+{
+    RefVec pos, fwd, right, up;
+    float yaw, pitch;
+
+    void rotate(float xOffset, float yOffset, float sensitivity)
+    {
+        yaw = fmodf(yaw + xOffset * sensitivity, 360.0f);
+        pitch += yOffset * sensitivity;
+        if(pitch >  89.0f) pitch =  89.0f;
+        if(pitch < -89.0f) pitch = -89.0f;
+
+        float y = yaw * (float)M_PI / 180.0f;
+        float p = pitch * (float)M_PI / 180.0f;
+        RefVec f = {{cosf(y) * cosf(p), sinf(p), sinf(y) * cosf(p), 0.0f}};
+        RefVec worldUp = {{0.0f, 1.0f, 0.0f, 0.0f}};
+        fwd = refNormalize(f);
+        right = refNormalize(refCross(fwd, worldUp));
+        up = refNormalize(refCross(right, fwd));
+    }
+};
+
+static RefCamera toRef(const Camera &c)
+{
+    RefCamera r = {toRef(c.pos), toRef(c.fwd), toRef(c.right), toRef(c.up), c.yaw, c.pitch};
+    return r;
+}
+
+//============================ error ===============================
+
+static double relError(float a, float b) { return fabs((double)a - b) / fmax(1.0, fabs((double)b)); }
+
+static double maxError(float a, float b) { return relError(a, b); }
+
+static double maxError(vec3 a, const RefVec &b)
+{
+    double e = 0.0;
+    for(int i = 0; i < 3; i++) e = fmax(e, relError(a[i], b.v[i]));
+    return e;
+}
+
+static double maxError(vec4 a, const RefVec &b)
+{
+    double e = 0.0;
+    for(int i = 0; i < 4; i++) e = fmax(e, relError(a[i], b.v[i]));
+    return e;
+}
+
+static double maxError(const mat4 &a, const RefMat &b)
+{
+    double e = 0.0;
+    for(int i = 0; i < 4; i++)
+        for(int j = 0; j < 4; j++)
+            e = fmax(e, relError(a(i, j), b.m[i][j]));
+    return e;
+}
+
+//relative to the largest element: the error of an inverse scales with its norm, and small
+//elements are the difference of large ones
+static double maxError(const mat4 &a, const RefMatD &b)
+{
+    double e = 0.0, norm = 1.0;
+    for(int i = 0; i < 4; i++)
+    {
+        for(int j = 0; j < 4; j++)
+        {
+            e = fmax(e, fabs(a(i, j) - b.m[i][j]));
+            norm = fmax(norm, fabs(b.m[i][j]));
+        }
+    }
+    return e / norm;
+}
+
+static double maxError(const DecomposeOut &a, const RefDecompose &b)
+{
+    double e = 0.0;
+    for(int i = 0; i < 3; i++)
+    {
+        e = fmax(e, fabs(a.t[i] - b.t[i]) / fmax(1.0, fabs(b.t[i])));
+        e = fmax(e, fabs(a.s[i] - b.s[i]) / fabs(b.s[i]));
+        for(int j = 0; j < 3; j++) e = fmax(e, fabs(a.r(i, j) - b.r[i][j]));
+    }
+    return e;
+}
+
+static double maxError(quat a, const RefQuat &b)
+{
+    RefVec v = {{b.x, b.y, b.z, b.w}};
+    return maxError(vec4(a.m), v);
+}
+
+static double maxError(const SinCos &a, const RefSinCos &b) { return fmax(maxError(a.s, b.s), maxError(a.c, b.c)); }
+
+static double maxError(const Camera &a, const RefCamera &b)
+{
+    return fmax(maxError(a.fwd, b.fwd), fmax(maxError(a.right, b.right), maxError(a.up, b.up)));
+}
+
+//============================ harness ===============================
+
+struct Result
+{
+    const char *name;
+    double nsPerOp;
+    double latencyNs;   //< 0: not measured
+    double refNsPerOp;
+    double maxError;
+    double tolerance;
+};
+
+static std::vector<Result> results;
+static const char *filter = nullptr;
+
+static bool selected(const char *name) { return !filter || strstr(name, filter); }
+
+static double nowNs()
+{
+    using namespace std::chrono;
+    return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+//Best time per operation of body(), which does opsPerCall operations. The number of calls
+//per sample doubles until a sample takes SAMPLE_NS.
+template<typename F>
+static double measure(F body, double opsPerCall)
+{
+    size_t calls = 1;
+    double best = 0.0;
+
+    for(;;)
+    {
+        double t = nowNs();
+        for(size_t i = 0; i < calls; i++) body();
+        t = nowNs() - t;
+
+        if(t >= SAMPLE_NS)
+        {
+            best = t / (calls * opsPerCall);
+            break;
+        }
+        calls *= 2;
+    }
+
+    for(int s = 1; s < SAMPLES; s++)
+    {
+        double t = nowNs();
+        for(size_t i = 0; i < calls; i++) body();
+        t = nowNs() - t;
+
+        if(t / (calls * opsPerCall) < best) best = t / (calls * opsPerCall);
+    }
+    return best;
+}
+
+//Measures out = op(in) against refOut = refOp(toRef(in)) over every input.
+//carry(x, r, z) makes the input x depend on the register r, for the latency chain.
+template<typename In, typename Op, typename ToRef, typename RefOp, typename Carry>
+static void runCase(const char *name, const std::vector<In> &in, Op op,
+                    ToRef toRefIn, RefOp refOp, Carry carry, double tolerance)
+{
+    if(!selected(name)) return;
+
+    typedef decltype(op(in[0])) Out;
+    typedef decltype(toRefIn(in[0])) RefIn;
+    typedef decltype(refOp(toRefIn(in[0]))) RefOut;
+
+    size_t n = in.size();
+    std::vector<Out> out(n);
+    std::vector<RefIn> refIn;
+    std::vector<RefOut> refOut(n);
+    for(size_t i = 0; i < n; i++) refIn.push_back(toRefIn(in[i]));
+
+    Result r = {name, 0.0, -1.0, 0.0, 0.0, tolerance};
+
+    r.nsPerOp = measure([&]()
+    {
+        for(size_t i = 0; i < n; i++) out[i] = op(in[i]);
+        escape(out.data());
+        clobber();
+    }, (double)n);
+
+    r.refNsPerOp = measure([&]()
+    {
+        for(size_t i = 0; i < n; i++) refOut[i] = refOp(refIn[i]);
+        escape(refOut.data());
+        clobber();
+    }, (double)n);
+
+    r.latencyNs = measure([&]()
+    {
+        __m128 z = _mm_set1_ps(opaqueZero);
+        In x = in[0];
+        for(size_t i = 1; i < n; i++)
+        {
+            Out o = op(x);
+            x = in[i];
+            carry(x, reg(o), z);
+        }
+        Out o = op(x);
+        escape(&o);
+        clobber();
+    }, (double)n);
+
+    for(size_t i = 0; i < n; i++) r.maxError = fmax(r.maxError, maxError(out[i], refOut[i]));
+
+    results.push_back(r);
+}
+
+//============================ inputs ===============================
+
+static std::mt19937 rng(12345);
+
+static float randf(float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); }
+static vec3 randVec3(float lo, float hi) { return vec3(randf(lo, hi), randf(lo, hi), randf(lo, hi)); }
+static vec4 randVec4(float lo, float hi) { return vec4(randf(lo, hi), randf(lo, hi), randf(lo, hi), randf(lo, hi)); }
+static quat randQuat() { return normalize(quat(randVec4(-1.0f, 1.0f))); }
+static mat4 randMat4() { return mat4(randVec4(-2.0f, 2.0f), randVec4(-2.0f, 2.0f), randVec4(-2.0f, 2.0f), randVec4(-2.0f, 2.0f)); }
+
+//translation * rotation * non-uniform scale in [0.5, 2], well conditioned
+static mat4 randTRS() { return composeTRS(randVec3(-10.0f, 10.0f), randQuat(), randVec3(0.5f, 2.0f)); }
+
+//rotation + translation
+static mat4 randRigid() { return composeTRS(randVec3(-10.0f, 10.0f), randQuat(), vec3(1.0f, 1.0f, 1.0f)); }
+
+//scales of both signs spanning [1/16, 16] (log uniform), condition numbers up to 256
+static float randScale() { return (randf(0.0f, 1.0f) < 0.5f ? -1.0f : 1.0f) * exp2f(randf(-4.0f, 4.0f)); }
+static mat4 randNonUniform() { return composeTRS(randVec3(-10.0f, 10.0f), randQuat(), vec3(randScale(), randScale(), randScale())); }
+
+//one axis flattened to 1e-3 of the others, condition number ~1e3
+static mat4 randNearSingular()
+{
+    vec3 s(1.0f, 1.0f, 1.0f);
+    s[(int)randf(0.0f, 2.999f)] = 1e-3f;
+    return composeTRS(randVec3(-10.0f, 10.0f), randQuat(), s);
+}
+
+template<typename T, typename F>
+static std::vector<T> generate(F f)
+{
+    std::vector<T> v;
+    for(size_t i = 0; i < CASE_SIZE; i++) v.push_back(f());
+    return v;
+}
+
+struct MatMat { mat4 a, b; };
+struct VecMat { vec4 v; mat4 m; };
+struct Vec3Pair { vec3 a, b; };
+struct LookAtIn { vec3 from, to, up; };
+struct OffCenterIn { float l, r, b, t, n, f; };
+struct SymmetricIn { float w, h, n, f; };
+struct FovIn { float aspect, yFov, n, f; };
+struct SlerpIn { quat a, b; float t; };
+
+struct RefMatMat { RefMat a, b; };
+struct RefVecMat { RefVec v; RefMat m; };
+struct RefVec3Pair { RefVec a, b; };
+struct RefLookAtIn { RefVec from, to, up; };
+struct RefSlerpIn { RefQuat a, b; float t; };
+
+//============================ cases ===============================
+
+static void matrixCases()
+{
+    std::vector<MatMat> mm = generate<MatMat>([]() { MatMat x = {randMat4(), randMat4()}; return x; });
+    runCase("mat4_mul_mat4", mm,
+            [](const MatMat &x) { return x.a * x.b; },
+            [](const MatMat &x) { RefMatMat r = {toRef(x.a), toRef(x.b)}; return r; },
+            [](const RefMatMat &x) { return refMul(x.a, x.b); },
+            [](MatMat &x, __m128 r, __m128 z) { inject(x.a, r, z); },
+            1e-5);
+
+    std::vector<VecMat> vm = generate<VecMat>([]() { VecMat x = {randVec4(-10.0f, 10.0f), randMat4()}; return x; });
+    runCase("vec4_mul_mat4", vm,
+            [](const VecMat &x) { return x.v * x.m; },
+            [](const VecMat &x) { RefVecMat r = {toRef(x.v), toRef(x.m)}; return r; },
+            [](const RefVecMat &x) { return refMul(x.v, x.m); },
+            [](VecMat &x, __m128 r, __m128 z) { inject(x.v, r, z); },
+            1e-5);
+
+    std::vector<mat4> m = generate<mat4>(randMat4);
+    runCase("transpose", m,
+            [](mat4 x) { transpose(x); return x; },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refTranspose(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            0.0);
+
+    std::vector<mat4> trs = generate<mat4>(randTRS);
+    runCase("inverse", trs,
+            [](const mat4 &x) { return inverse(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refInverse(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    runCase("inverse_affine", trs,
+            [](const mat4 &x) { return inverseAffine(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refInverse(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    //relative to the norm of the inverse the error stays ~1e-6 for condition numbers up to 1e3:
+    //the rows of a TRS are scaled orthogonal rows, so the scales don't mix in the cofactors
+    std::vector<mat4> nonUniform = generate<mat4>(randNonUniform);
+    std::vector<mat4> nearSingular = generate<mat4>(randNearSingular);
+    runCase("inverse_nonuniform", nonUniform,
+            [](const mat4 &x) { return inverse(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refInverse(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    runCase("inverse_near_singular", nearSingular,
+            [](const mat4 &x) { return inverse(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refInverse(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    runCase("inverse_affine_nonuniform", nonUniform,
+            [](const mat4 &x) { return inverseAffine(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refInverse(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    runCase("inverse_affine_near_singular", nearSingular,
+            [](const mat4 &x) { return inverseAffine(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refInverse(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    //the transpose is only exact for an exactly orthonormal input, the rotation has float error
+    std::vector<mat4> rigid = generate<mat4>(randRigid);
+    runCase("inverse_rigid", rigid,
+            [](const mat4 &x) { return inverseRigid(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refInverse(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    runCase("normal_matrix", trs,
+            [](const mat4 &x) { return normalMatrix(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refNormalMatrix(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    runCase("normal_matrix_nonuniform", nonUniform,
+            [](const mat4 &x) { return normalMatrix(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refNormalMatrix(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    runCase("normal_matrix_near_singular", nearSingular,
+            [](const mat4 &x) { return normalMatrix(x); },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refNormalMatrix(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-5);
+
+    //mirrored and flattened axes, each row is scaled separately so no condition number here
+    std::vector<mat4> decompose = nonUniform;
+    decompose.insert(decompose.end(), nearSingular.begin(), nearSingular.end());
+    runCase("decompose_trs", decompose,
+            [](const mat4 &x) { DecomposeOut d; decomposeTRS(x, d.t, d.r, d.s); return d; },
+            [](const mat4 &x) { return toRef(x); },
+            [](const RefMat &x) { return refDecomposeTRS(x); },
+            [](mat4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-6);
+
+    std::vector<LookAtIn> la = generate<LookAtIn>([]()
+    {
+        LookAtIn x = {randVec3(-10.0f, 10.0f), randVec3(-10.0f, 10.0f), normalize(randVec3(-1.0f, 1.0f))};
+        return x;
+    });
+    runCase("lookAt", la,
+            [](const LookAtIn &x) { return lookAt(x.from, x.to, x.up); },
+            [](const LookAtIn &x) { RefLookAtIn r = {toRef(x.from), toRef(x.to), toRef(x.up)}; return r; },
+            [](const RefLookAtIn &x) { return refLookAt(x.from, x.to, x.up); },
+            [](LookAtIn &x, __m128 r, __m128 z) { inject(x.from, r, z); },
+            1e-5);
+
+    std::vector<SymmetricIn> ps = generate<SymmetricIn>([]()
+    {
+        SymmetricIn x = {randf(0.1f, 2.0f), randf(0.1f, 2.0f), randf(0.01f, 1.0f), randf(10.0f, 1000.0f)};
+        return x;
+    });
+    runCase("vulkanPerspectiveSymmetric", ps,
+            [](const SymmetricIn &x) { return vulkanPerspectiveSymmetric(x.w, x.h, x.n, x.f); },
+            [](const SymmetricIn &x) { return x; },
+            [](const SymmetricIn &x) { return refPerspectiveSymmetric(x.w, x.h, x.n, x.f); },
+            [](SymmetricIn &x, __m128 r, __m128 z) { inject(x.w, r, z); },
+            1e-6);
+
+    std::vector<OffCenterIn> po = generate<OffCenterIn>([]()
+    {
+        float l = randf(-1.0f, -0.1f), b = randf(-1.0f, -0.1f);
+        OffCenterIn x = {l, l + randf(0.2f, 2.0f), b, b + randf(0.2f, 2.0f), randf(0.01f, 1.0f), randf(10.0f, 1000.0f)};
+        return x;
+    });
+    runCase("vulkanPerspective_offCenter", po,
+            [](const OffCenterIn &x) { return vulkanPerspective(x.l, x.r, x.b, x.t, x.n, x.f); },
+            [](const OffCenterIn &x) { return x; },
+            [](const OffCenterIn &x) { return refPerspective(x.l, x.r, x.b, x.t, x.n, x.f); },
+            [](OffCenterIn &x, __m128 r, __m128 z) { inject(x.l, r, z); },
+            1e-6);
+
+    std::vector<FovIn> pf = generate<FovIn>([]()
+    {
+        FovIn x = {randf(0.5f, 2.5f), randf(30.0f, 120.0f), randf(0.01f, 1.0f), randf(10.0f, 1000.0f)};
+        return x;
+    });
+    runCase("vulkanPerspective_fov", pf,
+            [](const FovIn &x) { return vulkanPerspective(x.aspect, x.yFov, x.n, x.f); },
+            [](const FovIn &x) { return x; },
+            [](const FovIn &x) { return refPerspectiveFov(x.aspect, x.yFov, x.n, x.f); },
+            [](FovIn &x, __m128 r, __m128 z) { inject(x.yFov, r, z); },
+            1e-5);
+}
+
+static void vectorCases()
+{
+    std::vector<Vec3Pair> vp = generate<Vec3Pair>([]() { Vec3Pair x = {randVec3(-10.0f, 10.0f), randVec3(-10.0f, 10.0f)}; return x; });
+    //with -mfma either side may contract a * b - c * d, rounding a cancelling pair differently
+    runCase("cross", vp,
+            [](const Vec3Pair &x) { return cross(x.a, x.b); },
+            [](const Vec3Pair &x) { RefVec3Pair r = {toRef(x.a), toRef(x.b)}; return r; },
+            [](const RefVec3Pair &x) { return refCross(x.a, x.b); },
+            [](Vec3Pair &x, __m128 r, __m128 z) { inject(x.a, r, z); },
+            1e-5);
+
+    std::vector<vec3> v = generate<vec3>([]() { return randVec3(-10.0f, 10.0f); });
+    runCase("normalize", v,
+            [](vec3 x) { return normalize(x); },
+            [](vec3 x) { return toRef(x); },
+            [](const RefVec &x) { return refNormalize(x); },
+            [](vec3 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-6);
+
+    runCase("hmin", v,
+            [](vec3 x) { return hmin(x); },
+            [](vec3 x) { return toRef(x); },
+            [](const RefVec &x) { return refHmin(x); },
+            [](vec3 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            0.0);
+
+    runCase("hmax", v,
+            [](vec3 x) { return hmax(x); },
+            [](vec3 x) { return toRef(x); },
+            [](const RefVec &x) { return refHmax(x); },
+            [](vec3 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            0.0);
+
+    std::vector<vec4> angles = generate<vec4>([]() { return randVec4(-10.0f, 10.0f); });
+    runCase("vsincos", angles,
+            [](vec4 x) { SinCos r; vsincos(x, r.s, r.c); return r; },
+            [](vec4 x) { return toRef(x); },
+            [](const RefVec &x)
+            {
+                RefSinCos r;
+                for(int i = 0; i < 4; i++) { r.s.v[i] = sinf(x.v[i]); r.c.v[i] = cosf(x.v[i]); }
+                return r;
+            },
+            [](vec4 &x, __m128 r, __m128 z) { inject(x, r, z); },
+            1e-6);
+
+    std::vector<SlerpIn> sl = generate<SlerpIn>([]() { SlerpIn x = {randQuat(), randQuat(), randf(0.0f, 1.0f)}; return x; });
+    runCase("quat_slerp", sl,
+            [](const SlerpIn &x) { return slerp(x.a, x.b, x.t); },
+            [](const SlerpIn &x) { RefSlerpIn r = {toRef(x.a), toRef(x.b), x.t}; return r; },
+            [](const RefSlerpIn &x) { return refSlerp(x.a, x.b, x.t); },
+            [](SlerpIn &x, __m128 r, __m128 z) { inject(x.a, r, z); },
+            1e-5);
+}
+
+static void cameraCases()
+{
+    std::vector<Camera> cams = generate<Camera>([]()
+    {
+        Camera c;
+        c.init(randVec3(-10.0f, 10.0f), randf(0.0f, 360.0f), randf(-80.0f, 80.0f));
+        return c;
+    });
+
+    runCase("Camera_getViewMatrix", cams,
+            [](Camera c) { return c.getViewMatrix(); },
+            [](const Camera &c) { return toRef(c); },
+            [](const RefCamera &c) { return refLookAt(c.pos, refAdd(c.pos, c.fwd), c.up); },
+            [](Camera &c, __m128 r, __m128 z) { inject(c.pos, r, z); },
+            1e-5);
+
+    //rotate mutates the camera: each call applies one mouse delta to a copy
+    struct RotateIn { Camera cam; float dx, dy; };
+    struct RefRotateIn { RefCamera cam; float dx, dy; };
+    std::vector<RotateIn> rot;
+    for(size_t i = 0; i < cams.size(); i++)
+    {
+        RotateIn x = {cams[i], randf(-50.0f, 50.0f), randf(-50.0f, 50.0f)};
+        rot.push_back(x);
+    }
+
+    runCase("Camera_rotate", rot,
+            [](RotateIn x) { x.cam.rotate(x.dx, x.dy, 0.1f); return x.cam; },
+            [](const RotateIn &x) { RefRotateIn r = {toRef(x.cam), x.dx, x.dy}; return r; },
+            [](RefRotateIn x) { x.cam.rotate(x.dx, x.dy, 0.1f); return x.cam; },
+            [](RotateIn &x, __m128 r, __m128 z) { inject(x.dx, r, z); },
+            1e-5);
+}
+
+//Batch kernels: one op is one element. No latency, the calls are independent by design.
+static void batchCases()
+{
+    std::vector<vec4> points(BATCH_SIZE), pointsOut(BATCH_SIZE);
+    std::vector<mat4> local(BATCH_SIZE), parent(BATCH_SIZE), world(BATCH_SIZE);
+    for(size_t i = 0; i < BATCH_SIZE; i++)
+    {
+        points[i] = randVec4(-10.0f, 10.0f);
+        local[i] = randTRS();
+        parent[i] = randTRS();
+    }
+    mat4 m = randTRS();
+
+    if(selected("transformPoints"))
+    {
+        Result r = {"transformPoints", 0.0, -1.0, 0.0, 0.0, 1e-5};
+        r.nsPerOp = measure([&]()
+        {
+            transformPoints(points.data(), pointsOut.data(), BATCH_SIZE, m);
+            escape(pointsOut.data());
+            clobber();
+        }, (double)BATCH_SIZE);
+
+        RefMat rm = toRef(m);
+        std::vector<RefVec> refIn, refOut(BATCH_SIZE);
+        for(size_t i = 0; i < BATCH_SIZE; i++) refIn.push_back(toRef(points[i]));
+        r.refNsPerOp = measure([&]()
+        {
+            for(size_t i = 0; i < BATCH_SIZE; i++) refOut[i] = refMul(refIn[i], rm);
+            escape(refOut.data());
+            clobber();
+        }, (double)BATCH_SIZE);
+
+        for(size_t i = 0; i < BATCH_SIZE; i++) r.maxError = fmax(r.maxError, maxError(pointsOut[i], refOut[i]));
+        results.push_back(r);
+    }
+
+    if(selected("composeMatrices"))
+    {
+        Result r = {"composeMatrices", 0.0, -1.0, 0.0, 0.0, 1e-5};
+        r.nsPerOp = measure([&]()
+        {
+            composeMatrices(local.data(), parent.data(), world.data(), BATCH_SIZE);
+            escape(world.data());
+            clobber();
+        }, (double)BATCH_SIZE);
+
+        std::vector<RefMat> refLocal, refParent, refOut(BATCH_SIZE);
+        for(size_t i = 0; i < BATCH_SIZE; i++)
+        {
+            refLocal.push_back(toRef(local[i]));
+            refParent.push_back(toRef(parent[i]));
+        }
+        r.refNsPerOp = measure([&]()
+        {
+            for(size_t i = 0; i < BATCH_SIZE; i++) refOut[i] = refMul(refLocal[i], refParent[i]);
+            escape(refOut.data());
+            clobber();
+        }, (double)BATCH_SIZE);
+
+        for(size_t i = 0; i < BATCH_SIZE; i++) r.maxError = fmax(r.maxError, maxError(world[i], refOut[i]));
+        results.push_back(r);
+    }
+}
+
+//Structure of arrays against arrays of structures: the same operation over BATCH_SIZE vectors
+//with vec3x4 (and vec3x8 with AVX) loaded from SoA arrays, against a loop over vec3s. The
+//reference is the vec3 loop, so speedup is the gain of the SoA layout. One op is one vector.
+//  soa_dot_*               dot(a, b)
+//  soa_normalize_*         normalize(a), normalize_fast(a)
+//  soa_cross_normalize_*   normalize(cross(a, b)), the basis of a lookAt
+//  soa_integrate_*         clamp(p + v * dt, lo, hi), a particle update
+struct alignas(32) SoAArrays
+{
+    float x[BATCH_SIZE];
+    float y[BATCH_SIZE];
+    float z[BATCH_SIZE];
+};
+
+static SoAArrays soaA, soaB, soaOut;
+
+template<typename Body, typename Error>
+static void soaCase(const char *name, double aosNsPerOp, Body body, Error error)
+{
+    if(!selected(name)) return;
+
+    //contracting to FMAs or not rounds a cancelling dot differently
+    Result r = {name, 0.0, -1.0, aosNsPerOp, 0.0, 1e-5};
+    r.nsPerOp = measure([&]()
+    {
+        body();
+        escape(&soaOut);
+        clobber();
+    }, (double)BATCH_SIZE);
+
+    for(size_t i = 0; i < BATCH_SIZE; i++) r.maxError = fmax(r.maxError, error(i));
+    results.push_back(r);
+}
+
+static void soaCases()
+{
+    std::vector<vec3> a(BATCH_SIZE), b(BATCH_SIZE), aosOut(BATCH_SIZE);
+    std::vector<float> aosDot(BATCH_SIZE);
+    for(size_t i = 0; i < BATCH_SIZE; i++)
+    {
+        a[i] = randVec3(-10.0f, 10.0f);
+        b[i] = randVec3(-10.0f, 10.0f);
+        soaA.x[i] = a[i][0]; soaA.y[i] = a[i][1]; soaA.z[i] = a[i][2];
+        soaB.x[i] = b[i][0]; soaB.y[i] = b[i][1]; soaB.z[i] = b[i][2];
+    }
+
+    auto aosNs = [](auto body)
+    {
+        return measure([&]()
+        {
+            body();
+            clobber();
+        }, (double)BATCH_SIZE);
+    };
+    auto vecError = [&](size_t i)
+    {
+        RefVec v = toRef(aosOut[i]);
+        return fmax(relError(soaOut.x[i], v.v[0]), fmax(relError(soaOut.y[i], v.v[1]), relError(soaOut.z[i], v.v[2])));
+    };
+
+    //dot
+    double ns = aosNs([&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i++) aosDot[i] = dot(a[i], b[i]);
+        escape(aosDot.data());
+    });
+    auto dotError = [&](size_t i) { return relError(soaOut.x[i], aosDot[i]); };
+
+    soaCase("soa_dot_x4", ns, [&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i += 4)
+        {
+            vec3x4 va(soaA.x + i, soaA.y + i, soaA.z + i), vb(soaB.x + i, soaB.y + i, soaB.z + i);
+            _mm_store_ps(soaOut.x + i, dot(va, vb).m);
+        }
+    }, dotError);
+#if defined(VEC_AVX)
+    soaCase("soa_dot_x8", ns, [&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i += 8)
+        {
+            vec3x8 va(soaA.x + i, soaA.y + i, soaA.z + i), vb(soaB.x + i, soaB.y + i, soaB.z + i);
+            dot(va, vb).store(soaOut.x + i);
+        }
+    }, dotError);
+#endif
+
+    ns = aosNs([&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i++) aosOut[i] = normalize(a[i]);
+        escape(aosOut.data());
+    });
+
+    soaCase("soa_normalize_x4", ns, [&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i += 4)
+        {
+            normalize(vec3x4(soaA.x + i, soaA.y + i, soaA.z + i)).store(soaOut.x + i, soaOut.y + i, soaOut.z + i);
+        }
+    }, vecError);
+    soaCase("soa_normalize_fast_x4", ns, [&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i += 4)
+        {
+            normalize_fast(vec3x4(soaA.x + i, soaA.y + i, soaA.z + i)).store(soaOut.x + i, soaOut.y + i, soaOut.z + i);
+        }
+    }, vecError);
+
+    //normalize(cross)
+    ns = aosNs([&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i++) aosOut[i] = normalize(cross(a[i], b[i]));
+        escape(aosOut.data());
+    });
+
+    soaCase("soa_cross_normalize_x4", ns, [&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i += 4)
+        {
+            vec3x4 va(soaA.x + i, soaA.y + i, soaA.z + i), vb(soaB.x + i, soaB.y + i, soaB.z + i);
+            normalize(cross(va, vb)).store(soaOut.x + i, soaOut.y + i, soaOut.z + i);
+        }
+    }, vecError);
+#if defined(VEC_AVX)
+    soaCase("soa_cross_normalize_x8", ns, [&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i += 8)
+        {
+            vec3x8 va(soaA.x + i, soaA.y + i, soaA.z + i), vb(soaB.x + i, soaB.y + i, soaB.z + i);
+            normalize(cross(va, vb)).store(soaOut.x + i, soaOut.y + i, soaOut.z + i);
+        }
+    }, vecError);
+#endif
+
+    //positions a, velocities b
+    const float dt = 1.0f / 60.0f;
+    vec3 lo(-9.0f, -9.0f, -9.0f), hi(9.0f, 9.0f, 9.0f);
+    ns = aosNs([&]()
+    {
+        for(size_t i = 0; i < BATCH_SIZE; i++) aosOut[i] = clamp(a[i] + b[i] * dt, lo, hi);
+        escape(aosOut.data());
+    });
+
+    soaCase("soa_integrate_x4", ns, [&]()
+    {
+        vec3x4 lo4(lo), hi4(hi);
+        for(size_t i = 0; i < BATCH_SIZE; i += 4)
+        {
+            vec3x4 p(soaA.x + i, soaA.y + i, soaA.z + i), v(soaB.x + i, soaB.y + i, soaB.z + i);
+            clamp(p + v * dt, lo4, hi4).store(soaOut.x + i, soaOut.y + i, soaOut.z + i);
+        }
+    }, vecError);
+#if defined(VEC_AVX)
+    soaCase("soa_integrate_x8", ns, [&]()
+    {
+        vec3x8 lo8(lo), hi8(hi);
+        for(size_t i = 0; i < BATCH_SIZE; i += 8)
+        {
+            vec3x8 p(soaA.x + i, soaA.y + i, soaA.z + i), v(soaB.x + i, soaB.y + i, soaB.z + i);
+            clamp(p + v * dt, lo8, hi8).store(soaOut.x + i, soaOut.y + i, soaOut.z + i);
+        }
+    }, vecError);
+#endif
+}
+
+//Brute force box test in clip space, independent of extractFrustum: the box is culled when
+//all 8 corners are outside the same clip plane (-w <= x, y <= w, 0 <= z <= w).
+//Returns 0 culled, 1 visible, 2 within rounding distance of a plane (either answer is fine).
+static int refBoxVisibility(const RefMat &vp, const float c[3], const float e[3])
+{
+    double clip[8][4];
+    for(int k = 0; k < 8; k++)
+    {
+        double p[4] = {c[0] + ((k & 1) ? e[0] : -e[0]), c[1] + ((k & 2) ? e[1] : -e[1]), c[2] + ((k & 4) ? e[2] : -e[2]), 1.0};
+        for(int j = 0; j < 4; j++)
+        {
+            clip[k][j] = 0.0;
+            for(int i = 0; i < 4; i++) clip[k][j] += p[i] * vp.m[i][j];
+        }
+    }
+
+    bool ambiguous = false;
+    for(int q = 0; q < 6; q++)
+    {
+        bool allOutside = true;
+        for(int k = 0; k < 8; k++)
+        {
+            double x = clip[k][0], y = clip[k][1], z = clip[k][2], w = clip[k][3];
+            double inside[6] = {w + x, w - x, w + y, w - y, w - z, z};
+            if(fabs(inside[q]) < 1e-5 * (1.0 + fabs(x) + fabs(y) + fabs(z) + fabs(w))) ambiguous = true;
+            if(inside[q] >= 0.0) allOutside = false;
+        }
+        if(allOutside && !ambiguous) return 0;
+    }
+    return ambiguous ? 2 : 1;
+}
+
+//Sphere test against planes extracted in double precision from the matrix columns.
+static void refFrustumPlanes(const RefMat &vp, double planes[6][4])
+{
+    for(int j = 0; j < 4; j++)
+    {
+        double c0 = vp.m[j][0], c1 = vp.m[j][1], c2 = vp.m[j][2], c3 = vp.m[j][3];
+        planes[0][j] = c3 + c0;
+        planes[1][j] = c3 - c0;
+        planes[2][j] = c3 + c1;
+        planes[3][j] = c3 - c1;
+        planes[4][j] = c3 - c2;
+        planes[5][j] = c2;
+    }
+    for(int q = 0; q < 6; q++)
+    {
+        double len = sqrt(planes[q][0] * planes[q][0] + planes[q][1] * planes[q][1] + planes[q][2] * planes[q][2]);
+        for(int j = 0; j < 4; j++) planes[q][j] /= len;
+    }
+}
+
+static int refSphereVisibility(const double planes[6][4], const float c[3], float radius)
+{
+    bool ambiguous = false;
+    for(int q = 0; q < 6; q++)
+    {
+        double d = planes[q][0] * c[0] + planes[q][1] * c[1] + planes[q][2] * c[2] + planes[q][3] + radius;
+        if(fabs(d) < 1e-4) ambiguous = true;
+        else if(d < 0.0) return 0;
+    }
+    return ambiguous ? 2 : 1;
+}
+
+//objects classified differently from the reference, ignoring the ambiguous ones
+static double countMismatches(const std::vector<uint32_t> &visible, size_t n, const std::vector<int> &ref)
+{
+    std::vector<int> v(ref.size(), 0);
+    for(size_t i = 0; i < n; i++) v[visible[i]] = 1;
+
+    double bad = 0.0;
+    for(size_t i = 0; i < ref.size(); i++)
+    {
+        if(ref[i] != 2 && ref[i] != v[i]) bad += 1.0;
+    }
+    return bad;
+}
+
+//Frustum culling of 1M objects scattered around the camera. One op is one object.
+//For these cases max_error is the number of misclassified objects.
+static void cullingCases()
+{
+    if(!selected("cullSpheres_1M") && !selected("cullBoxes_1M")) return;
+
+    const size_t count = 1 << 20;
+    std::vector<float> cx(count), cy(count), cz(count), ex(count), ey(count), ez(count), radius(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        cx[i] = randf(-500.0f, 500.0f);
+        cy[i] = randf(-500.0f, 500.0f);
+        cz[i] = randf(-500.0f, 500.0f);
+        ex[i] = randf(0.1f, 10.0f);
+        ey[i] = randf(0.1f, 10.0f);
+        ez[i] = randf(0.1f, 10.0f);
+        radius[i] = randf(0.1f, 10.0f);
+    }
+
+    Camera cam;
+    cam.init(vec3(1.0f, 2.0f, 3.0f), 30.0f, -10.0f);
+    mat4 viewProj = cam.getViewMatrix() * vulkanPerspective(16.0f / 9.0f, 60.0f, 0.1f, 1000.0f);
+    Frustum f = extractFrustum(viewProj);
+    RefMat refViewProj = toRef(viewProj);
+
+    std::vector<uint32_t> visible(count);
+    std::vector<int> refVisible(count);
+
+    if(selected("cullSpheres_1M"))
+    {
+        BoundingSpheres spheres = {cx.data(), cy.data(), cz.data(), radius.data(), count};
+        Result r = {"cullSpheres_1M", 0.0, -1.0, 0.0, 0.0, 0.0};
+
+        size_t n = 0;
+        r.nsPerOp = measure([&]()
+        {
+            n = cullSpheres(f, spheres, visible.data());
+            escape(visible.data());
+            clobber();
+        }, (double)count);
+
+        double planes[6][4];
+        refFrustumPlanes(refViewProj, planes);
+        r.refNsPerOp = measure([&]()
+        {
+            for(size_t i = 0; i < count; i++)
+            {
+                float c[3] = {cx[i], cy[i], cz[i]};
+                refVisible[i] = refSphereVisibility(planes, c, radius[i]);
+            }
+            escape(refVisible.data());
+            clobber();
+        }, (double)count);
+
+        r.maxError = countMismatches(visible, n, refVisible);
+        results.push_back(r);
+    }
+
+    if(selected("cullBoxes_1M"))
+    {
+        BoundingBoxes boxes = {cx.data(), cy.data(), cz.data(), ex.data(), ey.data(), ez.data(), count};
+        Result r = {"cullBoxes_1M", 0.0, -1.0, 0.0, 0.0, 0.0};
+
+        size_t n = 0;
+        r.nsPerOp = measure([&]()
+        {
+            n = cullBoxes(f, boxes, visible.data());
+            escape(visible.data());
+            clobber();
+        }, (double)count);
+
+        r.refNsPerOp = measure([&]()
+        {
+            for(size_t i = 0; i < count; i++)
+            {
+                float c[3] = {cx[i], cy[i], cz[i]};
+                float e[3] = {ex[i], ey[i], ez[i]};
+                refVisible[i] = refBoxVisibility(refViewProj, c, e);
+            }
+            escape(refVisible.data());
+            clobber();
+        }, (double)count);
+
+        r.maxError = countMismatches(visible, n, refVisible);
+        results.push_back(r);
+    }
+}
+
+//Conversion of 1M values with the batch (streaming) kernels, against a loop over the single
+//value functions in packing.h. One op is one output element. The output is bigger than the
+//caches, like a real upload. max_error is the number of outputs that differ bit for bit.
+template<typename In, typename Out, typename Batch, typename Single>
+static void packingCase(const char *name, const std::vector<In> &in, Batch batch, Single single)
+{
+    if(!selected(name)) return;
+
+    const size_t count = in.size();
+    std::vector<Out> out(count), refOut(count);
+    Result r = {name, 0.0, -1.0, 0.0, 0.0, 0.0};
+
+    r.nsPerOp = measure([&]()
+    {
+        batch(in.data(), out.data(), count);
+        escape(out.data());
+        clobber();
+    }, (double)count);
+
+    r.refNsPerOp = measure([&]()
+    {
+        for(size_t i = 0; i < count; i++) refOut[i] = single(in[i]);
+        escape(refOut.data());
+        clobber();
+    }, (double)count);
+
+    for(size_t i = 0; i < count; i++)
+        if(memcmp(&out[i], &refOut[i], sizeof(Out)) != 0) r.maxError += 1.0;
+    results.push_back(r);
+}
+
+static void packingCases()
+{
+    const size_t count = 1 << 20;
+
+    //a bit outside the normalized range to exercise the clamping, and a few special values
+    std::vector<float> floats(count);
+    for(size_t i = 0; i < count; i++) floats[i] = randf(-1.25f, 1.25f);
+    floats[1] = INFINITY; floats[2] = -INFINITY; floats[3] = NAN; floats[4] = 1e-7f; floats[5] = 70000.0f;
+
+    std::vector<uint16_t> halves(count);
+    for(size_t i = 0; i < count; i++) halves[i] = floatToHalf(randf(-1000.0f, 1000.0f));
+
+    std::vector<vec4> vectors(count / 4);
+    for(size_t i = 0; i < vectors.size(); i++)
+        vectors[i] = vec4(randf(-1.25f, 1.25f), randf(-1.25f, 1.25f), randf(-1.25f, 1.25f), randf(-1.25f, 1.25f));
+
+    //the single value functions share their names with the batch ones, so spell out the overload
+    packingCase<float, uint16_t>("floatToHalf_1M", floats, [](const float *in, uint16_t *out, size_t n) { floatToHalf(in, out, n); }, [](float f) { return floatToHalf(f); });
+    packingCase<uint16_t, float>("halfToFloat_1M", halves, [](const uint16_t *in, float *out, size_t n) { halfToFloat(in, out, n); }, [](uint16_t h) { return halfToFloat(h); });
+    packingCase<float, uint8_t>("packUnorm8_1M", floats, [](const float *in, uint8_t *out, size_t n) { packUnorm8(in, out, n); }, [](float f) { return packUnorm8(f); });
+    packingCase<float, int8_t>("packSnorm8_1M", floats, [](const float *in, int8_t *out, size_t n) { packSnorm8(in, out, n); }, [](float f) { return packSnorm8(f); });
+    packingCase<float, uint16_t>("packUnorm16_1M", floats, [](const float *in, uint16_t *out, size_t n) { packUnorm16(in, out, n); }, [](float f) { return packUnorm16(f); });
+    packingCase<float, int16_t>("packSnorm16_1M", floats, [](const float *in, int16_t *out, size_t n) { packSnorm16(in, out, n); }, [](float f) { return packSnorm16(f); });
+    packingCase<vec4, uint32_t>("packUnorm1010102_256k", vectors, [](const vec4 *in, uint32_t *out, size_t n) { packUnorm1010102(in, out, n); }, [](vec4 v) { return packUnorm1010102(v); });
+    packingCase<vec4, uint32_t>("packSnorm1010102_256k", vectors, [](const vec4 *in, uint32_t *out, size_t n) { packSnorm1010102(in, out, n); }, [](vec4 v) { return packSnorm1010102(v); });
+}
+
+//Local-to-world propagation through a random hierarchy (each node's parent picked among the
+//nodes before it, which gives a few thousand roots and depths up to ~15), against a scalar
+//loop recomputing every node in the same order. One op is one node.
+//  transforms_*_all      every node dirty
+//  transforms_1M_1pct    1% of the nodes moved since the last update, so only they and
+//                        their descendants are recomputed (the reference still does all)
+static void transformCase(const char *name, size_t count, size_t moved)
+{
+    if(!selected(name)) return;
+
+    TransformHierarchy h;
+    size_t roots = count / 256;
+    for(size_t i = 0; i < count; i++)
+    {
+        TransformId parent = i < roots ? NO_TRANSFORM : (TransformId)(rng() % i);
+        h.add(parent, randVec3(-10.0f, 10.0f), randQuat(), randVec3(0.9f, 1.1f));
+    }
+    h.update();
+
+    std::vector<TransformId> movedIds(moved);
+    for(size_t i = 0; i < moved; i++) movedIds[i] = (TransformId)(rng() % count);
+    quat rotation = randQuat();
+
+    Result r = {name, 0.0, -1.0, 0.0, 0.0, 1e-4};
+    r.nsPerOp = measure([&]()
+    {
+        if(moved == count) std::fill(h.dirty.begin(), h.dirty.end(), (uint8_t)1);
+        else for(size_t i = 0; i < moved; i++) h.setRotation(movedIds[i], rotation);
+        h.update();
+        escape(h.world.data());
+        clobber();
+    }, (double)count);
+
+    std::vector<RefMat> refWorld(count);
+    r.refNsPerOp = measure([&]()
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            float t[3] = {h.posX[i], h.posY[i], h.posZ[i]};
+            float s[3] = {h.scaleX[i], h.scaleY[i], h.scaleZ[i]};
+            RefQuat q = {h.rotX[i], h.rotY[i], h.rotZ[i], h.rotW[i]};
+            RefMat local = refTRS(t, q, s);
+            refWorld[i] = h.parent[i] == NO_TRANSFORM ? local : refMul(local, refWorld[h.parent[i]]);
+        }
+        escape(refWorld.data());
+        clobber();
+    }, (double)count);
+
+    for(size_t i = 0; i < count; i++) r.maxError = fmax(r.maxError, maxError(h.world[i], refWorld[i]));
+    results.push_back(r);
+}
+
+static void transformCases()
+{
+    transformCase("transforms_100k_all", 100000, 100000);
+    transformCase("transforms_1M_all", 1000000, 1000000);
+    transformCase("transforms_1M_1pct", 1000000, 10000);
+}
+
+//Skinning palettes of a crowd: every character samples its own time in a shared 30 fps clip
+//(lerp / nlerp between two keys), concatenates its joints down a random 64 joint skeleton
+//and applies the inverse bind matrices. Against a scalar version of the same steps on plain
+//float keys. One op is one character.
+static void animationCase(const char *name, size_t characterCount, size_t jointCount)
+{
+    if(!selected(name)) return;
+
+    const uint32_t frameCount = 32;
+
+    Skeleton skeleton;
+    for(size_t j = 0; j < jointCount; j++)
+    {
+        skeleton.parent.push_back(j == 0 ? NO_JOINT : (uint32_t)(rng() % j));
+        skeleton.inverseBind.push_back(randTRS());
+    }
+
+    //keys as plain floats for the reference, then packed into the clip's blocks
+    size_t blocks = skeleton.blockCount();
+    std::vector<float> keyT(frameCount * blocks * 4 * 3), keyS(keyT.size());
+    std::vector<RefQuat> keyR(frameCount * blocks * 4);
+    for(size_t k = 0; k < keyR.size(); k++)
+    {
+        vec3 t = randVec3(-0.5f, 0.5f), s = randVec3(0.9f, 1.1f);
+        keyR[k] = toRef(randQuat());
+        for(int c = 0; c < 3; c++) { keyT[k * 3 + c] = t[c]; keyS[k * 3 + c] = s[c]; }
+    }
+
+    AnimationClip clip;
+    clip.sampleRate = 30.0f;
+    clip.frameCount = frameCount;
+    clip.blockCount = (uint32_t)blocks;
+    for(size_t b = 0; b < frameCount * blocks; b++)
+    {
+        const float *t = &keyT[b * 12], *s = &keyS[b * 12];
+        const RefQuat *q = &keyR[b * 4];
+        clip.translations.push_back(vec3x4(_mm_setr_ps(t[0], t[3], t[6], t[9]), _mm_setr_ps(t[1], t[4], t[7], t[10]), _mm_setr_ps(t[2], t[5], t[8], t[11])));
+        clip.scales.push_back(vec3x4(_mm_setr_ps(s[0], s[3], s[6], s[9]), _mm_setr_ps(s[1], s[4], s[7], s[10]), _mm_setr_ps(s[2], s[5], s[8], s[11])));
+        clip.rotations.push_back(quatx4(_mm_setr_ps(q[0].x, q[1].x, q[2].x, q[3].x), _mm_setr_ps(q[0].y, q[1].y, q[2].y, q[3].y),
+                                        _mm_setr_ps(q[0].z, q[1].z, q[2].z, q[3].z), _mm_setr_ps(q[0].w, q[1].w, q[2].w, q[3].w)));
+    }
+
+    std::vector<Character> characters(characterCount);
+    for(size_t c = 0; c < characterCount; c++)
+    {
+        Character ch = {&skeleton, &clip, randf(0.0f, 3.0f), true, (uint32_t)(c * jointCount)};
+        characters[c] = ch;
+    }
+
+    std::vector<mat4> palettes(characterCount * jointCount);
+
+    Result r = {name, 0.0, -1.0, 0.0, 0.0, 1e-4};
+    r.nsPerOp = measure([&]()
+    {
+        updateCharacters(characters.data(), characterCount, palettes.data());
+        escape(palettes.data());
+        clobber();
+    }, (double)characterCount);
+
+    std::vector<RefMat> model(jointCount), refPalettes(palettes.size());
+    r.refNsPerOp = measure([&]()
+    {
+        for(size_t c = 0; c < characterCount; c++)
+        {
+            float last = (float)(frameCount - 1);
+            float f = fmodf(characters[c].time * clip.sampleRate, last);
+            size_t f0 = (size_t)f, f1 = f0 + 1;
+            float w = f - (float)f0;
+
+            for(size_t j = 0; j < jointCount; j++)
+            {
+                size_t k0 = f0 * blocks * 4 + j, k1 = f1 * blocks * 4 + j;
+                float t[3], s[3];
+                for(int i = 0; i < 3; i++)
+                {
+                    t[i] = keyT[k0 * 3 + i] + (keyT[k1 * 3 + i] - keyT[k0 * 3 + i]) * w;
+                    s[i] = keyS[k0 * 3 + i] + (keyS[k1 * 3 + i] - keyS[k0 * 3 + i]) * w;
+                }
+
+                RefQuat a = keyR[k0], b = keyR[k1];
+                if(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.0f) { b.x = -b.x; b.y = -b.y; b.z = -b.z; b.w = -b.w; }
+                RefQuat q = {a.x + (b.x - a.x) * w, a.y + (b.y - a.y) * w, a.z + (b.z - a.z) * w, a.w + (b.w - a.w) * w};
+                float l = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+                q.x /= l; q.y /= l; q.z /= l; q.w /= l;
+
+                RefMat local = refTRS(t, q, s);
+                model[j] = skeleton.parent[j] == NO_JOINT ? local : refMul(local, model[skeleton.parent[j]]);
+                refPalettes[c * jointCount + j] = refMul(toRef(skeleton.inverseBind[j]), model[j]);
+            }
+        }
+        escape(refPalettes.data());
+        clobber();
+    }, (double)characterCount);
+
+    for(size_t i = 0; i < palettes.size(); i++) r.maxError = fmax(r.maxError, maxError(palettes[i], refPalettes[i]));
+    results.push_back(r);
+}
+
+static void animationCases()
+{
+    animationCase("animation_256x64", 256, 64);
+}
+
+//Scaling of the job system from 1 to N threads (N = hardware threads) on the two parallel
+//frame workloads: a full transform update (1M nodes) and the palettes of 4096 characters.
+//The reference is the same work on the calling thread alone, so speedup is the scaling, and
+//the results must match it exactly. One op is one node / one character.
+static std::deque<std::string> caseNames;
+
+static const char *caseName(const char *prefix, uint32_t threads)
+{
+    caseNames.push_back(std::string(prefix) + std::to_string(threads) + "t");
+    return caseNames.back().c_str();
+}
+
+static void jobsCase(uint32_t threads)
+{
+    const char *transformsName = caseName("jobs_transforms_1M_", threads);
+    const char *animationName = caseName("jobs_animation_4096x64_", threads);
+    if(!selected(transformsName) && !selected(animationName)) return;
+
+    JobSystem jobs;
+    jobs.startUp(threads);
+    auto parallelFor = [&jobs](size_t count, size_t chunkSize, auto &&fn) { jobs.parallelFor(count, chunkSize, fn); };
+
+    if(selected(transformsName))
+    {
+        const size_t count = 1000000;
+        TransformHierarchy h;
+        for(size_t i = 0; i < count; i++)
+        {
+            TransformId parent = i < count / 256 ? NO_TRANSFORM : (TransformId)(rng() % i);
+            h.add(parent, randVec3(-10.0f, 10.0f), randQuat(), randVec3(0.9f, 1.1f));
+        }
+
+        Result r = {transformsName, 0.0, -1.0, 0.0, 0.0, 0.0};
+        r.refNsPerOp = measure([&]()
+        {
+            std::fill(h.dirty.begin(), h.dirty.end(), (uint8_t)1);
+            h.update();
+            escape(h.world.data());
+            clobber();
+        }, (double)count);
+        std::vector<mat4> refWorld = h.world;
+
+        r.nsPerOp = measure([&]()
+        {
+            std::fill(h.dirty.begin(), h.dirty.end(), (uint8_t)1);
+            h.update(parallelFor);
+            escape(h.world.data());
+            clobber();
+        }, (double)count);
+
+        for(size_t i = 0; i < count; i++) r.maxError = fmax(r.maxError, maxError(h.world[i], toRef(refWorld[i])));
+        results.push_back(r);
+    }
+
+    if(selected(animationName))
+    {
+        const size_t characterCount = 4096, jointCount = 64;
+        Skeleton skeleton;
+        for(size_t j = 0; j < jointCount; j++)
+        {
+            skeleton.parent.push_back(j == 0 ? NO_JOINT : (uint32_t)(rng() % j));
+            skeleton.inverseBind.push_back(randTRS());
+        }
+
+        AnimationClip clip;
+        clip.sampleRate = 30.0f;
+        clip.frameCount = 32;
+        clip.blockCount = (uint32_t)skeleton.blockCount();
+        for(size_t b = 0; b < clip.frameCount * clip.blockCount; b++)
+        {
+            clip.translations.push_back(vec3x4(randVec3(-0.5f, 0.5f)));
+            clip.rotations.push_back(quatx4(randQuat()));
+            clip.scales.push_back(vec3x4(randVec3(0.9f, 1.1f)));
+        }
+
+        std::vector<Character> characters(characterCount);
+        for(size_t c = 0; c < characterCount; c++)
+        {
+            Character ch = {&skeleton, &clip, randf(0.0f, 3.0f), true, (uint32_t)(c * jointCount)};
+            characters[c] = ch;
+        }
+
+        std::vector<mat4> palettes(characterCount * jointCount), refPalettes(palettes.size());
+
+        Result r = {animationName, 0.0, -1.0, 0.0, 0.0, 0.0};
+        r.refNsPerOp = measure([&]()
+        {
+            updateCharacters(characters.data(), characterCount, refPalettes.data());
+            escape(refPalettes.data());
+            clobber();
+        }, (double)characterCount);
+
+        r.nsPerOp = measure([&]()
+        {
+            updateCharacters(characters.data(), characterCount, palettes.data(), parallelFor);
+            escape(palettes.data());
+            clobber();
+        }, (double)characterCount);
+
+        for(size_t i = 0; i < palettes.size(); i++) r.maxError = fmax(r.maxError, maxError(palettes[i], toRef(refPalettes[i])));
+        results.push_back(r);
+    }
+
+    jobs.shutDown();
+}
+
+static void jobsCases()
+{
+    uint32_t cores = std::thread::hardware_concurrency();
+    if(cores == 0) cores = 1;
+
+    for(uint32_t threads = 1; threads < cores; threads *= 2) jobsCase(threads);
+    jobsCase(cores);
+}
+
+//============================ output ===============================
+
+//TSC ticks per ns, 0 without a TSC
+static double tscGhz()
+{
+#if defined(VEC_BACKEND_SSE)
+    double t0 = nowNs();
+    unsigned long long c0 = __rdtsc();
+    while(nowNs() - t0 < 50e6) {}
+    double t1 = nowNs();
+    unsigned long long c1 = __rdtsc();
+    return (double)(c1 - c0) / (t1 - t0);
+#else
+    return 0.0;
+#endif
+}
+
+static void printNumber(const char *key, double v, bool valid, const char *end)
+{
+    if(valid) printf("\"%s\": %.4g%s", key, v, end);
+    else      printf("\"%s\": null%s", key, end);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc > 1) filter = argv[1];
+
+    initMatrixKernels();
+    initCullingKernels();
+    initPackingKernels();
+    double ghz = tscGhz();
+
+    matrixCases();
+    vectorCases();
+    cameraCases();
+    batchCases();
+    soaCases();
+    cullingCases();
+    packingCases();
+    transformCases();
+    animationCases();
+    jobsCases();
+
+    bool allOk = true;
+
+    printf("{\n");
+    printf("  \"backend\": \"%s\",\n", VEC_BACKEND_NAME);
+    printf("  \"matrix_kernels\": \"%s\",\n", matrixKernelsName());
+    printf("  \"culling_kernels\": \"%s\",\n", cullingKernelsName());
+    printf("  \"packing_kernels\": \"%s\",\n", packingKernelsName());
+    printf("  ");
+    printNumber("tsc_ghz", ghz, ghz > 0.0, ",\n");
+    printf("  \"cases\": [\n");
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const Result &r = results[i];
+        bool ok = r.maxError <= r.tolerance;
+        allOk = allOk && ok;
+
+        printf("    {\"name\": \"%s\", ", r.name);
+        printNumber("ns_per_op", r.nsPerOp, true, ", ");
+        printNumber("ops_per_cycle", 1.0 / (r.nsPerOp * ghz), ghz > 0.0, ", ");
+        printNumber("latency_ns", r.latencyNs, r.latencyNs >= 0.0, ", ");
+        printNumber("ref_ns_per_op", r.refNsPerOp, true, ", ");
+        printNumber("speedup", r.refNsPerOp / r.nsPerOp, true, ", ");
+        printNumber("max_error", r.maxError, true, ", ");
+        printf("\"ok\": %s}%s\n", ok ? "true" : "false", i + 1 < results.size() ? "," : "");
+
+        if(!ok)
+            fprintf(stderr, "%s: error %g above tolerance %g\n", r.name, r.maxError, r.tolerance);
+        if(r.refNsPerOp < r.nsPerOp)
+            fprintf(stderr, "%s: slower than the scalar reference (%.2f vs %.2f ns)\n", r.name, r.nsPerOp, r.refNsPerOp);
+    }
+
+    printf("  ]\n}\n");
+
+    return allOk ? 0 : 1;
+}
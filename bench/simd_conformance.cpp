@@ -0,0 +1,430 @@
+//Cross-backend conformance test for the math headers (vectors.h, matrix.h, simd_math.h).
+//The backend is picked at compile time (simd_backend.h), so the same program is built once
+//per backend: one build writes its results, the others compare theirs against them. The
+//scalar backend is the reference:
+//
+//  g++ -std=c++17 -O2 -Iinclude -DVEC_FORCE_SCALAR bench/simd_conformance.cpp -o conformance_scalar
+//  g++ -std=c++17 -O2 -Iinclude bench/simd_conformance.cpp -o conformance_sse2
+//  g++ -std=c++17 -O2 -Iinclude -msse4.1 bench/simd_conformance.cpp -o conformance_sse41
+//  g++ -std=c++17 -O2 -Iinclude -mavx2 -mfma bench/simd_conformance.cpp -o conformance_avx2
+//  ./conformance_scalar --write scalar.bin
+//  ./conformance_sse2 --compare scalar.bin
+//  ./conformance_sse41 --compare scalar.bin
+//  ./conformance_avx2 --compare scalar.bin
+//
+//For NEON, cross compile and run under qemu (or on the device) against the same file:
+//
+//  aarch64-linux-gnu-g++ -std=c++17 -O2 -static -Iinclude bench/simd_conformance.cpp -o conformance_neon
+//  qemu-aarch64 ./conformance_neon --compare scalar.bin
+//
+//Every operation runs on the same inputs in every build: they come from the raw output of
+//std::mt19937, which is the same for every standard library, not from a distribution. The
+//8-wide versions (vec3x8 with AVX, simd_math with AVX2) are compared against the 4-wide
+//results of the reference.
+//
+//Per case the largest |result - reference| / max(1, |reference|) must be within the case's
+//tolerance: 0 for the lane operations (abs, min/max, select, shuffles...), which must be bit
+//identical, 1e-5 where FMA contraction or the rsqrt estimate change the rounding. Exits
+//with 1 if a case differs, or if there is nothing to compare.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "vectors.h"
+#include "matrix.h"
+#include "simd_math.h"
+
+#define INPUT_COUNT 256
+#define CONFORMANCE_MAGIC 0x31434556u  //"VEC1"
+
+//============================ inputs ===============================
+
+static std::mt19937 rng(12345);
+
+static float randf(float lo, float hi) { return lo + (hi - lo) * (float)(rng() >> 8) * (1.0f / 16777216.0f); }
+static vec3 randVec3(float lo, float hi) { return vec3(randf(lo, hi), randf(lo, hi), randf(lo, hi)); }
+static vec4 randVec4(float lo, float hi) { return vec4(randf(lo, hi), randf(lo, hi), randf(lo, hi), randf(lo, hi)); }
+static quat randQuat() { return normalize(quat(randVec4(-1.0f, 1.0f))); }
+
+struct Inputs
+{
+    vec4 a[INPUT_COUNT], b[INPUT_COUNT], c[INPUT_COUNT];
+    quat qa[INPUT_COUNT], qb[INPUT_COUNT];
+    float t[INPUT_COUNT];
+    mat4 m[INPUT_COUNT], trs[INPUT_COUNT], rigid[INPUT_COUNT];
+    vec3 from[INPUT_COUNT], to[INPUT_COUNT];
+
+    //simd_math arguments, over the ranges stated in simd_math.h
+    vec4 trig[INPUT_COUNT], tan[INPUT_COUNT], wide[INPUT_COUNT], exp[INPUT_COUNT], positive[INPUT_COUNT];
+};
+
+static Inputs in;
+
+static void generateInputs()
+{
+    for(int i = 0; i < INPUT_COUNT; i++)
+    {
+        in.a[i] = randVec4(-10.0f, 10.0f);
+        in.b[i] = randVec4(-10.0f, 10.0f);
+        in.c[i] = randVec4(-10.0f, 10.0f);
+        in.qa[i] = randQuat();
+        in.qb[i] = randQuat();
+        in.t[i] = randf(0.0f, 1.0f);
+        in.m[i] = mat4(randVec4(-2.0f, 2.0f), randVec4(-2.0f, 2.0f), randVec4(-2.0f, 2.0f), randVec4(-2.0f, 2.0f));
+        in.trs[i] = composeTRS(randVec3(-10.0f, 10.0f), randQuat(), randVec3(0.1f, 10.0f));
+        in.rigid[i] = composeTRS(randVec3(-10.0f, 10.0f), randQuat(), vec3(1.0f, 1.0f, 1.0f));
+        in.from[i] = randVec3(-10.0f, 10.0f);
+        in.to[i] = randVec3(-10.0f, 10.0f);
+
+        in.trig[i] = randVec4(-100.0f, 100.0f);
+        in.tan[i] = randVec4(-1.56f, 1.56f);
+        in.wide[i] = vec4(randf(-1e4f, 1e4f), randf(-10.0f, 10.0f), randf(-1.0f, 1.0f), randf(-1e-3f, 1e-3f));
+        in.exp[i] = randVec4(-87.0f, 88.0f);
+        in.positive[i] = vec4(randf(1e-30f, 1e-20f), randf(1e-3f, 1.0f), randf(1.0f, 1e3f), randf(1e20f, 1e30f));
+    }
+}
+
+//============================ cases ===============================
+
+struct Output
+{
+    std::vector<float> values;
+
+    void put(float f) { values.push_back(f); }
+    void put(vec2 v) { for(int i = 0; i < 2; i++) put(v[i]); }
+    void put(vec3 v) { for(int i = 0; i < 3; i++) put(v[i]); }
+    void put(vec4 v) { for(int i = 0; i < 4; i++) put(v[i]); }
+    void put(__m128 v) { for(int i = 0; i < 4; i++) put(vlane(v, i)); }
+    void put(quat q) { put(q.m); }
+    void put(const mat4 &m) { for(int i = 0; i < 4; i++) put(m.row[i]); }
+    void put(vec3x4 v) { put(v.x); put(v.y); put(v.z); }
+    void put(quatx4 q) { put(q.x); put(q.y); put(q.z); put(q.w); }
+#if defined(VEC_AVX)
+    void put(__m256 v) { alignas(32) float f[8]; _mm256_store_ps(f, v); for(int i = 0; i < 8; i++) put(f[i]); }
+#endif
+};
+
+struct Case
+{
+    std::string name;
+    double tolerance;
+    std::vector<float> values;
+};
+
+static std::vector<Case> cases;
+
+//body(i, out) writes the results for input i
+template<typename Body>
+static void addCase(const char *name, double tolerance, Body body)
+{
+    Output out;
+    for(int i = 0; i < INPUT_COUNT; i++) body(i, out);
+
+    Case c = {name, tolerance, std::move(out.values)};
+    cases.push_back(std::move(c));
+}
+
+//the 4 SoA lanes of input i and the next 3, so each input is in lane 0 once
+static int lane(int i, int l) { return (i + l) % INPUT_COUNT; }
+
+static vec3x4 soa(const vec4 *v, int i)
+{
+    return vec3x4(vec3(v[lane(i, 0)].m), vec3(v[lane(i, 1)].m), vec3(v[lane(i, 2)].m), vec3(v[lane(i, 3)].m));
+}
+
+static quatx4 soa(const quat *q, int i)
+{
+    return quatx4(q[lane(i, 0)], q[lane(i, 1)], q[lane(i, 2)], q[lane(i, 3)]);
+}
+
+#if defined(VEC_AVX)
+//lanes 0-3 are soa(v, i), 4-7 repeat them, so the results compare with the 4-wide ones
+static vec3x8 soa8(const vec4 *v, int i)
+{
+    vec3x4 s = soa(v, i);
+    return vec3x8(s, s);
+}
+
+static void put4(Output &out, vec3x8 v)
+{
+    out.put(v.lo());
+}
+
+static void put4(Output &out, __m256 v)
+{
+    out.put(_mm256_castps256_ps128(v));
+}
+#endif
+
+#define EXACT 0.0
+#define ROUNDING 1e-5   //FMA contraction: a * b - c * d rounds once, off by an ulp of the products
+#define RSQRT 1e-6      //the rsqrt estimate + Newton step against an exact 1/sqrt
+#define INVERSE 1e-5    //contraction in the cofactors, amplified by the conditioning
+
+static void vectorCases()
+{
+    addCase("vec4_add_sub_mul", ROUNDING, [](int i, Output &o) { o.put(in.a[i] + in.b[i] * in.c[i] - in.a[i]); });
+    //not EXACT: ARMv7 NEON has no divide, it refines a reciprocal estimate (~1 ulp)
+    addCase("vec4_div", ROUNDING, [](int i, Output &o) { o.put(in.a[i] / in.b[i]); });
+    addCase("vec4_min_max_abs", EXACT, [](int i, Output &o) { o.put(vec_min(in.a[i], in.b[i])); o.put(vec_max(in.a[i], in.b[i])); o.put(abs(in.a[i])); });
+    addCase("vec4_compare_select", EXACT, [](int i, Output &o) { o.put(select(in.a[i] < in.b[i], in.a[i], in.c[i])); o.put((float)mask(in.a[i] < in.b[i])); });
+    addCase("vec4_clamp", EXACT, [](int i, Output &o) { o.put(clamp(in.a[i], in.b[i], in.b[i] + abs(in.c[i]))); });
+    addCase("vec4_sum_dot", ROUNDING, [](int i, Output &o) { o.put(sum(in.a[i])); o.put(dot(in.a[i], in.b[i])); o.put(dotv(in.a[i], in.b[i])); });
+    addCase("vec4_length_normalize", ROUNDING, [](int i, Output &o) { o.put(length(in.a[i])); o.put(lengthv(in.a[i])); o.put(normalize(in.a[i])); });
+    addCase("vec4_lerp", ROUNDING, [](int i, Output &o) { o.put(lerp(in.a[i], in.b[i], in.t[i])); });
+
+    addCase("vec3_cross", ROUNDING, [](int i, Output &o) { o.put(cross(vec3(in.a[i].m), vec3(in.b[i].m))); });
+    addCase("vec3_dot_length", ROUNDING, [](int i, Output &o)
+    {
+        vec3 a(in.a[i].m), b(in.b[i].m);
+        o.put(dot(a, b)); o.put(length(a)); o.put(lengthv(a)); o.put(sumv(a));
+    });
+    addCase("vec3_normalize", ROUNDING, [](int i, Output &o) { o.put(normalize(vec3(in.a[i].m))); });
+    addCase("vec3_hmin_hmax", EXACT, [](int i, Output &o) { vec3 a(in.a[i].m); o.put(hmin(a)); o.put(hmax(a)); });
+    addCase("vec2_ops", ROUNDING, [](int i, Output &o)
+    {
+        vec2 a(in.a[i][0], in.a[i][1]), b(in.b[i][0], in.b[i][1]);
+        o.put(a * b + a); o.put(dot(a, b)); o.put(normalize(a));
+    });
+    addCase("rsqrtv", RSQRT, [](int i, Output &o) { o.put(rsqrtv(abs(in.a[i]).m)); });
+
+    addCase("quat_mul_rotate", ROUNDING, [](int i, Output &o)
+    {
+        o.put(in.qa[i] * in.qb[i]); o.put(rotate(in.qa[i], vec3(in.a[i].m))); o.put(inverse(in.qa[i]));
+    });
+    addCase("quat_slerp_nlerp", ROUNDING, [](int i, Output &o)
+    {
+        o.put(slerp(in.qa[i], in.qb[i], in.t[i])); o.put(nlerp(in.qa[i], in.qb[i], in.t[i]));
+    });
+    addCase("quat_axis_angle", ROUNDING, [](int i, Output &o) { o.put(quatAxisAngle(normalize(vec3(in.a[i].m)), in.t[i] * 6.0f)); });
+}
+
+static void soaCases()
+{
+    addCase("soa_dot_cross", ROUNDING, [](int i, Output &o) { vec3x4 a = soa(in.a, i), b = soa(in.b, i); o.put(dot(a, b)); o.put(cross(a, b)); });
+    addCase("soa_length_normalize", ROUNDING, [](int i, Output &o) { vec3x4 a = soa(in.a, i); o.put(length(a)); o.put(normalize(a)); });
+    addCase("soa_normalize_fast", RSQRT, [](int i, Output &o) { o.put(normalize_fast(soa(in.a, i))); });
+    addCase("soa_clamp_select", EXACT, [](int i, Output &o)
+    {
+        vec3x4 a = soa(in.a, i), b = soa(in.b, i), c = soa(in.c, i);
+        o.put(clamp(a, b, b + abs(c))); o.put(select(a < b, a, c));
+    });
+    addCase("soa_lerp", ROUNDING, [](int i, Output &o) { o.put(lerp(soa(in.a, i), soa(in.b, i), in.t[i])); });
+    addCase("soa_quat", ROUNDING, [](int i, Output &o)
+    {
+        quatx4 a = soa(in.qa, i), b = soa(in.qb, i);
+        vec4 t(in.t[lane(i, 0)], in.t[lane(i, 1)], in.t[lane(i, 2)], in.t[lane(i, 3)]);
+        o.put(a * b); o.put(rotate(a, soa(in.a, i))); o.put(nlerp(a, b, t)); o.put(slerpApprox(a, b, t));
+    });
+
+#if defined(VEC_AVX)
+    addCase("soa_dot_cross/x8", ROUNDING, [](int i, Output &o) { vec3x8 a = soa8(in.a, i), b = soa8(in.b, i); put4(o, dot(a, b).m); put4(o, cross(a, b)); });
+    addCase("soa_length_normalize/x8", ROUNDING, [](int i, Output &o) { vec3x8 a = soa8(in.a, i); put4(o, length(a).m); put4(o, normalize(a)); });
+    addCase("soa_clamp_select/x8", EXACT, [](int i, Output &o)
+    {
+        vec3x8 a = soa8(in.a, i), b = soa8(in.b, i), c = soa8(in.c, i);
+        put4(o, clamp(a, b, b + abs(c))); put4(o, select(a < b, a, c));
+    });
+    addCase("soa_lerp/x8", ROUNDING, [](int i, Output &o) { put4(o, lerp(soa8(in.a, i), soa8(in.b, i), in.t[i])); });
+#endif
+}
+
+static void matrixCases()
+{
+    addCase("mat4_mul", ROUNDING, [](int i, Output &o) { o.put(in.m[i] * in.m[lane(i, 1)]); o.put(in.a[i] * in.m[i]); o.put(in.m[i] * in.a[i]); });
+    addCase("mat4_transpose", EXACT, [](int i, Output &o) { mat4 m = in.m[i]; transpose(m); o.put(m); });
+    addCase("mat4_inverse", INVERSE, [](int i, Output &o) { o.put(inverse(in.trs[i])); o.put(inverseAffine(in.trs[i])); o.put(inverseRigid(in.rigid[i])); });
+    addCase("mat4_normal_matrix", INVERSE, [](int i, Output &o) { o.put(normalMatrix(in.trs[i])); });
+    addCase("trs_compose_decompose", ROUNDING, [](int i, Output &o)
+    {
+        vec3 t, s;
+        quat r;
+        decomposeTRS(in.trs[i], t, r, s);
+        o.put(t); o.put(r); o.put(s);
+        o.put(composeTRS(t, r, s));
+    });
+    addCase("trs_compose_soa", ROUNDING, [](int i, Output &o)
+    {
+        mat4 out[4];
+        composeTRS(soa(in.a, i), normalize(soa(in.qa, i)), soa(in.b, i), out);
+        for(int l = 0; l < 4; l++) o.put(out[l]);
+    });
+    addCase("quat_mat4", ROUNDING, [](int i, Output &o) { o.put(quatToMat4(in.qa[i])); o.put(mat4ToQuat(quatToMat4(in.qa[i]))); });
+    addCase("lookAt_perspective", ROUNDING, [](int i, Output &o)
+    {
+        o.put(lookAt(in.from[i], in.to[i], vec3(0.0f, 1.0f, 0.0f)));
+        o.put(vulkanPerspective(0.5f + in.t[i], 30.0f + 90.0f * in.t[i], 0.1f, 1000.0f));
+    });
+}
+
+static void simdMathCases()
+{
+    addCase("vsincos", ROUNDING, [](int i, Output &o) { __m128 s, c; vsincos(in.trig[i].m, &s, &c); o.put(s); o.put(c); });
+    addCase("vtan", ROUNDING, [](int i, Output &o) { o.put(vtan(in.tan[i].m)); });
+    addCase("vatan_atan2", ROUNDING, [](int i, Output &o) { o.put(vatan(in.wide[i].m)); o.put(vatan2(in.wide[i].m, in.a[i].m)); });
+    addCase("vexp", ROUNDING, [](int i, Output &o) { o.put(vexp(in.exp[i].m)); });
+    addCase("vlog", ROUNDING, [](int i, Output &o) { o.put(vlog(in.positive[i].m)); });
+    addCase("vrsqrt", RSQRT, [](int i, Output &o) { o.put(vrsqrt(in.positive[i].m)); });
+
+#if defined(VEC_AVX2)
+    //each input in both halves
+    auto wide = [](const vec4 &v) { return _mm256_set_m128(v.m, v.m); };
+    addCase("vsincos/x8", ROUNDING, [&](int i, Output &o) { __m256 s, c; vsincos(wide(in.trig[i]), &s, &c); put4(o, s); put4(o, c); });
+    addCase("vtan/x8", ROUNDING, [&](int i, Output &o) { put4(o, vtan(wide(in.tan[i]))); });
+    addCase("vatan_atan2/x8", ROUNDING, [&](int i, Output &o) { put4(o, vatan(wide(in.wide[i]))); put4(o, vatan2(wide(in.wide[i]), wide(in.a[i]))); });
+    addCase("vexp/x8", ROUNDING, [&](int i, Output &o) { put4(o, vexp(wide(in.exp[i]))); });
+    addCase("vlog/x8", ROUNDING, [&](int i, Output &o) { put4(o, vlog(wide(in.positive[i]))); });
+    addCase("vrsqrt/x8", RSQRT, [&](int i, Output &o) { put4(o, vrsqrt(wide(in.positive[i]))); });
+#endif
+}
+
+//============================ file ===============================
+//magic, backend name, case count, then per case: name, value count, values. Native byte
+//order, the backends are all little endian.
+
+static void writeString(FILE *f, const std::string &s)
+{
+    uint32_t n = (uint32_t)s.size();
+    fwrite(&n, sizeof(n), 1, f);
+    fwrite(s.data(), 1, n, f);
+}
+
+static bool readString(FILE *f, std::string &s)
+{
+    uint32_t n;
+    if(fread(&n, sizeof(n), 1, f) != 1 || n > 4096) return false;
+    s.resize(n);
+    return fread(&s[0], 1, n, f) == n;
+}
+
+static bool writeCases(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if(!f) return false;
+
+    uint32_t magic = CONFORMANCE_MAGIC, count = (uint32_t)cases.size();
+    fwrite(&magic, sizeof(magic), 1, f);
+    writeString(f, VEC_BACKEND_NAME);
+    fwrite(&count, sizeof(count), 1, f);
+    for(size_t c = 0; c < cases.size(); c++)
+    {
+        uint32_t n = (uint32_t)cases[c].values.size();
+        writeString(f, cases[c].name);
+        fwrite(&n, sizeof(n), 1, f);
+        fwrite(cases[c].values.data(), sizeof(float), n, f);
+    }
+    return fclose(f) == 0;
+}
+
+static bool readCases(const char *path, std::string &backend, std::vector<Case> &ref)
+{
+    FILE *f = fopen(path, "rb");
+    if(!f) return false;
+
+    uint32_t magic = 0, count = 0;
+    bool ok = fread(&magic, sizeof(magic), 1, f) == 1 && magic == CONFORMANCE_MAGIC &&
+              readString(f, backend) && fread(&count, sizeof(count), 1, f) == 1;
+    for(uint32_t c = 0; ok && c < count; c++)
+    {
+        Case r = {"", 0.0, {}};
+        uint32_t n = 0;
+        ok = readString(f, r.name) && fread(&n, sizeof(n), 1, f) == 1 && n < (1u << 24);
+        if(!ok) break;
+
+        r.values.resize(n);
+        ok = fread(r.values.data(), sizeof(float), n, f) == n;
+        ref.push_back(std::move(r));
+    }
+    fclose(f);
+    return ok;
+}
+
+//============================ compare ===============================
+
+static double difference(float a, float b)
+{
+    if(a != a || b != b) return (a != a && b != b) ? 0.0 : INFINITY;
+    if(a == b) return 0.0;   //also equal infinities
+    return fabs((double)a - b) / fmax(1.0, fabs((double)b));
+}
+
+static int compare(const char *path)
+{
+    std::string backend;
+    std::vector<Case> ref;
+    if(!readCases(path, backend, ref))
+    {
+        fprintf(stderr, "Unable to read %s\n", path);
+        return 1;
+    }
+    printf("%s against %s\n", VEC_BACKEND_NAME, backend.c_str());
+
+    int compared = 0, failed = 0;
+    for(size_t c = 0; c < cases.size(); c++)
+    {
+        //the 8-wide versions against the 4-wide reference
+        std::string name = cases[c].name;
+        size_t slash = name.find('/');
+        if(slash != std::string::npos) name = name.substr(0, slash);
+
+        const Case *r = nullptr;
+        for(size_t i = 0; i < ref.size() && !r; i++) if(ref[i].name == name) r = &ref[i];
+        if(!r)
+        {
+            printf("%-26s not in the reference, skipped\n", cases[c].name.c_str());
+            continue;
+        }
+
+        bool ok = r->values.size() == cases[c].values.size();
+        double worst = 0.0;
+        size_t worstAt = 0;
+        for(size_t i = 0; ok && i < r->values.size(); i++)
+        {
+            double d = difference(cases[c].values[i], r->values[i]);
+            if(d > worst) { worst = d; worstAt = i; }
+        }
+        ok = ok && worst <= cases[c].tolerance;
+
+        printf("%-26s max %.3g", cases[c].name.c_str(), worst);
+        if(worst > 0.0) printf(" (%.9g against %.9g)", cases[c].values[worstAt], r->values[worstAt]);
+        printf(", tolerance %g  %s\n", cases[c].tolerance, ok ? "ok" : "FAILED");
+
+        compared++;
+        if(!ok) failed++;
+    }
+
+    printf("%d cases compared, %d failed\n", compared, failed);
+    return (failed || !compared) ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc != 3 || (strcmp(argv[1], "--write") && strcmp(argv[1], "--compare")))
+    {
+        fprintf(stderr, "Usage: %s --write <file> | --compare <file>\n", argv[0]);
+        return 2;
+    }
+
+    generateInputs();
+    vectorCases();
+    soaCases();
+    matrixCases();
+    simdMathCases();
+
+    if(strcmp(argv[1], "--write") == 0)
+    {
+        if(!writeCases(argv[2]))
+        {
+            fprintf(stderr, "Unable to write %s\n", argv[2]);
+            return 1;
+        }
+        printf("%s: %zu cases written to %s\n", VEC_BACKEND_NAME, cases.size(), argv[2]);
+        return 0;
+    }
+    return compare(argv[2]);
+}
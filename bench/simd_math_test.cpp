@@ -0,0 +1,275 @@
+//Accuracy test for simd_math.h: sweeps each function over the range stated at the top of the
+//header against libm in double precision and fails if the error exceeds the stated bound.
+//Like math_bench it needs no window, GPU or Vulkan SDK:
+//
+//  g++ -std=c++17 -O2 -Iinclude bench/simd_math_test.cpp -o simd_math_test
+//  cl /std:c++17 /O2 /EHsc /Iinclude bench\simd_math_test.cpp
+//
+//Add -mavx2 -mfma (/arch:AVX2) to also test the 8-wide versions, -DVEC_FORCE_SCALAR for the
+//scalar backend (see simd_backend.h).
+//
+//Usage: simd_math_test [--full]
+//
+//By default every 127th float of each range is tested (a few seconds); --full tests every
+//float, which is how the bounds in the header were measured. atan2 always takes 2e7 random
+//pairs. Prints one line per function with the largest error found and the input it was found
+//at, and exits with 1 if any function is above its bound.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <random>
+
+#include "simd_math.h"
+
+#define DEFAULT_STRIDE 127
+#define ATAN2_PAIRS 20000000
+
+struct Bound
+{
+    const char *name;
+    double ulp;
+    double ulpAbove;    //the ulp bound applies where |reference| >= ulpAbove
+    double absError;    //and this one everywhere, 0: none
+};
+
+struct Worst
+{
+    double ulp;
+    double absError;
+    float x, y;
+    bool ok;
+};
+
+static uint32_t stride = DEFAULT_STRIDE;
+static bool failed = false;
+
+//Float bit patterns mapped to integers in the order of the floats, so a range of floats is a
+//range of integers
+static uint32_t orderedKey(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+static float fromKey(uint32_t k)
+{
+    uint32_t u = (k & 0x80000000u) ? (k & 0x7fffffffu) : ~k;
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+//the spacing of the floats at ref, denormal spacing below FLT_MIN
+static double ulpOf(double ref)
+{
+    double a = fabs(ref);
+    if(a < FLT_MIN) return ldexp(1.0, -149);
+
+    int e;
+    frexp(a, &e);
+    return ldexp(1.0, e - 24);
+}
+
+static void record(Worst &w, float r, double ref, float x, float y, const Bound &bound)
+{
+    double absError = fabs((double)r - ref);
+    double ulp = absError / ulpOf(ref);
+    if(r != r && ref == ref) ulp = absError = INFINITY;   //NaN where a number was expected
+    if(absError > w.absError) w.absError = absError;
+
+    if(bound.absError > 0.0 && absError > bound.absError) w.ok = false;
+
+    //near the zeros of sin and cos the ulp is meaningless, only the absolute error bound applies
+    if(fabs(ref) < bound.ulpAbove) return;
+
+    bool ok = ulp <= bound.ulp;
+    if(!ok) w.ok = false;
+
+    //the worst of the passing inputs too, the margin is worth seeing
+    if(ulp > w.ulp && (ok || !w.ok))
+    {
+        w.ulp = ulp;
+        w.x = x;
+        w.y = y;
+    }
+}
+
+static void report(const Bound &bound, const Worst &w, const char *width)
+{
+    printf("%-8s %-3s max %6.3f ulp at x = %-14.9g", bound.name, width, w.ulp, w.x);
+    if(w.y == w.y) printf(" y = %-14.9g", w.y);
+    else printf(" %16s", "");
+    printf(" bound %.2f ulp", bound.ulp);
+    if(bound.ulpAbove > 0.0) printf(" where |f(x)| >= %g", bound.ulpAbove);
+    if(bound.absError > 0.0) printf(", absolute error %.2e bound %.0e", w.absError, bound.absError);
+    printf("  %s\n", w.ok ? "ok" : "FAILED");
+
+    if(!w.ok) failed = true;
+}
+
+//Calls f4 (and f8 with AVX2) on every stride-th float of [lo, hi] and compares with ref.
+template<typename F4, typename F8, typename Ref>
+static void sweep(const Bound &bound, float lo, float hi, F4 f4, F8 f8, Ref ref)
+{
+    Worst w4 = {0.0, 0.0, 0.0f, NAN, true};
+#if defined(VEC_AVX2)
+    Worst w8 = w4;
+#else
+    (void)f8;
+#endif
+
+    uint64_t first = orderedKey(lo), last = orderedKey(hi);
+    for(uint64_t k = first; k <= last; k += 8 * (uint64_t)stride)
+    {
+        alignas(32) float in[8], out[8];
+        for(int i = 0; i < 8; i++) in[i] = fromKey((uint32_t)std::min(k + i * (uint64_t)stride, last));
+
+        _mm_store_ps(out, f4(_mm_load_ps(in)));
+        _mm_store_ps(out + 4, f4(_mm_load_ps(in + 4)));
+        for(int i = 0; i < 8; i++) record(w4, out[i], ref((double)in[i]), in[i], NAN, bound);
+
+#if defined(VEC_AVX2)
+        _mm256_store_ps(out, f8(_mm256_load_ps(in)));
+        for(int i = 0; i < 8; i++) record(w8, out[i], ref((double)in[i]), in[i], NAN, bound);
+#endif
+    }
+
+    report(bound, w4, "x4");
+#if defined(VEC_AVX2)
+    report(bound, w8, "x8");
+#endif
+}
+
+//|y| and |x| log uniform over the whole float range, random signs
+static float randWide(std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> e(-126.0f, 127.0f);
+    float f = exp2f(e(rng));
+    return (rng() & 1) ? -f : f;
+}
+
+static void sweepAtan2(const Bound &bound)
+{
+    Worst w4 = {0.0, 0.0, 0.0f, 0.0f, true};
+#if defined(VEC_AVX2)
+    Worst w8 = w4;
+#endif
+    std::mt19937 rng(12345);
+
+    for(int n = 0; n < ATAN2_PAIRS; n += 8)
+    {
+        alignas(32) float y[8], x[8], out[8];
+        for(int i = 0; i < 8; i++)
+        {
+            y[i] = randWide(rng);
+            //every other pair with |y| ~ |x|, where the quadrant and the pi/4 reduction meet
+            x[i] = (i & 1) ? y[i] * std::uniform_real_distribution<float>(-2.0f, 2.0f)(rng) : randWide(rng);
+        }
+
+        _mm_store_ps(out, vatan2(_mm_load_ps(y), _mm_load_ps(x)));
+        _mm_store_ps(out + 4, vatan2(_mm_load_ps(y + 4), _mm_load_ps(x + 4)));
+        for(int i = 0; i < 8; i++) record(w4, out[i], atan2((double)y[i], (double)x[i]), x[i], y[i], bound);
+
+#if defined(VEC_AVX2)
+        _mm256_store_ps(out, vatan2(_mm256_load_ps(y), _mm256_load_ps(x)));
+        for(int i = 0; i < 8; i++) record(w8, out[i], atan2((double)y[i], (double)x[i]), x[i], y[i], bound);
+#endif
+    }
+
+    report(bound, w4, "x4");
+#if defined(VEC_AVX2)
+    report(bound, w8, "x8");
+#endif
+}
+
+//the special values documented in the header
+static void specialValues()
+{
+    struct Case { const char *what; float got, expected; };
+    alignas(16) float r[4];
+
+    _mm_store_ps(r, vatan2(_mm_setzero_ps(), _mm_setzero_ps()));
+    float atan2Zero = r[0];
+    _mm_store_ps(r, vlog(_mm_setr_ps(0.0f, -1.0f, 1.0f, FLT_MIN)));
+    float log0 = r[0], logNeg = r[1], log1 = r[2];
+    _mm_store_ps(r, vexp(_mm_setr_ps(-1000.0f, 1000.0f, 0.0f, 0.0f)));
+    float expLo = r[0], expHi = r[1], exp0 = r[2];
+
+    Case cases[] =
+    {
+        {"atan2(0, 0)", atan2Zero, 0.0f},
+        {"log(0)", log0, -INFINITY},
+        {"log(1)", log1, 0.0f},
+        {"exp(0)", exp0, 1.0f},
+        {"exp(-1000) (clamped)", expLo, expf(-87.3365447504019f)},
+        {"exp(1000) (clamped)", expHi, expf(88.3762626647949f)},
+    };
+
+    bool ok = logNeg != logNeg;
+    if(!ok) printf("log(-1)                            = %g, expected NaN  FAILED\n", logNeg);
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        //the clamped exp only within an ulp of libm
+        float d = fabsf(cases[i].got - cases[i].expected);
+        if(d <= (float)ulpOf(cases[i].expected) || cases[i].got == cases[i].expected) continue;
+        printf("%-34s = %g, expected %g  FAILED\n", cases[i].what, cases[i].got, cases[i].expected);
+        ok = false;
+    }
+    printf("special values %s\n", ok ? "ok" : "FAILED");
+    if(!ok) failed = true;
+}
+
+#if defined(VEC_AVX2)
+#define F8(f) [](__m256 x) { return f(x); }
+#else
+#define F8(f) [](__m128 x) { return x; }
+#endif
+
+int main(int argc, char **argv)
+{
+    if(argc > 1 && strcmp(argv[1], "--full") == 0) stride = 1;
+
+#if defined(VEC_BACKEND_SCALAR)
+    printf("backend scalar, ");
+#elif defined(VEC_BACKEND_NEON)
+    printf("backend NEON, ");
+#elif defined(VEC_AVX2)
+    printf("backend AVX2, ");
+#else
+    printf("backend SSE, ");
+#endif
+    printf("every %u%s float\n", stride, stride == 1 ? "st" : "th");
+
+    //the bounds of the table at the top of simd_math.h
+    const Bound sinBound = {"vsin", 1.6, 1e-3, 8e-8};
+    const Bound cosBound = {"vcos", 1.6, 1e-3, 8e-8};
+    const Bound tanBound = {"vtan", 3.0, 0.0, 0.0};
+    const Bound atanBound = {"vatan", 3.0, 0.0, 0.0};
+    const Bound atan2Bound = {"vatan2", 3.5, 0.0, 0.0};
+    const Bound expBound = {"vexp", 1.05, 0.0, 0.0};
+    const Bound logBound = {"vlog", 1.0, 0.0, 0.0};
+    const Bound rsqrtBound = {"vrsqrt", 5.0, 0.0, 0.0};
+
+    sweep(sinBound, -8192.0f, 8192.0f,
+          [](__m128 x) { return vsin(x); }, F8(vsin), [](double x) { return sin(x); });
+    sweep(cosBound, -8192.0f, 8192.0f,
+          [](__m128 x) { return vcos(x); }, F8(vcos), [](double x) { return cos(x); });
+    sweep(tanBound, -1.5607963f, 1.5607963f,
+          [](__m128 x) { return vtan(x); }, F8(vtan), [](double x) { return tan(x); });
+    sweep(atanBound, -FLT_MAX, FLT_MAX,
+          [](__m128 x) { return vatan(x); }, F8(vatan), [](double x) { return atan(x); });
+    sweepAtan2(atan2Bound);
+    sweep(expBound, -87.3f, 88.3f,
+          [](__m128 x) { return vexp(x); }, F8(vexp), [](double x) { return exp(x); });
+    sweep(logBound, FLT_MIN, FLT_MAX,
+          [](__m128 x) { return vlog(x); }, F8(vlog), [](double x) { return log(x); });
+    sweep(rsqrtBound, FLT_MIN, FLT_MAX,
+          [](__m128 x) { return vrsqrt(x); }, F8(vrsqrt), [](double x) { return 1.0 / sqrt(x); });
+    specialValues();
+
+    return failed ? 1 : 0;
+}
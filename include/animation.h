@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "vectors.h"
+#include "matrix.h"
+
+//Skeletal animation on the CPU: keyframe sampling and skinning palettes.
+//
+//Clips are sampled at a fixed rate, so the two keys around a time are found with a multiply,
+//and store every joint at every frame, 4 joints per block in SoA form (vec3x4 / quatx4). A
+//pose is then sampled with plain lerps and nlerps over the blocks of two frames, with no
+//per-joint track lookups or transposes.
+//
+//The palette of a character holds inverseBind[j] * model[j] for each joint j: the matrix
+//that takes a bind pose vertex to where joint j has moved it. It is what the skinning
+//compute shader (shaders/skinning) reads, see skinning.h.
+
+static const uint32_t NO_JOINT = 0xFFFFFFFF;
+
+struct Skeleton
+{
+	std::vector<uint32_t> parent;   //NO_JOINT for the root, a parent always comes before its children
+	std::vector<mat4> inverseBind;  //inverse of each joint's model space bind matrix
+
+	size_t jointCount() const { return parent.size(); }
+	size_t blockCount() const { return (parent.size() + 3) / 4; }
+};
+
+struct AnimationClip
+{
+	float sampleRate;        //frames per second
+	uint32_t frameCount;
+	uint32_t blockCount;     //joint blocks per frame, Skeleton::blockCount() of the skeleton it animates
+
+	//local transforms of joints 4b..4b+3 at frame f are at [f * blockCount + b]
+	std::vector<vec3x4> translations;
+	std::vector<quatx4> rotations;
+	std::vector<vec3x4> scales;
+
+	float duration() const { return (float)(frameCount - 1) / sampleRate; }
+};
+
+//Local joint transforms, in the same block layout as one frame of a clip.
+struct Pose
+{
+	std::vector<vec3x4> translations;
+	std::vector<quatx4> rotations;
+	std::vector<vec3x4> scales;
+};
+
+//Samples the clip at time (seconds), wrapping around when loop is set and clamping to the
+//ends otherwise.
+void samplePose(const AnimationClip &clip, float time, bool loop, Pose &pose);
+
+//Model space joint matrices of the pose, then palette[j] = inverseBind[j] * model[j].
+//model needs room for blockCount() * 4 matrices, palette for jointCount().
+void computePalette(const Skeleton &skeleton, const Pose &pose, mat4 *model, mat4 *palette);
+
+struct Character
+{
+	const Skeleton *skeleton;
+	const AnimationClip *clip;
+	float time;
+	bool loop;
+	uint32_t paletteOffset;  //index of the character's first joint in the palette array
+};
+
+//Samples and evaluates count characters into palettes. The palettes are only written, in
+//order, so they can go straight to mapped upload memory.
+void updateCharacters(const Character *characters, size_t count, mat4 *palettes);
+
+//The same spread over threads: parallelFor(count, chunkSize, fn) must call fn(begin, end)
+//over [0, count) (from any threads) and return once every call is done. Characters are
+//independent, so the chunks need no synchronization.
+template<typename ParallelFor>
+void updateCharacters(const Character *characters, size_t count, mat4 *palettes, ParallelFor &&parallelFor)
+{
+	const size_t charactersPerChunk = 16;
+	parallelFor(count, charactersPerChunk, [characters, palettes](size_t begin, size_t end)
+	{
+		updateCharacters(characters + begin, end - begin, palettes);
+	});
+}
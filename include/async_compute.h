@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "typedefs_and_macros.h"
+#include "barriers.h"
+#include "frame_scheduler.h"
+
+//Compute work submitted on its own queue, ahead of the frame's graphics.
+//
+//A frame's compute work (culling, simulation, skinning...) is recorded into the frame slot's
+//compute command buffer and submitted on TIMELINE_COMPUTE before the frame's graphics is
+//recorded. On a dedicated compute queue it then runs while the GPU is still busy with the
+//previous frame's graphics, and the graphics submission waits for its timeline value only at
+//the stages that read the results.
+//
+//Results graphics reads are handed off: with separate queue families, a buffer written on
+//the compute queue is released there and acquired by the graphics queue, the two barriers
+//recorded by handOff() and acquire(). With one family, or no compute-only family to begin
+//with (TIMELINE_COMPUTE then submits to the graphics queue), the semaphore wait is all it
+//takes. Nothing is handed back: compute rewrites its outputs every frame, and contents that
+//are overwritten need no ownership transfer. The slot's previous frame, graphics included,
+//is done before the slot's compute work is recorded again (FrameScheduler::beginFrame()).
+
+//A buffer written by compute and read by graphics.
+struct ComputeHandoff
+{
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	VkPipelineStageFlags2KHR srcStages;  //of the writes on the compute queue
+	VkAccessFlags2KHR srcAccess;
+	VkPipelineStageFlags2KHR dstStages;  //of the reads on the graphics queue
+	VkAccessFlags2KHR dstAccess;
+};
+
+struct AsyncCompute
+{
+	VkDevice device;
+	uint32 computeFamily;
+	uint32 graphicsFamily;
+
+	std::vector<VkCommandPool> pools;  //per frame slot, on the compute family
+	std::vector<VkCommandBuffer> cmds;
+	uint32 frame;
+	bool recording;
+
+	BarrierBatch releases;  //recorded at the end of the compute command buffer
+	BarrierBatch acquires;  //recorded into the graphics command buffer
+	VkPipelineStageFlags2KHR readStages;  //of this frame's handoffs
+
+	SubmitWait graphicsWait;  //value 0 when there is nothing to wait for
+
+	void init(VkDevice device,
+	          uint32 computeFamily,
+	          uint32 graphicsFamily,
+	          uint32 framesInFlight,
+	          PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2);
+	void destroy();
+
+	bool separateFamily() const { return computeFamily != graphicsFamily; }
+
+	//--- compute side ---
+	//Resets the frame slot's pool and begins its command buffer. Call after
+	//FrameScheduler::beginFrame() returned frame.
+	VkCommandBuffer begin(uint32 frame);
+	VkCommandBuffer cmd() const { return cmds[frame]; }
+
+	//buffer's writes are read by graphics this frame.
+	void handOff(const ComputeHandoff &handoff);
+
+	//Ends the command buffer and submits it on TIMELINE_COMPUTE once waits are met.
+	uint64 submit(FrameScheduler &scheduler, const SubmitWait *waits = nullptr, uint32 waitCount = 0);
+
+	//--- graphics side ---
+	//Records the acquires of the handoffs into cmd, outside a render pass. Submit cmd with the
+	//wait from takeGraphicsWait().
+	void acquire(VkCommandBuffer cmd);
+
+	//The wait for the last compute submission, at the stages reading its results. False when
+	//nothing was submitted since the last call.
+	bool takeGraphicsWait(SubmitWait &wait);
+};
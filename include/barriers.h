@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "typedefs_and_macros.h"
+
+//Pipeline barriers collected and recorded together.
+//
+//Barriers are added one by one and flush() records all of them with a single
+//vkCmdPipelineBarrier2KHR (VK_KHR_synchronization2), where every barrier keeps its own stage
+//and access masks. Without synchronization2 it falls back to a single vkCmdPipelineBarrier
+//with the stage masks of all the barriers merged.
+//
+//Images can be tracked: the batch then remembers the layout, the last write and the reads
+//since of each mip level and array layer, and image() only takes where they are going, like
+//RenderGraph does for its resources. A read in the same layout needs no barrier once the
+//last write has been made visible to its stages and accesses.
+//
+//Masks are always given as synchronization2 flags. The stages and accesses that exist in
+//Vulkan 1.0 have the same bits in both, so the legacy path just keeps the low 32 bits.
+
+struct SubresourceState
+{
+	VkImageLayout layout;
+	VkPipelineStageFlags2KHR writeStages;   //of the last write or layout change, 0 if none
+	VkAccessFlags2KHR writeAccess;
+	VkPipelineStageFlags2KHR readStages;    //reads since the last write
+	VkPipelineStageFlags2KHR visibleStages; //what the last write has been made visible to
+	VkAccessFlags2KHR visibleAccess;
+};
+
+struct TrackedImage
+{
+	VkImage image;
+	VkImageAspectFlags aspect;
+	uint32 mipLevels;
+	uint32 arrayLayers;
+	std::vector<SubresourceState> states;  //layer * mipLevels + mip
+};
+
+struct BarrierBatch
+{
+	PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2;  //null for the legacy path
+
+	std::vector<TrackedImage> images;
+
+	std::vector<VkMemoryBarrier2KHR> memoryBarriers;
+	std::vector<VkBufferMemoryBarrier2KHR> bufferBarriers;
+	std::vector<VkImageMemoryBarrier2KHR> imageBarriers;
+
+	//legacy path scratch
+	std::vector<VkBufferMemoryBarrier> legacyBufferBarriers;
+	std::vector<VkImageMemoryBarrier> legacyImageBarriers;
+
+	void init(PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2);
+
+	//Starts tracking image, every subresource in layout with nothing to wait for.
+	void trackImage(VkImage image, VkImageAspectFlags aspect, uint32 mipLevels, uint32 arrayLayers, VkImageLayout layout);
+	void untrackImage(VkImage image);
+
+	//Gets the subresources of a tracked image ready for an access at stages in layout,
+	//adding a barrier per run of consecutive mips that were in the same state.
+	void image(VkImage image,
+	           VkImageLayout layout,
+	           VkPipelineStageFlags2KHR stages,
+	           VkAccessFlags2KHR access,
+	           uint32 baseMip = 0, uint32 mipCount = VK_REMAINING_MIP_LEVELS,
+	           uint32 baseLayer = 0, uint32 layerCount = VK_REMAINING_ARRAY_LAYERS);
+
+	//Untracked barriers, everything given.
+	void imageBarrier(const VkImageMemoryBarrier2KHR &barrier);
+	void buffer(VkBuffer buffer,
+	            VkPipelineStageFlags2KHR srcStages, VkAccessFlags2KHR srcAccess,
+	            VkPipelineStageFlags2KHR dstStages, VkAccessFlags2KHR dstAccess,
+	            VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE,
+	            uint32 srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32 dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+	void execution(VkPipelineStageFlags2KHR srcStages, VkPipelineStageFlags2KHR dstStages);
+
+	bool empty() const { return memoryBarriers.empty() && bufferBarriers.empty() && imageBarriers.empty(); }
+
+	//Records everything added since the last flush, if anything.
+	void flush(VkCommandBuffer cmd);
+};
@@ -2,6 +2,7 @@
 
 #include "vectors.h"
 #include "matrix.h"
+#include "simd_math.h"
 
 struct Camera
 {
@@ -67,10 +68,14 @@ struct Camera
 
 	void updateVectors()
 	{
+		//sin/cos of yaw and pitch in one call: s = (sy, sp, ..), c = (cy, cp, ..)
+		vec4 s, c;
+		vsincos(vec4(DEG2RAD(yaw), DEG2RAD(pitch), 0.0f, 0.0f), s, c);
+
 		vec3 forward;
-		forward = vec3(cos(DEG2RAD(yaw)) * cos(DEG2RAD(pitch)),  //x
-		               sin(DEG2RAD(pitch)),                       //y
-		               sin(DEG2RAD(yaw)) * cos(DEG2RAD(pitch))); //z
+		forward = vec3(c.x() * c.y(),  //x
+		               s.y(),          //y
+		               s.x() * c.y()); //z
 		fwd = normalize(forward);
 
 		right = normalize(cross(fwd, worldUp));
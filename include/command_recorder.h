@@ -0,0 +1,173 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include "vulkan_manager.h"
+#include "jobs.h"
+#include "hash.h"
+
+//Per-frame command buffers recorded from the job system threads.
+//
+//Every thread has its own command pool per frame in flight, so recording never locks and a
+//frame's pools can be reset as a whole, with one vkResetCommandPool each, once the frame's
+//last submission has completed. The command buffers themselves are kept and reused.
+//
+//A render pass is recorded as secondary command buffers, each holding a contiguous batch of
+//draws, by whichever thread picks the batch up. The primary then executes them in batch
+//order, so the GPU sees the same commands whatever the thread count or scheduling.
+//
+//recordCachedRenderPass() keeps the secondaries instead: each batch comes with a hash of
+//everything its commands depend on, and only batches whose hash changed since that frame
+//slot last recorded them are re-recorded. A slot's secondaries are only touched once its
+//previous frame is done, so they never need SIMULTANEOUS_USE.
+
+struct ThreadCommandPool
+{
+	VkCommandPool pool;
+	std::vector<VkCommandBuffer> secondaries;
+	uint32 usedSecondaries;
+};
+
+struct CachedBatch
+{
+	VkCommandBuffer cmd;
+	uint64 hash;
+};
+
+struct CommandRecorderStats
+{
+	uint32 batches;    //secondaries executed by the last pass
+	uint32 cacheHits;  //of them, reused without recording
+	double recordMs;   //CPU time of the last pass, recording and hashing included
+
+	uint64 totalBatches;
+	uint64 totalCacheHits;
+};
+
+struct CommandRecorder
+{
+	VkDevice device;
+	uint32 threadCount;
+
+	std::vector<ThreadCommandPool> pools[MAX_FRAMES];  //one per job system thread
+	VkCommandBuffer primaries[MAX_FRAMES];  //from the frame's thread 0 pool
+
+	std::vector<VkCommandBuffer> batches;   //secondaries of the pass being recorded, in order
+
+	//Cached secondaries. Batch b always records from cachePools[frame][b % threadCount], and
+	//one job records all the batches of a pool, so pools are never used by two threads at once.
+	std::vector<VkCommandPool> cachePools[MAX_FRAMES];
+	std::vector<CachedBatch> cache[MAX_FRAMES];
+
+	CommandRecorderStats stats{};
+
+	void init(VulkanManager &vulkanManager, uint32 threadCount);
+	void destroy();
+
+	//Resets the frame's pools and begins its primary command buffer. Call after
+	//FrameScheduler::beginFrame() returned frame.
+	VkCommandBuffer beginFrame(uint32 frame);
+
+	//A secondary command buffer from the calling thread's pool, begun inside renderPass.
+	VkCommandBuffer beginSecondary(uint32 frame, uint32 thread, VkRenderPass renderPass, VkFramebuffer framebuffer);
+
+	//Begins the cached secondary of batch, allocating it the first time.
+	VkCommandBuffer beginCachedSecondary(uint32 frame, uint32 batch, VkRenderPass renderPass);
+
+	void updateStats(uint32 batchCount, uint32 cacheHits, std::chrono::steady_clock::time_point start);
+
+	//Records a render pass into primary with drawCount draws split in batches of
+	//drawsPerBatch, recordBatch(cmd, firstDraw, endDraw) recording each batch into its own
+	//secondary command buffer on the job system threads. A secondary inherits no state, so
+	//recordBatch binds the pipeline, descriptor sets and dynamic state itself.
+	template<typename RecordBatch>
+	void recordRenderPass(JobSystem &jobs,
+	                      uint32 frame,
+	                      VkCommandBuffer primary,
+	                      const VkRenderPassBeginInfo &renderPassInfo,
+	                      uint32 drawCount,
+	                      uint32 drawsPerBatch,
+	                      RecordBatch &&recordBatch)
+	{
+		uint32 batchCount = (drawCount + drawsPerBatch - 1) / drawsPerBatch;
+		batches.resize(batchCount);
+
+		jobs.parallelFor(batchCount, 1, [&](size_t begin, size_t end)
+		{
+			uint32 thread = jobs.currentThread();
+			for(size_t b = begin; b < end; b++)
+			{
+				VkCommandBuffer cmd = beginSecondary(frame, thread, renderPassInfo.renderPass, renderPassInfo.framebuffer);
+
+				uint32 firstDraw = (uint32)b * drawsPerBatch;
+				uint32 endDraw = firstDraw + drawsPerBatch < drawCount ? firstDraw + drawsPerBatch : drawCount;
+				recordBatch(cmd, firstDraw, endDraw);
+
+				VK_CHECK(vkEndCommandBuffer(cmd));
+				batches[b] = cmd;
+			}
+		});
+
+		vkCmdBeginRenderPass(primary, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		if(batchCount) vkCmdExecuteCommands(primary, batchCount, batches.data());
+		vkCmdEndRenderPass(primary);
+	}
+
+	//Same as recordRenderPass(), but a batch is only recorded when hashBatch(firstDraw, endDraw)
+	//differs from the hash it had when this frame slot last recorded it. The hash has to cover
+	//every input of recordBatch: pipeline, descriptor sets, dynamic state and the draw list.
+	//The secondaries don't inherit the framebuffer, so they work with any swapchain image.
+	template<typename HashBatch, typename RecordBatch>
+	void recordCachedRenderPass(JobSystem &jobs,
+	                            uint32 frame,
+	                            VkCommandBuffer primary,
+	                            const VkRenderPassBeginInfo &renderPassInfo,
+	                            uint32 drawCount,
+	                            uint32 drawsPerBatch,
+	                            HashBatch &&hashBatch,
+	                            RecordBatch &&recordBatch)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		uint32 batchCount = (drawCount + drawsPerBatch - 1) / drawsPerBatch;
+		std::vector<CachedBatch> &frameCache = cache[frame];
+		if(frameCache.size() < batchCount) frameCache.resize(batchCount, CachedBatch{VK_NULL_HANDLE, 0});
+		batches.resize(batchCount);
+
+		std::atomic<uint32> cacheHits{0};
+
+		jobs.parallelFor(threadCount, 1, [&](size_t begin, size_t end)
+		{
+			for(size_t pool = begin; pool < end; pool++)
+			{
+				uint32 hits = 0;
+				for(uint32 b = (uint32)pool; b < batchCount; b += threadCount)
+				{
+					uint32 firstDraw = b * drawsPerBatch;
+					uint32 endDraw = firstDraw + drawsPerBatch < drawCount ? firstDraw + drawsPerBatch : drawCount;
+
+					uint64 hash = hashBatch(firstDraw, endDraw);
+					if(frameCache[b].cmd != VK_NULL_HANDLE && frameCache[b].hash == hash)
+					{
+						hits++;
+					}
+					else
+					{
+						VkCommandBuffer cmd = beginCachedSecondary(frame, b, renderPassInfo.renderPass);
+						recordBatch(cmd, firstDraw, endDraw);
+						VK_CHECK(vkEndCommandBuffer(cmd));
+						frameCache[b].hash = hash;
+					}
+					batches[b] = frameCache[b].cmd;
+				}
+				cacheHits.fetch_add(hits, std::memory_order_relaxed);
+			}
+		});
+
+		vkCmdBeginRenderPass(primary, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		if(batchCount) vkCmdExecuteCommands(primary, batchCount, batches.data());
+		vkCmdEndRenderPass(primary);
+
+		updateStats(batchCount, cacheHits.load(), start);
+	}
+};
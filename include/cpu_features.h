@@ -0,0 +1,28 @@
+#pragma once
+
+//Runtime detection of the x86 instruction set extensions used by the batched math kernels.
+//A feature is only reported when both the CPU and the OS (XSAVE state) support it.
+struct CpuFeatures
+{
+	bool sse41;
+	bool avx;
+	bool avx2;
+	bool fma;
+	bool f16c;
+	bool avx512f;
+};
+
+//CPUID is queried once, on the first call.
+const CpuFeatures &getCpuFeatures();
+
+//MSVC lets any function use any intrinsic, GCC and Clang need the target enabled per function
+//so the rest of the translation unit can still be compiled for the baseline (SSE2).
+#if defined(_MSC_VER) && !defined(__clang__)
+	#define TARGET_AVX2_FMA
+	#define TARGET_AVX512
+	#define TARGET_F16C
+#else
+	#define TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+	#define TARGET_AVX512   __attribute__((target("avx512f,avx2,fma")))
+	#define TARGET_F16C     __attribute__((target("f16c,avx")))
+#endif
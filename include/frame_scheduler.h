@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "typedefs_and_macros.h"
+
+//Frame pacing and queue submission on timeline semaphores (core in Vulkan 1.2,
+//VK_KHR_timeline_semaphore before).
+//
+//Every queue has a timeline semaphore and every submission to it signals the queue's next
+//value, so whether some work has finished is a (timeline, value) pair, and waiting for it on
+//the CPU is one vkWaitSemaphores. Submissions wait on each other's values, across queues too,
+//instead of on fences.
+//
+//Frames in flight and swapchain images are independent of each other:
+//  -a frame slot (frame number % framesInFlight) owns what the CPU writes every frame, e.g. the
+//   command pools. beginFrame() waits for the last submission of the slot's previous frame.
+//  -a swapchain image owns what is tied to it, e.g. its present command buffer. imageAcquired()
+//   waits for the last submission of the previous frame that drew to the image, which the
+//   slot wait doesn't cover when images outnumber frames in flight.
+//The swapchain only takes binary semaphores: an acquire semaphore per frame slot, free again
+//once the slot's frame is done, and a present semaphore per image, free again once the image
+//is acquired again.
+
+//timelines of the queues VulkanManager creates
+#define TIMELINE_GRAPHICS 0
+#define TIMELINE_PRESENT  1  //separate present queue only
+#define TIMELINE_COMPUTE  2  //the graphics queue without a compute-only family
+#define MAX_TIMELINES     4
+
+#define MAX_SUBMIT_WAITS  8
+
+struct QueueTimeline
+{
+	VkQueue queue;
+	VkSemaphore semaphore;  //VK_NULL_HANDLE if the timeline isn't used
+	uint64 submitted;       //value of the last submission
+};
+
+//a point on a queue's timeline, reached when the submission that signals it completes
+struct TimelinePoint
+{
+	uint32 timeline;
+	uint64 value;  //0: nothing to wait for
+};
+
+struct SubmitWait
+{
+	VkSemaphore semaphore;
+	uint64 value;  //ignored for binary semaphores
+	VkPipelineStageFlags stages;
+};
+
+struct FrameScheduler
+{
+	VkDevice device;
+	uint32 framesInFlight;
+
+	QueueTimeline timelines[MAX_TIMELINES];
+
+	uint64 frameNumber;  //frames begun
+	uint32 frame;        //slot of the current frame
+	uint32 image;        //swapchain image of the current frame
+
+	TimelinePoint lastSubmission;  //of the current frame
+
+	std::vector<TimelinePoint> frameDone;  //per slot
+	std::vector<VkSemaphore> acquireSemaphores;
+
+	std::vector<TimelinePoint> imageDone;  //per swapchain image
+	std::vector<VkSemaphore> presentSemaphores;
+
+	void init(VkDevice device, uint32 framesInFlight);
+	void destroy();
+
+	//Gives queue a timeline, submitted to with index.
+	void initTimeline(uint32 index, VkQueue queue);
+
+	//Per-image state for a new swapchain. The device must be idle.
+	void initImages(uint32 imageCount);
+
+	//--- every frame ---
+	//Waits until the next frame slot is free and returns it.
+	uint32 beginFrame();
+	VkSemaphore acquireSemaphore() const { return acquireSemaphores[frame]; }
+
+	//After vkAcquireNextImageKHR: waits until the last frame that drew to image is done.
+	void imageAcquired(uint32 image);
+	VkSemaphore presentSemaphore() const { return presentSemaphores[image]; }
+
+	//Submits cmd to the timeline's queue once waits are met. It signals the timeline's next
+	//value, which is returned, and binarySignal if given.
+	uint64 submit(uint32 timeline,
+	              VkCommandBuffer cmd,
+	              const SubmitWait *waits = nullptr,
+	              uint32 waitCount = 0,
+	              VkSemaphore binarySignal = VK_NULL_HANDLE);
+
+	//The frame slot and the image are done with once the frame's last submission completes.
+	void endFrame();
+
+	//--- CPU waits ---
+	void wait(TimelinePoint point);
+	void waitIdle();  //every submission so far
+
+	//Frames whose last submission hasn't completed yet, without waiting.
+	uint32 framesPending() const;
+};
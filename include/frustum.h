@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vectors.h"
+#include "matrix.h"
+
+//View frustum planes extracted from a view-projection matrix (Gribb & Hartmann).
+//
+//With row vectors clip = p * M, so clip.x = dot(p, column 0) and so on. Vulkan clip space is
+//-w <= x <= w, -w <= y <= w, 0 <= z <= w, and each of those inequalities is a plane made of
+//two columns of M. The Y flip and the reverse Z of vulkanPerspective don't change that set,
+//they only decide which plane is which: y = -w is the top of the screen, and with reverse Z
+//z = w is the near plane and z = 0 the far one (the other way round for a conventional
+//projection, the planes are the same).
+//
+//Pass view * proj to get world space planes, model * view * proj for object space ones.
+
+struct Frustum
+{
+	//xyz = unit normal pointing inside, w = distance: p is inside when dot(p, xyz) + w >= 0.
+	//Order: left, right, top, bottom, near, far.
+	vec4 planes[6];
+
+	//The same planes transposed, 4 per register, to test one object against all of them at
+	//once. Lanes 2 and 3 of the second set hold (0, 0, 0, 1), which nothing is outside of.
+	vec3x4 normals[2];
+	vec4 dist[2];
+};
+
+//Normalizes 4 planes in SoA form. A plane with no normal (the far plane of an infinite
+//projection) becomes (0, 0, 0, 1) so it never culls.
+FORCE_INLINE void normalizePlanes(vec3x4 &n, vec4 &d)
+{
+	__m128 lenSq = dot(n, n).m;
+	__m128 degenerate = _mm_cmpeq_ps(lenSq, _mm_setzero_ps());
+	__m128 rlen = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lenSq));
+	rlen = vselect(degenerate, _mm_setzero_ps(), rlen);
+
+	n = n * vec4(rlen);
+	d = vec4(vselect(degenerate, _mm_set1_ps(1.0f), _mm_mul_ps(d.m, rlen)));
+}
+
+inline Frustum extractFrustum(mat4 viewProj)
+{
+	//rows of the transpose are the columns
+	transpose(viewProj);
+	__m128 c0 = viewProj.row[0].m;
+	__m128 c1 = viewProj.row[1].m;
+	__m128 c2 = viewProj.row[2].m;
+	__m128 c3 = viewProj.row[3].m;
+
+	__m128 p0 = _mm_add_ps(c3, c0); //x >= -w  left
+	__m128 p1 = _mm_sub_ps(c3, c0); //x <=  w  right
+	__m128 p2 = _mm_add_ps(c3, c1); //y >= -w  top
+	__m128 p3 = _mm_sub_ps(c3, c1); //y <=  w  bottom
+	__m128 p4 = _mm_sub_ps(c3, c2); //z <=  w  near (reverse Z)
+	__m128 p5 = c2;                 //z >=  0  far  (reverse Z)
+	__m128 p6 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+	__m128 p7 = p6;
+
+	_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+	_MM_TRANSPOSE4_PS(p4, p5, p6, p7);
+
+	Frustum f;
+	f.normals[0] = vec3x4(p0, p1, p2);
+	f.normals[1] = vec3x4(p4, p5, p6);
+	f.dist[0] = vec4(p3);
+	f.dist[1] = vec4(p7);
+	normalizePlanes(f.normals[0], f.dist[0]);
+	normalizePlanes(f.normals[1], f.dist[1]);
+
+	//back to one plane per register
+	p0 = f.normals[0].x; p1 = f.normals[0].y; p2 = f.normals[0].z; p3 = f.dist[0].m;
+	p4 = f.normals[1].x; p5 = f.normals[1].y; p6 = f.normals[1].z; p7 = f.dist[1].m;
+	_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+	_MM_TRANSPOSE4_PS(p4, p5, p6, p7);
+
+	f.planes[0] = vec4(p0);
+	f.planes[1] = vec4(p1);
+	f.planes[2] = vec4(p2);
+	f.planes[3] = vec4(p3);
+	f.planes[4] = vec4(p4);
+	f.planes[5] = vec4(p5);
+	return f;
+}
+
+//Pushes every plane out by margin, so whatever is within margin of the frustum is inside.
+inline void expandFrustum(Frustum &f, float margin)
+{
+	__m128 m = _mm_set1_ps(margin);
+	f.dist[0] = vec4(_mm_add_ps(f.dist[0].m, m));
+	f.dist[1] = vec4(_mm_add_ps(f.dist[1].m, m));
+	for(int i = 0; i < 6; i++)
+	{
+		f.planes[i] = f.planes[i] + vec4(0.0f, 0.0f, 0.0f, margin);
+	}
+}
+
+//Sphere test: visible unless the center is more than radius behind one of the planes.
+FORCE_INLINE bool isSphereVisible(const Frustum &f, vec3 center, float radius)
+{
+	vec3x4 c(center);
+	__m128 r = _mm_set1_ps(-radius);
+	__m128 out = _mm_cmplt_ps((dot(c, f.normals[0]) + f.dist[0]).m, r);
+	out = _mm_or_ps(out, _mm_cmplt_ps((dot(c, f.normals[1]) + f.dist[1]).m, r));
+	return _mm_movemask_ps(out) == 0;
+}
+
+//Box test, with the box as center + half extents: the box is behind a plane when its corner
+//furthest along the normal is, i.e. dot(center, n) + dot(extent, |n|) + d < 0.
+FORCE_INLINE bool isAABBVisible(const Frustum &f, vec3 center, vec3 extent)
+{
+	vec3x4 c(center);
+	vec3x4 e(extent);
+	__m128 zero = _mm_setzero_ps();
+	__m128 out = _mm_cmplt_ps((dot(c, f.normals[0]) + dot(e, abs(f.normals[0])) + f.dist[0]).m, zero);
+	out = _mm_or_ps(out, _mm_cmplt_ps((dot(c, f.normals[1]) + dot(e, abs(f.normals[1])) + f.dist[1]).m, zero));
+	return _mm_movemask_ps(out) == 0;
+}
+
+//============================ Batched culling ===============================
+//The bounding volumes are stored as separate float arrays (SoA) so a register holds the
+//same component of 4, 8 or 16 objects. The arrays need no particular alignment.
+//
+//The cull functions write the indices of the visible objects, in increasing order, to
+//visible (which must have room for count entries) and return how many there are.
+//Like the matrix kernels there is an SSE2, an AVX2+FMA and an AVX-512 version, picked by
+//initCullingKernels(). Results are identical across versions up to FMA rounding on objects
+//touching a plane.
+
+struct BoundingSpheres
+{
+	const float *x;
+	const float *y;
+	const float *z;
+	const float *radius;
+	size_t count;
+};
+
+//axis aligned boxes as center + half extents
+struct BoundingBoxes
+{
+	const float *centerX;
+	const float *centerY;
+	const float *centerZ;
+	const float *extentX;
+	const float *extentY;
+	const float *extentZ;
+	size_t count;
+};
+
+void initCullingKernels();
+
+//name of the selected implementation, for logging.
+const char *cullingKernelsName();
+
+size_t cullSpheres(const Frustum &f, const BoundingSpheres &spheres, uint32_t *visible);
+
+size_t cullBoxes(const Frustum &f, const BoundingBoxes &boxes, uint32_t *visible);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include "typedefs_and_macros.h"
+
+//FNV-1a, to build cache keys from plain bytes
+inline uint64 hashBytes(const void *data, size_t size, uint64 hash = 0xcbf29ce484222325ull)
+{
+	const uint8 *bytes = (const uint8 *)data;
+	for(size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+template<typename T>
+inline uint64 hashValue(const T &value, uint64 hash)
+{
+	return hashBytes(&value, sizeof(value), hash);
+}
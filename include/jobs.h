@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//Work-stealing job system.
+//
+//Each thread (the one that called startUp, worker 0, and the worker threads) owns a
+//Chase-Lev deque: it pushes and pops jobs at the bottom without locks, and idle threads
+//steal from the top of the others. Jobs are small PODs stored by value in the deques, so
+//running one never allocates.
+//
+//Completion is tracked with JobCounters: run() increments the counter, the job decrements it
+//when it is done, and wait() runs other jobs (the calling thread helps instead of blocking)
+//until it reaches zero. A job that needs the result of others waits on their counter.
+//
+//parallelFor splits a range lazily: a job keeps halving its range and pushing the upper
+//half until it is down to chunkSize, so idle threads steal big ranges and a busy thread
+//doesn't pay for splitting work nobody takes.
+//
+//run(), wait() and parallelFor() may only be called from the thread that called startUp()
+//and from inside jobs.
+
+typedef void (*JobFunction)(void *data, size_t begin, size_t end);
+
+struct JobCounter
+{
+	std::atomic<uint32_t> pending{0};
+};
+
+struct Job
+{
+	JobFunction function;
+	void *data;
+	size_t begin;
+	size_t end;
+	size_t chunkSize;  //parallelFor jobs split down to this size, 0 for plain jobs
+	JobCounter *counter;
+};
+
+//Fixed size Chase-Lev deque ("Correct and Efficient Work-Stealing for Weak Memory Models",
+//Le et al. 2013). push() and pop() are only called by the owning thread.
+//
+//A thief copies a job before claiming it, while the owner may be reusing the slot: the copy
+//is then thrown away because the claim fails, but the fields have to be atomics for the read
+//to be defined.
+struct JobDeque
+{
+	static const int64_t CAPACITY = 4096;  //power of two
+
+	struct Slot
+	{
+		std::atomic<JobFunction> function;
+		std::atomic<void*> data;
+		std::atomic<size_t> begin;
+		std::atomic<size_t> end;
+		std::atomic<size_t> chunkSize;
+		std::atomic<JobCounter*> counter;
+	};
+
+	alignas(64) std::atomic<int64_t> top{0};
+	alignas(64) std::atomic<int64_t> bottom{0};
+	Slot slots[CAPACITY];
+
+	bool push(const Job &job);  //false when full
+	bool pop(Job &job);
+	bool steal(Job &job);
+};
+
+struct alignas(64) JobWorker
+{
+	JobDeque deque;
+	uint32_t rngState;
+	std::thread thread;
+};
+
+struct JobSystem
+{
+	std::vector<JobWorker*> workers;  //workers[0] is the thread that called startUp()
+
+	std::atomic<uint32_t> queuedJobs{0};  //jobs sitting in a deque
+	std::atomic<uint32_t> sleepingWorkers{0};
+	std::atomic<bool> quit{false};
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+
+	//threadCount includes the calling thread, 0 picks one per hardware thread. The worker
+	//threads are pinned to a core each when there are enough of them.
+	void startUp(uint32_t threadCount = 0);
+	void shutDown();
+
+	uint32_t threadCount() const { return (uint32_t)workers.size(); }
+
+	//Index of the calling thread in [0, threadCount()), to pick per-thread resources from
+	//inside a job.
+	uint32_t currentThread() const;
+
+	//Queues function(data, 0, 0).
+	void run(JobFunction function, void *data, JobCounter &counter);
+
+	//Runs jobs on the calling thread until counter reaches zero.
+	void wait(JobCounter &counter);
+
+	//Calls fn(begin, end) over [0, count) in chunks of at most chunkSize, from any threads,
+	//and returns once every call is done. Same signature as the parallelFor taken by
+	//TransformHierarchy::update() and updateCharacters(), so jobs.parallelFor can be passed
+	//there through a lambda.
+	template<typename F>
+	void parallelFor(size_t count, size_t chunkSize, F &&fn)
+	{
+		if(count == 0) return;
+		if(chunkSize == 0) chunkSize = 1;
+
+		if(count <= chunkSize || workers.size() == 1)
+		{
+			fn((size_t)0, count);
+			return;
+		}
+
+		JobCounter counter;
+		push(function<typename std::remove_reference<F>::type>(), (void*)&fn, 0, count, chunkSize, counter);
+		wait(counter);
+	}
+
+	template<typename F>
+	static JobFunction function()
+	{
+		return [](void *data, size_t begin, size_t end) { (*(F*)data)(begin, end); };
+	}
+
+	void push(JobFunction function, void *data, size_t begin, size_t end, size_t chunkSize, JobCounter &counter);
+	void execute(Job job);
+	bool findJob(uint32_t self, Job &job);
+	void workerLoop(uint32_t self);
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vectors.h"
+#include "simd_math.h"
 
 struct mat4
 {
@@ -47,7 +48,7 @@ FORCE_INLINE void transpose(mat4 &a)
 	_MM_TRANSPOSE4_PS(a.row[0].m, a.row[1].m, a.row[2].m, a.row[3].m);
 }
 
-mat4 operator+ (mat4 a, mat4 b) 
+FORCE_INLINE mat4 operator+ (mat4 a, mat4 b) 
 {
 	a.row[0] = a.row[0] + b.row[0];
 	a.row[1] = a.row[1] + b.row[1];
@@ -57,7 +58,7 @@ mat4 operator+ (mat4 a, mat4 b)
 	return a;
 }
 
-mat4 operator- (mat4 a, mat4 b) 
+FORCE_INLINE mat4 operator- (mat4 a, mat4 b) 
 {
 	a.row[0] = a.row[0] - b.row[0];
 	a.row[1] = a.row[1] - b.row[1];
@@ -68,29 +69,30 @@ mat4 operator- (mat4 a, mat4 b)
 }
 
 //linear combination: row-vector * matrix
-vec4 operator* (vec4 a, mat4 b)
+//the components are broadcast with shuffles so the vector never leaves the SSE registers
+FORCE_INLINE vec4 operator* (vec4 a, mat4 b)
 {
 	vec4 result;	
-	result = a.x() * b.row[0];
-	result += a.y() * b.row[1];
-	result += a.z() * b.row[2];
-	result += a.w() * b.row[3];
+	result = SHUFFLE4(a, 0, 0, 0, 0) * b.row[0];
+	result += SHUFFLE4(a, 1, 1, 1, 1) * b.row[1];
+	result += SHUFFLE4(a, 2, 2, 2, 2) * b.row[2];
+	result += SHUFFLE4(a, 3, 3, 3, 3) * b.row[3];
 	
 	return result;
 }
 
-vec4 operator* (mat4 b, vec4 a)
+FORCE_INLINE vec4 operator* (mat4 b, vec4 a)
 {
-	vec4 result = vec4();	
-	result = a.x() * b.row[0];
-	result += a.y() * b.row[1];
-	result += a.z() * b.row[2];
-	result += a.w() * b.row[3];
+	vec4 result;	
+	result = SHUFFLE4(a, 0, 0, 0, 0) * b.row[0];
+	result += SHUFFLE4(a, 1, 1, 1, 1) * b.row[1];
+	result += SHUFFLE4(a, 2, 2, 2, 2) * b.row[2];
+	result += SHUFFLE4(a, 3, 3, 3, 3) * b.row[3];
 
 	return result;
 }
 
-mat4 operator* (mat4 a, mat4 b) 
+FORCE_INLINE mat4 operator* (mat4 a, mat4 b) 
 {
 	a.row[0] = a.row[0] * b;
 	a.row[1] = a.row[1] * b;
@@ -100,21 +102,313 @@ mat4 operator* (mat4 a, mat4 b)
 	return a;
 }
 	
-mat4 lookAt(vec3 from, vec3 to, vec3 up_)
+//============================ Inverses ==============================
+//Helpers for the block-wise inverse. A __m128 holds a 2x2 row-major matrix as (m00, m01, m10, m11).
+
+//2x2 A * B
+FORCE_INLINE __m128 mat2Mul(__m128 a, __m128 b)
+{
+	return _mm_add_ps(_mm_mul_ps(a, VSWIZZLE(b, 0, 3, 0, 3)),
+	                  _mm_mul_ps(VSWIZZLE(a, 1, 0, 3, 2), VSWIZZLE(b, 2, 1, 2, 1)));
+}
+
+//2x2 adj(A) * B
+FORCE_INLINE __m128 mat2AdjMul(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(VSWIZZLE(a, 3, 3, 0, 0), b),
+	                  _mm_mul_ps(VSWIZZLE(a, 1, 1, 2, 2), VSWIZZLE(b, 2, 3, 0, 1)));
+}
+
+//2x2 A * adj(B)
+FORCE_INLINE __m128 mat2MulAdj(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(a, VSWIZZLE(b, 3, 0, 3, 0)),
+	                  _mm_mul_ps(VSWIZZLE(a, 1, 0, 3, 2), VSWIZZLE(b, 2, 1, 2, 1)));
+}
+
+//General 4x4 inverse.
+//The matrix is split into 2x2 blocks | A B |
+//                                    | C D |
+//and inverted with the block (Schur complement) form of Cramer's rule, so everything stays
+//in registers: ~60 SSE instructions and a single divide. The result is undefined if the
+//matrix is singular.
+FORCE_INLINE mat4 inverse(mat4 m)
+{
+	__m128 r0 = m.row[0].m;
+	__m128 r1 = m.row[1].m;
+	__m128 r2 = m.row[2].m;
+	__m128 r3 = m.row[3].m;
+
+	__m128 A = _mm_movelh_ps(r0, r1);
+	__m128 B = _mm_movehl_ps(r1, r0);
+	__m128 C = _mm_movelh_ps(r2, r3);
+	__m128 D = _mm_movehl_ps(r3, r2);
+
+	//(|A|, |B|, |C|, |D|)
+	__m128 detSub = _mm_sub_ps(_mm_mul_ps(VSHUFFLE(r0, r2, 0, 2, 0, 2), VSHUFFLE(r1, r3, 1, 3, 1, 3)),
+	                           _mm_mul_ps(VSHUFFLE(r0, r2, 1, 3, 1, 3), VSHUFFLE(r1, r3, 0, 2, 0, 2)));
+	__m128 detA = VSWIZZLE(detSub, 0, 0, 0, 0);
+	__m128 detB = VSWIZZLE(detSub, 1, 1, 1, 1);
+	__m128 detC = VSWIZZLE(detSub, 2, 2, 2, 2);
+	__m128 detD = VSWIZZLE(detSub, 3, 3, 3, 3);
+
+	__m128 D_C = mat2AdjMul(D, C);
+	__m128 A_B = mat2AdjMul(A, B);
+
+	//adjugates of the inverse blocks:
+	//X# = |D|A - B(D#C),  W# = |A|D - C(A#B)
+	//Y# = |B|C - D(A#B)#, Z# = |C|B - A(D#C)#
+	__m128 X_ = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, D_C));
+	__m128 W_ = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, A_B));
+	__m128 Y_ = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, A_B));
+	__m128 Z_ = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, D_C));
+
+	//|M| = |A||D| + |B||C| - tr((A#B)(D#C))
+	__m128 tr = _mm_mul_ps(A_B, VSWIZZLE(D_C, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, VSWIZZLE(tr, 2, 3, 0, 1));
+	tr = _mm_add_ps(tr, VSWIZZLE(tr, 1, 0, 3, 2));
+	__m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+	//the adjugate sign pattern of each 2x2 block is folded into the reciprocal
+	__m128 rDetM = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+	X_ = _mm_mul_ps(X_, rDetM);
+	Y_ = _mm_mul_ps(Y_, rDetM);
+	Z_ = _mm_mul_ps(Z_, rDetM);
+	W_ = _mm_mul_ps(W_, rDetM);
+
+	//undo the adjugate swizzle while reassembling the rows
+	return mat4(vec4(VSHUFFLE(X_, Y_, 3, 1, 3, 1)),
+	            vec4(VSHUFFLE(X_, Y_, 2, 0, 2, 0)),
+	            vec4(VSHUFFLE(Z_, W_, 3, 1, 3, 1)),
+	            vec4(VSHUFFLE(Z_, W_, 2, 0, 2, 0)));
+}
+
+//Inverse of an affine matrix (last column is (0, 0, 0, 1)).
+//With row vectors M = | L 0 |  so  M^-1 = |   L^-1   0 |
+//                     | t 1 |             | -t*L^-1  1 |
+//L^-1 comes from the cross products of the rows of L (its cofactors).
+FORCE_INLINE mat4 inverseAffine(mat4 m)
+{
+	vec3 r0 = vec3(m.row[0].m);
+	vec3 r1 = vec3(m.row[1].m);
+	vec3 r2 = vec3(m.row[2].m);
+
+	vec3 c0 = cross(r1, r2);
+	vec3 c1 = cross(r2, r0);
+	vec3 c2 = cross(r0, r1);
+	float rDet = 1.0f / dot(r0, c0);
+
+	//L^-1 = transpose(c0, c1, c2) / |L|
+	__m128 i0 = _mm_mul_ps(c0.m, _mm_set1_ps(rDet));
+	__m128 i1 = _mm_mul_ps(c1.m, _mm_set1_ps(rDet));
+	__m128 i2 = _mm_mul_ps(c2.m, _mm_set1_ps(rDet));
+	__m128 i3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+
+	mat4 result(vec4(i0), vec4(i1), vec4(i2), vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	vec4 t = -(vec4(m.row[3].m) * result);
+	result.row[3] = vec4(vec3(t.m), 1.0f);
+	return result;
+}
+
+//Inverse of a rigid transform (orthonormal rotation + translation): L^-1 is just L transposed.
+FORCE_INLINE mat4 inverseRigid(mat4 m)
+{
+	__m128 i0 = m.row[0].m;
+	__m128 i1 = m.row[1].m;
+	__m128 i2 = m.row[2].m;
+	__m128 i3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+
+	mat4 result(vec4(i0), vec4(i1), vec4(i2), vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	vec4 t = -(vec4(m.row[3].m) * result);
+	result.row[3] = vec4(vec3(t.m), 1.0f);
+	return result;
+}
+
+//Matrix that transforms normals: the inverse-transpose of the upper 3x3, which is just the
+//cofactor matrix divided by the determinant. It is returned in a mat4 (rows padded
+//to vec4, no translation) so it can be uploaded with std140 layout.
+FORCE_INLINE mat4 normalMatrix(mat4 m)
+{
+	vec3 r0 = vec3(m.row[0].m);
+	vec3 r1 = vec3(m.row[1].m);
+	vec3 r2 = vec3(m.row[2].m);
+
+	vec3 c0 = cross(r1, r2);
+	vec3 c1 = cross(r2, r0);
+	vec3 c2 = cross(r0, r1);
+	float rDet = 1.0f / dot(r0, c0);
+
+	return mat4(vec4(c0 * rDet, 0.0f),
+	            vec4(c1 * rDet, 0.0f),
+	            vec4(c2 * rDet, 0.0f),
+	            vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+//============================ TRS ==============================
+//With row vectors a TRS matrix scales first, then rotates, then translates: M = S * R * T.
+//Rows 0-2 are the rotation rows multiplied by the scale, row 3 is the translation.
+
+//r must be a pure rotation (only its upper 3x3 is used).
+FORCE_INLINE mat4 composeTRS(vec3 t, mat4 r, vec3 s)
+{
+	return mat4(vec4(vec3(r.row[0].m) * SHUFFLE3(s, 0, 0, 0), 0.0f),
+	            vec4(vec3(r.row[1].m) * SHUFFLE3(s, 1, 1, 1), 0.0f),
+	            vec4(vec3(r.row[2].m) * SHUFFLE3(s, 2, 2, 2), 0.0f),
+	            vec4(t, 1.0f));
+}
+
+//Splits an affine matrix without shear into translation, rotation and scale.
+//A negative determinant (mirroring) is folded into the X scale.
+FORCE_INLINE void decomposeTRS(mat4 m, vec3 &t, mat4 &r, vec3 &s)
+{
+	vec3 r0 = vec3(m.row[0].m);
+	vec3 r1 = vec3(m.row[1].m);
+	vec3 r2 = vec3(m.row[2].m);
+
+	float sx = length(r0);
+	float sy = length(r1);
+	float sz = length(r2);
+	
+	if(dot(r0, cross(r1, r2)) < 0.0f) sx = -sx;
+
+	s = vec3(sx, sy, sz);
+	t = vec3(m.row[3].m);
+	r = mat4(vec4(r0 / sx, 0.0f),
+	         vec4(r1 / sy, 0.0f),
+	         vec4(r2 / sz, 0.0f),
+	         vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+	
+//============================ Quaternion <-> mat4 ==============================
+
+//Rotation matrix of a unit quaternion (row-vector convention, rows are the rotated axes).
+FORCE_INLINE mat4 quatToMat4(quat q)
+{
+	__m128 q2 = _mm_add_ps(q.m, q.m);
+
+	//diagonal: (1 - 2(yy + zz), 1 - 2(xx + zz), 1 - 2(xx + yy))
+	__m128 d = _mm_add_ps(_mm_mul_ps(VSWIZZLE(q.m, 1, 0, 0, 0), VSWIZZLE(q2, 1, 0, 0, 0)),
+	                      _mm_mul_ps(VSWIZZLE(q.m, 2, 2, 1, 0), VSWIZZLE(q2, 2, 2, 1, 0)));
+	d = _mm_sub_ps(_mm_set1_ps(1.0f), d);
+
+	//(2xy, 2yz, 2zx) +/- (2wz, 2wx, 2wy)
+	__m128 a = _mm_mul_ps(q.m, VSWIZZLE(q2, 1, 2, 0, 0));
+	__m128 b = _mm_mul_ps(VSWIZZLE(q.m, 3, 3, 3, 3), VSWIZZLE(q2, 2, 0, 1, 0));
+	__m128 s = _mm_add_ps(a, b);
+	__m128 t = _mm_sub_ps(a, b);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 r0 = VSHUFFLE(VSHUFFLE(d, s, 0, 0, 0, 0), VSHUFFLE(t, zero, 2, 2, 0, 0), 0, 2, 0, 2);
+	__m128 r1 = VSHUFFLE(VSHUFFLE(t, d, 0, 0, 1, 1), VSHUFFLE(s, zero, 1, 1, 0, 0), 0, 2, 0, 2);
+	__m128 r2 = VSHUFFLE(VSHUFFLE(s, t, 2, 2, 1, 1), VSHUFFLE(d, zero, 2, 2, 0, 0), 0, 2, 0, 2);
+
+	return mat4(vec4(r0), vec4(r1), vec4(r2), vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+//Unit quaternion from the upper 3x3 of a rotation matrix (Shepperd's method: the largest
+//of w, x, y, z is recovered first so the square root argument never gets close to zero).
+inline quat mat4ToQuat(mat4 m)
+{
+	float m00 = m(0, 0), m01 = m(0, 1), m02 = m(0, 2);
+	float m10 = m(1, 0), m11 = m(1, 1), m12 = m(1, 2);
+	float m20 = m(2, 0), m21 = m(2, 1), m22 = m(2, 2);
+	float trace = m00 + m11 + m22;
+
+	if(trace > 0.0f)
+	{
+		float s = 2.0f * sqrtf(trace + 1.0f);
+		return quat((m12 - m21) / s, (m20 - m02) / s, (m01 - m10) / s, 0.25f * s);
+	}
+	else if(m00 > m11 && m00 > m22)
+	{
+		float s = 2.0f * sqrtf(1.0f + m00 - m11 - m22);
+		return quat(0.25f * s, (m01 + m10) / s, (m02 + m20) / s, (m12 - m21) / s);
+	}
+	else if(m11 > m22)
+	{
+		float s = 2.0f * sqrtf(1.0f + m11 - m00 - m22);
+		return quat((m01 + m10) / s, 0.25f * s, (m12 + m21) / s, (m20 - m02) / s);
+	}
+	else
+	{
+		float s = 2.0f * sqrtf(1.0f + m22 - m00 - m11);
+		return quat((m02 + m20) / s, (m12 + m21) / s, 0.25f * s, (m01 - m10) / s);
+	}
+}
+
+FORCE_INLINE mat4 composeTRS(vec3 t, quat r, vec3 s)
+{
+	return composeTRS(t, quatToMat4(r), s);
+}
+
+FORCE_INLINE void decomposeTRS(mat4 m, vec3 &t, quat &r, vec3 &s)
+{
+	mat4 rm(1.0f);
+	decomposeTRS(m, t, rm, s);
+	r = mat4ToQuat(rm);
+}
+
+//composeTRS for 4 transforms in SoA form. The quaternion -> matrix terms (the same as
+//quatToMat4) are computed for the 4 at once and transposed into rows at the end.
+FORCE_INLINE void composeTRS(vec3x4 t, quatx4 r, vec3x4 s, mat4 out[4])
+{
+	__m128 x2 = _mm_add_ps(r.x, r.x);
+	__m128 y2 = _mm_add_ps(r.y, r.y);
+	__m128 z2 = _mm_add_ps(r.z, r.z);
+	__m128 xx = _mm_mul_ps(r.x, x2), yy = _mm_mul_ps(r.y, y2), zz = _mm_mul_ps(r.z, z2);
+	__m128 xy = _mm_mul_ps(r.x, y2), xz = _mm_mul_ps(r.x, z2), yz = _mm_mul_ps(r.y, z2);
+	__m128 wx = _mm_mul_ps(r.w, x2), wy = _mm_mul_ps(r.w, y2), wz = _mm_mul_ps(r.w, z2);
+
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 m00 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), s.x);
+	__m128 m01 = _mm_mul_ps(_mm_add_ps(xy, wz), s.x);
+	__m128 m02 = _mm_mul_ps(_mm_sub_ps(xz, wy), s.x);
+	__m128 m10 = _mm_mul_ps(_mm_sub_ps(xy, wz), s.y);
+	__m128 m11 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), s.y);
+	__m128 m12 = _mm_mul_ps(_mm_add_ps(yz, wx), s.y);
+	__m128 m20 = _mm_mul_ps(_mm_add_ps(xz, wy), s.z);
+	__m128 m21 = _mm_mul_ps(_mm_sub_ps(yz, wx), s.z);
+	__m128 m22 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), s.z);
+	__m128 tx = t.x, ty = t.y, tz = t.z;
+
+	__m128 w0 = _mm_setzero_ps(), w1 = _mm_setzero_ps(), w2 = _mm_setzero_ps(), w3 = one;
+	_MM_TRANSPOSE4_PS(m00, m01, m02, w0);
+	_MM_TRANSPOSE4_PS(m10, m11, m12, w1);
+	_MM_TRANSPOSE4_PS(m20, m21, m22, w2);
+	_MM_TRANSPOSE4_PS(tx, ty, tz, w3);
+
+	out[0] = mat4(vec4(m00), vec4(m10), vec4(m20), vec4(tx));
+	out[1] = mat4(vec4(m01), vec4(m11), vec4(m21), vec4(ty));
+	out[2] = mat4(vec4(m02), vec4(m12), vec4(m22), vec4(tz));
+	out[3] = mat4(vec4(w0), vec4(w1), vec4(w2), vec4(w3));
+}
+
+inline mat4 lookAt(vec3 from, vec3 to, vec3 up_)
 {
     vec3 fwd = normalize(from - to);
-    vec3 right = cross(normalize(up_), fwd);
+    vec3 right = normalize(cross(up_, fwd));
     vec3 up = cross(fwd, right);
-    
-	return mat4(vec4(    right.x(),         up.x(),        fwd.x(),      0.0f),
-	            vec4(    right.y(),         up.y(),        fwd.y(),      0.0f),
-				vec4(    right.z(),         up.z(),        fwd.z(),      0.0f),
-				vec4(-dot(from, right), -dot(from, up), -dot(from, fwd), 1.0f));
 
+    //the basis vectors are the columns of the rotation part
+    __m128 r0 = right.m;
+    __m128 r1 = up.m;
+    __m128 r2 = fwd.m;
+    __m128 r3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    //translation = -(from * rotation), i.e. (-dot(from, right), -dot(from, up), -dot(from, fwd))
+    __m128 t = _mm_mul_ps(VSWIZZLE(from.m, 0, 0, 0, 0), r0);
+    t = _mm_add_ps(t, _mm_mul_ps(VSWIZZLE(from.m, 1, 1, 1, 1), r1));
+    t = _mm_add_ps(t, _mm_mul_ps(VSWIZZLE(from.m, 2, 2, 2, 2), r2));
+    t = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), t);
+
+    return mat4(vec4(r0), vec4(r1), vec4(r2), vec4(t));
 }
 
-mat4 vulkanPerspectiveSymmetric(float width, float height, 
-                                float n, float f)
+inline mat4 vulkanPerspectiveSymmetric(float width, float height, 
+                                       float n, float f)
 {
     //NOTE: Uses reverse depth !!!
     //pipeline depth info struct compare op should be VK_COMPARE_OP_GREATER_OR_EQUAL;
@@ -130,9 +424,9 @@ mat4 vulkanPerspectiveSymmetric(float width, float height,
                 vec4(0.0f, 0.0f, m32,  0.0f));
 }
 
-mat4 vulkanPerspective(float l, float r, 
-                       float b, float t, 
-                       float n, float f)
+inline mat4 vulkanPerspective(float l, float r, 
+                              float b, float t, 
+                              float n, float f)
 {
     //NOTE: Uses reverse depth !!!
     //pipeline depth info struct compare op should be VK_COMPARE_OP_GREATER_OR_EQUAL;
@@ -150,15 +444,15 @@ mat4 vulkanPerspective(float l, float r,
                 vec4(0.0f, 0.0f, m32,  0.0f));
 }
 
-mat4 vulkanPerspective(float aspect,
-                       float yFov,
-                       float n,
-                       float f)
+inline mat4 vulkanPerspective(float aspect,
+                              float yFov,
+                              float n,
+                              float f)
 {
     //NOTE: Uses reverse depth !!!
     //pipeline depth info struct compare op should be VK_COMPARE_OP_GREATER_OR_EQUAL;
     
-    float focalLength = 1.0f / tan( DEG2RAD( yFov * 0.5f ) );
+    float focalLength = 1.0f / _mm_cvtss_f32(vtan(_mm_set_ss(DEG2RAD( yFov * 0.5f ))));
     float x = focalLength/aspect;
     float y = -focalLength;
     float A = n/(f-n);
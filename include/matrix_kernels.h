@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "matrix.h"
+
+//Batched mat4 kernels.
+//Every kernel has an SSE2, an AVX2+FMA and an AVX-512 implementation. The SSE2 one is used
+//until initMatrixKernels() picks the widest one the CPU supports. On the NEON and scalar
+//backends (see simd_backend.h) only the 128-bit version exists.
+//Input and output arrays may alias (in-place transforms are fine).
+
+void initMatrixKernels();
+
+//name of the selected implementation, for logging.
+const char *matrixKernelsName();
+
+//out[i] = in[i] * m  (row-vector convention, same as operator*(vec4, mat4))
+void transformPoints(const vec4 *in, vec4 *out, size_t count, mat4 m);
+
+//out[i] = in[i] * m
+void multiplyMatrices(const mat4 *in, mat4 *out, size_t count, mat4 m);
+
+//out[i] = local[i] * parent[i]  (local-to-world of a child given its parent's world matrix)
+void composeMatrices(const mat4 *local, const mat4 *parent, mat4 *out, size_t count);
+
+//out[i] = local[i] * world[parentIndex[i]], the same with the parents looked up in the world
+//matrix array of a hierarchy. out must not overlap the parents being read.
+void composeMatricesIndexed(const mat4 *local, const mat4 *world, const uint32_t *parentIndex, mat4 *out, size_t count);
+
+//out[i] = inverse(in[i]). These are plain loops over the SSE versions in matrix.h: the
+//block-wise inverse is shuffle bound and gains nothing from wider registers.
+void invertMatrices(const mat4 *in, mat4 *out, size_t count);
+
+//out[i] = inverseAffine(in[i]), for matrices whose last column is (0, 0, 0, 1).
+void invertAffineMatrices(const mat4 *in, mat4 *out, size_t count);
+
+//out[i] = normalMatrix(in[i])
+void normalMatrices(const mat4 *in, mat4 *out, size_t count);
+
+//out[i] = slerp(a[i], b[i], t[i]) over SoA blocks of 4 quaternions (count is the number of
+//blocks). Keyframe tracks are expected to be stored as quatx4 so sampling never transposes.
+void slerpQuats(const quatx4 *a, const quatx4 *b, const vec4 *t, quatx4 *out, size_t count);
+
+//out[i] = nlerp(a[i], b[i], t) with one t for all the blocks: sampling every joint of a pose
+//between two keyframes.
+void nlerpQuats(const quatx4 *a, const quatx4 *b, float t, quatx4 *out, size_t count);
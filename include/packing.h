@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "vectors.h"
+
+//Conversion of float data to the compact formats the GPU reads natively, so vertex, instance
+//and texture data can be uploaded at half the size (or less) where the precision allows.
+//
+//  half        VK_FORMAT_R16_SFLOAT (and the 2/3/4 component variants), round to nearest even
+//  unorm8/16   VK_FORMAT_R8_UNORM, R16_UNORM...   clamp(x, 0, 1) * (2^n - 1), rounded
+//  snorm8/16   VK_FORMAT_R8_SNORM, R16_SNORM...   clamp(x, -1, 1) * (2^(n-1) - 1), rounded
+//  1010102     VK_FORMAT_A2B10G10R10_UNORM/SNORM_PACK32, x in the low bits, w in the top 2
+//
+//Multi-component formats are just consecutive components, so an array of vec2/vec3/vec4 is
+//converted as count * components floats.
+//
+//The batch versions are meant to write straight into mapped upload memory: the output is
+//written with non-temporal (streaming) stores, which go around the cache and combine into
+//full lines, the best case for write-combined memory. Don't use them on data that is going
+//to be read back by the CPU right away. The output needs no particular alignment, but only
+//the part that is 16-byte aligned is streamed, and an output not aligned to its element
+//size is written with plain stores.
+//
+//floatToHalf/halfToFloat use F16C when initPackingKernels() finds it, SSE2 otherwise. Both
+//give the same results, including NaNs (made quiet, payload truncated to fit), infinities
+//and subnormals. The NEON and scalar backends use the single value functions below.
+
+//============================ Single values ===============================
+//Plain C++, also the reference the batch kernels are checked against.
+
+FORCE_INLINE uint16_t floatToHalf(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, 4);
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t abs = x & 0x7FFFFFFF;
+
+	if(abs >= 0x7F800000) //inf or NaN, NaNs stay NaNs
+	{
+		return (uint16_t)(sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 | ((abs >> 13) & 0x3FF) : 0));
+	}
+	if(abs >= 0x477FF000) //rounds to a value above 65504
+	{
+		return (uint16_t)(sign | 0x7C00);
+	}
+	if(abs < 0x38800000) //below the smallest normal half: subnormal or 0
+	{
+		//align the mantissa (with its implicit 1) to the 2^-24 grid, rounding to nearest even
+		uint32_t shift = 126 - (abs >> 23);
+		if(shift > 24) return (uint16_t)sign;
+		uint32_t m = (abs & 0x7FFFFF) | 0x800000;
+		uint32_t h = m >> shift;
+		uint32_t rest = m & ((1u << shift) - 1);
+		uint32_t half = 1u << (shift - 1);
+		h += (rest > half || (rest == half && (h & 1))) ? 1 : 0;
+		return (uint16_t)(sign | h);
+	}
+
+	//rebias the exponent, round the 13 dropped mantissa bits to nearest even
+	uint32_t h = (abs - 0x38000000) >> 13;
+	uint32_t rest = abs & 0x1FFF;
+	h += (rest > 0x1000 || (rest == 0x1000 && (h & 1))) ? 1 : 0;
+	return (uint16_t)(sign | h);
+}
+
+FORCE_INLINE float halfToFloat(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1F;
+	uint32_t mantissa = h & 0x3FF;
+	uint32_t x;
+
+	if(exponent == 0x1F)
+	{
+		//NaNs come out quiet, like F16C
+		x = sign | 0x7F800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0);
+	}
+	else if(exponent == 0)
+	{
+		//subnormal (or 0): mantissa * 2^-24, exact in float
+		float f = (float)mantissa * (1.0f / 16777216.0f);
+		memcpy(&x, &f, 4);
+		x |= sign;
+	}
+	else
+	{
+		x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float f;
+	memcpy(&f, &x, 4);
+	return f;
+}
+
+//Vulkan's float -> normalized fixed point conversion: clamp to [lo, 1], scale, round to
+//nearest even (like the SSE conversions). NaN becomes 0.
+FORCE_INLINE int32_t quantizeNorm(float f, float lo, float scale)
+{
+	f = (f == f) ? fminf(fmaxf(f, lo), 1.0f) : 0.0f;
+	return (int32_t)lrintf(f * scale);
+}
+
+FORCE_INLINE uint8_t packUnorm8(float f)    { return (uint8_t)quantizeNorm(f, 0.0f, 255.0f); }
+FORCE_INLINE int8_t packSnorm8(float f)     { return (int8_t)quantizeNorm(f, -1.0f, 127.0f); }
+FORCE_INLINE uint16_t packUnorm16(float f)  { return (uint16_t)quantizeNorm(f, 0.0f, 65535.0f); }
+FORCE_INLINE int16_t packSnorm16(float f)   { return (int16_t)quantizeNorm(f, -1.0f, 32767.0f); }
+
+FORCE_INLINE uint32_t packUnorm1010102(vec4 v)
+{
+	uint32_t x = (uint32_t)quantizeNorm(v.x(), 0.0f, 1023.0f);
+	uint32_t y = (uint32_t)quantizeNorm(v.y(), 0.0f, 1023.0f);
+	uint32_t z = (uint32_t)quantizeNorm(v.z(), 0.0f, 1023.0f);
+	uint32_t w = (uint32_t)quantizeNorm(v.w(), 0.0f, 3.0f);
+	return x | (y << 10) | (z << 20) | (w << 30);
+}
+
+//two's complement fields
+FORCE_INLINE uint32_t packSnorm1010102(vec4 v)
+{
+	uint32_t x = (uint32_t)quantizeNorm(v.x(), -1.0f, 511.0f) & 0x3FF;
+	uint32_t y = (uint32_t)quantizeNorm(v.y(), -1.0f, 511.0f) & 0x3FF;
+	uint32_t z = (uint32_t)quantizeNorm(v.z(), -1.0f, 511.0f) & 0x3FF;
+	uint32_t w = (uint32_t)quantizeNorm(v.w(), -1.0f, 1.0f) & 0x3;
+	return x | (y << 10) | (z << 20) | (w << 30);
+}
+
+//============================ Batch kernels ===============================
+
+void initPackingKernels();
+
+//name of the selected implementation, for logging.
+const char *packingKernelsName();
+
+void floatToHalf(const float *in, uint16_t *out, size_t count);
+void halfToFloat(const uint16_t *in, float *out, size_t count);
+
+void packUnorm8(const float *in, uint8_t *out, size_t count);
+void packSnorm8(const float *in, int8_t *out, size_t count);
+void packUnorm16(const float *in, uint16_t *out, size_t count);
+void packSnorm16(const float *in, int16_t *out, size_t count);
+
+void packUnorm1010102(const vec4 *in, uint32_t *out, size_t count);
+void packSnorm1010102(const vec4 *in, uint32_t *out, size_t count);
+
+//memcpy with the same streaming stores, for data that is uploaded as it is (matrices).
+void streamCopy(void *dst, const void *src, size_t size);
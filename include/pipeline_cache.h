@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include "vulkan/vulkan.h"
+#include "typedefs_and_macros.h"
+
+//A VkPipelineCache kept on disk between runs.
+//
+//The cache is created once per device, seeded with the file's contents, and kept across
+//resizes, so pipelines created again are found in it instead of compiled again. The file is
+//only used when its VkPipelineCacheHeaderVersionOne matches the device: drivers are required
+//to ignore data from another device or driver version, but not all of them check, and stale
+//data is of no use anyway.
+//
+//Saving writes the cache data to a temporary file next to the cache file and renames it over
+//the old one, so a crash or a full disk mid-save leaves the previous file as it was. The cache
+//is saved on destroy() and, as pipelines get added, from update() every so often.
+//
+//Every pipeline creation is logged as a cache hit or miss. With VK_EXT_pipeline_creation_feedback
+//the driver says which, from APPLICATION_PIPELINE_CACHE_HIT_BIT. Without it, a pipeline counts
+//as a hit when the cache was loaded from disk, which is only right on runs that compile the
+//same pipelines as the last one.
+
+//seconds between update() saves
+#define PIPELINE_CACHE_SAVE_INTERVAL 30.0
+
+struct PipelineCacheStats
+{
+	uint32 pipelines;
+	double createMs;
+	uint32 hits;  //found in the cache
+	double hitCreateMs;
+};
+
+//What the driver reports about one pipeline creation, chained with PipelineCache::feedback().
+#define PIPELINE_FEEDBACK_MAX_STAGES 2
+
+struct PipelineFeedback
+{
+	VkPipelineCreationFeedbackEXT pipeline;
+	VkPipelineCreationFeedbackEXT stages[PIPELINE_FEEDBACK_MAX_STAGES];
+	VkPipelineCreationFeedbackCreateInfoEXT info;
+};
+
+struct PipelineCache
+{
+	typedef std::chrono::steady_clock Clock;
+
+	VkDevice device;
+	VkPipelineCache cache;
+
+	std::string filepath;  //empty to not persist
+	bool loaded;           //seeded from the file
+	bool creationFeedback; //VK_EXT_pipeline_creation_feedback enabled
+	size_t savedSize;      //of the data last loaded or saved
+	Clock::time_point lastSave;
+
+	PipelineCacheStats stats;
+	std::mutex statsMutex;  //pipelines are created from several threads
+
+	void init(VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &filepath,
+	          bool creationFeedback);
+	void destroy();  //saves first
+
+	//Writes the cache to disk if it grew since it was loaded or last saved.
+	bool save();
+	//Saves every PIPELINE_CACHE_SAVE_INTERVAL seconds, call once a frame.
+	void update();
+
+	//Chains feedback in front of *next, the pNext of a pipeline create info with stageCount
+	//shader stages, when the driver can report. Pass it to created() afterwards.
+	void feedback(PipelineFeedback &feedback, const void **next, uint32 stageCount);
+	//Logs and counts the creation of a pipeline that took ms as a cache hit or miss. Thread
+	//safe, as is creating pipelines with cache.
+	void created(const char *name, double ms, const PipelineFeedback &feedback);
+};
+
+//Writes data to a temporary file next to filepath and renames it over filepath.
+bool writeFileAtomic(const std::string &filepath, const void *data, size_t size);
+
+//Whether data, a pipeline cache's contents, was written by the device with properties.
+bool pipelineCacheMatches(const uint8 *data, size_t size, const VkPhysicalDeviceProperties &properties);
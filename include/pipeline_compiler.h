@@ -0,0 +1,183 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "typedefs_and_macros.h"
+#include "pipeline_cache.h"
+#include "shader_library.h"
+
+//Graphics pipelines compiled on background threads.
+//
+//request() queues a pipeline and returns its id right away. Until the pipeline is compiled,
+//get() returns its fallback instead, a generic pipeline compiled up front with compile(), so
+//draws never wait for a compile. Finished pipelines are only swapped in by update(), at a
+//frame boundary, and the ones they replace are destroyed once the frames that may still use
+//them are done.
+//
+//With VK_EXT_graphics_pipeline_library a pipeline is built from four libraries: vertex input,
+//pre-rasterization (vertex shader), fragment shader and fragment output. Each is compiled once
+//per distinct state and shared by every pipeline using it, so a new material usually only
+//compiles its fragment shader. Linking the libraries without link time optimization is fast
+//enough to do synchronously, and the link time optimized pipeline then replaces that one once
+//it's compiled in the background. Without the extension every pipeline is compiled whole.
+//
+//Every pipeline requested is recorded in a prewarm list, saved on shutDown() and queued again
+//at the next run's begin(), so the pipelines of previous runs are in the pipeline cache, and
+//usually compiled, before anything asks for them.
+//
+//Shaders come from a ShaderLibrary. When one of them is recompiled after an edit, update()
+//queues the pipelines using it again, the libraries of the new code are compiled beside the
+//old ones, and the new pipelines are swapped in like any other once compiled. Until then, and
+//for good when the edited shader doesn't compile, the old pipelines are drawn with.
+//
+//All pipelines share the render pass and layout given to begin(). request(), compile() and
+//update() are called from the main thread; get() from anywhere, but not during update().
+
+#define PIPELINE_NONE 0xFFFFFFFF
+
+#define PIPELINE_SHADER_PATH 96  //longest shader path + 1
+
+//where the vertex shader gets its vertices from
+#define VERTEX_INPUT_PULLED  0  //no vertex buffers, the shader indexes its own data
+#define VERTEX_INPUT_SKINNED 1  //binding 0: SkinnedOutputVertex (skinning.h), position and normal
+
+//Everything a pipeline varies by, plain data so the prewarm list can be saved as it is.
+struct GraphicsPipelineDesc
+{
+	char vertexShader[PIPELINE_SHADER_PATH];  //GLSL sources or SPIR-V files
+	char fragmentShader[PIPELINE_SHADER_PATH];
+
+	uint32 vertexInput;  //VERTEX_INPUT_*
+	VkPrimitiveTopology topology;
+	VkPolygonMode polygonMode;
+	VkCullModeFlags cullMode;
+	VkFrontFace frontFace;
+
+	VkBool32 depthTest;
+	VkBool32 depthWrite;
+	VkCompareOp depthCompareOp;
+
+	VkBool32 blendEnable;  //alpha blending
+};
+
+//Pulled triangle lists with back face culling, reverse depth and no blending.
+GraphicsPipelineDesc makePipelineDesc(const char *vertexShader, const char *fragmentShader);
+
+struct CompiledPipeline
+{
+	GraphicsPipelineDesc desc;
+	uint32 fallback;    //drawn with until pipeline is set, PIPELINE_NONE for none
+	VkPipeline pipeline;
+	bool optimized;     //link time optimized, or compiled whole
+	bool queued;        //waiting for or being compiled in the background
+	uint32 version;         //bumped by every reload of its shaders
+	uint32 pipelineVersion; //the version pipeline was compiled from
+};
+
+//A part of a pipeline compiled on its own
+struct PipelineLibrary
+{
+	VkGraphicsPipelineLibraryFlagsEXT part;
+	uint64 key;  //hash of the desc fields and shader code the part depends on
+	VkPipeline pipeline;
+};
+
+struct QueuedPipeline
+{
+	uint32 id;
+	GraphicsPipelineDesc desc;
+	bool linkFast;  //link without optimization first, for libraries when id has no current pipeline
+	uint32 version;
+};
+
+struct PipelineCompilerResult
+{
+	uint32 id;
+	VkPipeline pipeline;  //VK_NULL_HANDLE when a shader doesn't compile
+	bool optimized;
+	uint32 version;
+};
+
+struct RetiredPipeline
+{
+	VkPipeline pipeline;
+	uint64 frameNumber;  //last frame that may use it
+};
+
+struct PipelineCompiler
+{
+	VkDevice device;
+	PipelineCache *cache;
+	ShaderLibrary *shaders;
+	bool useLibraries;
+
+	VkRenderPass renderPass;  //of every pipeline, set by begin()
+	VkPipelineLayout layout;
+
+	std::vector<CompiledPipeline> pipelines;  //by id, main thread only
+	std::vector<RetiredPipeline> retired;
+	uint64 generation;  //bumped by every pipeline swapped in
+
+	std::string prewarmFilepath;
+	std::vector<GraphicsPipelineDesc> prewarm;  //loaded, queued by begin()
+
+	//shared with the workers
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::condition_variable idle;
+	std::vector<std::thread> workers;
+	std::vector<QueuedPipeline> queue;  //first in first out
+	std::vector<PipelineCompilerResult> results;
+	std::vector<PipelineLibrary> libraries;
+	uint32 busyWorkers;
+	bool quit;
+
+	void init(VkDevice device,
+	          PipelineCache *cache,
+	          ShaderLibrary *shaders,
+	          bool useLibraries,
+	          uint32 threadCount,
+	          const std::string &prewarmFilepath);
+	void shutDown();  //saves the prewarm list, the device must be idle
+
+	//Sets the target of every pipeline and queues the prewarm list, then every pipeline known
+	//before reset().
+	void begin(VkRenderPass renderPass, VkPipelineLayout layout);
+	//Drops every pipeline and library for a new render pass or layout. The device must be
+	//idle. Ids stay valid and are compiled again by the next begin().
+	void reset();
+
+	//Compiles desc now, exits if it doesn't compile, or with hot reload waits until its shaders
+	//are fixed. Linked without link time optimization when libraries are used: the
+	//optimized pipeline is queued and swapped in later.
+	uint32 compile(const GraphicsPipelineDesc &desc);
+	//Queues desc, drawn with fallback until compiled. The same desc twice gives the same id.
+	uint32 request(const GraphicsPipelineDesc &desc, uint32 fallback);
+
+	//The pipeline to draw id with: its own once compiled, its fallback's until then.
+	//VK_NULL_HANDLE if neither is compiled.
+	VkPipeline get(uint32 id) const;
+	bool ready(uint32 id) const { return pipelines[id].pipeline != VK_NULL_HANDLE; }
+
+	//At the frame boundary, after FrameScheduler::beginFrame(): queues the pipelines whose
+	//shaders were reloaded, swaps in the pipelines compiled since the last call and destroys
+	//the replaced ones no frame uses anymore.
+	void update(uint64 frameNumber, uint32 framesInFlight);
+
+	//Queues every pipeline using the shader at path again, for its new code.
+	void reload(const std::string &path);
+
+	//--- internal ---
+	uint32 add(const GraphicsPipelineDesc &desc, uint32 fallback);  //without queueing it
+	uint32 find(const GraphicsPipelineDesc &desc) const;
+	void enqueue(uint32 id);
+	void workerLoop();
+	//These return VK_NULL_HANDLE when a shader doesn't compile
+	VkPipeline library(const GraphicsPipelineDesc &desc, VkGraphicsPipelineLibraryFlagsEXT part);
+	VkPipeline link(const GraphicsPipelineDesc &desc, bool optimize);
+	VkPipeline compileWhole(const GraphicsPipelineDesc &desc);
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "typedefs_and_macros.h"
+
+//Presentation policy and frame pacing.
+//
+//A latency mode picks the present mode and swapchain image count, trading how many frames may
+//queue up ahead of the display for smoothness:
+//  -throughput: FIFO with 3 images. Never tears, but up to 2 frames wait for the display.
+//  -low latency: MAILBOX, which replaces queued frames instead of waiting behind them, or FIFO
+//   with 2 images where it isn't supported. FIFO then also waits on the CPU, before the frame
+//   samples its input, until no more than one present is queued (VK_KHR_present_wait, with
+//   the presents numbered by VK_KHR_present_id).
+//  -uncapped: IMMEDIATE, may tear. MAILBOX, then FIFO, where it isn't supported.
+//
+//An optional frame rate cap sleeps before the frame begins, on top of any mode.
+//
+//The present interval is measured between presents reaching the display when they are waited
+//for, as seen when the waits return, and between vkQueuePresentKHR calls otherwise. The queue
+//depth is sampled at every present: presents not on screen yet (present wait only) and frames
+//the GPU hasn't finished.
+
+//VulkanConfig::latencyMode
+#define LATENCY_THROUGHPUT 0
+#define LATENCY_LOW        1
+#define LATENCY_UNCAPPED   2
+
+struct PresentSettings
+{
+	VkPresentModeKHR presentMode;
+	uint32 imageCount;
+	uint32 maxQueuedPresents;  //presents not on screen yet a frame may begin with, 0 for no wait
+};
+
+//The settings of latencyMode among the surface's present modes.
+PresentSettings choosePresentSettings(uint32 latencyMode,
+                                      const std::vector<VkPresentModeKHR> &presentModes,
+                                      bool presentWait);
+
+struct PresentStats
+{
+	uint32 intervals;
+	double intervalMsSum;
+	double minIntervalMs;
+	double maxIntervalMs;
+
+	uint32 presents;
+	uint64 queuedPresentsSum;  //not on screen yet
+	uint64 gpuFramesSum;       //not finished on the GPU
+	uint32 maxQueuedPresents;
+	uint32 maxGpuFrames;
+
+	double intervalMs() const { return intervals ? intervalMsSum / intervals : 0.0; }
+	double queuedPresents() const { return presents ? (double)queuedPresentsSum / presents : 0.0; }
+	double gpuFrames() const { return presents ? (double)gpuFramesSum / presents : 0.0; }
+};
+
+struct PresentPacer
+{
+	typedef std::chrono::steady_clock Clock;
+
+	VkDevice device;
+	PFN_vkWaitForPresentKHR waitForPresent;  //null without VK_KHR_present_wait
+
+	VkSwapchainKHR swapchain;
+	PresentSettings settings;
+
+	float frameRateCap;  //frames per second, 0 for none
+	Clock::time_point nextFrame;
+
+	uint64 presentId;      //of the last present, they start at 1
+	uint64 presentsShown;  //presents known to be on screen, or given up on
+	Clock::time_point lastPresent;
+	bool hasLastPresent;
+	double smoothedIntervalMs;  //for predictions, 0 until measured
+
+	PresentStats stats;  //since the last resetStats()
+
+	void init(VkDevice device, PFN_vkWaitForPresentKHR waitForPresent, float frameRateCap);
+
+	//For a new swapchain, created with settings. Presents to the old one aren't waited for.
+	void setSwapchain(VkSwapchainKHR swapchain, PresentSettings settings);
+
+	//Before the frame samples its input: sleeps for the frame rate cap and waits until no more
+	//than settings.maxQueuedPresents presents are queued.
+	void beginFrame();
+
+	//vkQueuePresentKHR with the next present id chained in. gpuFrames is how many frames the
+	//GPU hasn't finished, for the stats.
+	VkResult present(VkQueue queue, const VkPresentInfoKHR &presentInfo, uint32 gpuFrames);
+
+	//Seconds until a frame submitted now is likely to be on screen: a present interval for
+	//every frame queued ahead of it and one for its own. 0 until an interval was measured.
+	double predictPresentDelay(uint32 gpuFrames) const;
+
+	void resetStats();
+
+	void addInterval(Clock::time_point now);
+};
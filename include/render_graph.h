@@ -0,0 +1,235 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan_manager.h"
+#include "barriers.h"
+
+//Frame graph: the frame as a list of passes that declare how they use named resources.
+//
+//compile() works out, once per swapchain:
+//  -which passes are needed: walking backwards from the outputs (imported resources with a
+//   final usage, or marked with markOutput()), a pass is kept when it writes something a
+//   later kept pass or an output reads. Writes nobody reads are dropped with their pass.
+//  -the barriers: every resource's layout, pending write and reads since that write are
+//   tracked through the kept passes, and a pass only gets the barriers its accesses need.
+//   A read of something already made visible to that stage needs none, a write after reads
+//   only an execution dependency. All the barriers before a pass are recorded with one
+//   BarrierBatch flush, each keeping its own stage masks when synchronization2 is there.
+//  -a render pass per graphics pass, with load and store ops from whether the attachment's
+//   contents are defined and read later. Layouts are changed by the barriers, not the render
+//   passes.
+//  -memory for the transient images: images whose lifetimes (first to last kept pass using
+//   them) don't overlap share a VkDeviceMemory. The first use of a transient image waits on
+//   the last use of whatever was in its memory before it, the previous frame's included.
+//
+//execute() then records the passes with their barriers, and the barriers taking the imported
+//resources to their final usage, e.g. PRESENT_SRC_KHR and the present queue family.
+//
+//Resources and passes are referred to by the indices returned when adding them. All passes
+//run on one queue.
+
+//What a pass does with a resource.
+#define USAGE_NONE                 0   //no pending access, contents undefined (initial only)
+#define USAGE_SWAPCHAIN_ACQUIRE    1   //acquired, waited on at COLOR_ATTACHMENT_OUTPUT (initial only)
+#define USAGE_COLOR_ATTACHMENT     2
+#define USAGE_DEPTH_ATTACHMENT     3   //depth test and write
+#define USAGE_DEPTH_READ           4   //depth test without write, e.g. after a depth prepass
+#define USAGE_SAMPLED_FRAGMENT     5
+#define USAGE_SAMPLED_COMPUTE      6
+#define USAGE_STORAGE_READ_COMPUTE 7
+#define USAGE_STORAGE_WRITE_COMPUTE 8
+#define USAGE_STORAGE_READ_VERTEX  9
+#define USAGE_VERTEX_BUFFER        10
+#define USAGE_TRANSFER_SRC         11
+#define USAGE_TRANSFER_DST         12
+#define USAGE_PRESENT              13  //final only
+#define USAGE_COUNT                14
+
+#define RENDER_GRAPH_MAX_ATTACHMENTS 8
+
+struct RenderGraph;
+
+struct RenderGraphContext
+{
+	RenderGraph *graph;
+	VkCommandBuffer cmd;
+	//graphics passes only. The pass begins and ends the render pass itself, so it can pick
+	//inline or secondary command buffer contents.
+	VkRenderPassBeginInfo renderPassInfo;
+};
+
+typedef void (*RenderPassFunction)(const RenderGraphContext &context, void *data);
+
+struct RenderGraphAccess
+{
+	uint32 resource;
+	uint32 usage;
+	bool clear;  //attachments only
+	VkClearValue clearValue;
+
+	//set by compile()
+	bool load;   //contents defined before the pass
+	bool store;  //read by a later pass, or an output
+};
+
+//where a resource is between passes while compiling
+struct RenderGraphState
+{
+	VkImageLayout layout;
+	VkPipelineStageFlags writeStages;  //of the last write, 0 once nothing has to wait on it
+	VkAccessFlags writeAccess;
+	VkPipelineStageFlags readStages;   //reads since the last write
+	VkPipelineStageFlags visibleStages; //what the last write has been made visible to
+	VkAccessFlags visibleAccess;
+	bool defined;                      //contents worth loading
+};
+
+struct RenderGraphResource
+{
+	std::string name;
+	bool isImage;
+	bool imported;
+	bool output;
+
+	VkFormat format;
+	VkImageAspectFlags aspect;
+	uint32 width, height;
+	VkDeviceSize size;  //buffers
+
+	uint32 initialUsage;  //imported only
+	uint32 finalUsage;    //imported only, USAGE_NONE to leave it where the last pass did
+	uint32 finalQueueFamily;
+
+	//set by compile() for transient images, by setImage()/setBuffer() for imported resources
+	VkImage image;
+	VkImageView view;
+	VkBuffer buffer;
+
+	VkImageUsageFlags imageUsage;
+	int32 firstPass, lastPass;  //kept passes using it, -1 if none
+	int32 memoryBlock;
+	RenderGraphState endState;
+};
+
+struct RenderGraphPass
+{
+	std::string name;
+	RenderPassFunction function;
+	void *data;
+	std::vector<RenderGraphAccess> accesses;
+
+	bool graphics;  //has attachments
+	bool live;      //kept by compile()
+
+	VkRenderPass renderPass;
+	uint32 attachmentCount;
+	uint32 attachments[RENDER_GRAPH_MAX_ATTACHMENTS];  //resources, colors first
+	VkClearValue clearValues[RENDER_GRAPH_MAX_ATTACHMENTS];
+	uint32 width, height;
+
+	uint32 barrierBatch;
+};
+
+struct RenderGraphBarrier
+{
+	uint32 resource;
+	bool executionOnly;  //just the stages, no memory barrier for the resource
+	VkPipelineStageFlags srcStages, dstStages;
+	VkAccessFlags srcAccess, dstAccess;
+	VkImageLayout oldLayout, newLayout;
+	uint32 srcQueueFamily, dstQueueFamily;
+};
+
+//the barriers recorded with one flush
+struct RenderGraphBarrierBatch
+{
+	uint32 firstBarrier, barrierCount;
+};
+
+struct RenderGraphFramebuffer
+{
+	uint32 pass;
+	VkImageView views[RENDER_GRAPH_MAX_ATTACHMENTS];
+	VkFramebuffer framebuffer;
+};
+
+struct RenderGraphMemoryBlock
+{
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint32 memoryTypeBits;
+	std::vector<uint32> resources;  //in order of first use
+};
+
+struct RenderGraphStats
+{
+	uint32 passes;
+	uint32 culledPasses;
+	uint32 barriers;
+	uint32 barrierBatches;
+	VkDeviceSize transientBytes;  //sum of the transient images' sizes
+	VkDeviceSize allocatedBytes;  //memory actually allocated for them
+};
+
+struct RenderGraph
+{
+	VkDevice device;
+	uint32 queueFamily;
+
+	std::vector<RenderGraphResource> resources;
+	std::vector<RenderGraphPass> passes;
+
+	std::vector<uint32> livePasses;
+	std::vector<RenderGraphBarrier> barriers;
+	std::vector<RenderGraphBarrierBatch> batches;  //one per live pass, then the final one
+	std::vector<RenderGraphMemoryBlock> memoryBlocks;
+	std::vector<RenderGraphFramebuffer> framebuffers;
+
+	BarrierBatch cmdBarriers;  //execute() scratch
+
+	RenderGraphStats stats;
+
+	//--- building ---
+	//An image owned outside the graph, bound with setImage() before each execute().
+	uint32 importImage(const char *name, VkFormat format, uint32 width, uint32 height,
+	                   uint32 initialUsage, uint32 finalUsage,
+	                   uint32 finalQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+	uint32 importBuffer(const char *name, VkDeviceSize size, uint32 initialUsage, uint32 finalUsage);
+
+	//An image that only lives during the frame, created by compile().
+	uint32 createImage(const char *name, VkFormat format, uint32 width, uint32 height);
+
+	//Keeps the passes writing resource even though no pass reads it.
+	void markOutput(uint32 resource);
+
+	uint32 addPass(const char *name, RenderPassFunction function, void *data);
+
+	//Declares an access of pass to resource. clearValue, for attachments, clears it when the
+	//pass begins instead of loading it.
+	void use(uint32 pass, uint32 resource, uint32 usage, const VkClearValue *clearValue = nullptr);
+
+	//--- compiled ---
+	void compile(VulkanManager &vulkanManager);
+	void destroy();
+
+	void setImage(uint32 resource, VkImage image, VkImageView view);
+	void setBuffer(uint32 resource, VkBuffer buffer);
+
+	void execute(VkCommandBuffer cmd);
+
+	VkRenderPass renderPass(uint32 pass) const { return passes[pass].renderPass; }
+
+	//The barrier taking an imported resource to its final usage, false if it needs none. A
+	//queue family release has to be acquired on the other queue with the same layouts.
+	bool finalBarrier(uint32 resource, RenderGraphBarrier &barrier) const;
+
+	//internal
+	void cullPasses();
+	void trackAccesses();
+	void allocateTransients(VulkanManager &vulkanManager);
+	void initRenderPass(RenderGraphPass &pass);
+	VkFramebuffer getFramebuffer(uint32 pass);
+	void recordBarriers(VkCommandBuffer cmd, const RenderGraphBarrierBatch &batch);
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <shaderc/shaderc.h>
+#include "typedefs_and_macros.h"
+
+//Shaders compiled from GLSL at runtime, and recompiled when their sources change.
+//
+//load() takes a GLSL source (.vert, .frag, .comp...) and returns its SPIR-V, compiled with
+//shaderc, the compiler library of the Vulkan SDK. The SPIR-V is cached on disk under a hash
+//of the source, so unchanged shaders aren't compiled again at the next run, and in memory
+//for the other pipelines using them. Precompiled .spv files are loaded as they are.
+//
+//With hot reload, a thread watches the directories of the sources loaded so far (change
+//notifications on Win32, inotify on Linux). A source whose contents changed is recompiled on
+//that thread and, if it compiles, reported by takeChanged(); compile errors are only logged,
+//the last good SPIR-V stays. PipelineCompiler::update() then rebuilds the pipelines using it.
+//A source that doesn't compile when it is first loaded, or doesn't exist yet, is watched all
+//the same, and reported once it compiles.
+
+#define SHADER_CACHE_VERSION 1  //bump when the compile options change
+
+//milliseconds between a change notification and reading the sources, for the editor to be
+//done writing
+#define SHADER_RELOAD_SETTLE_MS 50
+
+struct ShaderSource
+{
+	std::string path;
+	uint64 sourceHash;  //of the text last compiled, 0 for .spv files
+	uint64 codeHash;    //of spirv
+	std::vector<uint32> spirv;  //empty while the source doesn't compile
+};
+
+struct ShaderLibrary
+{
+	shaderc_compiler_t compiler;
+	std::string cacheDir;
+
+	std::mutex mutex;
+	std::vector<ShaderSource> sources;  //loaded so far
+	std::vector<std::string> changed;   //recompiled since the last takeChanged()
+
+	std::thread watcher;
+	std::atomic<bool> quit;
+	bool hotReload;
+
+	//cacheDir empty for no disk cache
+	void init(const std::string &cacheDir, bool hotReload);
+	void shutDown();
+
+	//The SPIR-V of the shader at path and a hash identifying it. False if it doesn't compile,
+	//until it is fixed and reported by takeChanged(). Thread safe.
+	bool load(const char *path, std::vector<uint32> &spirv, uint64 &codeHash);
+
+	//The sources recompiled since the last call. Main thread.
+	void takeChanged(std::vector<std::string> &paths);
+
+	//--- internal ---
+	bool compile(const std::string &path, const std::string &source, std::vector<uint32> &spirv);
+	void watchLoop();
+	void scan();  //recompiles the sources that changed
+};
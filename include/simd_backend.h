@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Compiler and instruction set abstraction under vectors.h, matrix.h and simd_math.h.
+//
+//The math code is written against the SSE intrinsics (__m128, _mm_add_ps, ...). On x86 those
+//are the real thing. On ARM the subset we use is implemented with NEON in simd_backend_neon.h,
+//and anywhere else (or when VEC_FORCE_SCALAR is defined) with plain C++ in
+//simd_backend_scalar.h, which is also the reference the other backends are checked against
+//(bench/simd_conformance.cpp).
+//
+//The backend is picked at compile time. Exactly one of these ends up defined:
+//  VEC_BACKEND_SSE     x86 / x64. On top of the SSE2 baseline:
+//                        VEC_SSE41  when the compiler targets SSE4.1 (-msse4.1, /arch:AVX)
+//                        VEC_AVX    when it targets AVX (-mavx, /arch:AVX), enables vec8/vec3x8
+//                        VEC_AVX2   when it targets AVX2 + FMA (-mavx2 -mfma, /arch:AVX2)
+//  VEC_BACKEND_NEON    AArch64, or ARMv7 with NEON (GCC/Clang)
+//  VEC_BACKEND_SCALAR  everything else, or VEC_FORCE_SCALAR
+//VEC_BACKEND_NAME is a string for logging.
+
+#if defined(_MSC_VER) && !defined(__clang__)
+	#define FORCE_INLINE __forceinline
+#else
+	#define FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+//Constants defined in headers, with a single instance across translation units.
+#if defined(_MSC_VER)
+	#define VCONST extern const __declspec(selectany)
+#else
+	#define VCONST extern const __attribute__((weak))
+#endif
+
+#if defined(VEC_FORCE_SCALAR)
+	#define VEC_BACKEND_SCALAR
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define VEC_BACKEND_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define VEC_BACKEND_NEON
+#else
+	#define VEC_BACKEND_SCALAR
+#endif
+
+#if defined(VEC_BACKEND_SSE)
+
+	#include <emmintrin.h>
+
+	#if defined(__SSE4_1__) || defined(__AVX__)
+		#include <smmintrin.h>
+		#define VEC_SSE41
+	#endif
+
+	#if defined(__AVX__)
+		#include <immintrin.h>
+		#define VEC_AVX
+	#endif
+
+	//MSVC has no __FMA__, /arch:AVX2 implies it
+	#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+		#define VEC_AVX2
+	#endif
+
+	#if defined(VEC_AVX2)
+		#define VEC_BACKEND_NAME "AVX2"
+	#elif defined(VEC_AVX)
+		#define VEC_BACKEND_NAME "AVX"
+	#elif defined(VEC_SSE41)
+		#define VEC_BACKEND_NAME "SSE4.1"
+	#else
+		#define VEC_BACKEND_NAME "SSE2"
+	#endif
+
+#elif defined(VEC_BACKEND_NEON)
+
+	#include "simd_backend_neon.h"
+	#define VEC_BACKEND_NAME "NEON"
+
+#else
+
+	#include "simd_backend_scalar.h"
+	#define VEC_BACKEND_NAME "scalar"
+
+#endif
+
+//Lane access. Every backend's register type can be read as an array of 4 floats
+//(MSVC's __m128 is a union, GCC/Clang vector types alias their element type).
+FORCE_INLINE float vlane(const __m128 &v, size_t i) { return reinterpret_cast<const float *>(&v)[i]; }
+FORCE_INLINE float &vlane(__m128 &v, size_t i) { return reinterpret_cast<float *>(&v)[i]; }
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <arm_neon.h>
+
+//NEON implementation of the SSE intrinsics used by the math headers. Included by
+//simd_backend.h, do not include directly. Needs GCC or Clang (vector subscripts and brace
+//initialization of the NEON types).
+//
+//Results match SSE bit for bit except:
+// - _mm_rsqrt_ps: vrsqrte + one refinement step, ~16 bits instead of SSE's ~12.
+// - on ARMv7, which has no divide or square root instruction, _mm_div_ps and _mm_sqrt_ps
+//   are reciprocal estimates refined with two Newton-Raphson steps (~1 ulp).
+// - _mm_cvttps_epi32 saturates out of range inputs instead of returning 0x80000000.
+
+typedef float32x4_t __m128;
+typedef int32x4_t __m128i;
+
+#define _MM_SHUFFLE(z, y, x, w) (((z) << 6) | ((y) << 4) | ((x) << 2) | (w))
+
+FORCE_INLINE __m128i _mm_castps_si128(__m128 a) { return vreinterpretq_s32_f32(a); }
+FORCE_INLINE __m128 _mm_castsi128_ps(__m128i a) { return vreinterpretq_f32_s32(a); }
+FORCE_INLINE __m128 vfromu32_(uint32x4_t a) { return vreinterpretq_f32_u32(a); }
+FORCE_INLINE uint32x4_t vtou32_(__m128 a) { return vreinterpretq_u32_f32(a); }
+
+//================================ set / load / store ================================
+
+FORCE_INLINE __m128 _mm_set_ps(float w, float z, float y, float x) { __m128 r = {x, y, z, w}; return r; }
+FORCE_INLINE __m128 _mm_setr_ps(float x, float y, float z, float w) { __m128 r = {x, y, z, w}; return r; }
+FORCE_INLINE __m128 _mm_set1_ps(float a) { return vdupq_n_f32(a); }
+FORCE_INLINE __m128 _mm_set_ss(float a) { return vsetq_lane_f32(a, vdupq_n_f32(0.0f), 0); }
+FORCE_INLINE __m128 _mm_setzero_ps() { return vdupq_n_f32(0.0f); }
+FORCE_INLINE float _mm_cvtss_f32(__m128 a) { return vgetq_lane_f32(a, 0); }
+
+FORCE_INLINE __m128 _mm_load_ps(const float *p) { return vld1q_f32(p); }
+FORCE_INLINE __m128 _mm_loadu_ps(const float *p) { return vld1q_f32(p); }
+FORCE_INLINE void _mm_store_ps(float *p, __m128 a) { vst1q_f32(p, a); }
+FORCE_INLINE void _mm_storeu_ps(float *p, __m128 a) { vst1q_f32(p, a); }
+
+FORCE_INLINE __m128i _mm_set1_epi32(int32_t a) { return vdupq_n_s32(a); }
+FORCE_INLINE __m128i _mm_setzero_si128() { return vdupq_n_s32(0); }
+
+//================================ arithmetic ================================
+
+FORCE_INLINE __m128 _mm_add_ps(__m128 a, __m128 b) { return vaddq_f32(a, b); }
+FORCE_INLINE __m128 _mm_sub_ps(__m128 a, __m128 b) { return vsubq_f32(a, b); }
+FORCE_INLINE __m128 _mm_mul_ps(__m128 a, __m128 b) { return vmulq_f32(a, b); }
+
+//vrsqrte is only ~8 bits, one vrsqrts step brings it past the SSE estimate
+FORCE_INLINE __m128 _mm_rsqrt_ps(__m128 a)
+{
+	__m128 e = vrsqrteq_f32(a);
+	return vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+}
+
+#if defined(__aarch64__)
+FORCE_INLINE __m128 _mm_div_ps(__m128 a, __m128 b) { return vdivq_f32(a, b); }
+FORCE_INLINE __m128 _mm_sqrt_ps(__m128 a) { return vsqrtq_f32(a); }
+#else
+FORCE_INLINE __m128 _mm_div_ps(__m128 a, __m128 b)
+{
+	__m128 r = vrecpeq_f32(b);
+	r = vmulq_f32(r, vrecpsq_f32(b, r));
+	r = vmulq_f32(r, vrecpsq_f32(b, r));
+	return vmulq_f32(a, r);
+}
+
+FORCE_INLINE __m128 _mm_sqrt_ps(__m128 a)
+{
+	__m128 r = vrsqrteq_f32(a);
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+	//sqrt(0) would be 0 * inf
+	return vbslq_f32(vceqq_f32(a, vdupq_n_f32(0.0f)), a, vmulq_f32(a, r));
+}
+#endif
+
+//SSE returns the second operand when the comparison fails (including NaNs), vmin/vmax don't
+FORCE_INLINE __m128 _mm_min_ps(__m128 a, __m128 b) { return vbslq_f32(vcltq_f32(a, b), a, b); }
+FORCE_INLINE __m128 _mm_max_ps(__m128 a, __m128 b) { return vbslq_f32(vcgtq_f32(a, b), a, b); }
+
+FORCE_INLINE __m128 _mm_cmpeq_ps(__m128 a, __m128 b) { return vfromu32_(vceqq_f32(a, b)); }
+FORCE_INLINE __m128 _mm_cmpneq_ps(__m128 a, __m128 b) { return vfromu32_(vmvnq_u32(vceqq_f32(a, b))); }
+FORCE_INLINE __m128 _mm_cmplt_ps(__m128 a, __m128 b) { return vfromu32_(vcltq_f32(a, b)); }
+FORCE_INLINE __m128 _mm_cmple_ps(__m128 a, __m128 b) { return vfromu32_(vcleq_f32(a, b)); }
+FORCE_INLINE __m128 _mm_cmpgt_ps(__m128 a, __m128 b) { return vfromu32_(vcgtq_f32(a, b)); }
+FORCE_INLINE __m128 _mm_cmpge_ps(__m128 a, __m128 b) { return vfromu32_(vcgeq_f32(a, b)); }
+
+FORCE_INLINE __m128 _mm_and_ps(__m128 a, __m128 b) { return vfromu32_(vandq_u32(vtou32_(a), vtou32_(b))); }
+FORCE_INLINE __m128 _mm_andnot_ps(__m128 a, __m128 b) { return vfromu32_(vbicq_u32(vtou32_(b), vtou32_(a))); }
+FORCE_INLINE __m128 _mm_or_ps(__m128 a, __m128 b) { return vfromu32_(vorrq_u32(vtou32_(a), vtou32_(b))); }
+FORCE_INLINE __m128 _mm_xor_ps(__m128 a, __m128 b) { return vfromu32_(veorq_u32(vtou32_(a), vtou32_(b))); }
+
+FORCE_INLINE int _mm_movemask_ps(__m128 a)
+{
+	uint32x4_t s = vshrq_n_u32(vtou32_(a), 31);
+	return (int)(s[0] | (s[1] << 1) | (s[2] << 2) | (s[3] << 3));
+}
+
+//================================ shuffles ================================
+
+//imm is always a constant after inlining, the compiler turns the subscripts into dup/ext/zip
+FORCE_INLINE __m128 _mm_shuffle_ps(__m128 a, __m128 b, unsigned imm)
+{
+	__m128 r = {a[imm & 3], a[(imm >> 2) & 3], b[(imm >> 4) & 3], b[(imm >> 6) & 3]};
+	return r;
+}
+
+FORCE_INLINE __m128 _mm_move_ss(__m128 a, __m128 b) { return vsetq_lane_f32(vgetq_lane_f32(b, 0), a, 0); }
+FORCE_INLINE __m128 _mm_unpacklo_ps(__m128 a, __m128 b) { return vzipq_f32(a, b).val[0]; }
+FORCE_INLINE __m128 _mm_unpackhi_ps(__m128 a, __m128 b) { return vzipq_f32(a, b).val[1]; }
+FORCE_INLINE __m128 _mm_movelh_ps(__m128 a, __m128 b) { return vcombine_f32(vget_low_f32(a), vget_low_f32(b)); }
+FORCE_INLINE __m128 _mm_movehl_ps(__m128 a, __m128 b) { return vcombine_f32(vget_high_f32(b), vget_high_f32(a)); }
+
+#define _MM_TRANSPOSE4_PS(r0, r1, r2, r3) \
+	do { \
+		float32x4x2_t t01_ = vtrnq_f32((r0), (r1)); \
+		float32x4x2_t t23_ = vtrnq_f32((r2), (r3)); \
+		(r0) = vcombine_f32(vget_low_f32(t01_.val[0]), vget_low_f32(t23_.val[0])); \
+		(r1) = vcombine_f32(vget_low_f32(t01_.val[1]), vget_low_f32(t23_.val[1])); \
+		(r2) = vcombine_f32(vget_high_f32(t01_.val[0]), vget_high_f32(t23_.val[0])); \
+		(r3) = vcombine_f32(vget_high_f32(t01_.val[1]), vget_high_f32(t23_.val[1])); \
+	} while(0)
+
+//================================ integer ================================
+
+FORCE_INLINE __m128i _mm_cvttps_epi32(__m128 a) { return vcvtq_s32_f32(a); }
+FORCE_INLINE __m128 _mm_cvtepi32_ps(__m128i a) { return vcvtq_f32_s32(a); }
+
+FORCE_INLINE __m128i _mm_add_epi32(__m128i a, __m128i b) { return vaddq_s32(a, b); }
+FORCE_INLINE __m128i _mm_sub_epi32(__m128i a, __m128i b) { return vsubq_s32(a, b); }
+FORCE_INLINE __m128i _mm_and_si128(__m128i a, __m128i b) { return vandq_s32(a, b); }
+FORCE_INLINE __m128i _mm_andnot_si128(__m128i a, __m128i b) { return vbicq_s32(b, a); }
+FORCE_INLINE __m128i _mm_or_si128(__m128i a, __m128i b) { return vorrq_s32(a, b); }
+FORCE_INLINE __m128i _mm_xor_si128(__m128i a, __m128i b) { return veorq_s32(a, b); }
+FORCE_INLINE __m128i _mm_cmpeq_epi32(__m128i a, __m128i b) { return vreinterpretq_s32_u32(vceqq_s32(a, b)); }
+
+//the immediate forms need a literal shift count, the register forms take any value
+FORCE_INLINE __m128i _mm_slli_epi32(__m128i a, int n) { return vshlq_s32(a, vdupq_n_s32(n)); }
+FORCE_INLINE __m128i _mm_srli_epi32(__m128i a, int n)
+{
+	return vreinterpretq_s32_u32(vshlq_u32(vreinterpretq_u32_s32(a), vdupq_n_s32(-n)));
+}
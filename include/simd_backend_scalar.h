@@ -0,0 +1,170 @@
+#pragma once
+
+#include <math.h>
+#include <string.h>
+
+//Plain C++ implementation of the SSE intrinsics used by the math headers. Included by
+//simd_backend.h, do not include directly.
+//
+//This is the reference backend: every operation follows the SSE definition lane by lane,
+//including the ones with odd semantics (min/max return the second operand when either is
+//NaN, comparisons produce all-ones masks, out of range float->int conversions give
+//0x80000000). The only deliberate difference is _mm_rsqrt_ps, which is exact here instead
+//of a 12 bit estimate.
+
+struct alignas(16) __m128  { float f[4]; };
+struct alignas(16) __m128i { int32_t i[4]; };
+
+#define _MM_SHUFFLE(z, y, x, w) (((z) << 6) | ((y) << 4) | ((x) << 2) | (w))
+
+//bit casts
+FORCE_INLINE uint32_t vbits_(float f) { uint32_t u; memcpy(&u, &f, 4); return u; }
+FORCE_INLINE float vfloat_(uint32_t u) { float f; memcpy(&f, &u, 4); return f; }
+FORCE_INLINE float vmask_(bool b) { return vfloat_(b ? 0xFFFFFFFFu : 0u); }
+
+FORCE_INLINE __m128i _mm_castps_si128(__m128 a) { __m128i r; memcpy(&r, &a, 16); return r; }
+FORCE_INLINE __m128 _mm_castsi128_ps(__m128i a) { __m128 r; memcpy(&r, &a, 16); return r; }
+
+//================================ set / load / store ================================
+
+FORCE_INLINE __m128 _mm_set_ps(float w, float z, float y, float x) { __m128 r = {{x, y, z, w}}; return r; }
+FORCE_INLINE __m128 _mm_setr_ps(float x, float y, float z, float w) { __m128 r = {{x, y, z, w}}; return r; }
+FORCE_INLINE __m128 _mm_set1_ps(float a) { __m128 r = {{a, a, a, a}}; return r; }
+FORCE_INLINE __m128 _mm_set_ss(float a) { __m128 r = {{a, 0.0f, 0.0f, 0.0f}}; return r; }
+FORCE_INLINE __m128 _mm_setzero_ps() { return _mm_set1_ps(0.0f); }
+FORCE_INLINE float _mm_cvtss_f32(__m128 a) { return a.f[0]; }
+
+FORCE_INLINE __m128 _mm_load_ps(const float *p) { __m128 r; memcpy(r.f, p, 16); return r; }
+FORCE_INLINE __m128 _mm_loadu_ps(const float *p) { __m128 r; memcpy(r.f, p, 16); return r; }
+FORCE_INLINE void _mm_store_ps(float *p, __m128 a) { memcpy(p, a.f, 16); }
+FORCE_INLINE void _mm_storeu_ps(float *p, __m128 a) { memcpy(p, a.f, 16); }
+
+FORCE_INLINE __m128i _mm_set1_epi32(int32_t a) { __m128i r = {{a, a, a, a}}; return r; }
+FORCE_INLINE __m128i _mm_setzero_si128() { return _mm_set1_epi32(0); }
+
+//================================ arithmetic ================================
+
+#define VSCALAR_OP_(NAME, EXPR) \
+	FORCE_INLINE __m128 NAME(__m128 a, __m128 b) \
+	{ \
+		__m128 r; \
+		for(int k = 0; k < 4; k++) { float x = a.f[k], y = b.f[k]; r.f[k] = (EXPR); } \
+		return r; \
+	}
+
+VSCALAR_OP_(_mm_add_ps, x + y)
+VSCALAR_OP_(_mm_sub_ps, x - y)
+VSCALAR_OP_(_mm_mul_ps, x * y)
+VSCALAR_OP_(_mm_div_ps, x / y)
+VSCALAR_OP_(_mm_min_ps, x < y ? x : y)
+VSCALAR_OP_(_mm_max_ps, x > y ? x : y)
+
+VSCALAR_OP_(_mm_cmpeq_ps, vmask_(x == y))
+VSCALAR_OP_(_mm_cmpneq_ps, vmask_(!(x == y)))
+VSCALAR_OP_(_mm_cmplt_ps, vmask_(x < y))
+VSCALAR_OP_(_mm_cmple_ps, vmask_(x <= y))
+VSCALAR_OP_(_mm_cmpgt_ps, vmask_(x > y))
+VSCALAR_OP_(_mm_cmpge_ps, vmask_(x >= y))
+
+#undef VSCALAR_OP_
+
+FORCE_INLINE __m128 _mm_sqrt_ps(__m128 a)
+{
+	for(int k = 0; k < 4; k++) a.f[k] = sqrtf(a.f[k]);
+	return a;
+}
+
+FORCE_INLINE __m128 _mm_rsqrt_ps(__m128 a)
+{
+	for(int k = 0; k < 4; k++) a.f[k] = 1.0f / sqrtf(a.f[k]);
+	return a;
+}
+
+FORCE_INLINE int _mm_movemask_ps(__m128 a)
+{
+	int m = 0;
+	for(int k = 0; k < 4; k++) m |= (int)(vbits_(a.f[k]) >> 31) << k;
+	return m;
+}
+
+//================================ shuffles ================================
+
+FORCE_INLINE __m128 _mm_shuffle_ps(__m128 a, __m128 b, unsigned imm)
+{
+	__m128 r = {{a.f[imm & 3], a.f[(imm >> 2) & 3], b.f[(imm >> 4) & 3], b.f[(imm >> 6) & 3]}};
+	return r;
+}
+
+FORCE_INLINE __m128 _mm_move_ss(__m128 a, __m128 b) { a.f[0] = b.f[0]; return a; }
+FORCE_INLINE __m128 _mm_unpacklo_ps(__m128 a, __m128 b) { __m128 r = {{a.f[0], b.f[0], a.f[1], b.f[1]}}; return r; }
+FORCE_INLINE __m128 _mm_unpackhi_ps(__m128 a, __m128 b) { __m128 r = {{a.f[2], b.f[2], a.f[3], b.f[3]}}; return r; }
+FORCE_INLINE __m128 _mm_movelh_ps(__m128 a, __m128 b) { __m128 r = {{a.f[0], a.f[1], b.f[0], b.f[1]}}; return r; }
+FORCE_INLINE __m128 _mm_movehl_ps(__m128 a, __m128 b) { __m128 r = {{b.f[2], b.f[3], a.f[2], a.f[3]}}; return r; }
+
+#define _MM_TRANSPOSE4_PS(r0, r1, r2, r3) \
+	do { \
+		__m128 t0_ = _mm_unpacklo_ps((r0), (r1)); \
+		__m128 t1_ = _mm_unpacklo_ps((r2), (r3)); \
+		__m128 t2_ = _mm_unpackhi_ps((r0), (r1)); \
+		__m128 t3_ = _mm_unpackhi_ps((r2), (r3)); \
+		(r0) = _mm_movelh_ps(t0_, t1_); \
+		(r1) = _mm_movehl_ps(t1_, t0_); \
+		(r2) = _mm_movelh_ps(t2_, t3_); \
+		(r3) = _mm_movehl_ps(t3_, t2_); \
+	} while(0)
+
+//================================ integer ================================
+
+FORCE_INLINE __m128i _mm_cvttps_epi32(__m128 a)
+{
+	__m128i r;
+	for(int k = 0; k < 4; k++)
+	{
+		float x = a.f[k];
+		r.i[k] = (x > -2147483648.0f && x < 2147483648.0f) ? (int32_t)x : INT32_MIN;
+	}
+	return r;
+}
+
+FORCE_INLINE __m128 _mm_cvtepi32_ps(__m128i a)
+{
+	__m128 r;
+	for(int k = 0; k < 4; k++) r.f[k] = (float)a.i[k];
+	return r;
+}
+
+#define VSCALAR_IOP_(NAME, EXPR) \
+	FORCE_INLINE __m128i NAME(__m128i a, __m128i b) \
+	{ \
+		__m128i r; \
+		for(int k = 0; k < 4; k++) { uint32_t x = (uint32_t)a.i[k], y = (uint32_t)b.i[k]; r.i[k] = (int32_t)(EXPR); } \
+		return r; \
+	}
+
+VSCALAR_IOP_(_mm_add_epi32, x + y)
+VSCALAR_IOP_(_mm_sub_epi32, x - y)
+VSCALAR_IOP_(_mm_and_si128, x & y)
+VSCALAR_IOP_(_mm_andnot_si128, ~x & y)
+VSCALAR_IOP_(_mm_or_si128, x | y)
+VSCALAR_IOP_(_mm_xor_si128, x ^ y)
+VSCALAR_IOP_(_mm_cmpeq_epi32, x == y ? 0xFFFFFFFFu : 0u)
+
+#undef VSCALAR_IOP_
+
+//bitwise float ops go through the integer lanes so NaN payloads are never touched by the FPU
+FORCE_INLINE __m128 _mm_and_ps(__m128 a, __m128 b) { return _mm_castsi128_ps(_mm_and_si128(_mm_castps_si128(a), _mm_castps_si128(b))); }
+FORCE_INLINE __m128 _mm_andnot_ps(__m128 a, __m128 b) { return _mm_castsi128_ps(_mm_andnot_si128(_mm_castps_si128(a), _mm_castps_si128(b))); }
+FORCE_INLINE __m128 _mm_or_ps(__m128 a, __m128 b) { return _mm_castsi128_ps(_mm_or_si128(_mm_castps_si128(a), _mm_castps_si128(b))); }
+FORCE_INLINE __m128 _mm_xor_ps(__m128 a, __m128 b) { return _mm_castsi128_ps(_mm_xor_si128(_mm_castps_si128(a), _mm_castps_si128(b))); }
+
+FORCE_INLINE __m128i _mm_slli_epi32(__m128i a, int n)
+{
+	for(int k = 0; k < 4; k++) a.i[k] = n > 31 ? 0 : (int32_t)((uint32_t)a.i[k] << n);
+	return a;
+}
+
+FORCE_INLINE __m128i _mm_srli_epi32(__m128i a, int n)
+{
+	for(int k = 0; k < 4; k++) a.i[k] = n > 31 ? 0 : (int32_t)((uint32_t)a.i[k] >> n);
+	return a;
+}
@@ -0,0 +1,432 @@
+#pragma once
+
+#include "vectors.h"
+
+//Polynomial approximations of the libm functions, 4 (__m128) or 8 (__m256) lanes at a time.
+//The reductions and coefficients are the single precision ones from Cephes. Only SSE2 is
+//needed for the 4-wide versions; the 8-wide versions need AVX2 for the integer lanes and
+//use FMA (VEC_AVX2, see simd_backend.h). The 4-wide versions also run on the NEON and
+//scalar backends.
+//
+//Max error against libm in double precision, measured over every float in the stated range
+//(atan2 over 2e7 random pairs) by bench/simd_math_test.cpp --full, which asserts these bounds:
+//
+//  vsin, vcos, vsincos   |x| <= 8192           1.6 ulp where |result| >= 1e-3, absolute error
+//                                              8e-8 everywhere (the ulp blows up at the zeros)
+//  vtan                  |x| <= pi/2 - 0.01    3 ulp, grows like 1/cos(x) closer to the poles
+//  vatan                 all                   3 ulp
+//  vatan2                all                   3.5 ulp, atan2(0, 0) returns 0
+//  vexp                  [-87.3, 88.3]         1.05 ulp, the input is clamped to that range
+//  vlog                  x >= FLT_MIN          1 ulp, log(0) = -inf, log(x < 0) = NaN
+//  vrsqrt                x >= FLT_MIN          5 ulp (rsqrtps estimate + one Newton step)
+//
+//Outside the trig range the Cody-Waite reduction loses precision; use a scalar function
+//for huge arguments.
+
+//============================ 4-wide (SSE2) ==============================
+
+FORCE_INLINE __m128 vpoly(__m128 x, __m128 c0, __m128 c1)
+{
+	return _mm_add_ps(_mm_mul_ps(c1, x), c0);
+}
+
+//sin and cos of x in one go, they share the range reduction.
+FORCE_INLINE void vsincos(__m128 x, __m128 *s, __m128 *c)
+{
+	__m128 signSin = _mm_and_ps(x, vsignbits);
+	x = _mm_andnot_ps(vsignbits, x);
+
+	//octant j = (int)(x * 4/pi), rounded up to even so the reduced x is in [-pi/4, pi/4]
+	__m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+	j = _mm_add_epi32(j, _mm_set1_epi32(1));
+	j = _mm_and_si128(j, _mm_set1_epi32(~1));
+	__m128 y = _mm_cvtepi32_ps(j);
+
+	//bit 2 of the octant flips the sign of sin, bit 2 of (j - 2) that of cos,
+	//bit 1 swaps the sin and cos polynomials
+	__m128 flipSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+	__m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+	__m128 sinPoly = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+	signSin = _mm_xor_ps(signSin, flipSin);
+
+	//x - y * pi/4 with pi/4 split in 3 parts so the products are exact
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+	__m128 z = _mm_mul_ps(x, x);
+
+	//cos(x) = 1 - z/2 + z^2 * P(z)
+	__m128 pc = vpoly(z, _mm_set1_ps(-1.388731625493765e-3f), _mm_set1_ps(2.443315711809948e-5f));
+	pc = vpoly(z, _mm_set1_ps(4.166664568298827e-2f), pc);
+	pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+	pc = _mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	pc = _mm_add_ps(pc, _mm_set1_ps(1.0f));
+
+	//sin(x) = x + x * z * Q(z)
+	__m128 ps = vpoly(z, _mm_set1_ps(8.3321608736e-3f), _mm_set1_ps(-1.9515295891e-4f));
+	ps = vpoly(z, _mm_set1_ps(-1.6666654611e-1f), ps);
+	ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), x), x);
+
+	__m128 rs = vselect(sinPoly, ps, pc);
+	__m128 rc = vselect(sinPoly, pc, ps);
+	*s = _mm_xor_ps(rs, signSin);
+	*c = _mm_xor_ps(rc, signCos);
+}
+
+FORCE_INLINE __m128 vsin(__m128 x)
+{
+	__m128 s, c;
+	vsincos(x, &s, &c);
+	return s;
+}
+
+FORCE_INLINE __m128 vcos(__m128 x)
+{
+	__m128 s, c;
+	vsincos(x, &s, &c);
+	return c;
+}
+
+FORCE_INLINE __m128 vtan(__m128 x)
+{
+	__m128 s, c;
+	vsincos(x, &s, &c);
+	return _mm_div_ps(s, c);
+}
+
+FORCE_INLINE __m128 vatan(__m128 x)
+{
+	__m128 sign = _mm_and_ps(x, vsignbits);
+	x = _mm_andnot_ps(vsignbits, x);
+
+	//reduce to |x| <= tan(pi/8):
+	//x > tan(3pi/8):  atan(x) = pi/2 + atan(-1/x)
+	//x > tan(pi/8):   atan(x) = pi/4 + atan((x-1)/(x+1))
+	__m128 big = _mm_cmpgt_ps(x, _mm_set1_ps(2.414213562373095f));
+	__m128 mid = _mm_andnot_ps(big, _mm_cmpgt_ps(x, _mm_set1_ps(0.4142135623730950f)));
+	__m128 one = _mm_set1_ps(1.0f);
+
+	__m128 xBig = _mm_div_ps(_mm_set1_ps(-1.0f), x);
+	__m128 xMid = _mm_div_ps(_mm_sub_ps(x, one), _mm_add_ps(x, one));
+	x = _mm_or_ps(_mm_andnot_ps(_mm_or_ps(big, mid), x), _mm_or_ps(_mm_and_ps(big, xBig), _mm_and_ps(mid, xMid)));
+	__m128 y = _mm_or_ps(_mm_and_ps(big, _mm_set1_ps(1.5707963267948966f)), _mm_and_ps(mid, _mm_set1_ps(0.7853981633974483f)));
+
+	__m128 z = _mm_mul_ps(x, x);
+	__m128 p = vpoly(z, _mm_set1_ps(-1.38776856032e-1f), _mm_set1_ps(8.05374449538e-2f));
+	p = vpoly(z, _mm_set1_ps(1.99777106478e-1f), p);
+	p = vpoly(z, _mm_set1_ps(-3.33329491539e-1f), p);
+	p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, z), x), x);
+
+	return _mm_xor_ps(_mm_add_ps(y, p), sign);
+}
+
+FORCE_INLINE __m128 vatan2(__m128 y, __m128 x)
+{
+	__m128 zero = _mm_setzero_ps();
+	__m128 r = vatan(_mm_div_ps(y, x));
+
+	//left half plane: atan(y/x) +/- pi, taking the sign of y (so atan2(+0, -1) = pi).
+	//The sign bit of x, not x < 0: y / -0 is the infinity of the other sign
+	__m128 xNeg = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_srli_epi32(_mm_castps_si128(x), 31), _mm_set1_epi32(1)));
+	__m128 pi = _mm_or_ps(_mm_set1_ps(3.14159265358979f), _mm_and_ps(y, vsignbits));
+	r = _mm_add_ps(r, _mm_and_ps(xNeg, pi));
+
+	//0/0 is NaN, return 0 instead
+	__m128 bothZero = _mm_and_ps(_mm_cmpeq_ps(x, zero), _mm_cmpeq_ps(y, zero));
+	return _mm_andnot_ps(bothZero, r);
+}
+
+FORCE_INLINE __m128 vexp(__m128 x)
+{
+	x = _mm_min_ps(x, _mm_set1_ps(88.3762626647949f));
+	x = _mm_max_ps(x, _mm_set1_ps(-87.3365447504019f));
+
+	//exp(x) = 2^n * exp(r),  n = round(x / ln2),  r = x - n * ln2
+	__m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+#ifdef VEC_SSE41
+	__m128 n = _mm_floor_ps(fx);
+#else
+	__m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+	n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, fx), _mm_set1_ps(1.0f)));   //floor
+#endif
+
+	x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+	__m128 z = _mm_mul_ps(x, x);
+
+	__m128 p = vpoly(x, _mm_set1_ps(1.3981999507e-3f), _mm_set1_ps(1.9875691500e-4f));
+	p = vpoly(x, _mm_set1_ps(8.3334519073e-3f), p);
+	p = vpoly(x, _mm_set1_ps(4.1665795894e-2f), p);
+	p = vpoly(x, _mm_set1_ps(1.6666665459e-1f), p);
+	p = vpoly(x, _mm_set1_ps(5.0000001201e-1f), p);
+	p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p, z), x), _mm_set1_ps(1.0f));
+
+	//2^n built directly in the exponent bits
+	__m128i e = _mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127));
+	return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(e, 23)));
+}
+
+FORCE_INLINE __m128 vlog(__m128 x)
+{
+	__m128 zero = _mm_setzero_ps();
+	__m128 isNeg = _mm_cmplt_ps(x, zero);
+	__m128 isZero = _mm_cmpeq_ps(x, zero);
+	__m128 one = _mm_set1_ps(1.0f);
+
+	//log(x) = log(m) + e * ln2 with the mantissa m in [sqrt(0.5), sqrt(2))
+	x = _mm_max_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x00800000)));   //denormals -> FLT_MIN
+	__m128i bits = _mm_castps_si128(x);
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+	x = _mm_or_ps(_mm_castsi128_ps(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF))), _mm_set1_ps(0.5f));
+
+	//m in [0.5, 1): move [0.5, sqrt(0.5)) up an octave
+	__m128 small = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+	e = _mm_sub_ps(e, _mm_and_ps(small, one));
+	x = _mm_sub_ps(_mm_add_ps(x, _mm_and_ps(small, x)), one);
+	__m128 z = _mm_mul_ps(x, x);
+
+	__m128 p = vpoly(x, _mm_set1_ps(-1.1514610310e-1f), _mm_set1_ps(7.0376836292e-2f));
+	p = vpoly(x, _mm_set1_ps(1.1676998740e-1f), p);
+	p = vpoly(x, _mm_set1_ps(-1.2420140846e-1f), p);
+	p = vpoly(x, _mm_set1_ps(1.4249322787e-1f), p);
+	p = vpoly(x, _mm_set1_ps(-1.6668057665e-1f), p);
+	p = vpoly(x, _mm_set1_ps(2.0000714765e-1f), p);
+	p = vpoly(x, _mm_set1_ps(-2.4999993993e-1f), p);
+	p = vpoly(x, _mm_set1_ps(3.3333331174e-1f), p);
+	p = _mm_mul_ps(_mm_mul_ps(p, x), z);
+
+	p = _mm_add_ps(p, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+	p = _mm_sub_ps(p, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	x = _mm_add_ps(x, p);
+	x = _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+
+	x = vselect(isZero, _mm_set1_ps(-INFINITY), x);
+	return _mm_or_ps(x, isNeg);   //all bits set is a NaN
+}
+
+//rsqrtps is only good to ~12 bits, one Newton-Raphson step brings it to ~23:
+//y' = y * (1.5 - 0.5 * x * y^2)
+FORCE_INLINE __m128 vrsqrt(__m128 x)
+{
+	__m128 y = _mm_rsqrt_ps(x);
+	__m128 hx = _mm_mul_ps(x, _mm_set1_ps(0.5f));
+	return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(hx, _mm_mul_ps(y, y))));
+}
+
+//vec4 overloads
+FORCE_INLINE vec4 vsin(vec4 x) { return vec4(vsin(x.m)); }
+FORCE_INLINE vec4 vcos(vec4 x) { return vec4(vcos(x.m)); }
+FORCE_INLINE void vsincos(vec4 x, vec4 &s, vec4 &c) { vsincos(x.m, &s.m, &c.m); }
+FORCE_INLINE vec4 vtan(vec4 x) { return vec4(vtan(x.m)); }
+FORCE_INLINE vec4 vatan(vec4 x) { return vec4(vatan(x.m)); }
+FORCE_INLINE vec4 vatan2(vec4 y, vec4 x) { return vec4(vatan2(y.m, x.m)); }
+FORCE_INLINE vec4 vexp(vec4 x) { return vec4(vexp(x.m)); }
+FORCE_INLINE vec4 vlog(vec4 x) { return vec4(vlog(x.m)); }
+FORCE_INLINE vec4 vrsqrt(vec4 x) { return vec4(vrsqrt(x.m)); }
+
+//============================ Batch slerp ==============================
+
+//Exact slerp of 4 quaternion pairs, with the same nlerp fallback as the scalar slerp()
+//for the lanes where the quaternions are almost parallel.
+FORCE_INLINE quatx4 slerp(quatx4 a, quatx4 b, vec4 t)
+{
+	//shortest path
+	__m128 d = dot(a, b).m;
+	__m128 flip = _mm_and_ps(d, vsignbits);
+	b = quatx4(_mm_xor_ps(b.x, flip), _mm_xor_ps(b.y, flip), _mm_xor_ps(b.z, flip), _mm_xor_ps(b.w, flip));
+	d = _mm_xor_ps(d, flip);
+
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 sinTheta = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(d, d)), _mm_setzero_ps()));
+	__m128 theta = vatan2(sinTheta, d);
+
+	//sin((1-t) theta) and sin(t theta) with a single range reduction
+	__m128 wa, wb, unused;
+	vsincos(_mm_mul_ps(_mm_sub_ps(one, t.m), theta), &wa, &unused);
+	vsincos(_mm_mul_ps(t.m, theta), &wb, &unused);
+	__m128 rSinTheta = _mm_div_ps(one, sinTheta);
+	wa = _mm_mul_ps(wa, rSinTheta);
+	wb = _mm_mul_ps(wb, rSinTheta);
+
+	//lerp weights for the nearly parallel lanes (normalized below)
+	__m128 parallel = _mm_cmpgt_ps(d, _mm_set1_ps(0.9995f));
+	wa = vselect(parallel, _mm_sub_ps(one, t.m), wa);
+	wb = vselect(parallel, t.m, wb);
+
+	quatx4 r(_mm_add_ps(_mm_mul_ps(a.x, wa), _mm_mul_ps(b.x, wb)),
+	         _mm_add_ps(_mm_mul_ps(a.y, wa), _mm_mul_ps(b.y, wb)),
+	         _mm_add_ps(_mm_mul_ps(a.z, wa), _mm_mul_ps(b.z, wb)),
+	         _mm_add_ps(_mm_mul_ps(a.w, wa), _mm_mul_ps(b.w, wb)));
+
+	__m128 n = vselect(parallel, vrsqrt(dot(r, r).m), one);
+	return quatx4(_mm_mul_ps(r.x, n), _mm_mul_ps(r.y, n), _mm_mul_ps(r.z, n), _mm_mul_ps(r.w, n));
+}
+
+//============================ 8-wide (AVX2) ==============================
+#ifdef VEC_AVX2
+
+FORCE_INLINE __m256 vpoly(__m256 x, __m256 c0, __m256 c1)
+{
+	return _mm256_fmadd_ps(c1, x, c0);
+}
+
+FORCE_INLINE void vsincos(__m256 x, __m256 *s, __m256 *c)
+{
+	__m256 signBits = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+	__m256 signSin = _mm256_and_ps(x, signBits);
+	x = _mm256_andnot_ps(signBits, x);
+
+	__m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f)));
+	j = _mm256_add_epi32(j, _mm256_set1_epi32(1));
+	j = _mm256_and_si256(j, _mm256_set1_epi32(~1));
+	__m256 y = _mm256_cvtepi32_ps(j);
+
+	__m256 flipSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29));
+	__m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+	__m256 sinPoly = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+	signSin = _mm256_xor_ps(signSin, flipSin);
+
+	x = _mm256_fnmadd_ps(y, _mm256_set1_ps(0.78515625f), x);
+	x = _mm256_fnmadd_ps(y, _mm256_set1_ps(2.4187564849853515625e-4f), x);
+	x = _mm256_fnmadd_ps(y, _mm256_set1_ps(3.77489497744594108e-8f), x);
+	__m256 z = _mm256_mul_ps(x, x);
+
+	__m256 pc = vpoly(z, _mm256_set1_ps(-1.388731625493765e-3f), _mm256_set1_ps(2.443315711809948e-5f));
+	pc = vpoly(z, _mm256_set1_ps(4.166664568298827e-2f), pc);
+	pc = _mm256_mul_ps(_mm256_mul_ps(pc, z), z);
+	pc = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), pc);
+	pc = _mm256_add_ps(pc, _mm256_set1_ps(1.0f));
+
+	__m256 ps = vpoly(z, _mm256_set1_ps(8.3321608736e-3f), _mm256_set1_ps(-1.9515295891e-4f));
+	ps = vpoly(z, _mm256_set1_ps(-1.6666654611e-1f), ps);
+	ps = _mm256_fmadd_ps(_mm256_mul_ps(ps, z), x, x);
+
+	*s = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, sinPoly), signSin);
+	*c = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, sinPoly), signCos);
+}
+
+FORCE_INLINE __m256 vsin(__m256 x)
+{
+	__m256 s, c;
+	vsincos(x, &s, &c);
+	return s;
+}
+
+FORCE_INLINE __m256 vcos(__m256 x)
+{
+	__m256 s, c;
+	vsincos(x, &s, &c);
+	return c;
+}
+
+FORCE_INLINE __m256 vtan(__m256 x)
+{
+	__m256 s, c;
+	vsincos(x, &s, &c);
+	return _mm256_div_ps(s, c);
+}
+
+FORCE_INLINE __m256 vatan(__m256 x)
+{
+	__m256 signBits = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+	__m256 sign = _mm256_and_ps(x, signBits);
+	x = _mm256_andnot_ps(signBits, x);
+
+	__m256 big = _mm256_cmp_ps(x, _mm256_set1_ps(2.414213562373095f), _CMP_GT_OQ);
+	__m256 mid = _mm256_andnot_ps(big, _mm256_cmp_ps(x, _mm256_set1_ps(0.4142135623730950f), _CMP_GT_OQ));
+	__m256 one = _mm256_set1_ps(1.0f);
+
+	__m256 xBig = _mm256_div_ps(_mm256_set1_ps(-1.0f), x);
+	__m256 xMid = _mm256_div_ps(_mm256_sub_ps(x, one), _mm256_add_ps(x, one));
+	x = _mm256_blendv_ps(_mm256_blendv_ps(x, xMid, mid), xBig, big);
+	__m256 y = _mm256_or_ps(_mm256_and_ps(big, _mm256_set1_ps(1.5707963267948966f)), _mm256_and_ps(mid, _mm256_set1_ps(0.7853981633974483f)));
+
+	__m256 z = _mm256_mul_ps(x, x);
+	__m256 p = vpoly(z, _mm256_set1_ps(-1.38776856032e-1f), _mm256_set1_ps(8.05374449538e-2f));
+	p = vpoly(z, _mm256_set1_ps(1.99777106478e-1f), p);
+	p = vpoly(z, _mm256_set1_ps(-3.33329491539e-1f), p);
+	p = _mm256_fmadd_ps(_mm256_mul_ps(p, z), x, x);
+
+	return _mm256_xor_ps(_mm256_add_ps(y, p), sign);
+}
+
+FORCE_INLINE __m256 vatan2(__m256 y, __m256 x)
+{
+	__m256 zero = _mm256_setzero_ps();
+	__m256 signBits = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+	__m256 r = vatan(_mm256_div_ps(y, x));
+
+	__m256 xNeg = _mm256_castsi256_ps(_mm256_srai_epi32(_mm256_castps_si256(x), 31));
+	__m256 pi = _mm256_or_ps(_mm256_set1_ps(3.14159265358979f), _mm256_and_ps(y, signBits));
+	r = _mm256_add_ps(r, _mm256_and_ps(xNeg, pi));
+
+	__m256 bothZero = _mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_EQ_OQ), _mm256_cmp_ps(y, zero, _CMP_EQ_OQ));
+	return _mm256_andnot_ps(bothZero, r);
+}
+
+FORCE_INLINE __m256 vexp(__m256 x)
+{
+	x = _mm256_min_ps(x, _mm256_set1_ps(88.3762626647949f));
+	x = _mm256_max_ps(x, _mm256_set1_ps(-87.3365447504019f));
+
+	__m256 n = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f), _mm256_set1_ps(0.5f)));
+
+	x = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+	x = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), x);
+	__m256 z = _mm256_mul_ps(x, x);
+
+	__m256 p = vpoly(x, _mm256_set1_ps(1.3981999507e-3f), _mm256_set1_ps(1.9875691500e-4f));
+	p = vpoly(x, _mm256_set1_ps(8.3334519073e-3f), p);
+	p = vpoly(x, _mm256_set1_ps(4.1665795894e-2f), p);
+	p = vpoly(x, _mm256_set1_ps(1.6666665459e-1f), p);
+	p = vpoly(x, _mm256_set1_ps(5.0000001201e-1f), p);
+	p = _mm256_add_ps(_mm256_fmadd_ps(p, z, x), _mm256_set1_ps(1.0f));
+
+	__m256i e = _mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127));
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(e, 23)));
+}
+
+FORCE_INLINE __m256 vlog(__m256 x)
+{
+	__m256 zero = _mm256_setzero_ps();
+	__m256 isNeg = _mm256_cmp_ps(x, zero, _CMP_LT_OQ);
+	__m256 isZero = _mm256_cmp_ps(x, zero, _CMP_EQ_OQ);
+	__m256 one = _mm256_set1_ps(1.0f);
+
+	x = _mm256_max_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000)));
+	__m256i bits = _mm256_castps_si256(x);
+	__m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+	x = _mm256_or_ps(_mm256_castsi256_ps(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF))), _mm256_set1_ps(0.5f));
+
+	__m256 small = _mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+	e = _mm256_sub_ps(e, _mm256_and_ps(small, one));
+	x = _mm256_sub_ps(_mm256_add_ps(x, _mm256_and_ps(small, x)), one);
+	__m256 z = _mm256_mul_ps(x, x);
+
+	__m256 p = vpoly(x, _mm256_set1_ps(-1.1514610310e-1f), _mm256_set1_ps(7.0376836292e-2f));
+	p = vpoly(x, _mm256_set1_ps(1.1676998740e-1f), p);
+	p = vpoly(x, _mm256_set1_ps(-1.2420140846e-1f), p);
+	p = vpoly(x, _mm256_set1_ps(1.4249322787e-1f), p);
+	p = vpoly(x, _mm256_set1_ps(-1.6668057665e-1f), p);
+	p = vpoly(x, _mm256_set1_ps(2.0000714765e-1f), p);
+	p = vpoly(x, _mm256_set1_ps(-2.4999993993e-1f), p);
+	p = vpoly(x, _mm256_set1_ps(3.3333331174e-1f), p);
+	p = _mm256_mul_ps(_mm256_mul_ps(p, x), z);
+
+	p = _mm256_fmadd_ps(e, _mm256_set1_ps(-2.12194440e-4f), p);
+	p = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), p);
+	x = _mm256_add_ps(x, p);
+	x = _mm256_fmadd_ps(e, _mm256_set1_ps(0.693359375f), x);
+
+	x = _mm256_blendv_ps(x, _mm256_set1_ps(-INFINITY), isZero);
+	return _mm256_or_ps(x, isNeg);
+}
+
+FORCE_INLINE __m256 vrsqrt(__m256 x)
+{
+	__m256 y = _mm256_rsqrt_ps(x);
+	__m256 hx = _mm256_mul_ps(x, _mm256_set1_ps(0.5f));
+	return _mm256_mul_ps(y, _mm256_fnmadd_ps(hx, _mm256_mul_ps(y, y), _mm256_set1_ps(1.5f)));
+}
+
+#endif //VEC_AVX2
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "vulkan_manager.h"
+#include "matrix.h"
+
+//GPU skinning of a crowd sharing one mesh (shaders/skinning/skinning.comp).
+//
+//The CPU only writes the joint palettes (updateCharacters() in animation.h), straight into
+//the mapped palette buffer of the frame. One dispatch then skins every character into the
+//frame's output buffer, which is also a vertex buffer: character c's vertices start at
+//c * vertexCount, so it is drawn with vkCmdBindVertexBuffers at that offset, or with
+//firstVertex = c * vertexCount, by a pipeline with VERTEX_INPUT_SKINNED
+//(shaders/skinning/skinned.vert). Every frame in flight has its own palette and output
+//buffers, so the CPU never writes what the GPU may still be reading.
+//
+//The dispatch can go on the graphics command buffer (record()) or to the compute queue
+//(recordAsync()), where it overlaps the previous frame's graphics.
+//
+//Adding characters adds palette bytes and compute work, not CPU time per vertex.
+
+//Bind pose vertex, 48 bytes to match the std430 struct of the shader.
+struct SkinnedVertex
+{
+	float position[4];
+	float normal[4];
+	uint32 joints;   //4 joint indices, 8 bits each, the first in the low byte
+	uint32 weights;  //4 unorm8 weights summing to 255, so to 1.0 once unpacked
+	uint32 pad[2];
+};
+
+//Skinned vertex as the draw reads it: position at offset 0, normal at offset 16.
+struct SkinnedOutputVertex
+{
+	float position[4];
+	float normal[4];
+};
+
+struct GpuSkinning
+{
+	uint32 vertexCount;
+	uint32 jointCount;
+	uint32 maxCharacters;
+
+	VkBuffer bindPoseBuffer;
+	VkDeviceMemory bindPoseMemory;
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingMemory;
+
+	VkBuffer paletteBuffers[MAX_FRAMES];
+	VkDeviceMemory paletteMemory[MAX_FRAMES];
+	mat4 *paletteMemoryPtr[MAX_FRAMES];
+
+	VkBuffer outputBuffers[MAX_FRAMES];
+	VkDeviceMemory outputMemory[MAX_FRAMES];
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSets[MAX_FRAMES];
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	//Creates the buffers and the pipeline, and records the bind pose upload into uploadCmd
+	//(which must be recording). Call freeStaging() once uploadCmd has completed.
+	void init(VulkanManager &vulkanManager,
+	          VkCommandBuffer uploadCmd,
+	          const SkinnedVertex *vertices,
+	          uint32 vertexCount,
+	          uint32 jointCount,
+	          uint32 maxCharacters);
+
+	void freeStaging(VulkanManager &vulkanManager);
+	void destroy(VulkanManager &vulkanManager);
+
+	//Mapped palette memory of the frame: maxCharacters * jointCount matrices, character c
+	//starting at c * jointCount. Write it only once the frame slot is free again
+	//(FrameScheduler::beginFrame()).
+	mat4 *palettes(uint32 frame) const { return paletteMemoryPtr[frame]; }
+
+	VkBuffer output(uint32 frame) const { return outputBuffers[frame]; }
+
+	//Records the skinning dispatch of the first characterCount characters and the barrier
+	//that makes its output visible to vertex input. Must be recorded outside a render pass.
+	void record(VkCommandBuffer cmd, uint32 frame, uint32 characterCount);
+
+	//The same on the compute queue: records the dispatch into compute's command buffer,
+	//between AsyncCompute::begin() and submit(), and hands the output off to vertex input.
+	//The submission has to wait for the graphics one of init()'s uploadCmd, at
+	//COMPUTE_SHADER: the bind pose is shared by both queue families, the wait makes the
+	//upload visible to the compute queue.
+	void recordAsync(AsyncCompute &compute, uint32 frame, uint32 characterCount);
+
+	void recordDispatch(VkCommandBuffer cmd, uint32 frame, uint32 characterCount);
+};
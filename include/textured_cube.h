@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <vector>
 #include <platform.h> 
 #include <vulkan_manager.h>
@@ -10,6 +11,15 @@
 #include <stb_image.h>
 
 #include "matrix.h"
+#include "matrix_kernels.h"
+#include "frustum.h"
+#include "packing.h"
+#include "transforms.h"
+#include "jobs.h"
+#include "command_recorder.h"
+#include "animation.h"
+#include "skinning.h"
+#include "render_graph.h"
 
 struct Texture
 {
@@ -30,8 +40,6 @@ struct VS_UBO
 	alignas(16) vec4 attr[12 * 3];
 };
 
-void loadShaderModule(std::string &filename, std::vector<char> &buffer);
-
 struct Demo
 {
 	Win32Window window;
@@ -39,9 +47,61 @@ struct Demo
 	Camera camera;
 	FPSInput input;
 
+	JobSystem jobs;
+	CommandRecorder recorder;
+
+	RenderGraph graph;
+	uint32 backbuffer;  //the acquired swapchain image
+	uint32 mainPass;
+	uint32 cubePipeline;  //id in vulkanManager.pipelines
+
+	//cubes in the field around cubeTransform, raise to stress culling and command recording
+	uint32 drawCount = 1;
+
+	//per cube offset in the cube's model space and bounding sphere, as cullSpheres() takes it
+	std::vector<vec4> cubeOffsets;
+	std::vector<float> cubeBoundsX;
+	std::vector<float> cubeBoundsY;
+	std::vector<float> cubeBoundsZ;
+	std::vector<float> cubeBoundsRadius;
+
+	//the cubes in view this frame, the only ones recorded
+	std::vector<uint32> visibleCubes;
+	uint32 visibleCount = 0;
+
+	//a row of skinned columns swaying beside the field, skinned on the GPU every frame
+	uint32 characterCount = 4;  //0 for none
+	Skeleton skeleton;
+	AnimationClip swayClip;
+	std::vector<SkinnedVertex> columnVertices;  //bind pose
+	std::vector<Character> characters;
+	std::vector<vec4> characterOffsets;         //model space, like cubeOffsets
+	GpuSkinning skinning;
+	uint32 skinnedPipeline;  //id in vulkanManager.pipelines
+	uint64 initUploaded = 0;  //graphics timeline value of the last init command buffer
+
+	TransformHierarchy transforms;
+	TransformId cubeTransform;
+
 	mat4 modelMatrix;
 	mat4 viewMatrix;
 	mat4 projMatrix;
+	mat4 cullProjMatrix;  //projMatrix widened by the most the camera can turn after culling
+
+	//The camera is latched from the newest input right before submit, see latchInput(), and
+	//optionally extrapolated to when the frame is likely to be on screen.
+	bool predictCamera = true;
+	float cameraPrediction = 0.0f;  //seconds ahead, this frame
+	vec3 cameraVelocity;            //units per second, from the keys held
+	float yawRate = 0.0f;           //degrees per second, over the last latch
+	float pitchRate = 0.0f;
+	std::chrono::steady_clock::time_point lastLatch;
+
+	//input to submit, summed since the last stats log
+	std::chrono::steady_clock::time_point frameStart;  //where the input was sampled before latching
+	double latchToSubmitMs = 0.0;
+	double frameStartToSubmitMs = 0.0;
+	uint32 latencySamples = 0;
 
 	std::vector<float> vertexData;
 	std::vector<float> uvData;
@@ -52,11 +112,19 @@ struct Demo
 	
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorPool descriptorPool;
+
+	//per frame slot, written once the slot is free again: the cached draw batches of a slot
+	//then always bind the same set, whichever swapchain image the frame draws to
+	VkBuffer uniformBuffers[MAX_FRAMES] = {};
+	VkDeviceMemory uniformMemory[MAX_FRAMES] = {};
+	void *uniformMemoryPtr[MAX_FRAMES];
+	VkDescriptorSet descriptorSets[MAX_FRAMES];
 	
 	uint32 currBufferIndex = 0;
-	int frameIndex = 0;	
+	uint32 frameIndex = 0;  //frame slot, see FrameScheduler	
+	uint64 frameCount = 0;
 
-	float lastFrameTime; //seconds
+	float lastFrameTime = 0.0f; //seconds
 
 	uint32 width;
 	uint32 height;
@@ -85,17 +153,29 @@ struct Demo
 	void prepare();
 	void initStagingTexture();
 	void initTextures();
+	void initTextureSampler(VulkanTexture &texture);
+	void initCubeField();
+	void initCharacters();
 	void initCubeDataBuffers();
+	void destroyCubeDataBuffers();
 	void initDescriptorLayout();
-	void initRenderPass();
+	void initRenderGraph();
 	void initPipeline();
+	void initSkinning();
 	void setupImageOwnership(int i);
 	void initDescriptorPool();
 	void initDescriptorSet();
-	void initFramebuffers();
 	void recordDrawCommands(VkCommandBuffer cmdBuffer);
+	void recordMainPass(const RenderGraphContext &context);
+	uint64 hashDrawBatch(uint32 firstDraw, uint32 endDraw);
+	void recordDrawBatch(VkCommandBuffer cmdBuffer, uint32 firstDraw, uint32 endDraw);
 	void flushInitCmd();
 	void resize();
+	void updateScene();
+	void latchInput();
 	void updateDataBuffer();
+	void animateCharacters();
+	void cullCubes(const mat4 &mvp);
+	void paceFrame();
 	void updateAndRender();	
 };
\ No newline at end of file
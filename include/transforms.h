@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "vectors.h"
+#include "matrix.h"
+
+//Parent/child transforms.
+//
+//The local translation, rotation and scale of the nodes are stored as separate float arrays
+//(SoA), so the local matrices are built 4 at a time, and the nodes are kept sorted by depth:
+//all the roots, then all their children, and so on. A parent always comes before its
+//children, and the nodes of one depth only read the world matrices of the depth above, so
+//each depth can be split in chunks that run in parallel.
+//
+//update() only recomputes the nodes whose local transform was set since the last update,
+//and their descendants. The world matrices are in depth order too, so they can be copied as
+//they are into a per-instance buffer; instanceIndex() is a node's position in it.
+//
+//Nodes are referred to by a TransformId, which stays valid when the depth order changes.
+
+typedef uint32_t TransformId;
+static const uint32_t NO_TRANSFORM = 0xFFFFFFFF;
+
+struct TransformHierarchy
+{
+	//nodes per parallel chunk: big enough to amortize the scheduling, small enough to split
+	//a depth of a few thousand nodes between the cores
+	static const size_t CHUNK_SIZE = 1024;
+
+	//per node, in depth order
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> rotX, rotY, rotZ, rotW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<uint32_t> parent;   //index of the parent, NO_TRANSFORM for roots
+	std::vector<uint32_t> depth;
+	std::vector<uint8_t> dirty;     //local transform set since the last update
+	std::vector<uint8_t> changed;   //world matrix recomputed by the last update
+	std::vector<mat4> world;
+
+	//levelStart[d] is the index of the first node of depth d, the last entry the node count
+	std::vector<uint32_t> levelStart;
+
+	std::vector<uint32_t> idToIndex;
+	std::vector<TransformId> indexToId;
+	bool orderDirty = false;        //a node was added above the deepest level
+
+	//parentId is NO_TRANSFORM for a root. r must be a unit quaternion.
+	TransformId add(TransformId parentId, vec3 t, quat r, vec3 s);
+
+	void setLocal(TransformId id, vec3 t, quat r, vec3 s);
+	void setPosition(TransformId id, vec3 t);
+	void setRotation(TransformId id, quat r);
+
+	size_t size() const { return world.size(); }
+
+	//Index of the node's world matrix in world[] and in what writeWorldMatrices() writes.
+	//Adding nodes can change it, it is stable from one update() to the next add().
+	uint32_t instanceIndex(TransformId id) const { return idToIndex[id]; }
+
+	const mat4 &getWorld(TransformId id) const { return world[idToIndex[id]]; }
+
+	//Recomputes the world matrices on the calling thread.
+	void update();
+
+	//The same, with each depth split in chunks of CHUNK_SIZE nodes handed to
+	//parallelFor(count, chunkSize, fn), which must call fn(begin, end) over [0, count)
+	//(from any threads) and return once every call is done.
+	template<typename ParallelFor>
+	void update(ParallelFor &&parallelFor)
+	{
+		if(orderDirty) sortByDepth();
+
+		for(size_t d = 0; d + 1 < levelStart.size(); d++)
+		{
+			size_t first = levelStart[d];
+			size_t count = levelStart[d + 1] - first;
+			parallelFor(count, CHUNK_SIZE, [this, first](size_t begin, size_t end)
+			{
+				updateNodes(first + begin, first + end);
+			});
+		}
+	}
+
+	//Copies all the world matrices, in depth order, to mapped upload memory with streaming
+	//stores. dst must have room for size() matrices.
+	void writeWorldMatrices(void *dst) const;
+
+	void sortByDepth();
+	void updateNodes(size_t begin, size_t end);
+};
@@ -2,17 +2,23 @@
 
 #include <stdint.h>
 #include <math.h>
-#include <xmmintrin.h>
-
-#define FORCE_INLINE  __forceinline
+#include "simd_backend.h"
 
 //Helpers
+#ifndef M_PI
 #define M_PI          3.14159265358979323846f
+#endif
 #define DEG2RAD(_a)   ((_a)*M_PI/180.0f) 
 #define RAD2DEG(_a)   ((_a)*180.0f/M_PI)
+#ifndef INT_MIN
 #define INT_MIN       (-2147483647 - 1)
+#endif
+#ifndef INT_MAX
 #define INT_MAX       2147483647
+#endif
+#ifndef FLT_MAX
 #define FLT_MAX       3.402823466e+38F
+#endif
 
 //Shuffle helpers
 //Examples: SHUFFLE3(v, 0,1,2) leaves the vector unchanged.
@@ -21,6 +27,11 @@
 #define SHUFFLE3(V, X,Y,Z) vec3(_mm_shuffle_ps((V).m, (V).m, _MM_SHUFFLE(Z,Z,Y,X)))
 #define SHUFFLE4(V, X,Y,Z,W) vec4(_mm_shuffle_ps((V).m, (V).m, _MM_SHUFFLE(W,Z,Y,X)))
 
+//Same as above but on raw __m128 registers, in x,y,z,w order.
+//VSHUFFLE takes X,Y from A and Z,W from B.
+#define VSWIZZLE(A, X,Y,Z,W) _mm_shuffle_ps((A), (A), _MM_SHUFFLE(W,Z,Y,X))
+#define VSHUFFLE(A, B, X,Y,Z,W) _mm_shuffle_ps((A), (B), _MM_SHUFFLE(W,Z,Y,X))
+
 struct vec2
 {   
 	__m128 m;
@@ -51,8 +62,8 @@ struct vec2
 		m = _mm_move_ss(t, m);
 	}
 	
-	FORCE_INLINE float operator[] (size_t i) const { return m.m128_f32[i]; };
-	FORCE_INLINE float& operator[] (size_t i) { return m.m128_f32[i]; };
+	FORCE_INLINE float operator[] (size_t i) const { return vlane(m, i); };
+	FORCE_INLINE float& operator[] (size_t i) { return vlane(m, i); };
 };
 
 struct vec3
@@ -63,7 +74,7 @@ struct vec3
 	FORCE_INLINE explicit vec3(const float *p){ m = _mm_set_ps(p[2], p[2], p[1], p[0]); }
 	FORCE_INLINE explicit vec3(float x, float y, float z) { m = _mm_set_ps(z, z, y, x); }
 	FORCE_INLINE explicit vec3(__m128 v) { m = v; }
-	FORCE_INLINE explicit vec3(vec2 v, float z) {m = _mm_add_ps(v.m, _mm_set_ps(0.0f, 0.0f, z , 0.0f));}
+	FORCE_INLINE explicit vec3(vec2 v, float z) {m = _mm_shuffle_ps(v.m, _mm_set1_ps(z), _MM_SHUFFLE(0, 0, 1, 0));}
 
 	FORCE_INLINE float x() const { return _mm_cvtss_f32(m); }
 	FORCE_INLINE float y() const { return _mm_cvtss_f32(_mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1))); }
@@ -93,8 +104,8 @@ struct vec3
 		m = _mm_move_ss(t, m);
 	}
 	
-	FORCE_INLINE float operator[] (size_t i) const { return m.m128_f32[i]; };
-	FORCE_INLINE float& operator[] (size_t i) { return m.m128_f32[i]; };
+	FORCE_INLINE float operator[] (size_t i) const { return vlane(m, i); };
+	FORCE_INLINE float& operator[] (size_t i) { return vlane(m, i); };
 };
 
 struct vec4
@@ -106,9 +117,11 @@ struct vec4
 	FORCE_INLINE explicit vec4(float x, float y, float z, float w) { m = _mm_set_ps(w, z, y, x); }
 	FORCE_INLINE explicit vec4(__m128 v) { m = v; }
 	FORCE_INLINE explicit vec4(vec2 v) { m = v.m;}
-	FORCE_INLINE explicit vec4(vec2 v, float z, float w) {m = _mm_add_ps(v.m, _mm_set_ps(0.0f, 0.0f, z , w));}
+	FORCE_INLINE explicit vec4(vec2 v, float z, float w) {m = _mm_shuffle_ps(v.m, _mm_setr_ps(z, w, 0.0f, 0.0f), _MM_SHUFFLE(1, 0, 1, 0));}
 	FORCE_INLINE explicit vec4(vec3 v) { m = v.m;}
-	FORCE_INLINE explicit vec4(vec3 v, float w) { m = _mm_add_ps(v.m, _mm_set_ps(0.0f, 0.0f, 0.0f, w));}
+	FORCE_INLINE explicit vec4(vec3 v, float w) { m = _mm_shuffle_ps(v.m, _mm_unpackhi_ps(v.m, _mm_set1_ps(w)), _MM_SHUFFLE(1, 0, 1, 0));}
+	//w is a splatted register, e.g. a dotv() result
+	FORCE_INLINE explicit vec4(vec3 v, vec3 w) { m = _mm_shuffle_ps(v.m, _mm_unpackhi_ps(v.m, w.m), _MM_SHUFFLE(1, 0, 1, 0));}
 
 
 	FORCE_INLINE float x() const { return _mm_cvtss_f32(m); }
@@ -148,8 +161,8 @@ struct vec4
 		m = _mm_move_ss(t, m);
 	}
 	
-	FORCE_INLINE float operator[] (size_t i) const { return m.m128_f32[i]; };
-	FORCE_INLINE float& operator[] (size_t i) { return m.m128_f32[i]; };
+	FORCE_INLINE float operator[] (size_t i) const { return vlane(m, i); };
+	FORCE_INLINE float& operator[] (size_t i) { return vlane(m, i); };
 };
 
 //Helpers to load integer arguments to avoid manual casting
@@ -157,8 +170,7 @@ FORCE_INLINE vec2 vec2i(int x, int y) { return vec2((float)x, (float)y); }
 FORCE_INLINE vec3 vec3i(int x, int y, int z) { return vec3((float)x, (float)y, (float)z);}
 FORCE_INLINE vec4 vec4i(int x, int y, int z, int w) { return vec4((float)x, (float)y, (float)z, (float)w);}
 
-// Helpers for initializing static data.
-#define VCONST extern const __declspec(selectany)
+// Helpers for initializing static data (VCONST is defined in simd_backend.h).
 struct vconstu
 {
 	union { uint32_t u[4]; __m128 v; };
@@ -167,6 +179,19 @@ struct vconstu
 
 VCONST vconstu vsignbits = { 0x80000000, 0x80000000, 0x80000000, 0x80000000 };
 
+//Per-lane select on raw registers: a where the mask lane is set, b elsewhere.
+//The mask lanes must be all ones or all zeros, as produced by the comparisons.
+FORCE_INLINE __m128 vselect(__m128 mask, __m128 a, __m128 b)
+{
+#if defined(VEC_SSE41)
+	return _mm_blendv_ps(b, a, mask);
+#elif defined(VEC_BACKEND_NEON)
+	return vbslq_f32(vreinterpretq_u32_f32(mask), a, b);
+#else
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+#endif
+}
+
 
 typedef vec2 bool2; 
 typedef vec3 bool3;
@@ -325,3 +350,568 @@ FORCE_INLINE float lengthSq(vec4 v) { return dot(v, v); }
 FORCE_INLINE vec4 normalize(vec4 v) { return v * (1.0f / length(v)); }
 FORCE_INLINE vec4 lerp(vec4 a, vec4 b, float t) { return a + (b-a)*t; }
 
+
+//=========================== Splatted reductions ===========================
+//dot, length and normalize without leaving the SSE registers: the result is broadcast to
+//every lane (hence the v suffix), so it can be used directly in further vector math
+//instead of going through a float. The sums are shuffle + add trees; both hadd and
+//_mm_dp_ps measured slower than that for a single vector.
+//
+//There is no normalize_fast for a single vec3 or vec4: rsqrt + a Newton step measured no
+//faster than the sqrt + divide of normalize() (math_bench), the shuffle tree and the
+//dependency chain dominate either way. Over SoA data the divide is the bottleneck and
+//normalize_fast(vec3x4) wins.
+//
+//The precision of rsqrtv and the *_fast functions is selected with VEC_FAST_PRECISION,
+//which can be defined before including this header:
+//  VEC_FAST_EXACT     sqrt + divide, same results as normalize()
+//  VEC_FAST_NEWTON    rsqrt estimate + one Newton-Raphson step, ~22 bits (default)
+//  VEC_FAST_ESTIMATE  rsqrt estimate alone, ~12 bits
+#define VEC_FAST_EXACT    0
+#define VEC_FAST_NEWTON   1
+#define VEC_FAST_ESTIMATE 2
+
+#ifndef VEC_FAST_PRECISION
+#define VEC_FAST_PRECISION VEC_FAST_NEWTON
+#endif
+
+FORCE_INLINE vec3 sumv(vec3 v)
+{
+	return vec3(_mm_add_ps(_mm_add_ps(VSWIZZLE(v.m, 0, 0, 0, 0), VSWIZZLE(v.m, 1, 1, 1, 1)), VSWIZZLE(v.m, 2, 2, 2, 2)));
+}
+
+FORCE_INLINE vec4 sumv(vec4 v)
+{
+	__m128 t = _mm_add_ps(v.m, VSWIZZLE(v.m, 1, 0, 3, 2));
+	return vec4(_mm_add_ps(t, VSWIZZLE(t, 2, 3, 0, 1)));
+}
+
+FORCE_INLINE vec3 dotv(vec3 a, vec3 b) { return sumv(a * b); }
+FORCE_INLINE vec4 dotv(vec4 a, vec4 b) { return sumv(a * b); }
+
+//1/sqrt(x) at VEC_FAST_PRECISION
+FORCE_INLINE __m128 rsqrtv(__m128 x)
+{
+#if VEC_FAST_PRECISION == VEC_FAST_EXACT
+	return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(x));
+#elif VEC_FAST_PRECISION == VEC_FAST_ESTIMATE
+	return _mm_rsqrt_ps(x);
+#else
+	//y' = y * (1.5 - 0.5 * x * y^2)
+	__m128 y = _mm_rsqrt_ps(x);
+	__m128 hx = _mm_mul_ps(x, _mm_set1_ps(0.5f));
+	return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(hx, _mm_mul_ps(y, y))));
+#endif
+}
+
+FORCE_INLINE vec3 lengthSqv(vec3 v) { return dotv(v, v); }
+FORCE_INLINE vec3 lengthv(vec3 v) { return vec3(_mm_sqrt_ps(dotv(v, v).m)); }
+
+FORCE_INLINE vec4 lengthSqv(vec4 v) { return dotv(v, v); }
+FORCE_INLINE vec4 lengthv(vec4 v) { return vec4(_mm_sqrt_ps(dotv(v, v).m)); }
+
+// Masked select: returns a where the mask lane is set and b elsewhere.
+FORCE_INLINE vec4 select(bool4 m, vec4 a, vec4 b) 
+{
+	a.m = vselect(m.m, a.m, b.m); 
+	return a;
+}
+
+//=========================== SoA batch types ===========================
+//vec3x4 holds 4 vec3s in structure-of-arrays layout: x = (x0, x1, x2, x3), and so on.
+//Unlike vec3 no lane is wasted, and horizontal operations (dot, length) become plain
+//vertical arithmetic. Per-vector scalar results are returned as a vec4 where lane i
+//belongs to vector i, so they can be fed straight back into the batch operators.
+
+struct vec3x4
+{
+	__m128 x;
+	__m128 y;
+	__m128 z;
+
+	FORCE_INLINE vec3x4() {}
+	FORCE_INLINE explicit vec3x4(__m128 vx, __m128 vy, __m128 vz) { x = vx; y = vy; z = vz; }
+	FORCE_INLINE explicit vec3x4(vec4 vx, vec4 vy, vec4 vz) { x = vx.m; y = vy.m; z = vz.m; }
+	
+	//replicates v into all 4 lanes
+	FORCE_INLINE explicit vec3x4(vec3 v) 
+	{ 
+		x = _mm_shuffle_ps(v.m, v.m, _MM_SHUFFLE(0, 0, 0, 0));
+		y = _mm_shuffle_ps(v.m, v.m, _MM_SHUFFLE(1, 1, 1, 1));
+		z = _mm_shuffle_ps(v.m, v.m, _MM_SHUFFLE(2, 2, 2, 2));
+	}
+
+	//AoS -> SoA: lane i holds vector i
+	FORCE_INLINE explicit vec3x4(vec3 a, vec3 b, vec3 c, vec3 d)
+	{
+		__m128 w = d.m;
+		x = a.m; y = b.m; z = c.m;
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+	}
+
+	//aligned load from SoA arrays, all pointers must be 16-byte aligned
+	FORCE_INLINE explicit vec3x4(const float *px, const float *py, const float *pz)
+	{
+		x = _mm_load_ps(px);
+		y = _mm_load_ps(py);
+		z = _mm_load_ps(pz);
+	}
+
+	//aligned store to SoA arrays, all pointers must be 16-byte aligned
+	FORCE_INLINE void store(float *px, float *py, float *pz) const
+	{
+		_mm_store_ps(px, x);
+		_mm_store_ps(py, y);
+		_mm_store_ps(pz, z);
+	}
+
+	//SoA -> AoS
+	FORCE_INLINE void toAoS(vec3 &a, vec3 &b, vec3 &c, vec3 &d) const
+	{
+		__m128 r0 = x, r1 = y, r2 = z, r3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		a.m = r0; b.m = r1; c.m = r2; d.m = r3;
+	}
+};
+
+typedef vec3x4 bool3x4;
+
+//vec3x4 common operators:
+FORCE_INLINE vec3x4  operator+ (vec3x4 a, vec3x4 b) {return vec3x4(_mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z));}
+FORCE_INLINE vec3x4  operator- (vec3x4 a, vec3x4 b) {return vec3x4(_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z));}
+FORCE_INLINE vec3x4  operator* (vec3x4 a, vec3x4 b) {return vec3x4(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y), _mm_mul_ps(a.z, b.z));}
+FORCE_INLINE vec3x4  operator/ (vec3x4 a, vec3x4 b) {return vec3x4(_mm_div_ps(a.x, b.x), _mm_div_ps(a.y, b.y), _mm_div_ps(a.z, b.z));}
+FORCE_INLINE vec3x4  operator* (vec3x4 a, vec4 b) {return vec3x4(_mm_mul_ps(a.x, b.m), _mm_mul_ps(a.y, b.m), _mm_mul_ps(a.z, b.m));}
+FORCE_INLINE vec3x4  operator/ (vec3x4 a, vec4 b) {return vec3x4(_mm_div_ps(a.x, b.m), _mm_div_ps(a.y, b.m), _mm_div_ps(a.z, b.m));}
+FORCE_INLINE vec3x4  operator* (vec4 a, vec3x4 b) {return b * a;}
+FORCE_INLINE vec3x4  operator* (vec3x4 a, float b) {return a * vec4(_mm_set1_ps(b));}
+FORCE_INLINE vec3x4  operator/ (vec3x4 a, float b) {return a / vec4(_mm_set1_ps(b));}
+FORCE_INLINE vec3x4  operator* (float a, vec3x4 b) {return b * vec4(_mm_set1_ps(a));}
+FORCE_INLINE vec3x4& operator+= (vec3x4 &a, vec3x4 b) {a = a + b; return a;}
+FORCE_INLINE vec3x4& operator-= (vec3x4 &a, vec3x4 b) {a = a - b; return a;}
+FORCE_INLINE vec3x4& operator*= (vec3x4 &a, vec3x4 b) {a = a * b; return a;}
+FORCE_INLINE vec3x4& operator/= (vec3x4 &a, vec3x4 b) {a = a / b; return a;}
+FORCE_INLINE vec3x4& operator*= (vec3x4 &a, vec4 b) {a = a * b; return a;}
+FORCE_INLINE vec3x4& operator/= (vec3x4 &a, vec4 b) {a = a / b; return a;}
+FORCE_INLINE vec3x4& operator*= (vec3x4 &a, float b) {a = a * b; return a;}
+FORCE_INLINE vec3x4& operator/= (vec3x4 &a, float b) {a = a / b; return a;}
+FORCE_INLINE bool3x4 operator== (vec3x4 a, vec3x4 b) {return vec3x4(_mm_cmpeq_ps(a.x, b.x), _mm_cmpeq_ps(a.y, b.y), _mm_cmpeq_ps(a.z, b.z));}
+FORCE_INLINE bool3x4 operator!= (vec3x4 a, vec3x4 b) {return vec3x4(_mm_cmpneq_ps(a.x, b.x), _mm_cmpneq_ps(a.y, b.y), _mm_cmpneq_ps(a.z, b.z));}
+FORCE_INLINE bool3x4 operator< (vec3x4 a, vec3x4 b) {return vec3x4(_mm_cmplt_ps(a.x, b.x), _mm_cmplt_ps(a.y, b.y), _mm_cmplt_ps(a.z, b.z));}
+FORCE_INLINE bool3x4 operator> (vec3x4 a, vec3x4 b) {return vec3x4(_mm_cmpgt_ps(a.x, b.x), _mm_cmpgt_ps(a.y, b.y), _mm_cmpgt_ps(a.z, b.z));}
+FORCE_INLINE bool3x4 operator<= (vec3x4 a, vec3x4 b) {return vec3x4(_mm_cmple_ps(a.x, b.x), _mm_cmple_ps(a.y, b.y), _mm_cmple_ps(a.z, b.z));}
+FORCE_INLINE bool3x4 operator>= (vec3x4 a, vec3x4 b) {return vec3x4(_mm_cmpge_ps(a.x, b.x), _mm_cmpge_ps(a.y, b.y), _mm_cmpge_ps(a.z, b.z));}
+FORCE_INLINE vec3x4  vec_min(vec3x4 a, vec3x4 b) {return vec3x4(_mm_min_ps(a.x, b.x), _mm_min_ps(a.y, b.y), _mm_min_ps(a.z, b.z));}
+FORCE_INLINE vec3x4  vec_max(vec3x4 a, vec3x4 b) {return vec3x4(_mm_max_ps(a.x, b.x), _mm_max_ps(a.y, b.y), _mm_max_ps(a.z, b.z));}
+
+FORCE_INLINE vec3x4 operator- (vec3x4 a) { return vec3x4(_mm_xor_ps(a.x, vsignbits), _mm_xor_ps(a.y, vsignbits), _mm_xor_ps(a.z, vsignbits)); }
+FORCE_INLINE vec3x4 abs(vec3x4 a) { return vec3x4(_mm_andnot_ps(vsignbits, a.x), _mm_andnot_ps(vsignbits, a.y), _mm_andnot_ps(vsignbits, a.z)); }
+
+// Component-wise select with a bool3x4 mask, or whole-vector select with a per-lane bool4 mask.
+FORCE_INLINE vec3x4 select(bool3x4 m, vec3x4 a, vec3x4 b)
+{
+	return vec3x4(vselect(m.x, a.x, b.x), vselect(m.y, a.y, b.y), vselect(m.z, a.z, b.z));
+}
+FORCE_INLINE vec3x4 select(bool4 m, vec3x4 a, vec3x4 b) { return select(vec3x4(m, m, m), a, b); }
+
+// Reduces a component-wise mask to a per-lane mask.
+FORCE_INLINE bool4 anyComponent(bool3x4 m) { return vec4(_mm_or_ps(_mm_or_ps(m.x, m.y), m.z)); }
+FORCE_INLINE bool4 allComponents(bool3x4 m) { return vec4(_mm_and_ps(_mm_and_ps(m.x, m.y), m.z)); }
+
+FORCE_INLINE vec4 dot(vec3x4 a, vec3x4 b)
+{
+	__m128 r = _mm_mul_ps(a.x, b.x);
+	r = _mm_add_ps(r, _mm_mul_ps(a.y, b.y));
+	r = _mm_add_ps(r, _mm_mul_ps(a.z, b.z));
+	return vec4(r);
+}
+
+FORCE_INLINE vec3x4 cross(vec3x4 a, vec3x4 b)
+{
+	return vec3x4(_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+	              _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+	              _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x)));
+}
+
+FORCE_INLINE vec4 lengthSq(vec3x4 v) { return dot(v, v); }
+FORCE_INLINE vec4 length(vec3x4 v) { return vec4(_mm_sqrt_ps(dot(v, v).m)); }
+FORCE_INLINE vec3x4 normalize(vec3x4 v) { return v / length(v); }
+FORCE_INLINE vec3x4 normalize_fast(vec3x4 v) { return v * vec4(rsqrtv(dot(v, v).m)); }
+FORCE_INLINE vec3x4 lerp(vec3x4 a, vec3x4 b, float t) { return a + (b-a)*t; }
+FORCE_INLINE vec3x4 lerp(vec3x4 a, vec3x4 b, vec4 t) { return a + (b-a)*t; }
+FORCE_INLINE vec3x4 clamp(vec3x4 t, vec3x4 a, vec3x4 b) { return vec_min(vec_max(t, a), b); }
+
+//============================ Quaternions ==============================
+//quat stores (x, y, z, w) with w the scalar part. Rotations are unit quaternions.
+//a * b is the Hamilton product, which rotates by b first and then by a. Matrices
+//compose the other way around because of the row-vector convention:
+//quatToMat4(a * b) == quatToMat4(b) * quatToMat4(a).
+struct quat
+{
+	__m128 m;
+
+	FORCE_INLINE quat() {}
+	FORCE_INLINE explicit quat(float x, float y, float z, float w) { m = _mm_set_ps(w, z, y, x); }
+	FORCE_INLINE explicit quat(__m128 v) { m = v; }
+	FORCE_INLINE explicit quat(vec4 v) { m = v.m; }
+
+	FORCE_INLINE float x() const { return _mm_cvtss_f32(m); }
+	FORCE_INLINE float y() const { return _mm_cvtss_f32(_mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1))); }
+	FORCE_INLINE float z() const { return _mm_cvtss_f32(_mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2))); }
+	FORCE_INLINE float w() const { return _mm_cvtss_f32(_mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 3, 3, 3))); }
+
+	//vector part
+	FORCE_INLINE vec3 xyz() const { return vec3(m); }
+};
+
+VCONST vconstu vsignw   = { 0, 0, 0, 0x80000000 };
+VCONST vconstu vsignxyz = { 0x80000000, 0x80000000, 0x80000000, 0 };
+
+FORCE_INLINE quat quatIdentity() { return quat(0.0f, 0.0f, 0.0f, 1.0f); }
+
+//axis must be normalized, angle is in radians.
+FORCE_INLINE quat quatAxisAngle(vec3 axis, float angle)
+{
+	float s = sinf(0.5f * angle);
+	float c = cosf(0.5f * angle);
+	return quat(vec4(axis * s, c));
+}
+
+FORCE_INLINE quat operator* (quat a, quat b)
+{
+	//xyz = a.w*b.xyz + b.w*a.xyz + cross(a.xyz, b.xyz)
+	//w   = a.w*b.w - dot(a.xyz, b.xyz)
+	__m128 r = _mm_mul_ps(VSWIZZLE(a.m, 3, 3, 3, 3), b.m);
+	__m128 t = _mm_mul_ps(VSWIZZLE(a.m, 0, 1, 2, 0), VSWIZZLE(b.m, 3, 3, 3, 0));
+	t = _mm_add_ps(t, _mm_mul_ps(VSWIZZLE(a.m, 1, 2, 0, 1), VSWIZZLE(b.m, 2, 0, 1, 1)));
+	r = _mm_add_ps(r, _mm_xor_ps(t, vsignw));
+	r = _mm_sub_ps(r, _mm_mul_ps(VSWIZZLE(a.m, 2, 0, 1, 2), VSWIZZLE(b.m, 1, 2, 0, 2)));
+	return quat(r);
+}
+FORCE_INLINE quat& operator*= (quat &a, quat b) {a = a * b; return a;}
+
+//Negating every component gives the same rotation.
+FORCE_INLINE quat operator- (quat q) { return quat(_mm_xor_ps(q.m, vsignbits)); }
+
+FORCE_INLINE float dot(quat a, quat b) { return dot(vec4(a.m), vec4(b.m)); }
+FORCE_INLINE float length(quat q) { return length(vec4(q.m)); }
+FORCE_INLINE quat normalize(quat q) { return quat(normalize(vec4(q.m))); }
+
+FORCE_INLINE quat conjugate(quat q) { return quat(_mm_xor_ps(q.m, vsignxyz)); }
+
+//For unit quaternions this is the same as conjugate().
+FORCE_INLINE quat inverse(quat q) { return quat(_mm_div_ps(conjugate(q).m, _mm_set1_ps(dot(q, q)))); }
+
+//Rotates v by the unit quaternion q (q * v * q^-1) with two cross products
+//instead of two quaternion products:
+//t = 2 * cross(q.xyz, v),  v' = v + q.w * t + cross(q.xyz, t)
+FORCE_INLINE vec3 rotate(quat q, vec3 v)
+{
+	vec3 u = q.xyz();
+	vec3 t = cross(u, v);
+	t += t;
+	return v + vec3(VSWIZZLE(q.m, 3, 3, 3, 3)) * t + cross(u, t);
+}
+
+//Flips b when needed so the interpolation takes the shortest path.
+FORCE_INLINE quat shortestPath(quat a, quat b)
+{
+	__m128 d = _mm_set1_ps(dot(a, b));
+	return quat(_mm_xor_ps(b.m, _mm_and_ps(d, vsignbits)));
+}
+
+//Normalized linear interpolation: constant-time, but the angular speed is not uniform.
+FORCE_INLINE quat nlerp(quat a, quat b, float t)
+{
+	b = shortestPath(a, b);
+	return normalize(quat(lerp(vec4(a.m), vec4(b.m), t)));
+}
+
+//Spherical linear interpolation. Falls back to nlerp when the quaternions are almost
+//parallel, where sin(theta) gets too small to divide by and both give the same result.
+FORCE_INLINE quat slerp(quat a, quat b, float t)
+{
+	b = shortestPath(a, b);
+	float cosTheta = dot(a, b);
+	
+	if(cosTheta > 0.9995f)
+	{
+		return normalize(quat(lerp(vec4(a.m), vec4(b.m), t)));
+	}
+	
+	float theta = acosf(cosTheta);
+	float rSinTheta = 1.0f / sinf(theta);
+	float wa = sinf((1.0f - t) * theta) * rSinTheta;
+	float wb = sinf(t * theta) * rSinTheta;
+	return quat(vec4(a.m) * wa + vec4(b.m) * wb);
+}
+
+//quatx4 holds 4 quaternions in SoA layout, like vec3x4.
+struct quatx4
+{
+	__m128 x, y, z, w;
+
+	FORCE_INLINE quatx4() {}
+	FORCE_INLINE explicit quatx4(__m128 x_, __m128 y_, __m128 z_, __m128 w_) : x(x_), y(y_), z(z_), w(w_) {}
+	FORCE_INLINE explicit quatx4(quat q) 
+	{
+		x = VSWIZZLE(q.m, 0, 0, 0, 0);
+		y = VSWIZZLE(q.m, 1, 1, 1, 1);
+		z = VSWIZZLE(q.m, 2, 2, 2, 2);
+		w = VSWIZZLE(q.m, 3, 3, 3, 3);
+	}
+
+	//AoS -> SoA
+	FORCE_INLINE explicit quatx4(quat a, quat b, quat c, quat d)
+	{
+		x = a.m; y = b.m; z = c.m; w = d.m;
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+	}
+
+	FORCE_INLINE vec3x4 xyz() const { return vec3x4(x, y, z); }
+
+	//SoA -> AoS
+	FORCE_INLINE void toAoS(quat &a, quat &b, quat &c, quat &d) const
+	{
+		__m128 r0 = x, r1 = y, r2 = z, r3 = w;
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		a.m = r0; b.m = r1; c.m = r2; d.m = r3;
+	}
+};
+
+FORCE_INLINE vec4 dot(quatx4 a, quatx4 b)
+{
+	__m128 r = _mm_mul_ps(a.x, b.x);
+	r = _mm_add_ps(r, _mm_mul_ps(a.y, b.y));
+	r = _mm_add_ps(r, _mm_mul_ps(a.z, b.z));
+	r = _mm_add_ps(r, _mm_mul_ps(a.w, b.w));
+	return vec4(r);
+}
+
+FORCE_INLINE quatx4 operator* (quatx4 a, quatx4 b)
+{
+	vec3x4 av = a.xyz();
+	vec3x4 bv = b.xyz();
+	vec3x4 v = bv * vec4(a.w) + av * vec4(b.w) + cross(av, bv);
+	__m128 w = _mm_sub_ps(_mm_mul_ps(a.w, b.w), dot(av, bv).m);
+	return quatx4(v.x, v.y, v.z, w);
+}
+
+FORCE_INLINE vec3x4 rotate(quatx4 q, vec3x4 v)
+{
+	vec3x4 u = q.xyz();
+	vec3x4 t = cross(u, v);
+	t += t;
+	return v + t * vec4(q.w) + cross(u, t);
+}
+
+FORCE_INLINE quatx4 normalize(quatx4 q)
+{
+	__m128 r = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot(q, q).m));
+	return quatx4(_mm_mul_ps(q.x, r), _mm_mul_ps(q.y, r), _mm_mul_ps(q.z, r), _mm_mul_ps(q.w, r));
+}
+
+FORCE_INLINE quatx4 nlerp(quatx4 a, quatx4 b, vec4 t)
+{
+	//shortest path: flip b in the lanes where dot(a, b) < 0
+	__m128 flip = _mm_and_ps(dot(a, b).m, vsignbits);
+	__m128 bx = _mm_xor_ps(b.x, flip);
+	__m128 by = _mm_xor_ps(b.y, flip);
+	__m128 bz = _mm_xor_ps(b.z, flip);
+	__m128 bw = _mm_xor_ps(b.w, flip);
+
+	quatx4 r(_mm_add_ps(a.x, _mm_mul_ps(_mm_sub_ps(bx, a.x), t.m)),
+	         _mm_add_ps(a.y, _mm_mul_ps(_mm_sub_ps(by, a.y), t.m)),
+	         _mm_add_ps(a.z, _mm_mul_ps(_mm_sub_ps(bz, a.z), t.m)),
+	         _mm_add_ps(a.w, _mm_mul_ps(_mm_sub_ps(bw, a.w), t.m)));
+	return normalize(r);
+}
+
+//Cheap slerp without any trig: nlerp with t warped by a polynomial fitted to the
+//slerp angle (Zeux, "Approximating slerp"). Max error is under 1e-3 radians over the
+//whole [0, pi] range. The exact batch slerp is in simd_math.h.
+FORCE_INLINE quatx4 slerpApprox(quatx4 a, quatx4 b, vec4 t)
+{
+	__m128 d = _mm_andnot_ps(vsignbits, dot(a, b).m);
+
+	//A = 1.0904 + d * (-3.2452 + d * (3.55645 - d * 1.43519))
+	//B = 0.848013 + d * (-1.06021 + d * 0.215638)
+	__m128 A = _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(1.43519f)));
+	A = _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(d, A));
+	A = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, A));
+	__m128 B = _mm_add_ps(_mm_set1_ps(-1.06021f), _mm_mul_ps(d, _mm_set1_ps(0.215638f)));
+	B = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, B));
+
+	//t' = t + t * (t - 0.5) * (t - 1) * (A * (t - 0.5)^2 + B)
+	__m128 tm = _mm_sub_ps(t.m, _mm_set1_ps(0.5f));
+	__m128 k = _mm_add_ps(_mm_mul_ps(A, _mm_mul_ps(tm, tm)), B);
+	__m128 tt = _mm_mul_ps(_mm_mul_ps(t.m, tm), _mm_sub_ps(t.m, _mm_set1_ps(1.0f)));
+	tt = _mm_add_ps(t.m, _mm_mul_ps(tt, k));
+
+	return nlerp(a, b, vec4(tt));
+}
+
+//8-wide variants, only available when compiling with AVX enabled (/arch:AVX or -mavx).
+#ifdef VEC_AVX
+
+//vec8 carries 8 per-lane scalars for vec3x8, the same way vec4 does for vec3x4.
+struct vec8
+{
+	__m256 m;
+
+	FORCE_INLINE vec8() {}
+	FORCE_INLINE explicit vec8(__m256 v) { m = v; }
+	FORCE_INLINE explicit vec8(float s) { m = _mm256_set1_ps(s); }
+	//aligned load, p must be 32-byte aligned
+	FORCE_INLINE explicit vec8(const float *p) { m = _mm256_load_ps(p); }
+	FORCE_INLINE void store(float *p) const { _mm256_store_ps(p, m); }
+};
+
+typedef vec8 bool8;
+
+FORCE_INLINE vec8  operator+ (vec8 a, vec8 b) {a.m = _mm256_add_ps(a.m, b.m); return a;}
+FORCE_INLINE vec8  operator- (vec8 a, vec8 b) {a.m = _mm256_sub_ps(a.m, b.m); return a;}
+FORCE_INLINE vec8  operator* (vec8 a, vec8 b) {a.m = _mm256_mul_ps(a.m, b.m); return a;}
+FORCE_INLINE vec8  operator/ (vec8 a, vec8 b) {a.m = _mm256_div_ps(a.m, b.m); return a;}
+FORCE_INLINE vec8  operator* (vec8 a, float b) {a.m = _mm256_mul_ps(a.m, _mm256_set1_ps(b)); return a;}
+FORCE_INLINE vec8  operator/ (vec8 a, float b) {a.m = _mm256_div_ps(a.m, _mm256_set1_ps(b)); return a;}
+FORCE_INLINE vec8  operator* (float a, vec8 b) {b.m = _mm256_mul_ps(_mm256_set1_ps(a), b.m); return b;}
+FORCE_INLINE vec8& operator+= (vec8 &a, vec8 b) {a = a + b; return a;}
+FORCE_INLINE vec8& operator-= (vec8 &a, vec8 b) {a = a - b; return a;}
+FORCE_INLINE vec8& operator*= (vec8 &a, vec8 b) {a = a * b; return a;}
+FORCE_INLINE vec8& operator/= (vec8 &a, vec8 b) {a = a / b; return a;}
+FORCE_INLINE bool8 operator== (vec8 a, vec8 b) {a.m = _mm256_cmp_ps(a.m, b.m, _CMP_EQ_OQ); return a;}
+FORCE_INLINE bool8 operator!= (vec8 a, vec8 b) {a.m = _mm256_cmp_ps(a.m, b.m, _CMP_NEQ_UQ); return a;}
+FORCE_INLINE bool8 operator< (vec8 a, vec8 b) {a.m = _mm256_cmp_ps(a.m, b.m, _CMP_LT_OQ); return a;}
+FORCE_INLINE bool8 operator> (vec8 a, vec8 b) {a.m = _mm256_cmp_ps(a.m, b.m, _CMP_GT_OQ); return a;}
+FORCE_INLINE bool8 operator<= (vec8 a, vec8 b) {a.m = _mm256_cmp_ps(a.m, b.m, _CMP_LE_OQ); return a;}
+FORCE_INLINE bool8 operator>= (vec8 a, vec8 b) {a.m = _mm256_cmp_ps(a.m, b.m, _CMP_GE_OQ); return a;}
+FORCE_INLINE vec8  vec_min(vec8 a, vec8 b) {a.m = _mm256_min_ps(a.m, b.m); return a;}
+FORCE_INLINE vec8  vec_max(vec8 a, vec8 b) {a.m = _mm256_max_ps(a.m, b.m); return a;}
+FORCE_INLINE vec8  select(bool8 m, vec8 a, vec8 b) {a.m = _mm256_blendv_ps(b.m, a.m, m.m); return a;}
+
+FORCE_INLINE unsigned mask(vec8 v) { return _mm256_movemask_ps(v.m) & 0xFF; }
+FORCE_INLINE bool any(bool8 v) { return mask(v) != 0; }
+FORCE_INLINE bool all(bool8 v) { return mask(v) == 0xFF; }
+
+struct vec3x8
+{
+	__m256 x;
+	__m256 y;
+	__m256 z;
+
+	FORCE_INLINE vec3x8() {}
+	FORCE_INLINE explicit vec3x8(__m256 vx, __m256 vy, __m256 vz) { x = vx; y = vy; z = vz; }
+	FORCE_INLINE explicit vec3x8(vec8 vx, vec8 vy, vec8 vz) { x = vx.m; y = vy.m; z = vz.m; }
+	
+	//replicates v into all 8 lanes
+	FORCE_INLINE explicit vec3x8(vec3 v)
+	{
+		x = _mm256_set1_ps(v.x());
+		y = _mm256_set1_ps(v.y());
+		z = _mm256_set1_ps(v.z());
+	}
+
+	//two 4-wide batches: lanes 0-3 come from lo, lanes 4-7 from hi
+	FORCE_INLINE explicit vec3x8(vec3x4 lo, vec3x4 hi)
+	{
+		x = _mm256_insertf128_ps(_mm256_castps128_ps256(lo.x), hi.x, 1);
+		y = _mm256_insertf128_ps(_mm256_castps128_ps256(lo.y), hi.y, 1);
+		z = _mm256_insertf128_ps(_mm256_castps128_ps256(lo.z), hi.z, 1);
+	}
+
+	//aligned load from SoA arrays, all pointers must be 32-byte aligned
+	FORCE_INLINE explicit vec3x8(const float *px, const float *py, const float *pz)
+	{
+		x = _mm256_load_ps(px);
+		y = _mm256_load_ps(py);
+		z = _mm256_load_ps(pz);
+	}
+
+	//aligned store to SoA arrays, all pointers must be 32-byte aligned
+	FORCE_INLINE void store(float *px, float *py, float *pz) const
+	{
+		_mm256_store_ps(px, x);
+		_mm256_store_ps(py, y);
+		_mm256_store_ps(pz, z);
+	}
+
+	FORCE_INLINE vec3x4 lo() const { return vec3x4(_mm256_castps256_ps128(x), _mm256_castps256_ps128(y), _mm256_castps256_ps128(z)); }
+	FORCE_INLINE vec3x4 hi() const { return vec3x4(_mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1), _mm256_extractf128_ps(z, 1)); }
+};
+
+typedef vec3x8 bool3x8;
+
+//vec3x8 common operators:
+FORCE_INLINE vec3x8  operator+ (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_add_ps(a.x, b.x), _mm256_add_ps(a.y, b.y), _mm256_add_ps(a.z, b.z));}
+FORCE_INLINE vec3x8  operator- (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_sub_ps(a.x, b.x), _mm256_sub_ps(a.y, b.y), _mm256_sub_ps(a.z, b.z));}
+FORCE_INLINE vec3x8  operator* (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y), _mm256_mul_ps(a.z, b.z));}
+FORCE_INLINE vec3x8  operator/ (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_div_ps(a.x, b.x), _mm256_div_ps(a.y, b.y), _mm256_div_ps(a.z, b.z));}
+FORCE_INLINE vec3x8  operator* (vec3x8 a, vec8 b) {return vec3x8(_mm256_mul_ps(a.x, b.m), _mm256_mul_ps(a.y, b.m), _mm256_mul_ps(a.z, b.m));}
+FORCE_INLINE vec3x8  operator/ (vec3x8 a, vec8 b) {return vec3x8(_mm256_div_ps(a.x, b.m), _mm256_div_ps(a.y, b.m), _mm256_div_ps(a.z, b.m));}
+FORCE_INLINE vec3x8  operator* (vec8 a, vec3x8 b) {return b * a;}
+FORCE_INLINE vec3x8  operator* (vec3x8 a, float b) {return a * vec8(b);}
+FORCE_INLINE vec3x8  operator/ (vec3x8 a, float b) {return a / vec8(b);}
+FORCE_INLINE vec3x8  operator* (float a, vec3x8 b) {return b * vec8(a);}
+FORCE_INLINE vec3x8& operator+= (vec3x8 &a, vec3x8 b) {a = a + b; return a;}
+FORCE_INLINE vec3x8& operator-= (vec3x8 &a, vec3x8 b) {a = a - b; return a;}
+FORCE_INLINE vec3x8& operator*= (vec3x8 &a, vec3x8 b) {a = a * b; return a;}
+FORCE_INLINE vec3x8& operator/= (vec3x8 &a, vec3x8 b) {a = a / b; return a;}
+FORCE_INLINE vec3x8& operator*= (vec3x8 &a, vec8 b) {a = a * b; return a;}
+FORCE_INLINE vec3x8& operator/= (vec3x8 &a, vec8 b) {a = a / b; return a;}
+FORCE_INLINE vec3x8& operator*= (vec3x8 &a, float b) {a = a * b; return a;}
+FORCE_INLINE vec3x8& operator/= (vec3x8 &a, float b) {a = a / b; return a;}
+FORCE_INLINE bool3x8 operator== (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_cmp_ps(a.x, b.x, _CMP_EQ_OQ), _mm256_cmp_ps(a.y, b.y, _CMP_EQ_OQ), _mm256_cmp_ps(a.z, b.z, _CMP_EQ_OQ));}
+FORCE_INLINE bool3x8 operator!= (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_cmp_ps(a.x, b.x, _CMP_NEQ_UQ), _mm256_cmp_ps(a.y, b.y, _CMP_NEQ_UQ), _mm256_cmp_ps(a.z, b.z, _CMP_NEQ_UQ));}
+FORCE_INLINE bool3x8 operator< (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_cmp_ps(a.x, b.x, _CMP_LT_OQ), _mm256_cmp_ps(a.y, b.y, _CMP_LT_OQ), _mm256_cmp_ps(a.z, b.z, _CMP_LT_OQ));}
+FORCE_INLINE bool3x8 operator> (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_cmp_ps(a.x, b.x, _CMP_GT_OQ), _mm256_cmp_ps(a.y, b.y, _CMP_GT_OQ), _mm256_cmp_ps(a.z, b.z, _CMP_GT_OQ));}
+FORCE_INLINE bool3x8 operator<= (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_cmp_ps(a.x, b.x, _CMP_LE_OQ), _mm256_cmp_ps(a.y, b.y, _CMP_LE_OQ), _mm256_cmp_ps(a.z, b.z, _CMP_LE_OQ));}
+FORCE_INLINE bool3x8 operator>= (vec3x8 a, vec3x8 b) {return vec3x8(_mm256_cmp_ps(a.x, b.x, _CMP_GE_OQ), _mm256_cmp_ps(a.y, b.y, _CMP_GE_OQ), _mm256_cmp_ps(a.z, b.z, _CMP_GE_OQ));}
+FORCE_INLINE vec3x8  vec_min(vec3x8 a, vec3x8 b) {return vec3x8(_mm256_min_ps(a.x, b.x), _mm256_min_ps(a.y, b.y), _mm256_min_ps(a.z, b.z));}
+FORCE_INLINE vec3x8  vec_max(vec3x8 a, vec3x8 b) {return vec3x8(_mm256_max_ps(a.x, b.x), _mm256_max_ps(a.y, b.y), _mm256_max_ps(a.z, b.z));}
+
+FORCE_INLINE vec3x8 operator- (vec3x8 a) 
+{
+	__m256 s = _mm256_set1_ps(-0.0f);
+	return vec3x8(_mm256_xor_ps(a.x, s), _mm256_xor_ps(a.y, s), _mm256_xor_ps(a.z, s)); 
+}
+FORCE_INLINE vec3x8 abs(vec3x8 a) 
+{
+	__m256 s = _mm256_set1_ps(-0.0f);
+	return vec3x8(_mm256_andnot_ps(s, a.x), _mm256_andnot_ps(s, a.y), _mm256_andnot_ps(s, a.z)); 
+}
+
+FORCE_INLINE vec3x8 select(bool3x8 m, vec3x8 a, vec3x8 b)
+{
+	return vec3x8(_mm256_blendv_ps(b.x, a.x, m.x),
+	              _mm256_blendv_ps(b.y, a.y, m.y),
+	              _mm256_blendv_ps(b.z, a.z, m.z));
+}
+FORCE_INLINE vec3x8 select(bool8 m, vec3x8 a, vec3x8 b) { return select(vec3x8(m, m, m), a, b); }
+
+FORCE_INLINE bool8 anyComponent(bool3x8 m) { return vec8(_mm256_or_ps(_mm256_or_ps(m.x, m.y), m.z)); }
+FORCE_INLINE bool8 allComponents(bool3x8 m) { return vec8(_mm256_and_ps(_mm256_and_ps(m.x, m.y), m.z)); }
+
+FORCE_INLINE vec8 dot(vec3x8 a, vec3x8 b)
+{
+	__m256 r = _mm256_mul_ps(a.x, b.x);
+	r = _mm256_add_ps(r, _mm256_mul_ps(a.y, b.y));
+	r = _mm256_add_ps(r, _mm256_mul_ps(a.z, b.z));
+	return vec8(r);
+}
+
+FORCE_INLINE vec3x8 cross(vec3x8 a, vec3x8 b)
+{
+	return vec3x8(_mm256_sub_ps(_mm256_mul_ps(a.y, b.z), _mm256_mul_ps(a.z, b.y)),
+	              _mm256_sub_ps(_mm256_mul_ps(a.z, b.x), _mm256_mul_ps(a.x, b.z)),
+	              _mm256_sub_ps(_mm256_mul_ps(a.x, b.y), _mm256_mul_ps(a.y, b.x)));
+}
+
+FORCE_INLINE vec8 lengthSq(vec3x8 v) { return dot(v, v); }
+FORCE_INLINE vec8 length(vec3x8 v) { return vec8(_mm256_sqrt_ps(dot(v, v).m)); }
+FORCE_INLINE vec3x8 normalize(vec3x8 v) { return v / length(v); }
+FORCE_INLINE vec3x8 lerp(vec3x8 a, vec3x8 b, float t) { return a + (b-a)*t; }
+FORCE_INLINE vec3x8 lerp(vec3x8 a, vec3x8 b, vec8 t) { return a + (b-a)*t; }
+FORCE_INLINE vec3x8 clamp(vec3x8 t, vec3x8 a, vec3x8 b) { return vec_min(vec_max(t, a), b); }
+
+#endif //VEC_AVX
@@ -7,8 +7,15 @@
 #include <string>
 #include "platform.h"
 #include "typedefs_and_macros.h"
+#include "barriers.h"
+#include "frame_scheduler.h"
+#include "present_pacer.h"
+#include "async_compute.h"
+#include "pipeline_cache.h"
+#include "pipeline_compiler.h"
+#include "shader_library.h"
 
-#define MAX_FRAMES 3
+#define MAX_FRAMES 3  //most frames in flight, for arrays per frame
 
 // STRUCTS AND HELPER FUNCTIONS 
 //==================== Vulkan Config ======================
@@ -23,10 +30,24 @@ struct VulkanConfig
 
 	//physical device
 	VkPhysicalDeviceFeatures physDeviceFeaturesToEnable;
+	bool useSynchronization2;  //when the device has VK_KHR_synchronization2
+	bool useGraphicsPipelineLibrary;  //when the device has VK_EXT_graphics_pipeline_library
 
 	//swapchain
 	VkSurfaceFormatKHR preferredSurfaceFormat;
-	VkPresentModeKHR preferredPresentMode;
+	uint32 latencyMode;          //LATENCY_*, picks the present mode, see present_pacer.h
+	float frameRateCap;          //frames per second, 0 for none
+	uint32 swapchainImageCount;  //wanted, clamped to what the surface allows. 0 for the latency mode's
+	uint32 framesInFlight;       //1 to MAX_FRAMES, 0 for 2
+
+	//pipelines
+	std::string pipelineCacheFilePath;  //empty to not keep the pipeline cache on disk
+	std::string pipelinePrewarmFilePath;  //empty to not record and replay the pipelines used
+	uint32 pipelineCompileThreads;        //background compile threads, 0 for 1
+
+	//shaders
+	std::string shaderCacheDir;  //compiled SPIR-V by source hash, empty to not keep it on disk
+	bool hotReloadShaders;       //recompile the GLSL sources when they change
 
 	//depth buffer
 	VkFormat preferredDepthFormat;
@@ -41,15 +62,6 @@ struct VulkanConfig
 	std::vector<const char*> deviceExtensions;
 };
 
-struct Depth
-{
-	VkFormat format;
-	VkImage image;
-	VkMemoryAllocateInfo memAlloc;
-	VkDeviceMemory mem;
-	VkImageView view;
-};
-
 // ========================= Vulkan Texture ====================
 struct VulkanTexture
 {
@@ -79,8 +91,15 @@ struct PhysicalDevice
 
 	uint32 graphicsQueueFamilyIndex;
 	uint32 presentQueueFamilyIndex;
+	uint32 computeQueueFamilyIndex;  //the graphics family without a compute-only one
 	
 	bool separatePresentQueue;
+	bool separateComputeQueue;
+	bool supportsTimelineSemaphore;
+	bool supportsSynchronization2;
+	bool supportsPresentWait;  //VK_KHR_present_id and VK_KHR_present_wait
+	bool supportsGraphicsPipelineLibrary;  //VK_KHR_pipeline_library and VK_EXT_graphics_pipeline_library
+	bool supportsPipelineCreationFeedback; //VK_EXT_pipeline_creation_feedback
 
 	void init(VkPhysicalDevice physicalDevice, 
 	          VkSurfaceKHR surface,
@@ -97,6 +116,12 @@ struct LogicalDevice
 	VkDevice device;
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	VkQueue computeQueue;  //graphicsQueue without a separate compute family
+
+	PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2;  //null without synchronization2
+	PFN_vkWaitForPresentKHR waitForPresent;            //null without present wait
+	bool graphicsPipelineLibrary;                      //enabled
+	bool pipelineCreationFeedback;                     //enabled
 
 	void init(PhysicalDevice &physicalDevice,
 	          VulkanConfig config);
@@ -108,14 +133,8 @@ struct LogicalDevice
 struct SwapchainImageResources 
 {
     VkImage image;
-    VkCommandBuffer cmd;
     VkCommandBuffer graphicsToPresentCmd;
     VkImageView view;
-    VkBuffer uniformBuffer;
-    VkDeviceMemory uniformMemory;
-    void *uniformMemoryPtr;
-    VkFramebuffer framebuffer;
-    VkDescriptorSet descriptorSet;
 };
 
 struct Swapchain
@@ -126,6 +145,7 @@ struct Swapchain
 	std::vector<VkPresentModeKHR> presentModes;
 	VkSurfaceFormatKHR surfaceFormat;
 	VkPresentModeKHR presentMode;
+	PresentSettings presentSettings;
 	VkExtent2D imageExtent;
 
 	uint32 imageCount;
@@ -136,7 +156,8 @@ struct Swapchain
 						  VkSurfaceKHR surface);
 
 	void chooseSettings(VkSurfaceFormatKHR preferredFormat,
-						VkPresentModeKHR preferredPresentMode,
+						uint32 latencyMode,
+						bool presentWait,
 						uint32 *width, uint32 *height);
 
 
@@ -144,10 +165,12 @@ struct Swapchain
 									VkDevice logicalDevice,
 									VkSurfaceKHR surface,
 									VkSurfaceFormatKHR preferredFormat,
-									VkPresentModeKHR preferredPresentMode,
+									uint32 latencyMode,
+									bool presentWait,
 									uint32 *demoWidth, uint32 *demoHeight);
 		
-	void createSwapchainAndImageResources(VkSurfaceKHR surface, VkDevice logicalDevice);
+	//desiredImageCount 0 for presentSettings.imageCount
+	void createSwapchainAndImageResources(VkSurfaceKHR surface, VkDevice logicalDevice, uint32 desiredImageCount);
 
 	void destroy(VkDevice &device, VkCommandPool &cmdPool);
 };
@@ -163,6 +186,7 @@ VkResult CreateDebugUtilsMessengerEXT(VkInstance instance,
 void DestroyDebugUtilsMessengerEXT(VkInstance instance, 
                                    VkDebugUtilsMessengerEXT debugMessenger, 
                                    const VkAllocationCallbacks* pAllocator) ;
+
 //==================================================================
 
 struct VulkanManager
@@ -184,22 +208,19 @@ struct VulkanManager
 	
 	bool *isMinimized;
 	
-	VkSemaphore imageAcquiredSemaphores[MAX_FRAMES];
-	VkSemaphore drawCompleteSemaphores[MAX_FRAMES];
-	VkSemaphore imageOwnershipSemaphores[MAX_FRAMES];
-	VkFence fences[MAX_FRAMES];
-
-	VkRenderPass renderPass;
+	FrameScheduler scheduler;
+	PresentPacer pacer;
+	AsyncCompute compute;
 
 	VkCommandPool cmdPool;
 	VkCommandPool presentCmdPool;
 	VkCommandBuffer cmdBuffer; //used for initialization
+	BarrierBatch barriers;     //tracks the textures' layouts
 	
 	VkPipelineLayout pipelineLayout;
-	VkPipelineCache pipelineCache;
-	VkPipeline pipeline;
-
-	Depth depth;
+	PipelineCache pipelineCache;  //for the device's lifetime, across resizes
+	ShaderLibrary shaders;
+	PipelineCompiler pipelines;
 
 	VulkanManager(){} //do nothing
 	~VulkanManager(){} //do nothing
@@ -215,28 +236,23 @@ struct VulkanManager
 	void initSurface(Win32Window *window);
 	void initPhysicalDevice(VkPhysicalDeviceFeatures featuresToEnable);
 	void initCmdPool();
-	void initDepthImage(VkFormat depthFormat, uint32 width, uint32 height);
 	void initSyncPrimitives();
 	
+	//Shared by the queueFamilyCount families (VK_SHARING_MODE_CONCURRENT) when it is more
+	//than one, owned by one family at a time otherwise.
 	void initBuffer(VkDeviceSize size, 
 					VkBufferUsageFlags usageFlags, 
 					VkMemoryPropertyFlags propertyFlags,
 					VkBuffer &buffer, 
-					VkDeviceMemory &bufferMemory);
+					VkDeviceMemory &bufferMemory,
+					uint32 queueFamilyCount = 0,
+					const uint32 *queueFamilies = nullptr);
 					
 	void initImage(uint32 width, uint32 height,
 				   VkFormat format, VkImageTiling tiling, 
 				   VkImageUsageFlags usage, VkMemoryPropertyFlags propertyFlags, 
 				   VkImageLayout initialLayout, VkImage &image, VkDeviceMemory &imageMemory);
 
-	void setImageLayout(VkImage image, 
-					    VkImageAspectFlags aspectMask,
-						VkImageLayout oldLayout, 
-						VkImageLayout newLayout, 
-						VkAccessFlagBits srcAccessMask, 
-						VkPipelineStageFlags srcStages, 
-						VkPipelineStageFlags destStages);
-
 	void initVulkanTexture(uint8 *texPixels, 
 						   uint32 texWidth,
 						   uint32 texHeight,
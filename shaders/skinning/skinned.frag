@@ -0,0 +1,15 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 0) out vec4 outColor;
+
+const vec3 lightDir = vec3(0.424, 0.566, 0.707);
+const vec3 albedo = vec3(0.8, 0.55, 0.3);
+
+void main()
+{
+   float light = 0.2 + 0.8 * max(0.0, dot(lightDir, normalize(fragNormal)));
+   outColor = vec4(light * albedo, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+//Draws the vertices skinning.comp wrote, as a vertex buffer (VERTEX_INPUT_SKINNED).
+
+layout(std140, binding = 0) uniform UniformBuffer
+{
+    mat4 mvp;
+} ubo;
+
+layout(push_constant) uniform PushConstants
+{
+    vec4 offset; //model space, w = 0
+} character;
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec4 normal;
+
+layout(location = 0) out vec3 fragNormal;
+
+void main()
+{
+    gl_Position = ubo.mvp * (vec4(position.xyz, 1.0) + character.offset);
+    fragNormal = normal.xyz;
+}
@@ -1,3 +0,0 @@
-C:/VulkanSDK/1.2.170.0/Bin32/glslc.exe textured_cube.vert -o textured_cube_vert.spv
-C:/VulkanSDK/1.2.170.0/Bin32/glslc.exe textured_cube.frag -o textured_cube_frag.spv
-pause
\ No newline at end of file
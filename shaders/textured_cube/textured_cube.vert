@@ -9,6 +9,11 @@ layout(std140, binding = 0) uniform UniformBuffer
     vec4 attr[12 * 3];
 } ubo;
 
+layout(push_constant) uniform PushConstants
+{
+    vec4 offset; //model space, w = 0
+} cube;
+
 layout(location = 0) out vec4 texCoord;
 layout(location = 1) out vec3 fragPos;
 
@@ -16,6 +21,6 @@ void main()
 {
     texCoord = ubo.attr[gl_VertexIndex];
     transpose(ubo.mvp);
-    gl_Position = ubo.mvp * ubo.position[gl_VertexIndex];
+    gl_Position = ubo.mvp * (ubo.position[gl_VertexIndex] + cube.offset);
     fragPos = gl_Position.xyz;
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "animation.h"
+#include "matrix_kernels.h"
+
+#include <math.h>
+
+void samplePose(const AnimationClip &clip, float time, bool loop, Pose &pose)
+{
+    size_t blocks = clip.blockCount;
+    pose.translations.resize(blocks);
+    pose.rotations.resize(blocks);
+    pose.scales.resize(blocks);
+
+    //frame position, wrapped or clamped to [0, frameCount - 1]
+    float last = (float)(clip.frameCount - 1);
+    float f = time * clip.sampleRate;
+    if(loop && last > 0.0f)
+    {
+        f = fmodf(f, last);
+        if(f < 0.0f) f += last;
+    }
+    f = fminf(fmaxf(f, 0.0f), last);
+
+    uint32_t f0 = (uint32_t)f;
+    uint32_t f1 = f0 + 1 < clip.frameCount ? f0 + 1 : f0;
+    float t = f - (float)f0;
+
+    const vec3x4 *t0 = &clip.translations[f0 * blocks], *t1 = &clip.translations[f1 * blocks];
+    const vec3x4 *s0 = &clip.scales[f0 * blocks], *s1 = &clip.scales[f1 * blocks];
+    for(size_t b = 0; b < blocks; b++)
+    {
+        pose.translations[b] = lerp(t0[b], t1[b], t);
+        pose.scales[b] = lerp(s0[b], s1[b], t);
+    }
+
+    nlerpQuats(&clip.rotations[f0 * blocks], &clip.rotations[f1 * blocks], t, pose.rotations.data(), blocks);
+}
+
+void computePalette(const Skeleton &skeleton, const Pose &pose, mat4 *model, mat4 *palette)
+{
+    size_t joints = skeleton.jointCount();
+
+    //local matrices, 4 joints at a time, then concatenated down the hierarchy in place
+    for(size_t b = 0; b < skeleton.blockCount(); b++)
+    {
+        composeTRS(pose.translations[b], pose.rotations[b], pose.scales[b], model + b * 4);
+    }
+
+    for(size_t j = 0; j < joints; j++)
+    {
+        uint32_t p = skeleton.parent[j];
+        if(p != NO_JOINT) model[j] = model[j] * model[p];
+    }
+
+    composeMatrices(skeleton.inverseBind.data(), model, palette, joints);
+}
+
+void updateCharacters(const Character *characters, size_t count, mat4 *palettes)
+{
+    //per thread scratch, so evaluating a character never allocates once it has warmed up
+    static thread_local Pose pose;
+    static thread_local std::vector<mat4> model;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        const Character &c = characters[i];
+        model.resize(c.skeleton->blockCount() * 4);
+
+        samplePose(*c.clip, c.time, c.loop, pose);
+        computePalette(*c.skeleton, pose, model.data(), palettes + c.paletteOffset);
+    }
+}
@@ -0,0 +1,123 @@
+#include "async_compute.h"
+#include <assert.h>
+
+void AsyncCompute::init(VkDevice device,
+                        uint32 computeFamily,
+                        uint32 graphicsFamily,
+                        uint32 framesInFlight,
+                        PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2)
+{
+    this->device = device;
+    this->computeFamily = computeFamily;
+    this->graphicsFamily = graphicsFamily;
+
+    frame = 0;
+    recording = false;
+    readStages = 0;
+    graphicsWait = {};
+
+    releases.init(cmdPipelineBarrier2);
+    acquires.init(cmdPipelineBarrier2);
+
+    pools.resize(framesInFlight);
+    cmds.resize(framesInFlight);
+
+    for(uint32 f = 0; f < framesInFlight; f++)
+    {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = computeFamily;
+        VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &pools[f]));
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pools[f];
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &cmds[f]));
+    }
+}
+
+void AsyncCompute::destroy()
+{
+    //the command buffers go with their pools
+    for(size_t f = 0; f < pools.size(); f++)
+    {
+        vkDestroyCommandPool(device, pools[f], nullptr);
+    }
+    pools.clear();
+    cmds.clear();
+}
+
+VkCommandBuffer AsyncCompute::begin(uint32 frame)
+{
+    assert(!recording);
+    this->frame = frame;
+    recording = true;
+    readStages = 0;
+
+    VK_CHECK(vkResetCommandPool(device, pools[frame], 0));
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(cmds[frame], &beginInfo));
+
+    return cmds[frame];
+}
+
+void AsyncCompute::handOff(const ComputeHandoff &handoff)
+{
+    assert(recording);
+    readStages |= handoff.dstStages;
+
+    //within a family the semaphore makes the writes visible to the waiting stages
+    if(!separateFamily()) return;
+
+    //the release only makes the writes available, the acquire makes them visible
+    releases.buffer(handoff.buffer,
+                    handoff.srcStages, handoff.srcAccess,
+                    0, 0,
+                    handoff.offset, handoff.size,
+                    computeFamily, graphicsFamily);
+
+    acquires.buffer(handoff.buffer,
+                    0, 0,
+                    handoff.dstStages, handoff.dstAccess,
+                    handoff.offset, handoff.size,
+                    computeFamily, graphicsFamily);
+}
+
+uint64 AsyncCompute::submit(FrameScheduler &scheduler, const SubmitWait *waits, uint32 waitCount)
+{
+    assert(recording);
+    recording = false;
+
+    releases.flush(cmds[frame]);
+    VK_CHECK(vkEndCommandBuffer(cmds[frame]));
+
+    uint64 value = scheduler.submit(TIMELINE_COMPUTE, cmds[frame], waits, waitCount);
+
+    //without handoffs graphics doesn't say where it reads the results, so it waits for them
+    //before anything
+    graphicsWait.semaphore = scheduler.timelines[TIMELINE_COMPUTE].semaphore;
+    graphicsWait.value = value;
+    graphicsWait.stages = readStages ? (VkPipelineStageFlags)readStages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    return value;
+}
+
+void AsyncCompute::acquire(VkCommandBuffer cmd)
+{
+    acquires.flush(cmd);
+}
+
+bool AsyncCompute::takeGraphicsWait(SubmitWait &wait)
+{
+    if(!graphicsWait.value) return false;
+
+    wait = graphicsWait;
+    graphicsWait = {};
+    return true;
+}
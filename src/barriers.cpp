@@ -0,0 +1,253 @@
+#include "barriers.h"
+#include <assert.h>
+
+static const VkAccessFlags2KHR WRITE_ACCESS = VK_ACCESS_2_SHADER_WRITE_BIT_KHR |
+                                              VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR |
+                                              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR |
+                                              VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR |
+                                              VK_ACCESS_2_HOST_WRITE_BIT_KHR |
+                                              VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+
+static bool sameState(const SubresourceState &a, const SubresourceState &b)
+{
+    return a.layout == b.layout &&
+           a.writeStages == b.writeStages && a.writeAccess == b.writeAccess &&
+           a.readStages == b.readStages &&
+           a.visibleStages == b.visibleStages && a.visibleAccess == b.visibleAccess;
+}
+
+void BarrierBatch::init(PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2)
+{
+    this->cmdPipelineBarrier2 = cmdPipelineBarrier2;
+}
+
+void BarrierBatch::trackImage(VkImage image, VkImageAspectFlags aspect, uint32 mipLevels, uint32 arrayLayers, VkImageLayout layout)
+{
+    TrackedImage tracked;
+    tracked.image = image;
+    tracked.aspect = aspect;
+    tracked.mipLevels = mipLevels;
+    tracked.arrayLayers = arrayLayers;
+    tracked.states.assign(mipLevels * arrayLayers, SubresourceState{layout, 0, 0, 0, 0, 0});
+    images.push_back(tracked);
+}
+
+void BarrierBatch::untrackImage(VkImage image)
+{
+    for(size_t i = 0; i < images.size(); i++)
+    {
+        if(images[i].image == image)
+        {
+            images[i] = images.back();
+            images.pop_back();
+            return;
+        }
+    }
+}
+
+void BarrierBatch::image(VkImage image,
+                         VkImageLayout layout,
+                         VkPipelineStageFlags2KHR stages,
+                         VkAccessFlags2KHR access,
+                         uint32 baseMip, uint32 mipCount,
+                         uint32 baseLayer, uint32 layerCount)
+{
+    TrackedImage *tracked = nullptr;
+    for(size_t i = 0; i < images.size() && !tracked; i++)
+    {
+        if(images[i].image == image) tracked = &images[i];
+    }
+    assert(tracked);
+
+    if(mipCount == VK_REMAINING_MIP_LEVELS) mipCount = tracked->mipLevels - baseMip;
+    if(layerCount == VK_REMAINING_ARRAY_LAYERS) layerCount = tracked->arrayLayers - baseLayer;
+
+    for(uint32 layer = baseLayer; layer < baseLayer + layerCount; layer++)
+    {
+        SubresourceState *states = &tracked->states[layer * tracked->mipLevels];
+
+        uint32 mip = baseMip;
+        while(mip < baseMip + mipCount)
+        {
+            SubresourceState prev = states[mip];
+            SubresourceState next = prev;
+            bool writes = (access & WRITE_ACCESS) != 0;
+            VkPipelineStageFlags2KHR srcStages;
+            bool needed;
+
+            if(writes || prev.layout != layout)
+            {
+                //wait for the last write and every read since, flush the write. A layout
+                //change is a write later accesses have to wait on as well
+                srcStages = prev.writeStages | prev.readStages;
+                needed = srcStages || prev.writeAccess || prev.layout != layout;
+                next = SubresourceState{layout, stages, access & WRITE_ACCESS, writes ? 0 : stages, stages, access};
+            }
+            else
+            {
+                //a read in the same layout only waits if the last write isn't visible to it yet
+                bool visible = !(stages & ~prev.visibleStages) && !(access & ~prev.visibleAccess);
+                srcStages = prev.writeStages;
+                needed = srcStages && !visible;
+                next.readStages |= stages;
+                if(needed)
+                {
+                    next.visibleStages |= stages;
+                    next.visibleAccess |= access;
+                }
+            }
+
+            if(!needed)
+            {
+                states[mip] = next;
+                mip++;
+                continue;
+            }
+
+            //one barrier for the run of mips in the same state
+            uint32 end = mip + 1;
+            while(end < baseMip + mipCount && sameState(states[end], prev)) end++;
+
+            VkImageMemoryBarrier2KHR barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+            barrier.srcStageMask = srcStages;
+            barrier.srcAccessMask = prev.writeAccess;
+            barrier.dstStageMask = stages;
+            barrier.dstAccessMask = access;
+            barrier.oldLayout = prev.layout;
+            barrier.newLayout = layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange.aspectMask = tracked->aspect;
+            barrier.subresourceRange.baseMipLevel = mip;
+            barrier.subresourceRange.levelCount = end - mip;
+            barrier.subresourceRange.baseArrayLayer = layer;
+            barrier.subresourceRange.layerCount = 1;
+            imageBarriers.push_back(barrier);
+
+            for(; mip < end; mip++) states[mip] = next;
+        }
+    }
+}
+
+void BarrierBatch::imageBarrier(const VkImageMemoryBarrier2KHR &barrier)
+{
+    imageBarriers.push_back(barrier);
+    imageBarriers.back().sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+}
+
+void BarrierBatch::buffer(VkBuffer buffer,
+                          VkPipelineStageFlags2KHR srcStages, VkAccessFlags2KHR srcAccess,
+                          VkPipelineStageFlags2KHR dstStages, VkAccessFlags2KHR dstAccess,
+                          VkDeviceSize offset, VkDeviceSize size,
+                          uint32 srcQueueFamily, uint32 dstQueueFamily)
+{
+    VkBufferMemoryBarrier2KHR barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+    barrier.srcStageMask = srcStages;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStages;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = srcQueueFamily;
+    barrier.dstQueueFamilyIndex = dstQueueFamily;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    bufferBarriers.push_back(barrier);
+}
+
+void BarrierBatch::execution(VkPipelineStageFlags2KHR srcStages, VkPipelineStageFlags2KHR dstStages)
+{
+    VkMemoryBarrier2KHR barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+    barrier.srcStageMask = srcStages;
+    barrier.dstStageMask = dstStages;
+    memoryBarriers.push_back(barrier);
+}
+
+void BarrierBatch::flush(VkCommandBuffer cmd)
+{
+    if(empty()) return;
+
+    if(cmdPipelineBarrier2)
+    {
+        VkDependencyInfoKHR dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependencyInfo.memoryBarrierCount = (uint32)memoryBarriers.size();
+        dependencyInfo.pMemoryBarriers = memoryBarriers.data();
+        dependencyInfo.bufferMemoryBarrierCount = (uint32)bufferBarriers.size();
+        dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+        dependencyInfo.imageMemoryBarrierCount = (uint32)imageBarriers.size();
+        dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+
+        cmdPipelineBarrier2(cmd, &dependencyInfo);
+    }
+    else
+    {
+        //one pair of stage masks for everything, the memory barriers only carry stages
+        VkPipelineStageFlags2KHR srcStages = 0;
+        VkPipelineStageFlags2KHR dstStages = 0;
+        legacyBufferBarriers.clear();
+        legacyImageBarriers.clear();
+
+        for(size_t i = 0; i < memoryBarriers.size(); i++)
+        {
+            srcStages |= memoryBarriers[i].srcStageMask;
+            dstStages |= memoryBarriers[i].dstStageMask;
+        }
+
+        for(size_t i = 0; i < bufferBarriers.size(); i++)
+        {
+            const VkBufferMemoryBarrier2KHR &b = bufferBarriers[i];
+            srcStages |= b.srcStageMask;
+            dstStages |= b.dstStageMask;
+
+            VkBufferMemoryBarrier legacy{};
+            legacy.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            legacy.srcAccessMask = (VkAccessFlags)b.srcAccessMask;
+            legacy.dstAccessMask = (VkAccessFlags)b.dstAccessMask;
+            legacy.srcQueueFamilyIndex = b.srcQueueFamilyIndex;
+            legacy.dstQueueFamilyIndex = b.dstQueueFamilyIndex;
+            legacy.buffer = b.buffer;
+            legacy.offset = b.offset;
+            legacy.size = b.size;
+            legacyBufferBarriers.push_back(legacy);
+        }
+
+        for(size_t i = 0; i < imageBarriers.size(); i++)
+        {
+            const VkImageMemoryBarrier2KHR &b = imageBarriers[i];
+            srcStages |= b.srcStageMask;
+            dstStages |= b.dstStageMask;
+
+            VkImageMemoryBarrier legacy{};
+            legacy.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            legacy.srcAccessMask = (VkAccessFlags)b.srcAccessMask;
+            legacy.dstAccessMask = (VkAccessFlags)b.dstAccessMask;
+            legacy.oldLayout = b.oldLayout;
+            legacy.newLayout = b.newLayout;
+            legacy.srcQueueFamilyIndex = b.srcQueueFamilyIndex;
+            legacy.dstQueueFamilyIndex = b.dstQueueFamilyIndex;
+            legacy.image = b.image;
+            legacy.subresourceRange = b.subresourceRange;
+            legacyImageBarriers.push_back(legacy);
+        }
+
+        //no stages is TOP_OF_PIPE as a source and BOTTOM_OF_PIPE as a destination
+        vkCmdPipelineBarrier(cmd,
+                             srcStages ? (VkPipelineStageFlags)srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             dstStages ? (VkPipelineStageFlags)dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             (uint32)legacyBufferBarriers.size(),
+                             legacyBufferBarriers.data(),
+                             (uint32)legacyImageBarriers.size(),
+                             legacyImageBarriers.data());
+    }
+
+    memoryBarriers.clear();
+    bufferBarriers.clear();
+    imageBarriers.clear();
+}
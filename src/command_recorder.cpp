@@ -0,0 +1,155 @@
+#include "command_recorder.h"
+
+void CommandRecorder::init(VulkanManager &vulkanManager, uint32 threadCount)
+{
+    device = vulkanManager.logicalDevice.device;
+    this->threadCount = threadCount;
+
+    //transient: the buffers are re-recorded every frame
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = vulkanManager.physicalDevice.graphicsQueueFamilyIndex;
+
+    for(uint32 f = 0; f < vulkanManager.scheduler.framesInFlight; f++)
+    {
+        pools[f].resize(threadCount);
+        for(uint32 t = 0; t < threadCount; t++)
+        {
+            pools[f][t].usedSecondaries = 0;
+            VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &pools[f][t].pool));
+        }
+
+        //cached buffers live across frames and are reset one by one when re-recorded
+        VkCommandPoolCreateInfo cachePoolInfo = poolInfo;
+        cachePoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+        cachePools[f].resize(threadCount);
+        for(uint32 t = 0; t < threadCount; t++)
+        {
+            VK_CHECK(vkCreateCommandPool(device, &cachePoolInfo, nullptr, &cachePools[f][t]));
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = pools[f][0].pool;
+        allocInfo.commandBufferCount = 1;
+
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &primaries[f]));
+    }
+}
+
+void CommandRecorder::destroy()
+{
+    //destroying a pool frees its command buffers
+    for(uint32 f = 0; f < MAX_FRAMES; f++)
+    {
+        for(size_t t = 0; t < pools[f].size(); t++)
+        {
+            vkDestroyCommandPool(device, pools[f][t].pool, nullptr);
+        }
+        pools[f].clear();
+
+        for(size_t t = 0; t < cachePools[f].size(); t++)
+        {
+            vkDestroyCommandPool(device, cachePools[f][t], nullptr);
+        }
+        cachePools[f].clear();
+        cache[f].clear();
+    }
+}
+
+VkCommandBuffer CommandRecorder::beginFrame(uint32 frame)
+{
+    for(uint32 t = 0; t < threadCount; t++)
+    {
+        VK_CHECK(vkResetCommandPool(device, pools[frame][t].pool, 0));
+        pools[frame][t].usedSecondaries = 0;
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VK_CHECK(vkBeginCommandBuffer(primaries[frame], &beginInfo));
+    return primaries[frame];
+}
+
+VkCommandBuffer CommandRecorder::beginSecondary(uint32 frame, uint32 thread, VkRenderPass renderPass, VkFramebuffer framebuffer)
+{
+    ThreadCommandPool &p = pools[frame][thread];
+
+    if(p.usedSecondaries == p.secondaries.size())
+    {
+        //grows to the most batches a thread has recorded in one frame, then stays there
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = p.pool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer cmd;
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &cmd));
+        p.secondaries.push_back(cmd);
+    }
+
+    VkCommandBuffer cmd = p.secondaries[p.usedSecondaries++];
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = framebuffer;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+    return cmd;
+}
+
+VkCommandBuffer CommandRecorder::beginCachedSecondary(uint32 frame, uint32 batch, VkRenderPass renderPass)
+{
+    CachedBatch &cached = cache[frame][batch];
+
+    if(cached.cmd == VK_NULL_HANDLE)
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = cachePools[frame][batch % threadCount];
+        allocInfo.commandBufferCount = 1;
+
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &cached.cmd));
+    }
+
+    //any framebuffer of the render pass can execute it
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+    //no ONE_TIME_SUBMIT: it is submitted again until its batch changes. Beginning it resets it.
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VK_CHECK(vkBeginCommandBuffer(cached.cmd, &beginInfo));
+    return cached.cmd;
+}
+
+void CommandRecorder::updateStats(uint32 batchCount, uint32 cacheHits, std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    stats.batches = batchCount;
+    stats.cacheHits = cacheHits;
+    stats.recordMs = elapsed.count();
+    stats.totalBatches += batchCount;
+    stats.totalCacheHits += cacheHits;
+}
@@ -0,0 +1,83 @@
+#include "cpu_features.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86
+#endif
+
+#if defined(CPU_X86)
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void cpuid(int leaf, int subleaf, unsigned regs[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex((int *)regs, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features{};
+
+    unsigned regs[4] = {};
+    cpuid(0, 0, regs);
+    unsigned maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    unsigned ecx1 = regs[2];
+
+    features.sse41 = (ecx1 & (1u << 19)) != 0;
+
+    //AVX state must also be enabled by the OS, otherwise the upper register halves are not saved
+    bool osxsave = (ecx1 & (1u << 27)) != 0;
+    unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+    bool osAvx = (xcr0 & 0x6) == 0x6;       //XMM | YMM
+    bool osAvx512 = (xcr0 & 0xE6) == 0xE6;  //XMM | YMM | opmask | ZMM_Hi256 | Hi16_ZMM
+
+    features.avx  = osAvx && (ecx1 & (1u << 28));
+    features.fma  = features.avx && (ecx1 & (1u << 12));
+    features.f16c = features.avx && (ecx1 & (1u << 29));
+
+    if(maxLeaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        unsigned ebx7 = regs[1];
+        features.avx2 = features.avx && (ebx7 & (1u << 5));
+        features.avx512f = osAvx512 && features.avx2 && (ebx7 & (1u << 16));
+    }
+
+    return features;
+}
+
+#else
+
+//none of the x86 extensions exist elsewhere
+static CpuFeatures detectCpuFeatures()
+{
+    return CpuFeatures{};
+}
+
+#endif //CPU_X86
+
+const CpuFeatures &getCpuFeatures()
+{
+    static CpuFeatures features = detectCpuFeatures();
+    return features;
+}
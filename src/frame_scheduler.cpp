@@ -0,0 +1,192 @@
+#include "frame_scheduler.h"
+#include <assert.h>
+
+void FrameScheduler::init(VkDevice device, uint32 framesInFlight)
+{
+    this->device = device;
+    this->framesInFlight = framesInFlight;
+
+    for(uint32 t = 0; t < MAX_TIMELINES; t++)
+    {
+        timelines[t] = {};
+    }
+
+    frameNumber = 0;
+    frame = 0;
+    image = 0;
+    lastSubmission = {};
+
+    frameDone.assign(framesInFlight, TimelinePoint{});
+    acquireSemaphores.resize(framesInFlight);
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for(uint32 f = 0; f < framesInFlight; f++)
+    {
+        VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &acquireSemaphores[f]));
+    }
+}
+
+void FrameScheduler::destroy()
+{
+    waitIdle();
+
+    for(size_t f = 0; f < acquireSemaphores.size(); f++)
+    {
+        vkDestroySemaphore(device, acquireSemaphores[f], nullptr);
+    }
+    acquireSemaphores.clear();
+
+    for(size_t i = 0; i < presentSemaphores.size(); i++)
+    {
+        vkDestroySemaphore(device, presentSemaphores[i], nullptr);
+    }
+    presentSemaphores.clear();
+
+    for(uint32 t = 0; t < MAX_TIMELINES; t++)
+    {
+        if(timelines[t].semaphore) vkDestroySemaphore(device, timelines[t].semaphore, nullptr);
+        timelines[t] = {};
+    }
+}
+
+void FrameScheduler::initTimeline(uint32 index, VkQueue queue)
+{
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    timelines[index].queue = queue;
+    timelines[index].submitted = 0;
+    VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timelines[index].semaphore));
+}
+
+void FrameScheduler::initImages(uint32 imageCount)
+{
+    for(size_t i = 0; i < presentSemaphores.size(); i++)
+    {
+        vkDestroySemaphore(device, presentSemaphores[i], nullptr);
+    }
+
+    imageDone.assign(imageCount, TimelinePoint{});
+    presentSemaphores.resize(imageCount);
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for(uint32 i = 0; i < imageCount; i++)
+    {
+        VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &presentSemaphores[i]));
+    }
+}
+
+uint32 FrameScheduler::beginFrame()
+{
+    frame = (uint32)(frameNumber % framesInFlight);
+    wait(frameDone[frame]);
+    lastSubmission = {};
+    return frame;
+}
+
+void FrameScheduler::imageAcquired(uint32 image)
+{
+    this->image = image;
+    wait(imageDone[image]);
+}
+
+uint64 FrameScheduler::submit(uint32 timeline,
+                              VkCommandBuffer cmd,
+                              const SubmitWait *waits,
+                              uint32 waitCount,
+                              VkSemaphore binarySignal)
+{
+    QueueTimeline &t = timelines[timeline];
+    uint64 value = ++t.submitted;
+
+    VkSemaphore waitSemaphores[MAX_SUBMIT_WAITS];
+    uint64 waitValues[MAX_SUBMIT_WAITS];
+    VkPipelineStageFlags waitStages[MAX_SUBMIT_WAITS];
+    assert(waitCount <= MAX_SUBMIT_WAITS);
+
+    for(uint32 i = 0; i < waitCount; i++)
+    {
+        waitSemaphores[i] = waits[i].semaphore;
+        waitValues[i] = waits[i].value;
+        waitStages[i] = waits[i].stages;
+    }
+
+    VkSemaphore signalSemaphores[2] = {t.semaphore, binarySignal};
+    uint64 signalValues[2] = {value, 0};
+    uint32 signalCount = binarySignal ? 2 : 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = signalCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = cmd ? 1 : 0;
+    submitInfo.pCommandBuffers = &cmd;
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    VK_CHECK(vkQueueSubmit(t.queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    lastSubmission = {timeline, value};
+    return value;
+}
+
+void FrameScheduler::endFrame()
+{
+    frameDone[frame] = lastSubmission;
+    imageDone[image] = lastSubmission;
+    frameNumber++;
+}
+
+void FrameScheduler::wait(TimelinePoint point)
+{
+    if(!point.value) return;
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timelines[point.timeline].semaphore;
+    waitInfo.pValues = &point.value;
+
+    VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+}
+
+void FrameScheduler::waitIdle()
+{
+    for(uint32 t = 0; t < MAX_TIMELINES; t++)
+    {
+        if(timelines[t].semaphore) wait({t, timelines[t].submitted});
+    }
+}
+
+uint32 FrameScheduler::framesPending() const
+{
+    uint32 pending = 0;
+    for(uint32 f = 0; f < framesInFlight; f++)
+    {
+        if(!frameDone[f].value) continue;
+
+        uint64 completed;
+        VK_CHECK(vkGetSemaphoreCounterValue(device, timelines[frameDone[f].timeline].semaphore, &completed));
+        if(completed < frameDone[f].value) pending++;
+    }
+    return pending;
+}
@@ -0,0 +1,412 @@
+#include "frustum.h"
+#include "cpu_features.h"
+
+#ifdef VEC_BACKEND_SSE
+#include <immintrin.h>
+#define BASE_KERNELS_NAME "SSE2"
+#else
+#define BASE_KERNELS_NAME VEC_BACKEND_NAME
+#endif
+
+//Appends base + k for every set bit k of the mask. The store is unconditional and only the
+//counter depends on the mask, so there is no branch to mispredict. Writing past the last
+//visible index is fine: n <= base, so visible[n + lanes - 1] is still inside the output.
+static inline size_t appendVisible(uint32_t *visible, size_t n, size_t base, unsigned mask, unsigned lanes)
+{
+    for(unsigned k = 0; k < lanes; k++)
+    {
+        visible[n] = (uint32_t)(base + k);
+        n += (mask >> k) & 1;
+    }
+    return n;
+}
+
+//=========================== 128-bit (SSE2) ================================
+//4 objects per iteration, one plane at a time. Also what runs on the NEON and scalar backends.
+//The arithmetic is done in the same order as isSphereVisible/isAABBVisible so the results
+//match them exactly.
+
+struct Planes128
+{
+    __m128 nx[6], ny[6], nz[6], d[6];
+    __m128 ax[6], ay[6], az[6]; //|normal|, for the boxes
+};
+
+static inline void broadcastPlanes(const Frustum &f, Planes128 &p)
+{
+    for(int k = 0; k < 6; k++)
+    {
+        __m128 plane = f.planes[k].m;
+        __m128 absPlane = _mm_andnot_ps(vsignbits, plane);
+        p.nx[k] = VSWIZZLE(plane, 0, 0, 0, 0);
+        p.ny[k] = VSWIZZLE(plane, 1, 1, 1, 1);
+        p.nz[k] = VSWIZZLE(plane, 2, 2, 2, 2);
+        p.d[k]  = VSWIZZLE(plane, 3, 3, 3, 3);
+        p.ax[k] = VSWIZZLE(absPlane, 0, 0, 0, 0);
+        p.ay[k] = VSWIZZLE(absPlane, 1, 1, 1, 1);
+        p.az[k] = VSWIZZLE(absPlane, 2, 2, 2, 2);
+    }
+}
+
+//bit k set = object k visible
+static inline unsigned sphereMask128(const Planes128 &p, __m128 x, __m128 y, __m128 z, __m128 r)
+{
+    __m128 nr = _mm_xor_ps(r, vsignbits);
+    __m128 out = _mm_setzero_ps();
+    for(int k = 0; k < 6; k++)
+    {
+        __m128 d = _mm_mul_ps(x, p.nx[k]);
+        d = _mm_add_ps(d, _mm_mul_ps(y, p.ny[k]));
+        d = _mm_add_ps(d, _mm_mul_ps(z, p.nz[k]));
+        d = _mm_add_ps(d, p.d[k]);
+        out = _mm_or_ps(out, _mm_cmplt_ps(d, nr));
+    }
+    return ~_mm_movemask_ps(out) & 0xF;
+}
+
+static inline unsigned boxMask128(const Planes128 &p, __m128 cx, __m128 cy, __m128 cz,
+                                  __m128 ex, __m128 ey, __m128 ez)
+{
+    __m128 out = _mm_setzero_ps();
+    for(int k = 0; k < 6; k++)
+    {
+        __m128 d = _mm_mul_ps(cx, p.nx[k]);
+        d = _mm_add_ps(d, _mm_mul_ps(cy, p.ny[k]));
+        d = _mm_add_ps(d, _mm_mul_ps(cz, p.nz[k]));
+        __m128 r = _mm_mul_ps(ex, p.ax[k]);
+        r = _mm_add_ps(r, _mm_mul_ps(ey, p.ay[k]));
+        r = _mm_add_ps(r, _mm_mul_ps(ez, p.az[k]));
+        d = _mm_add_ps(_mm_add_ps(d, r), p.d[k]);
+        out = _mm_or_ps(out, _mm_cmplt_ps(d, _mm_setzero_ps()));
+    }
+    return ~_mm_movemask_ps(out) & 0xF;
+}
+
+//the leftover objects of the wider kernels, one at a time (lane 0 of a broadcast)
+static size_t cullSpheresTail(const Planes128 &p, const BoundingSpheres &s, size_t i, size_t n, uint32_t *visible)
+{
+    for(; i < s.count; i++)
+    {
+        unsigned mask = sphereMask128(p, _mm_set1_ps(s.x[i]), _mm_set1_ps(s.y[i]),
+                                      _mm_set1_ps(s.z[i]), _mm_set1_ps(s.radius[i]));
+        n = appendVisible(visible, n, i, mask & 1, 1);
+    }
+    return n;
+}
+
+static size_t cullBoxesTail(const Planes128 &p, const BoundingBoxes &b, size_t i, size_t n, uint32_t *visible)
+{
+    for(; i < b.count; i++)
+    {
+        unsigned mask = boxMask128(p, _mm_set1_ps(b.centerX[i]), _mm_set1_ps(b.centerY[i]), _mm_set1_ps(b.centerZ[i]),
+                                   _mm_set1_ps(b.extentX[i]), _mm_set1_ps(b.extentY[i]), _mm_set1_ps(b.extentZ[i]));
+        n = appendVisible(visible, n, i, mask & 1, 1);
+    }
+    return n;
+}
+
+static size_t cullSpheres128(const Frustum &f, const BoundingSpheres &s, uint32_t *visible)
+{
+    Planes128 p;
+    broadcastPlanes(f, p);
+
+    size_t n = 0;
+    size_t i = 0;
+    for(; i + 4 <= s.count; i += 4)
+    {
+        unsigned mask = sphereMask128(p, _mm_loadu_ps(s.x + i), _mm_loadu_ps(s.y + i),
+                                      _mm_loadu_ps(s.z + i), _mm_loadu_ps(s.radius + i));
+        n = appendVisible(visible, n, i, mask, 4);
+    }
+    return cullSpheresTail(p, s, i, n, visible);
+}
+
+static size_t cullBoxes128(const Frustum &f, const BoundingBoxes &b, uint32_t *visible)
+{
+    Planes128 p;
+    broadcastPlanes(f, p);
+
+    size_t n = 0;
+    size_t i = 0;
+    for(; i + 4 <= b.count; i += 4)
+    {
+        unsigned mask = boxMask128(p, _mm_loadu_ps(b.centerX + i), _mm_loadu_ps(b.centerY + i), _mm_loadu_ps(b.centerZ + i),
+                                   _mm_loadu_ps(b.extentX + i), _mm_loadu_ps(b.extentY + i), _mm_loadu_ps(b.extentZ + i));
+        n = appendVisible(visible, n, i, mask, 4);
+    }
+    return cullBoxesTail(p, b, i, n, visible);
+}
+
+#ifdef VEC_BACKEND_SSE
+
+//For every 8 bit mask, the positions of its set bits packed as nibbles (lowest first) and
+//how many there are. Unpacking the nibbles of a mask gives the lane offsets of the visible
+//objects already compacted, so the indices are stored with a single 8-wide write.
+struct CompactTable
+{
+    uint32_t lanes[256];
+    uint8_t count[256];
+
+    CompactTable()
+    {
+        for(uint32_t m = 0; m < 256; m++)
+        {
+            uint32_t packed = 0;
+            uint32_t j = 0;
+            for(uint32_t b = 0; b < 8; b++)
+            {
+                if(m & (1u << b)) packed |= b << (4 * j++);
+            }
+            lanes[m] = packed;
+            count[m] = (uint8_t)j;
+        }
+    }
+};
+
+static const CompactTable compactTable;
+
+//============================== AVX2 + FMA ==================================
+//8 objects per iteration.
+
+struct Planes256
+{
+    __m256 nx[6], ny[6], nz[6], d[6];
+    __m256 ax[6], ay[6], az[6];
+};
+
+TARGET_AVX2_FMA
+static inline void broadcastPlanes(const Frustum &f, Planes256 &p)
+{
+    for(int k = 0; k < 6; k++)
+    {
+        const float *plane = (const float *)&f.planes[k];
+        p.nx[k] = _mm256_set1_ps(plane[0]);
+        p.ny[k] = _mm256_set1_ps(plane[1]);
+        p.nz[k] = _mm256_set1_ps(plane[2]);
+        p.d[k]  = _mm256_set1_ps(plane[3]);
+        p.ax[k] = _mm256_set1_ps(fabsf(plane[0]));
+        p.ay[k] = _mm256_set1_ps(fabsf(plane[1]));
+        p.az[k] = _mm256_set1_ps(fabsf(plane[2]));
+    }
+}
+
+TARGET_AVX2_FMA
+static inline size_t appendVisibleAVX2(uint32_t *visible, size_t n, size_t base, unsigned mask)
+{
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    __m256i lanes = _mm256_srlv_epi32(_mm256_set1_epi32((int)compactTable.lanes[mask]), shifts);
+    lanes = _mm256_and_si256(lanes, _mm256_set1_epi32(7));
+    _mm256_storeu_si256((__m256i *)(visible + n), _mm256_add_epi32(lanes, _mm256_set1_epi32((int)base)));
+    return n + compactTable.count[mask];
+}
+
+TARGET_AVX2_FMA
+static size_t cullSpheresAVX2(const Frustum &f, const BoundingSpheres &s, uint32_t *visible)
+{
+    Planes256 p;
+    broadcastPlanes(f, p);
+
+    size_t n = 0;
+    size_t i = 0;
+    for(; i + 8 <= s.count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(s.x + i);
+        __m256 y = _mm256_loadu_ps(s.y + i);
+        __m256 z = _mm256_loadu_ps(s.z + i);
+        __m256 nr = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(s.radius + i));
+
+        __m256 out = _mm256_setzero_ps();
+        for(int k = 0; k < 6; k++)
+        {
+            __m256 d = _mm256_fmadd_ps(x, p.nx[k], p.d[k]);
+            d = _mm256_fmadd_ps(y, p.ny[k], d);
+            d = _mm256_fmadd_ps(z, p.nz[k], d);
+            out = _mm256_or_ps(out, _mm256_cmp_ps(d, nr, _CMP_LT_OQ));
+        }
+        n = appendVisibleAVX2(visible, n, i, ~_mm256_movemask_ps(out) & 0xFF);
+    }
+
+    Planes128 p128;
+    broadcastPlanes(f, p128);
+    return cullSpheresTail(p128, s, i, n, visible);
+}
+
+TARGET_AVX2_FMA
+static size_t cullBoxesAVX2(const Frustum &f, const BoundingBoxes &b, uint32_t *visible)
+{
+    Planes256 p;
+    broadcastPlanes(f, p);
+
+    size_t n = 0;
+    size_t i = 0;
+    for(; i + 8 <= b.count; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(b.centerX + i);
+        __m256 cy = _mm256_loadu_ps(b.centerY + i);
+        __m256 cz = _mm256_loadu_ps(b.centerZ + i);
+        __m256 ex = _mm256_loadu_ps(b.extentX + i);
+        __m256 ey = _mm256_loadu_ps(b.extentY + i);
+        __m256 ez = _mm256_loadu_ps(b.extentZ + i);
+
+        __m256 out = _mm256_setzero_ps();
+        for(int k = 0; k < 6; k++)
+        {
+            __m256 d = _mm256_fmadd_ps(cx, p.nx[k], p.d[k]);
+            d = _mm256_fmadd_ps(cy, p.ny[k], d);
+            d = _mm256_fmadd_ps(cz, p.nz[k], d);
+            d = _mm256_fmadd_ps(ex, p.ax[k], d);
+            d = _mm256_fmadd_ps(ey, p.ay[k], d);
+            d = _mm256_fmadd_ps(ez, p.az[k], d);
+            out = _mm256_or_ps(out, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        n = appendVisibleAVX2(visible, n, i, ~_mm256_movemask_ps(out) & 0xFF);
+    }
+
+    Planes128 p128;
+    broadcastPlanes(f, p128);
+    return cullBoxesTail(p128, b, i, n, visible);
+}
+
+//================================ AVX-512 ===================================
+//16 objects per iteration, compacted with vpcompressd. The tail is a masked iteration.
+
+struct Planes512
+{
+    __m512 nx[6], ny[6], nz[6], d[6];
+    __m512 ax[6], ay[6], az[6];
+};
+
+TARGET_AVX512
+static inline void broadcastPlanes(const Frustum &f, Planes512 &p)
+{
+    for(int k = 0; k < 6; k++)
+    {
+        const float *plane = (const float *)&f.planes[k];
+        p.nx[k] = _mm512_set1_ps(plane[0]);
+        p.ny[k] = _mm512_set1_ps(plane[1]);
+        p.nz[k] = _mm512_set1_ps(plane[2]);
+        p.d[k]  = _mm512_set1_ps(plane[3]);
+        p.ax[k] = _mm512_set1_ps(fabsf(plane[0]));
+        p.ay[k] = _mm512_set1_ps(fabsf(plane[1]));
+        p.az[k] = _mm512_set1_ps(fabsf(plane[2]));
+    }
+}
+
+TARGET_AVX512
+static inline size_t appendVisibleAVX512(uint32_t *visible, size_t n, size_t base, __mmask16 mask)
+{
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    _mm512_mask_compressstoreu_epi32(visible + n, mask, _mm512_add_epi32(lanes, _mm512_set1_epi32((int)base)));
+    return n + compactTable.count[mask & 0xFF] + compactTable.count[mask >> 8];
+}
+
+TARGET_AVX512
+static size_t cullSpheresAVX512(const Frustum &f, const BoundingSpheres &s, uint32_t *visible)
+{
+    Planes512 p;
+    broadcastPlanes(f, p);
+
+    size_t n = 0;
+    for(size_t i = 0; i < s.count; i += 16)
+    {
+        size_t remaining = (s.count - i) < 16 ? (s.count - i) : 16;
+        __mmask16 valid = (__mmask16)((1u << remaining) - 1);
+
+        __m512 x = _mm512_maskz_loadu_ps(valid, s.x + i);
+        __m512 y = _mm512_maskz_loadu_ps(valid, s.y + i);
+        __m512 z = _mm512_maskz_loadu_ps(valid, s.z + i);
+        __m512 nr = _mm512_sub_ps(_mm512_setzero_ps(), _mm512_maskz_loadu_ps(valid, s.radius + i));
+
+        __mmask16 in = valid;
+        for(int k = 0; k < 6; k++)
+        {
+            __m512 d = _mm512_fmadd_ps(x, p.nx[k], p.d[k]);
+            d = _mm512_fmadd_ps(y, p.ny[k], d);
+            d = _mm512_fmadd_ps(z, p.nz[k], d);
+            in = _mm512_mask_cmp_ps_mask(in, d, nr, _CMP_NLT_UQ);
+        }
+        n = appendVisibleAVX512(visible, n, i, in);
+    }
+    return n;
+}
+
+TARGET_AVX512
+static size_t cullBoxesAVX512(const Frustum &f, const BoundingBoxes &b, uint32_t *visible)
+{
+    Planes512 p;
+    broadcastPlanes(f, p);
+
+    size_t n = 0;
+    for(size_t i = 0; i < b.count; i += 16)
+    {
+        size_t remaining = (b.count - i) < 16 ? (b.count - i) : 16;
+        __mmask16 valid = (__mmask16)((1u << remaining) - 1);
+
+        __m512 cx = _mm512_maskz_loadu_ps(valid, b.centerX + i);
+        __m512 cy = _mm512_maskz_loadu_ps(valid, b.centerY + i);
+        __m512 cz = _mm512_maskz_loadu_ps(valid, b.centerZ + i);
+        __m512 ex = _mm512_maskz_loadu_ps(valid, b.extentX + i);
+        __m512 ey = _mm512_maskz_loadu_ps(valid, b.extentY + i);
+        __m512 ez = _mm512_maskz_loadu_ps(valid, b.extentZ + i);
+
+        __mmask16 in = valid;
+        for(int k = 0; k < 6; k++)
+        {
+            __m512 d = _mm512_fmadd_ps(cx, p.nx[k], p.d[k]);
+            d = _mm512_fmadd_ps(cy, p.ny[k], d);
+            d = _mm512_fmadd_ps(cz, p.nz[k], d);
+            d = _mm512_fmadd_ps(ex, p.ax[k], d);
+            d = _mm512_fmadd_ps(ey, p.ay[k], d);
+            d = _mm512_fmadd_ps(ez, p.az[k], d);
+            in = _mm512_mask_cmp_ps_mask(in, d, _mm512_setzero_ps(), _CMP_NLT_UQ);
+        }
+        n = appendVisibleAVX512(visible, n, i, in);
+    }
+    return n;
+}
+
+#endif //VEC_BACKEND_SSE
+
+//=============================== Dispatch ===================================
+
+struct CullingKernels
+{
+    const char *name;
+    size_t (*cullSpheres)(const Frustum &f, const BoundingSpheres &spheres, uint32_t *visible);
+    size_t (*cullBoxes)(const Frustum &f, const BoundingBoxes &boxes, uint32_t *visible);
+};
+
+static CullingKernels kernels = {BASE_KERNELS_NAME, cullSpheres128, cullBoxes128};
+
+void initCullingKernels()
+{
+#ifdef VEC_BACKEND_SSE
+    const CpuFeatures &cpu = getCpuFeatures();
+    if(cpu.avx512f)
+    {
+        kernels = {"AVX-512", cullSpheresAVX512, cullBoxesAVX512};
+        return;
+    }
+    else if(cpu.avx2 && cpu.fma)
+    {
+        kernels = {"AVX2+FMA", cullSpheresAVX2, cullBoxesAVX2};
+        return;
+    }
+#endif
+    kernels = {BASE_KERNELS_NAME, cullSpheres128, cullBoxes128};
+}
+
+const char *cullingKernelsName()
+{
+    return kernels.name;
+}
+
+size_t cullSpheres(const Frustum &f, const BoundingSpheres &spheres, uint32_t *visible)
+{
+    return kernels.cullSpheres(f, spheres, visible);
+}
+
+size_t cullBoxes(const Frustum &f, const BoundingBoxes &boxes, uint32_t *visible)
+{
+    return kernels.cullBoxes(f, boxes, visible);
+}
@@ -0,0 +1,250 @@
+#include "jobs.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//failed searches for work before a worker goes to sleep
+static const int IDLE_SPINS = 64;
+
+//index of the calling thread in JobSystem::workers
+static thread_local uint32_t workerIndex = 0;
+
+//============================ deque ===============================
+
+static void storeJob(JobDeque::Slot &slot, const Job &job)
+{
+    slot.function.store(job.function, std::memory_order_relaxed);
+    slot.data.store(job.data, std::memory_order_relaxed);
+    slot.begin.store(job.begin, std::memory_order_relaxed);
+    slot.end.store(job.end, std::memory_order_relaxed);
+    slot.chunkSize.store(job.chunkSize, std::memory_order_relaxed);
+    slot.counter.store(job.counter, std::memory_order_relaxed);
+}
+
+static void loadJob(const JobDeque::Slot &slot, Job &job)
+{
+    job.function = slot.function.load(std::memory_order_relaxed);
+    job.data = slot.data.load(std::memory_order_relaxed);
+    job.begin = slot.begin.load(std::memory_order_relaxed);
+    job.end = slot.end.load(std::memory_order_relaxed);
+    job.chunkSize = slot.chunkSize.load(std::memory_order_relaxed);
+    job.counter = slot.counter.load(std::memory_order_relaxed);
+}
+
+bool JobDeque::push(const Job &job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if(b - t >= CAPACITY) return false;
+
+    storeJob(slots[b & (CAPACITY - 1)], job);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool JobDeque::pop(Job &job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if(t > b)
+    {
+        //empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    loadJob(slots[b & (CAPACITY - 1)], job);
+    if(t == b)
+    {
+        //last job: race the thieves for it
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool JobDeque::steal(Job &job)
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if(t >= b) return false;
+
+    loadJob(slots[t & (CAPACITY - 1)], job);
+
+    //fails when another thief or the owner took it first
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+//============================ job system ===============================
+
+static void pinThread(std::thread &thread, uint32_t core)
+{
+#if defined(_WIN32)
+    SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << core);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+    (void)thread; (void)core;
+#endif
+}
+
+void JobSystem::startUp(uint32_t threadCount)
+{
+    uint32_t cores = std::thread::hardware_concurrency();
+    if(cores == 0) cores = 1;
+    if(threadCount == 0) threadCount = cores;
+
+    quit = false;
+    workerIndex = 0;
+
+    for(uint32_t i = 0; i < threadCount; i++)
+    {
+        JobWorker *worker = new JobWorker;
+        worker->rngState = 0x9E3779B9u * (i + 1);
+        workers.push_back(worker);
+    }
+
+    //the calling thread stays where the OS puts it: it also pumps the window messages
+    for(uint32_t i = 1; i < threadCount; i++)
+    {
+        workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+        if(threadCount <= cores) pinThread(workers[i]->thread, i);
+    }
+}
+
+void JobSystem::shutDown()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        quit = true;
+    }
+    wakeUp.notify_all();
+
+    for(size_t i = 1; i < workers.size(); i++) workers[i]->thread.join();
+    for(size_t i = 0; i < workers.size(); i++) delete workers[i];
+    workers.clear();
+}
+
+uint32_t JobSystem::currentThread() const
+{
+    return workerIndex;
+}
+
+void JobSystem::run(JobFunction function, void *data, JobCounter &counter)
+{
+    push(function, data, 0, 0, 0, counter);
+}
+
+void JobSystem::push(JobFunction function, void *data, size_t begin, size_t end, size_t chunkSize, JobCounter &counter)
+{
+    Job job = {function, data, begin, end, chunkSize, &counter};
+
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+    //counted before it can be stolen, so queuedJobs never goes below zero
+    queuedJobs.fetch_add(1);
+    if(!workers[workerIndex]->deque.push(job))
+    {
+        queuedJobs.fetch_sub(1);
+        execute(job); //deque full: nobody will be short of work for a while
+        return;
+    }
+
+    if(sleepingWorkers.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeUp.notify_one();
+    }
+}
+
+void JobSystem::execute(Job job)
+{
+    //lazy splitting: hand out the upper half until the range is small enough
+    while(job.chunkSize && job.end - job.begin > job.chunkSize)
+    {
+        size_t mid = job.begin + (job.end - job.begin) / 2;
+        push(job.function, job.data, mid, job.end, job.chunkSize, *job.counter);
+        job.end = mid;
+    }
+
+    job.function(job.data, job.begin, job.end);
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+bool JobSystem::findJob(uint32_t self, Job &job)
+{
+    bool found = workers[self]->deque.pop(job);
+
+    if(!found)
+    {
+        //steal, starting from a random victim so thieves spread out
+        uint32_t count = (uint32_t)workers.size();
+        uint32_t &rng = workers[self]->rngState;
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+
+        for(uint32_t i = 0; i < count && !found; i++)
+        {
+            uint32_t victim = (rng + i) % count;
+            if(victim != self) found = workers[victim]->deque.steal(job);
+        }
+    }
+
+    if(found) queuedJobs.fetch_sub(1);
+    return found;
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+    uint32_t self = workerIndex;
+    while(counter.pending.load(std::memory_order_acquire) != 0)
+    {
+        Job job;
+        if(findJob(self, job)) execute(job);
+        else                   std::this_thread::yield();
+    }
+}
+
+void JobSystem::workerLoop(uint32_t self)
+{
+    workerIndex = self;
+    int idle = 0;
+
+    while(!quit.load(std::memory_order_relaxed))
+    {
+        Job job;
+        if(findJob(self, job))
+        {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+
+        if(++idle < IDLE_SPINS)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        //sleepingWorkers is raised before checking for work under the lock, so a push either
+        //sees it and notifies, or the check sees the pushed job
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        wakeUp.wait(lock, [this]() { return queuedJobs.load() > 0 || quit.load(); });
+        sleepingWorkers.fetch_sub(1);
+        idle = 0;
+    }
+}
@@ -0,0 +1,321 @@
+#include "matrix_kernels.h"
+#include "cpu_features.h"
+
+#ifdef VEC_BACKEND_SSE
+#include <immintrin.h>
+#define BASE_KERNELS_NAME "SSE2"
+#else
+#define BASE_KERNELS_NAME VEC_BACKEND_NAME
+#endif
+
+static_assert(sizeof(mat4) == 16 * sizeof(float), "mat4 must be 4 tightly packed rows");
+
+//=========================== 128-bit (SSE2) ================================
+//Also what runs on the NEON and scalar backends.
+
+static void transformPoints128(const vec4 *in, vec4 *out, size_t count, mat4 m)
+{
+    __m128 r0 = m.row[0].m;
+    __m128 r1 = m.row[1].m;
+    __m128 r2 = m.row[2].m;
+    __m128 r3 = m.row[3].m;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        __m128 v = in[i].m;
+        __m128 r = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), r3));
+        out[i].m = r;
+    }
+}
+
+static void composeMatrices128(const mat4 *local, const mat4 *parent, mat4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        out[i] = local[i] * parent[i];
+    }
+}
+
+static void composeMatricesIndexed128(const mat4 *local, const mat4 *world, const uint32_t *parentIndex, mat4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        out[i] = local[i] * world[parentIndex[i]];
+    }
+}
+
+#ifdef VEC_BACKEND_SSE
+
+//============================== AVX2 + FMA ==================================
+//Two rows per ymm register. vpermilps broadcasts a component inside each 128-bit lane,
+//and the matrix rows are duplicated into both lanes, so each lane does one row-vector * mat4.
+
+TARGET_AVX2_FMA
+static inline __m256 transform2AVX2(__m256 v, __m256 r0, __m256 r1, __m256 r2, __m256 r3)
+{
+    __m256 r = _mm256_mul_ps(_mm256_permute_ps(v, 0x00), r0);
+    r = _mm256_fmadd_ps(_mm256_permute_ps(v, 0x55), r1, r);
+    r = _mm256_fmadd_ps(_mm256_permute_ps(v, 0xAA), r2, r);
+    r = _mm256_fmadd_ps(_mm256_permute_ps(v, 0xFF), r3, r);
+    return r;
+}
+
+TARGET_AVX2_FMA
+static void transformPointsAVX2(const vec4 *in, vec4 *out, size_t count, mat4 m)
+{
+    const float *src = (const float *)in;
+    float *dst = (float *)out;
+
+    __m256 r0 = _mm256_broadcast_ps(&m.row[0].m);
+    __m256 r1 = _mm256_broadcast_ps(&m.row[1].m);
+    __m256 r2 = _mm256_broadcast_ps(&m.row[2].m);
+    __m256 r3 = _mm256_broadcast_ps(&m.row[3].m);
+
+    size_t i = 0;
+    //4 points per iteration so two independent FMA chains are in flight
+    for(; i + 4 <= count; i += 4)
+    {
+        __m256 a = _mm256_loadu_ps(src + i * 4);
+        __m256 b = _mm256_loadu_ps(src + i * 4 + 8);
+        a = transform2AVX2(a, r0, r1, r2, r3);
+        b = transform2AVX2(b, r0, r1, r2, r3);
+        _mm256_storeu_ps(dst + i * 4, a);
+        _mm256_storeu_ps(dst + i * 4 + 8, b);
+    }
+
+    for(; i < count; i++)
+    {
+        __m128 v = in[i].m;
+        __m128 r = _mm_mul_ps(_mm_permute_ps(v, 0x00), m.row[0].m);
+        r = _mm_fmadd_ps(_mm_permute_ps(v, 0x55), m.row[1].m, r);
+        r = _mm_fmadd_ps(_mm_permute_ps(v, 0xAA), m.row[2].m, r);
+        r = _mm_fmadd_ps(_mm_permute_ps(v, 0xFF), m.row[3].m, r);
+        out[i].m = r;
+    }
+}
+
+TARGET_AVX2_FMA
+static void composeMatricesAVX2(const mat4 *local, const mat4 *parent, mat4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        __m256 p0 = _mm256_broadcast_ps(&parent[i].row[0].m);
+        __m256 p1 = _mm256_broadcast_ps(&parent[i].row[1].m);
+        __m256 p2 = _mm256_broadcast_ps(&parent[i].row[2].m);
+        __m256 p3 = _mm256_broadcast_ps(&parent[i].row[3].m);
+
+        const float *l = (const float *)&local[i];
+        __m256 lo = _mm256_loadu_ps(l);
+        __m256 hi = _mm256_loadu_ps(l + 8);
+        lo = transform2AVX2(lo, p0, p1, p2, p3);
+        hi = transform2AVX2(hi, p0, p1, p2, p3);
+
+        float *o = (float *)&out[i];
+        _mm256_storeu_ps(o, lo);
+        _mm256_storeu_ps(o + 8, hi);
+    }
+}
+
+TARGET_AVX2_FMA
+static void composeMatricesIndexedAVX2(const mat4 *local, const mat4 *world, const uint32_t *parentIndex, mat4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        const mat4 &parent = world[parentIndex[i]];
+        __m256 p0 = _mm256_broadcast_ps(&parent.row[0].m);
+        __m256 p1 = _mm256_broadcast_ps(&parent.row[1].m);
+        __m256 p2 = _mm256_broadcast_ps(&parent.row[2].m);
+        __m256 p3 = _mm256_broadcast_ps(&parent.row[3].m);
+
+        const float *l = (const float *)&local[i];
+        __m256 lo = _mm256_loadu_ps(l);
+        __m256 hi = _mm256_loadu_ps(l + 8);
+        lo = transform2AVX2(lo, p0, p1, p2, p3);
+        hi = transform2AVX2(hi, p0, p1, p2, p3);
+
+        float *o = (float *)&out[i];
+        _mm256_storeu_ps(o, lo);
+        _mm256_storeu_ps(o + 8, hi);
+    }
+}
+
+//================================ AVX-512 ===================================
+//Same scheme as AVX2 with four rows (a whole mat4) per zmm register.
+
+TARGET_AVX512
+static inline __m512 transform4AVX512(__m512 v, __m512 r0, __m512 r1, __m512 r2, __m512 r3)
+{
+    __m512 r = _mm512_mul_ps(_mm512_permute_ps(v, 0x00), r0);
+    r = _mm512_fmadd_ps(_mm512_permute_ps(v, 0x55), r1, r);
+    r = _mm512_fmadd_ps(_mm512_permute_ps(v, 0xAA), r2, r);
+    r = _mm512_fmadd_ps(_mm512_permute_ps(v, 0xFF), r3, r);
+    return r;
+}
+
+TARGET_AVX512
+static void transformPointsAVX512(const vec4 *in, vec4 *out, size_t count, mat4 m)
+{
+    const float *src = (const float *)in;
+    float *dst = (float *)out;
+
+    __m512 r0 = _mm512_broadcast_f32x4(m.row[0].m);
+    __m512 r1 = _mm512_broadcast_f32x4(m.row[1].m);
+    __m512 r2 = _mm512_broadcast_f32x4(m.row[2].m);
+    __m512 r3 = _mm512_broadcast_f32x4(m.row[3].m);
+
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m512 a = _mm512_loadu_ps(src + i * 4);
+        __m512 b = _mm512_loadu_ps(src + i * 4 + 16);
+        a = transform4AVX512(a, r0, r1, r2, r3);
+        b = transform4AVX512(b, r0, r1, r2, r3);
+        _mm512_storeu_ps(dst + i * 4, a);
+        _mm512_storeu_ps(dst + i * 4 + 16, b);
+    }
+
+    for(; i < count; i += 4)
+    {
+        //masked tail: up to 4 points, 4 floats each
+        size_t remaining = (count - i) < 4 ? (count - i) : 4;
+        __mmask16 k = (__mmask16)((1u << (remaining * 4)) - 1);
+        __m512 v = _mm512_maskz_loadu_ps(k, src + i * 4);
+        v = transform4AVX512(v, r0, r1, r2, r3);
+        _mm512_mask_storeu_ps(dst + i * 4, k, v);
+    }
+}
+
+TARGET_AVX512
+static void composeMatricesAVX512(const mat4 *local, const mat4 *parent, mat4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        __m512 p0 = _mm512_broadcast_f32x4(parent[i].row[0].m);
+        __m512 p1 = _mm512_broadcast_f32x4(parent[i].row[1].m);
+        __m512 p2 = _mm512_broadcast_f32x4(parent[i].row[2].m);
+        __m512 p3 = _mm512_broadcast_f32x4(parent[i].row[3].m);
+
+        __m512 l = _mm512_loadu_ps((const float *)&local[i]);
+        _mm512_storeu_ps((float *)&out[i], transform4AVX512(l, p0, p1, p2, p3));
+    }
+}
+
+TARGET_AVX512
+static void composeMatricesIndexedAVX512(const mat4 *local, const mat4 *world, const uint32_t *parentIndex, mat4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        const mat4 &parent = world[parentIndex[i]];
+        __m512 p0 = _mm512_broadcast_f32x4(parent.row[0].m);
+        __m512 p1 = _mm512_broadcast_f32x4(parent.row[1].m);
+        __m512 p2 = _mm512_broadcast_f32x4(parent.row[2].m);
+        __m512 p3 = _mm512_broadcast_f32x4(parent.row[3].m);
+
+        __m512 l = _mm512_loadu_ps((const float *)&local[i]);
+        _mm512_storeu_ps((float *)&out[i], transform4AVX512(l, p0, p1, p2, p3));
+    }
+}
+
+#endif //VEC_BACKEND_SSE
+
+//=============================== Dispatch ===================================
+
+struct MatrixKernels
+{
+    const char *name;
+    void (*transformPoints)(const vec4 *in, vec4 *out, size_t count, mat4 m);
+    void (*composeMatrices)(const mat4 *local, const mat4 *parent, mat4 *out, size_t count);
+    void (*composeMatricesIndexed)(const mat4 *local, const mat4 *world, const uint32_t *parentIndex, mat4 *out, size_t count);
+};
+
+static MatrixKernels kernels = {BASE_KERNELS_NAME, transformPoints128, composeMatrices128, composeMatricesIndexed128};
+
+void initMatrixKernels()
+{
+#ifdef VEC_BACKEND_SSE
+    const CpuFeatures &cpu = getCpuFeatures();
+
+    if(cpu.avx512f)
+    {
+        kernels = {"AVX-512", transformPointsAVX512, composeMatricesAVX512, composeMatricesIndexedAVX512};
+        return;
+    }
+    else if(cpu.avx2 && cpu.fma)
+    {
+        kernels = {"AVX2+FMA", transformPointsAVX2, composeMatricesAVX2, composeMatricesIndexedAVX2};
+        return;
+    }
+#endif
+
+    kernels = {BASE_KERNELS_NAME, transformPoints128, composeMatrices128, composeMatricesIndexed128};
+}
+
+const char *matrixKernelsName()
+{
+    return kernels.name;
+}
+
+void transformPoints(const vec4 *in, vec4 *out, size_t count, mat4 m)
+{
+    kernels.transformPoints(in, out, count, m);
+}
+
+void multiplyMatrices(const mat4 *in, mat4 *out, size_t count, mat4 m)
+{
+    //every row of a mat4 * m is just a row-vector transform
+    kernels.transformPoints((const vec4 *)in, (vec4 *)out, count * 4, m);
+}
+
+void composeMatrices(const mat4 *local, const mat4 *parent, mat4 *out, size_t count)
+{
+    kernels.composeMatrices(local, parent, out, count);
+}
+
+void composeMatricesIndexed(const mat4 *local, const mat4 *world, const uint32_t *parentIndex, mat4 *out, size_t count)
+{
+    kernels.composeMatricesIndexed(local, world, parentIndex, out, count);
+}
+
+void invertMatrices(const mat4 *in, mat4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        out[i] = inverse(in[i]);
+    }
+}
+
+void invertAffineMatrices(const mat4 *in, mat4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        out[i] = inverseAffine(in[i]);
+    }
+}
+
+void normalMatrices(const mat4 *in, mat4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        out[i] = normalMatrix(in[i]);
+    }
+}
+
+void slerpQuats(const quatx4 *a, const quatx4 *b, const vec4 *t, quatx4 *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        out[i] = slerp(a[i], b[i], t[i]);
+    }
+}
+
+void nlerpQuats(const quatx4 *a, const quatx4 *b, float t, quatx4 *out, size_t count)
+{
+    vec4 tv(_mm_set1_ps(t));
+    for(size_t i = 0; i < count; i++)
+    {
+        out[i] = nlerp(a[i], b[i], tv);
+    }
+}
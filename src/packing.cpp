@@ -0,0 +1,342 @@
+#include "packing.h"
+#include "cpu_features.h"
+
+#ifdef VEC_BACKEND_SSE
+#include <immintrin.h>
+#define BASE_KERNELS_NAME "SSE2"
+#else
+#define BASE_KERNELS_NAME VEC_BACKEND_NAME
+#endif
+
+#ifdef VEC_BACKEND_SSE
+
+//=========================== Streaming stores ================================
+//Plain stores until the output is 16-byte aligned, a non-temporal store per 16 bytes after
+//that, plain stores for the rest. block(in + i, out + i) converts and streams 16 bytes of
+//output, scalar(in[i]) converts one element.
+
+FORCE_INLINE void streamStore(void *p, __m128i v) { _mm_stream_si128((__m128i *)p, v); }
+FORCE_INLINE void streamStore(void *p, __m128 v) { _mm_stream_ps((float *)p, v); }
+
+template<typename In, typename Out, typename Block, typename Scalar>
+static inline void streamConvert(const In *in, Out *out, size_t count, Block block, Scalar scalar)
+{
+    const size_t perBlock = 16 / sizeof(Out);
+    size_t i = 0;
+
+    for(; i < count && ((uintptr_t)(out + i) & 15) != 0; i++) out[i] = scalar(in[i]);
+    for(; i + perBlock <= count; i += perBlock) streamStore(out + i, block(in + i));
+    for(; i < count; i++) out[i] = scalar(in[i]);
+
+    //make the streamed data visible before the caller hands the memory to the GPU
+    _mm_sfence();
+}
+
+//================================ SSE2 ======================================
+
+//float -> half for 4 lanes, result in the low 16 bits of each 32-bit lane (F. Giesen's
+//float_to_half_fast3 with the NaN payload kept the way F16C does).
+static inline __m128i floatToHalf4(__m128 f)
+{
+    const __m128i signMask = _mm_set1_epi32((int)0x80000000);
+    const __m128i f16max = _mm_set1_epi32((127 + 16) << 23);       //>= rounds to inf
+    const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);    //smallest float that gives a normal half
+    const __m128i subnormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normalBias = _mm_set1_epi32(0xFFF - ((127 - 15) << 23));
+
+    __m128 justSign = _mm_and_ps(_mm_castsi128_ps(signMask), f);
+    __m128 absf = _mm_xor_ps(f, justSign);
+    __m128i absi = _mm_castps_si128(absf);
+
+    //inf / NaN: quiet bit and the top of the payload
+    __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absf, absf));
+    __m128i payload = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(absi, 13), _mm_set1_epi32(0x3FF)), _mm_set1_epi32(0x200));
+    __m128i infOrNan = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(isNan, payload));
+    __m128i isRegular = _mm_cmpgt_epi32(f16max, absi);
+
+    //subnormal result: the float add does the shift and the rounding
+    __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absi);
+    __m128 sub1 = _mm_add_ps(absf, _mm_castsi128_ps(subnormMagic));
+    __m128i sub2 = _mm_sub_epi32(_mm_castps_si128(sub1), subnormMagic);
+
+    //normal result: rebias, round to nearest even
+    __m128i mantOdd = _mm_srai_epi32(_mm_slli_epi32(absi, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absi, normalBias), mantOdd), 13);
+
+    __m128i nonSpecial = _mm_or_si128(_mm_and_si128(sub2, isSubnormal), _mm_andnot_si128(isSubnormal, normal));
+    __m128i joined = _mm_or_si128(_mm_and_si128(nonSpecial, isRegular), _mm_andnot_si128(isRegular, infOrNan));
+    return _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(justSign), 16));
+}
+
+//half -> float for 4 lanes with the half in the low 16 bits
+static inline __m128 halfToFloat4(__m128i h)
+{
+    const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+    const __m128 infNanExp = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+    __m128i expMant = _mm_and_si128(h, _mm_set1_epi32(0x7FFF));
+    __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, expMant), 16);
+
+    //scaling by 2^112 rebiases normals and normalizes subnormals in one multiply
+    __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)), magic);
+
+    //inf / NaN: force the exponent to all ones (the shift already moved the payload), and
+    //set the quiet bit of NaNs like F16C does
+    __m128i wasInfNan = _mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7BFF));
+    __m128i wasNan = _mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7C00));
+    __m128 special = _mm_and_ps(_mm_castsi128_ps(wasInfNan), infNanExp);
+    special = _mm_or_ps(special, _mm_and_ps(_mm_castsi128_ps(wasNan), _mm_castsi128_ps(_mm_set1_epi32(0x400000))));
+    return _mm_or_ps(scaled, _mm_or_ps(_mm_castsi128_ps(sign), special));
+}
+
+static void floatToHalfSSE2(const float *in, uint16_t *out, size_t count)
+{
+    streamConvert(in, out, count, [](const float *p)
+    {
+        __m128i lo = floatToHalf4(_mm_loadu_ps(p));
+        __m128i hi = floatToHalf4(_mm_loadu_ps(p + 4));
+        //the halves are sign extended to 32 bits, so the signed saturating pack keeps them
+        return _mm_packs_epi32(lo, hi);
+    }, [](float f) { return floatToHalf(f); });
+}
+
+static void halfToFloatSSE2(const uint16_t *in, float *out, size_t count)
+{
+    streamConvert(in, out, count, [](const uint16_t *p)
+    {
+        __m128i h = _mm_loadl_epi64((const __m128i *)p);
+        return halfToFloat4(_mm_unpacklo_epi16(h, _mm_setzero_si128()));
+    }, [](uint16_t h) { return halfToFloat(h); });
+}
+
+//quantizeNorm for 4 lanes: NaN -> 0, clamp, scale, round to nearest
+static inline __m128i quantize4(__m128 v, __m128 lo, __m128 hi, __m128 scale)
+{
+    v = _mm_and_ps(v, _mm_cmpord_ps(v, v));
+    v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+    return _mm_cvtps_epi32(_mm_mul_ps(v, scale));
+}
+
+static inline __m128i quantize4(const float *p, __m128 lo, __m128 hi, __m128 scale)
+{
+    return quantize4(_mm_loadu_ps(p), lo, hi, scale);
+}
+
+void packUnorm8(const float *in, uint8_t *out, size_t count)
+{
+    streamConvert(in, out, count, [](const float *p)
+    {
+        const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f);
+        __m128i a = _mm_packs_epi32(quantize4(p, lo, hi, scale), quantize4(p + 4, lo, hi, scale));
+        __m128i b = _mm_packs_epi32(quantize4(p + 8, lo, hi, scale), quantize4(p + 12, lo, hi, scale));
+        return _mm_packus_epi16(a, b);
+    }, [](float f) { return packUnorm8(f); });
+}
+
+void packSnorm8(const float *in, int8_t *out, size_t count)
+{
+    streamConvert(in, out, count, [](const float *p)
+    {
+        const __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f), scale = _mm_set1_ps(127.0f);
+        __m128i a = _mm_packs_epi32(quantize4(p, lo, hi, scale), quantize4(p + 4, lo, hi, scale));
+        __m128i b = _mm_packs_epi32(quantize4(p + 8, lo, hi, scale), quantize4(p + 12, lo, hi, scale));
+        return _mm_packs_epi16(a, b);
+    }, [](float f) { return packSnorm8(f); });
+}
+
+void packUnorm16(const float *in, uint16_t *out, size_t count)
+{
+    streamConvert(in, out, count, [](const float *p)
+    {
+        //SSE2 has no unsigned 32 -> 16 pack (packus_epi32 is SSE4.1): shift into the
+        //signed range, pack, and flip the top bit back
+        const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(1.0f), scale = _mm_set1_ps(65535.0f);
+        const __m128i bias = _mm_set1_epi32(32768);
+        __m128i a = _mm_sub_epi32(quantize4(p, lo, hi, scale), bias);
+        __m128i b = _mm_sub_epi32(quantize4(p + 4, lo, hi, scale), bias);
+        return _mm_xor_si128(_mm_packs_epi32(a, b), _mm_set1_epi16((short)0x8000));
+    }, [](float f) { return packUnorm16(f); });
+}
+
+void packSnorm16(const float *in, int16_t *out, size_t count)
+{
+    streamConvert(in, out, count, [](const float *p)
+    {
+        const __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f), scale = _mm_set1_ps(32767.0f);
+        return _mm_packs_epi32(quantize4(p, lo, hi, scale), quantize4(p + 4, lo, hi, scale));
+    }, [](float f) { return packSnorm16(f); });
+}
+
+//4 vec4s per block, transposed so each register holds one component of all four
+static inline __m128i pack1010102x4(const vec4 *p, __m128 lo, __m128 hi, __m128 scaleXYZ, __m128 scaleW)
+{
+    __m128 x = p[0].m, y = p[1].m, z = p[2].m, w = p[3].m;
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+
+    const __m128i mask10 = _mm_set1_epi32(0x3FF);
+    __m128i qx = _mm_and_si128(quantize4(x, lo, hi, scaleXYZ), mask10);
+    __m128i qy = _mm_and_si128(quantize4(y, lo, hi, scaleXYZ), mask10);
+    __m128i qz = _mm_and_si128(quantize4(z, lo, hi, scaleXYZ), mask10);
+    __m128i qw = quantize4(w, lo, hi, scaleW);
+
+    __m128i r = _mm_or_si128(qx, _mm_slli_epi32(qy, 10));
+    r = _mm_or_si128(r, _mm_slli_epi32(qz, 20));
+    return _mm_or_si128(r, _mm_slli_epi32(qw, 30));
+}
+
+void packUnorm1010102(const vec4 *in, uint32_t *out, size_t count)
+{
+    streamConvert(in, out, count, [](const vec4 *p)
+    {
+        return pack1010102x4(p, _mm_setzero_ps(), _mm_set1_ps(1.0f), _mm_set1_ps(1023.0f), _mm_set1_ps(3.0f));
+    }, [](vec4 v) { return packUnorm1010102(v); });
+}
+
+void packSnorm1010102(const vec4 *in, uint32_t *out, size_t count)
+{
+    streamConvert(in, out, count, [](const vec4 *p)
+    {
+        return pack1010102x4(p, _mm_set1_ps(-1.0f), _mm_set1_ps(1.0f), _mm_set1_ps(511.0f), _mm_set1_ps(1.0f));
+    }, [](vec4 v) { return packSnorm1010102(v); });
+}
+
+void streamCopy(void *dst, const void *src, size_t size)
+{
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+
+    size_t i = (16 - ((uintptr_t)d & 15)) & 15;
+    if(i > size) i = size;
+    memcpy(d, s, i);
+    for(; i + 16 <= size; i += 16) _mm_stream_si128((__m128i *)(d + i), _mm_loadu_si128((const __m128i *)(s + i)));
+    memcpy(d + i, s + i, size - i);
+    _mm_sfence();
+}
+
+//================================= F16C =====================================
+//Hardware conversion, 8 values per instruction.
+
+TARGET_F16C
+static void floatToHalfF16C(const float *in, uint16_t *out, size_t count)
+{
+    size_t i = 0;
+    for(; i < count && ((uintptr_t)(out + i) & 15) != 0; i++) out[i] = floatToHalf(in[i]);
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_stream_si128((__m128i *)(out + i), h);
+    }
+    for(; i < count; i++) out[i] = floatToHalf(in[i]);
+    _mm_sfence();
+}
+
+TARGET_F16C
+static void halfToFloatF16C(const uint16_t *in, float *out, size_t count)
+{
+    size_t i = 0;
+    for(; i < count && ((uintptr_t)(out + i) & 15) != 0; i++) out[i] = halfToFloat(in[i]);
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 f = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(in + i)));
+        _mm_stream_ps(out + i, _mm256_castps256_ps128(f));
+        _mm_stream_ps(out + i + 4, _mm256_extractf128_ps(f, 1));
+    }
+    for(; i < count; i++) out[i] = halfToFloat(in[i]);
+    _mm_sfence();
+}
+
+#else //!VEC_BACKEND_SSE
+
+//========================= Other backends (scalar) ===========================
+//Plain loops over the single value functions, the compiler vectorizes what it can.
+
+static void floatToHalfScalar(const float *in, uint16_t *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++) out[i] = floatToHalf(in[i]);
+}
+
+static void halfToFloatScalar(const uint16_t *in, float *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++) out[i] = halfToFloat(in[i]);
+}
+
+void packUnorm8(const float *in, uint8_t *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++) out[i] = packUnorm8(in[i]);
+}
+
+void packSnorm8(const float *in, int8_t *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++) out[i] = packSnorm8(in[i]);
+}
+
+void packUnorm16(const float *in, uint16_t *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++) out[i] = packUnorm16(in[i]);
+}
+
+void packSnorm16(const float *in, int16_t *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++) out[i] = packSnorm16(in[i]);
+}
+
+void packUnorm1010102(const vec4 *in, uint32_t *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++) out[i] = packUnorm1010102(in[i]);
+}
+
+void packSnorm1010102(const vec4 *in, uint32_t *out, size_t count)
+{
+    for(size_t i = 0; i < count; i++) out[i] = packSnorm1010102(in[i]);
+}
+
+void streamCopy(void *dst, const void *src, size_t size)
+{
+    memcpy(dst, src, size);
+}
+
+#endif //VEC_BACKEND_SSE
+
+//=============================== Dispatch ===================================
+
+struct PackingKernels
+{
+    const char *name;
+    void (*floatToHalf)(const float *in, uint16_t *out, size_t count);
+    void (*halfToFloat)(const uint16_t *in, float *out, size_t count);
+};
+
+#ifdef VEC_BACKEND_SSE
+static const PackingKernels baseKernels = {BASE_KERNELS_NAME, floatToHalfSSE2, halfToFloatSSE2};
+#else
+static const PackingKernels baseKernels = {BASE_KERNELS_NAME, floatToHalfScalar, halfToFloatScalar};
+#endif
+
+static PackingKernels kernels = baseKernels;
+
+void initPackingKernels()
+{
+#ifdef VEC_BACKEND_SSE
+    if(getCpuFeatures().f16c)
+    {
+        kernels = {"F16C", floatToHalfF16C, halfToFloatF16C};
+        return;
+    }
+#endif
+    kernels = baseKernels;
+}
+
+const char *packingKernelsName()
+{
+    return kernels.name;
+}
+
+void floatToHalf(const float *in, uint16_t *out, size_t count)
+{
+    kernels.floatToHalf(in, out, count);
+}
+
+void halfToFloat(const uint16_t *in, float *out, size_t count)
+{
+    kernels.halfToFloat(in, out, count);
+}
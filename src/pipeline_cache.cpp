@@ -0,0 +1,187 @@
+#include "pipeline_cache.h"
+#include "platform.h"
+#include <string.h>
+#include <assert.h>
+#include <fstream>
+#include <vector>
+
+bool writeFileAtomic(const std::string &filepath, const void *data, size_t size)
+{
+    std::string tempPath = filepath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write((const char *)data, size);
+        file.close();
+
+        if(!file)
+        {
+            LOGW("Unable to write {}", tempPath);
+            DeleteFileA(tempPath.c_str());
+            return false;
+        }
+    }
+
+    //replaces the old file in one step, readers see either the old or the new one
+    if(!MoveFileExA(tempPath.c_str(), filepath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        LOGW("Unable to replace {}, error {}", filepath, (uint32)GetLastError());
+        DeleteFileA(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool pipelineCacheMatches(const uint8 *data, size_t size, const VkPhysicalDeviceProperties &properties)
+{
+    VkPipelineCacheHeaderVersionOne header;
+    if(size < sizeof(header)) return false;
+
+    //the file's bytes may not be aligned for the header's fields
+    memcpy(&header, data, sizeof(header));
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerSize <= size &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties &properties, const std::string &filepath,
+                         bool creationFeedback)
+{
+    this->device = device;
+    this->filepath = filepath;
+    this->creationFeedback = creationFeedback;
+
+    loaded = false;
+    savedSize = 0;
+    lastSave = Clock::now();
+    stats = {};
+
+    std::vector<uint8> data;
+    if(!filepath.empty())
+    {
+        std::ifstream file(filepath, std::ios::ate | std::ios::binary);
+        if(file.is_open())
+        {
+            size_t filesize = (size_t)file.tellg();
+            data.resize(filesize);
+            file.seekg(0);
+            file.read((char *)data.data(), filesize);
+
+            if(!file)
+            {
+                LOGW("Pipeline cache {}: unable to read, starting empty", filepath);
+                data.clear();
+            }
+            else if(!pipelineCacheMatches(data.data(), data.size(), properties))
+            {
+                LOGW("Pipeline cache {}: written by another device or driver, starting empty", filepath);
+                data.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    VkResult res = vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache);
+    if(res != VK_SUCCESS && !data.empty())
+    {
+        //the header matched, but the driver still didn't take the rest
+        LOGW("Pipeline cache {}: rejected by the driver, starting empty", filepath);
+        data.clear();
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        res = vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache);
+    }
+    VK_CHECK(res);
+
+    loaded = !data.empty();
+    savedSize = data.size();
+    if(loaded) LOGI("Pipeline cache {}: loaded {} bytes", filepath, data.size());
+}
+
+void PipelineCache::destroy()
+{
+    save();
+
+    if(stats.pipelines)
+    {
+        uint32 misses = stats.pipelines - stats.hits;
+        LOGI("Pipeline creation: {} cache misses in {:.2f} ms, {} hits in {:.2f} ms",
+             misses, stats.createMs - stats.hitCreateMs,
+             stats.hits, stats.hitCreateMs);
+    }
+
+    vkDestroyPipelineCache(device, cache, nullptr);
+    cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::save()
+{
+    lastSave = Clock::now();
+    if(filepath.empty()) return false;
+
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, nullptr));
+
+    //the cache only ever grows, the same size is the same contents. Nothing but a header
+    //isn't worth a file
+    if(size == savedSize || size <= sizeof(VkPipelineCacheHeaderVersionOne)) return false;
+
+    std::vector<uint8> data(size);
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &size, data.data()));
+    data.resize(size);
+
+    if(!writeFileAtomic(filepath, data.data(), data.size())) return false;
+
+    savedSize = size;
+    LOGI("Pipeline cache {}: saved {} bytes", filepath, size);
+    return true;
+}
+
+void PipelineCache::update()
+{
+    if(std::chrono::duration<double>(Clock::now() - lastSave).count() >= PIPELINE_CACHE_SAVE_INTERVAL)
+    {
+        save();
+    }
+}
+
+void PipelineCache::feedback(PipelineFeedback &feedback, const void **next, uint32 stageCount)
+{
+    feedback = {};
+    if(!creationFeedback) return;
+
+    //the driver fills in one per stage, there must be as many as the create info has
+    assert(stageCount <= PIPELINE_FEEDBACK_MAX_STAGES);
+    feedback.info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+    feedback.info.pNext = *next;
+    feedback.info.pPipelineCreationFeedback = &feedback.pipeline;
+    feedback.info.pipelineStageCreationFeedbackCount = stageCount;
+    feedback.info.pPipelineStageCreationFeedbacks = feedback.stages;
+    *next = &feedback.info;
+}
+
+void PipelineCache::created(const char *name, double ms, const PipelineFeedback &feedback)
+{
+    //without a valid report, a loaded cache is all there is to go by
+    bool reported = (feedback.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) != 0;
+    bool hit = reported ? (feedback.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0 :
+                          loaded;
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.pipelines++;
+    stats.createMs += ms;
+    if(hit)
+    {
+        stats.hits++;
+        stats.hitCreateMs += ms;
+    }
+
+    LOGI("Pipeline {}: {:.2f} ms, cache {}{}", name, ms, hit ? "hit" : "miss", reported ? "" : " (guessed)");
+}
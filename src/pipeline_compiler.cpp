@@ -0,0 +1,781 @@
+#include "pipeline_compiler.h"
+#include "vulkan_manager.h"
+#include "hash.h"
+#include <assert.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+//prewarm list file: a header, then the descs as they are in memory
+#define PREWARM_MAGIC   0x50574c53  //"SLWP"
+#define PREWARM_VERSION 1
+
+struct PrewarmHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint32 descSize;
+    uint32 count;
+};
+
+
+static bool fileExists(const char *filepath)
+{
+    std::ifstream file(filepath, std::ios::binary);
+    return file.is_open();
+}
+
+static double msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+GraphicsPipelineDesc makePipelineDesc(const char *vertexShader, const char *fragmentShader)
+{
+    assert(strlen(vertexShader) < PIPELINE_SHADER_PATH);
+    assert(strlen(fragmentShader) < PIPELINE_SHADER_PATH);
+
+    //zeroed padding and path tails, descs are compared and hashed as bytes
+    GraphicsPipelineDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    strncpy(desc.vertexShader, vertexShader, PIPELINE_SHADER_PATH - 1);
+    strncpy(desc.fragmentShader, fragmentShader, PIPELINE_SHADER_PATH - 1);
+
+    desc.vertexInput = VERTEX_INPUT_PULLED;
+    desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc.polygonMode = VK_POLYGON_MODE_FILL;
+    desc.cullMode = VK_CULL_MODE_BACK_BIT;
+    desc.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    desc.depthTest = VK_TRUE;
+    desc.depthWrite = VK_TRUE;
+    desc.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+
+    desc.blendEnable = VK_FALSE;
+    return desc;
+}
+
+//The fixed function state of a desc, for whole pipelines and libraries alike. A library only
+//reads the state of its part.
+struct PipelineStates
+{
+    VkVertexInputBindingDescription vertexBinding;
+    VkVertexInputAttributeDescription vertexAttributes[2];
+    VkPipelineVertexInputStateCreateInfo vertexInput;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+    VkPipelineViewportStateCreateInfo viewport;
+    VkPipelineRasterizationStateCreateInfo raster;
+    VkPipelineMultisampleStateCreateInfo multisample;
+    VkPipelineDepthStencilStateCreateInfo depth;
+    VkPipelineColorBlendAttachmentState blendAttachment;
+    VkPipelineColorBlendStateCreateInfo blend;
+    VkDynamicState dynamicStates[2];
+    VkPipelineDynamicStateCreateInfo dynamic;
+
+    PipelineStates(const PipelineStates&) = delete;  //points into itself
+
+    PipelineStates(const GraphicsPipelineDesc &desc)
+    {
+        //pulled vertices come from the uniform buffer, skinned ones from the output of the
+        //skinning dispatch: vec4 position, vec4 normal
+        vertexBinding = {};
+        vertexBinding.binding = 0;
+        vertexBinding.stride = 8 * sizeof(float);
+        vertexBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        for(uint32 i = 0; i < 2; i++)
+        {
+            vertexAttributes[i] = {};
+            vertexAttributes[i].location = i;
+            vertexAttributes[i].binding = 0;
+            vertexAttributes[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            vertexAttributes[i].offset = i * 4 * sizeof(float);
+        }
+
+        vertexInput = {};
+        vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        if(desc.vertexInput == VERTEX_INPUT_SKINNED)
+        {
+            vertexInput.vertexBindingDescriptionCount = 1;
+            vertexInput.pVertexBindingDescriptions = &vertexBinding;
+            vertexInput.vertexAttributeDescriptionCount = 2;
+            vertexInput.pVertexAttributeDescriptions = vertexAttributes;
+        }
+
+        inputAssembly = {};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = desc.topology;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        //one viewport and scissor box, both dynamic
+        viewport = {};
+        viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport.viewportCount = 1;
+        viewport.scissorCount = 1;
+
+        raster = {};
+        raster.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        raster.polygonMode = desc.polygonMode;
+        raster.cullMode = desc.cullMode;
+        raster.frontFace = desc.frontFace;
+        raster.depthClampEnable = VK_FALSE;
+        raster.rasterizerDiscardEnable = VK_FALSE;
+        raster.depthBiasEnable = VK_FALSE;
+        raster.lineWidth = 1.0f;
+
+        multisample = {};
+        multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        depth = {};
+        depth.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depth.depthTestEnable = desc.depthTest;
+        depth.depthWriteEnable = desc.depthWrite;
+        depth.depthCompareOp = desc.depthCompareOp;
+        depth.depthBoundsTestEnable = VK_FALSE;
+        depth.minDepthBounds = 0.0f;
+        depth.maxDepthBounds = 1.0f;
+        depth.stencilTestEnable = VK_FALSE;
+        depth.back.failOp = VK_STENCIL_OP_KEEP;
+        depth.back.passOp = VK_STENCIL_OP_KEEP;
+        depth.front = depth.back;
+
+        blendAttachment = {};
+        blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+                                         VK_COLOR_COMPONENT_G_BIT |
+                                         VK_COLOR_COMPONENT_B_BIT |
+                                         VK_COLOR_COMPONENT_A_BIT;
+        blendAttachment.blendEnable = desc.blendEnable;
+        blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+        blend = {};
+        blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        blend.attachmentCount = 1;
+        blend.pAttachments = &blendAttachment;
+
+        dynamicStates[0] = VK_DYNAMIC_STATE_VIEWPORT;
+        dynamicStates[1] = VK_DYNAMIC_STATE_SCISSOR;
+
+        dynamic = {};
+        dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic.dynamicStateCount = 2;
+        dynamic.pDynamicStates = dynamicStates;
+    }
+
+    void fill(VkGraphicsPipelineCreateInfo &info) const
+    {
+        info.pVertexInputState = &vertexInput;
+        info.pInputAssemblyState = &inputAssembly;
+        info.pViewportState = &viewport;
+        info.pRasterizationState = &raster;
+        info.pMultisampleState = &multisample;
+        info.pDepthStencilState = &depth;
+        info.pColorBlendState = &blend;
+        info.pDynamicState = &dynamic;
+    }
+};
+
+static VkShaderModule createShaderModule(VkDevice device, const std::vector<uint32> &code)
+{
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size() * sizeof(uint32);
+    moduleInfo.pCode = code.data();
+
+    VkShaderModule module;
+    VK_CHECK(vkCreateShaderModule(device, &moduleInfo, nullptr, &module));
+    return module;
+}
+
+static VkPipelineShaderStageCreateInfo shaderStage(VkShaderStageFlagBits stage, VkShaderModule module)
+{
+    VkPipelineShaderStageCreateInfo stageInfo{};
+    stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stageInfo.stage = stage;
+    stageInfo.module = module;
+    stageInfo.pName = "main";
+    return stageInfo;
+}
+
+void PipelineCompiler::init(VkDevice device,
+                            PipelineCache *cache,
+                            ShaderLibrary *shaders,
+                            bool useLibraries,
+                            uint32 threadCount,
+                            const std::string &prewarmFilepath)
+{
+    this->device = device;
+    this->cache = cache;
+    this->shaders = shaders;
+    this->useLibraries = useLibraries;
+    this->prewarmFilepath = prewarmFilepath;
+
+    renderPass = VK_NULL_HANDLE;
+    layout = VK_NULL_HANDLE;
+    generation = 0;
+    busyWorkers = 0;
+    quit = false;
+
+    //the descs of previous runs, minus the ones whose shaders are gone
+    prewarm.clear();
+    std::ifstream file(prewarmFilepath, std::ios::ate | std::ios::binary);
+    if(!prewarmFilepath.empty() && file.is_open())
+    {
+        size_t filesize = (size_t)file.tellg();
+        file.seekg(0);
+
+        PrewarmHeader header{};
+        if(filesize >= sizeof(header)) file.read((char *)&header, sizeof(header));
+
+        if(header.magic == PREWARM_MAGIC &&
+           header.version == PREWARM_VERSION &&
+           header.descSize == sizeof(GraphicsPipelineDesc) &&
+           filesize - sizeof(header) >= (size_t)header.count * sizeof(GraphicsPipelineDesc))
+        {
+            std::vector<GraphicsPipelineDesc> descs(header.count);
+            file.read((char *)descs.data(), descs.size() * sizeof(GraphicsPipelineDesc));
+
+            for(size_t i = 0; file && i < descs.size(); i++)
+            {
+                //a corrupt path isn't terminated
+                descs[i].vertexShader[PIPELINE_SHADER_PATH - 1] = 0;
+                descs[i].fragmentShader[PIPELINE_SHADER_PATH - 1] = 0;
+
+                if(fileExists(descs[i].vertexShader) && fileExists(descs[i].fragmentShader))
+                {
+                    prewarm.push_back(descs[i]);
+                }
+            }
+            LOGI("Pipeline prewarm list {}: {} pipelines", prewarmFilepath, prewarm.size());
+        }
+        else
+        {
+            LOGW("Pipeline prewarm list {}: unknown format, ignored", prewarmFilepath);
+        }
+    }
+
+    if(threadCount == 0) threadCount = 1;
+    for(uint32 t = 0; t < threadCount; t++)
+    {
+        workers.emplace_back([this]() { workerLoop(); });
+
+        //compiles must not take cores from the frame
+#if defined(_WIN32)
+        SetThreadPriority((HANDLE)workers.back().native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+    }
+
+    LOGI("Pipeline compiler: {} threads, {}", threadCount,
+         useLibraries ? "VK_EXT_graphics_pipeline_library" : "whole pipelines");
+}
+
+void PipelineCompiler::shutDown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+        queue.clear();
+    }
+    wakeUp.notify_all();
+
+    for(size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+    workers.clear();
+
+    reset();
+
+    //every pipeline of this run, and the prewarm ones never asked for
+    std::vector<GraphicsPipelineDesc> descs;
+    for(size_t i = 0; i < pipelines.size(); i++)
+    {
+        descs.push_back(pipelines[i].desc);
+    }
+    descs.insert(descs.end(), prewarm.begin(), prewarm.end());
+    pipelines.clear();
+    prewarm.clear();
+
+    if(!prewarmFilepath.empty() && !descs.empty())
+    {
+        PrewarmHeader header{PREWARM_MAGIC, PREWARM_VERSION, (uint32)sizeof(GraphicsPipelineDesc), (uint32)descs.size()};
+
+        std::vector<uint8> data(sizeof(header) + descs.size() * sizeof(GraphicsPipelineDesc));
+        memcpy(data.data(), &header, sizeof(header));
+        memcpy(data.data() + sizeof(header), descs.data(), descs.size() * sizeof(GraphicsPipelineDesc));
+
+        writeFileAtomic(prewarmFilepath, data.data(), data.size());
+    }
+}
+
+void PipelineCompiler::begin(VkRenderPass renderPass, VkPipelineLayout layout)
+{
+    this->renderPass = renderPass;
+    this->layout = layout;
+
+    //nothing draws with them until requested, which then finds them compiled
+    for(size_t i = 0; i < prewarm.size(); i++)
+    {
+        request(prewarm[i], PIPELINE_NONE);
+    }
+    prewarm.clear();
+
+    for(uint32 id = 0; id < (uint32)pipelines.size(); id++)
+    {
+        if(!pipelines[id].pipeline && !pipelines[id].queued) enqueue(id);
+    }
+}
+
+void PipelineCompiler::reset()
+{
+    std::vector<PipelineCompilerResult> pending;
+    {
+        //the compiles in progress finish, against the old render pass and layout
+        std::unique_lock<std::mutex> lock(mutex);
+        queue.clear();
+        idle.wait(lock, [this]() { return busyWorkers == 0; });
+        pending.swap(results);
+    }
+
+    for(size_t i = 0; i < pending.size(); i++)
+    {
+        vkDestroyPipeline(device, pending[i].pipeline, nullptr);
+    }
+
+    for(size_t i = 0; i < pipelines.size(); i++)
+    {
+        vkDestroyPipeline(device, pipelines[i].pipeline, nullptr);
+        pipelines[i].pipeline = VK_NULL_HANDLE;
+        pipelines[i].optimized = false;
+        pipelines[i].queued = false;
+    }
+
+    for(size_t i = 0; i < retired.size(); i++)
+    {
+        vkDestroyPipeline(device, retired[i].pipeline, nullptr);
+    }
+    retired.clear();
+
+    //linked pipelines don't need their libraries, so they go last
+    for(size_t i = 0; i < libraries.size(); i++)
+    {
+        vkDestroyPipeline(device, libraries[i].pipeline, nullptr);
+    }
+    libraries.clear();
+
+    renderPass = VK_NULL_HANDLE;
+    layout = VK_NULL_HANDLE;
+    generation++;
+}
+
+uint32 PipelineCompiler::compile(const GraphicsPipelineDesc &desc)
+{
+    assert(renderPass != VK_NULL_HANDLE);
+
+    uint32 id = add(desc, PIPELINE_NONE);
+    if(pipelines[id].pipeline) return id;
+
+    VkPipeline pipeline = useLibraries ? link(desc, false) : compileWhole(desc);
+
+    //with hot reload the shaders can still be fixed while this waits
+    while(!pipeline && shaders->hotReload)
+    {
+        LOGE("Pipeline {}, {} doesn't compile, waiting for its shaders to be fixed.",
+             desc.vertexShader, desc.fragmentShader);
+
+        std::vector<std::string> changed;
+        while(changed.empty())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            shaders->takeChanged(changed);
+        }
+
+        //taken from update(), so the pipelines compiled already pick the changes up too
+        for(size_t i = 0; i < changed.size(); i++)
+        {
+            reload(changed[i]);
+        }
+        pipeline = useLibraries ? link(desc, false) : compileWhole(desc);
+    }
+
+    if(!pipeline)
+    {
+        LOGE_EXIT("Pipeline {}, {} doesn't compile.", desc.vertexShader, desc.fragmentShader);
+    }
+    pipelines[id].pipeline = pipeline;
+    pipelines[id].optimized = !useLibraries;
+    pipelines[id].pipelineVersion = pipelines[id].version;
+    generation++;
+
+    //the optimized link replaces it later. When the pipeline was queued already, e.g. from
+    //the prewarm list, what the queue compiles is thrown away instead
+    if(useLibraries && !pipelines[id].queued) enqueue(id);
+
+    return id;
+}
+
+uint32 PipelineCompiler::request(const GraphicsPipelineDesc &desc, uint32 fallback)
+{
+    uint32 id = add(desc, fallback);
+
+    //before begin() the pipeline waits for it
+    CompiledPipeline &entry = pipelines[id];
+    if(renderPass != VK_NULL_HANDLE && !entry.pipeline && !entry.queued) enqueue(id);
+
+    return id;
+}
+
+VkPipeline PipelineCompiler::get(uint32 id) const
+{
+    while(id != PIPELINE_NONE)
+    {
+        const CompiledPipeline &entry = pipelines[id];
+        if(entry.pipeline) return entry.pipeline;
+        id = entry.fallback;
+    }
+    return VK_NULL_HANDLE;
+}
+
+void PipelineCompiler::update(uint64 frameNumber, uint32 framesInFlight)
+{
+    //frames up to frameNumber - framesInFlight are done, see FrameScheduler::beginFrame()
+    size_t kept = 0;
+    for(size_t i = 0; i < retired.size(); i++)
+    {
+        if(retired[i].frameNumber + framesInFlight <= frameNumber)
+        {
+            vkDestroyPipeline(device, retired[i].pipeline, nullptr);
+        }
+        else
+        {
+            retired[kept++] = retired[i];
+        }
+    }
+    retired.resize(kept);
+
+    std::vector<std::string> changed;
+    shaders->takeChanged(changed);
+    for(size_t i = 0; i < changed.size(); i++)
+    {
+        reload(changed[i]);
+    }
+
+    std::vector<PipelineCompilerResult> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(results.empty()) return;
+        finished.swap(results);
+    }
+
+    for(size_t i = 0; i < finished.size(); i++)
+    {
+        CompiledPipeline &entry = pipelines[finished[i].id];
+
+        //compiled from shaders reloaded since, the newer compile is queued
+        if(finished[i].version != entry.version)
+        {
+            vkDestroyPipeline(device, finished[i].pipeline, nullptr);
+            continue;
+        }
+        if(finished[i].optimized) entry.queued = false;
+
+        //a shader doesn't compile, the pipeline of the previous version stays
+        if(!finished[i].pipeline) continue;
+
+        //compile() got there first
+        bool current = entry.pipeline && entry.pipelineVersion == entry.version;
+        if(current && (entry.optimized || !finished[i].optimized))
+        {
+            vkDestroyPipeline(device, finished[i].pipeline, nullptr);
+            continue;
+        }
+
+        //the frames before this one may have recorded the old pipeline
+        if(entry.pipeline) retired.push_back({entry.pipeline, frameNumber ? frameNumber - 1 : 0});
+
+        entry.pipeline = finished[i].pipeline;
+        entry.optimized = finished[i].optimized;
+        entry.pipelineVersion = finished[i].version;
+        generation++;
+    }
+}
+
+void PipelineCompiler::reload(const std::string &path)
+{
+    for(uint32 id = 0; id < (uint32)pipelines.size(); id++)
+    {
+        CompiledPipeline &entry = pipelines[id];
+        if(path != entry.desc.vertexShader && path != entry.desc.fragmentShader) continue;
+
+        //the pipeline in use stays until the new one is swapped in. Before begin(), there's
+        //none and begin() compiles the new code anyway
+        entry.version++;
+        if(renderPass != VK_NULL_HANDLE) enqueue(id);
+    }
+}
+
+uint32 PipelineCompiler::add(const GraphicsPipelineDesc &desc, uint32 fallback)
+{
+    uint32 id = find(desc);
+    if(id != PIPELINE_NONE)
+    {
+        if(fallback != PIPELINE_NONE) pipelines[id].fallback = fallback;
+        return id;
+    }
+
+    CompiledPipeline entry{};
+    entry.desc = desc;
+    entry.fallback = fallback;
+    pipelines.push_back(entry);
+    return (uint32)pipelines.size() - 1;
+}
+
+uint32 PipelineCompiler::find(const GraphicsPipelineDesc &desc) const
+{
+    for(uint32 id = 0; id < (uint32)pipelines.size(); id++)
+    {
+        if(memcmp(&pipelines[id].desc, &desc, sizeof(desc)) == 0) return id;
+    }
+    return PIPELINE_NONE;
+}
+
+void PipelineCompiler::enqueue(uint32 id)
+{
+    CompiledPipeline &entry = pipelines[id];
+    entry.queued = true;
+
+    bool current = entry.pipeline && entry.pipelineVersion == entry.version;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back({id, entry.desc, !current, entry.version});
+    }
+    wakeUp.notify_one();
+}
+
+void PipelineCompiler::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for(;;)
+    {
+        wakeUp.wait(lock, [this]() { return quit || !queue.empty(); });
+        if(quit) return;
+
+        QueuedPipeline job = queue.front();
+        queue.erase(queue.begin());
+        busyWorkers++;
+        lock.unlock();
+
+        //a fast link first, published right away to stop drawing the fallback as soon as
+        //possible, while the optimized link is still compiling
+        VkPipeline optimized = VK_NULL_HANDLE;
+        if(useLibraries)
+        {
+            VkPipeline fast = VK_NULL_HANDLE;
+            if(job.linkFast)
+            {
+                fast = link(job.desc, false);
+
+                lock.lock();
+                if(fast) results.push_back({job.id, fast, false, job.version});
+                lock.unlock();
+            }
+            if(fast || !job.linkFast) optimized = link(job.desc, true);
+        }
+        else
+        {
+            optimized = compileWhole(job.desc);
+        }
+
+        lock.lock();
+        results.push_back({job.id, optimized, true, job.version});
+        busyWorkers--;
+        if(busyWorkers == 0) idle.notify_all();
+    }
+}
+
+VkPipeline PipelineCompiler::library(const GraphicsPipelineDesc &desc, VkGraphicsPipelineLibraryFlagsEXT part)
+{
+    //a part depends on its own fields only, and its shader's code: after a reload the libraries
+    //of the old code stay, for the pipelines still using them, until reset()
+    uint64 key = hashBytes(&part, sizeof(part));
+    const char *name = "";
+    const char *shader = nullptr;
+    if(part == VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT)
+    {
+        key = hashBytes(&desc.vertexInput, sizeof(desc.vertexInput), key);
+        key = hashBytes(&desc.topology, sizeof(desc.topology), key);
+        name = "vertex input";
+    }
+    else if(part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT)
+    {
+        key = hashBytes(&desc.polygonMode, sizeof(desc.polygonMode), key);
+        key = hashBytes(&desc.cullMode, sizeof(desc.cullMode), key);
+        key = hashBytes(&desc.frontFace, sizeof(desc.frontFace), key);
+        name = desc.vertexShader;
+        shader = desc.vertexShader;
+    }
+    else if(part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)
+    {
+        key = hashBytes(&desc.depthTest, sizeof(desc.depthTest), key);
+        key = hashBytes(&desc.depthWrite, sizeof(desc.depthWrite), key);
+        key = hashBytes(&desc.depthCompareOp, sizeof(desc.depthCompareOp), key);
+        name = desc.fragmentShader;
+        shader = desc.fragmentShader;
+    }
+    else
+    {
+        key = hashBytes(&desc.blendEnable, sizeof(desc.blendEnable), key);
+        name = "fragment output";
+    }
+
+    std::vector<uint32> code;
+    if(shader)
+    {
+        uint64 codeHash;
+        if(!shaders->load(shader, code, codeHash)) return VK_NULL_HANDLE;
+        key = hashBytes(&codeHash, sizeof(codeHash), key);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < libraries.size(); i++)
+        {
+            if(libraries[i].part == part && libraries[i].key == key) return libraries[i].pipeline;
+        }
+    }
+
+    PipelineStates states(desc);
+
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+    libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+    libraryInfo.flags = part;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &libraryInfo;
+    pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+    pipelineInfo.layout = layout;
+    pipelineInfo.renderPass = renderPass;
+    states.fill(pipelineInfo);
+
+    //the shader stages go with their part only
+    VkShaderModule module = VK_NULL_HANDLE;
+    VkPipelineShaderStageCreateInfo stage;
+    if(shader)
+    {
+        module = createShaderModule(device, code);
+        stage = shaderStage(part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT ?
+                            VK_SHADER_STAGE_FRAGMENT_BIT : VK_SHADER_STAGE_VERTEX_BIT, module);
+
+        pipelineInfo.stageCount = 1;
+        pipelineInfo.pStages = &stage;
+    }
+
+    PipelineFeedback feedback;
+    cache->feedback(feedback, &pipelineInfo.pNext, pipelineInfo.stageCount);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateGraphicsPipelines(device, cache->cache, 1, &pipelineInfo, nullptr, &pipeline));
+
+    cache->created((std::string(name) + " library").c_str(), msSince(start), feedback);
+    if(module) vkDestroyShaderModule(device, module, nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    //another thread compiled the same part meanwhile
+    for(size_t i = 0; i < libraries.size(); i++)
+    {
+        if(libraries[i].part == part && libraries[i].key == key)
+        {
+            vkDestroyPipeline(device, pipeline, nullptr);
+            return libraries[i].pipeline;
+        }
+    }
+
+    libraries.push_back({part, key, pipeline});
+    return pipeline;
+}
+
+VkPipeline PipelineCompiler::link(const GraphicsPipelineDesc &desc, bool optimize)
+{
+    VkPipeline parts[4] = {
+        library(desc, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT),
+        library(desc, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT),
+        library(desc, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT),
+        library(desc, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)
+    };
+    if(!parts[1] || !parts[2]) return VK_NULL_HANDLE;
+
+    VkPipelineLibraryCreateInfoKHR linkInfo{};
+    linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    linkInfo.libraryCount = 4;
+    linkInfo.pLibraries = parts;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &linkInfo;
+    pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    pipelineInfo.layout = layout;
+
+    PipelineFeedback feedback;
+    cache->feedback(feedback, &pipelineInfo.pNext, pipelineInfo.stageCount);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateGraphicsPipelines(device, cache->cache, 1, &pipelineInfo, nullptr, &pipeline));
+
+    cache->created((std::string(desc.fragmentShader) + (optimize ? " optimized link" : " fast link")).c_str(),
+                   msSince(start), feedback);
+    return pipeline;
+}
+
+VkPipeline PipelineCompiler::compileWhole(const GraphicsPipelineDesc &desc)
+{
+    std::vector<uint32> vertCode, fragCode;
+    uint64 codeHash;
+    if(!shaders->load(desc.vertexShader, vertCode, codeHash) ||
+       !shaders->load(desc.fragmentShader, fragCode, codeHash))
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    PipelineStates states(desc);
+
+    VkShaderModule vertModule = createShaderModule(device, vertCode);
+    VkShaderModule fragModule = createShaderModule(device, fragCode);
+    VkPipelineShaderStageCreateInfo stages[] = {shaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertModule),
+                                                shaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragModule)};
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.layout = layout;
+    pipelineInfo.renderPass = renderPass;
+    states.fill(pipelineInfo);
+
+    PipelineFeedback feedback;
+    cache->feedback(feedback, &pipelineInfo.pNext, pipelineInfo.stageCount);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateGraphicsPipelines(device, cache->cache, 1, &pipelineInfo, nullptr, &pipeline));
+
+    cache->created(desc.fragmentShader, msSince(start), feedback);
+
+    //shader modules are safe to destroy after the graphics pipeline is created
+    vkDestroyShaderModule(device, fragModule, nullptr);
+    vkDestroyShaderModule(device, vertModule, nullptr);
+    return pipeline;
+}
@@ -0,0 +1,181 @@
+#include "present_pacer.h"
+#include <assert.h>
+#include <thread>
+
+//a present that never reaches the display, e.g. to an out of date swapchain, isn't waited
+//for longer than this (nanoseconds)
+#define PRESENT_WAIT_TIMEOUT 100000000ull
+
+static bool hasPresentMode(const std::vector<VkPresentModeKHR> &presentModes, VkPresentModeKHR mode)
+{
+    for(VkPresentModeKHR m : presentModes)
+    {
+        if(m == mode) return true;
+    }
+    return false;
+}
+
+PresentSettings choosePresentSettings(uint32 latencyMode,
+                                      const std::vector<VkPresentModeKHR> &presentModes,
+                                      bool presentWait)
+{
+    //FIFO is the only mode guaranteed to be available
+    PresentSettings settings{VK_PRESENT_MODE_FIFO_KHR, 3, 0};
+
+    if(latencyMode == LATENCY_LOW)
+    {
+        if(hasPresentMode(presentModes, VK_PRESENT_MODE_MAILBOX_KHR))
+        {
+            //one image on screen, one queued to be replaced and one to draw to
+            settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        }
+        else
+        {
+            settings.imageCount = 2;
+            settings.maxQueuedPresents = presentWait ? 1 : 0;
+        }
+    }
+    else if(latencyMode == LATENCY_UNCAPPED)
+    {
+        if(hasPresentMode(presentModes, VK_PRESENT_MODE_IMMEDIATE_KHR))
+        {
+            settings.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        }
+        else if(hasPresentMode(presentModes, VK_PRESENT_MODE_MAILBOX_KHR))
+        {
+            settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        }
+    }
+
+    return settings;
+}
+
+void PresentPacer::init(VkDevice device, PFN_vkWaitForPresentKHR waitForPresent, float frameRateCap)
+{
+    this->device = device;
+    this->waitForPresent = waitForPresent;
+    this->frameRateCap = frameRateCap;
+
+    swapchain = VK_NULL_HANDLE;
+    settings = {};
+    nextFrame = Clock::now();
+
+    presentId = 0;
+    presentsShown = 0;
+    hasLastPresent = false;
+    smoothedIntervalMs = 0.0;
+
+    resetStats();
+}
+
+void PresentPacer::setSwapchain(VkSwapchainKHR swapchain, PresentSettings settings)
+{
+    this->swapchain = swapchain;
+    this->settings = settings;
+    if(!waitForPresent) this->settings.maxQueuedPresents = 0;
+
+    //the old swapchain's presents may never be shown. Ids keep counting up, which a new
+    //swapchain accepts as well
+    presentsShown = presentId;
+    hasLastPresent = false;
+}
+
+void PresentPacer::beginFrame()
+{
+    if(frameRateCap > 0.0f)
+    {
+        Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameRateCap));
+        Clock::time_point now = Clock::now();
+
+        if(now < nextFrame)
+        {
+            //sleeping is only good to a millisecond or so, spin the rest
+            if(nextFrame - now > std::chrono::milliseconds(2))
+            {
+                std::this_thread::sleep_for(nextFrame - now - std::chrono::milliseconds(2));
+            }
+            while(Clock::now() < nextFrame) {}
+        }
+
+        nextFrame += period;
+
+        //more than a frame late: start over from now instead of catching up with a burst
+        if(nextFrame < now) nextFrame = now + period;
+    }
+
+    if(settings.maxQueuedPresents && presentId - presentsShown > settings.maxQueuedPresents)
+    {
+        uint64 id = presentId - settings.maxQueuedPresents;
+        VkResult res = waitForPresent(device, swapchain, id, PRESENT_WAIT_TIMEOUT);
+        presentsShown = id;
+
+        //timed out or the swapchain is out of date, which the next present reports
+        if(res == VK_SUCCESS)
+        {
+            addInterval(Clock::now());
+        }
+        else
+        {
+            hasLastPresent = false;
+        }
+    }
+}
+
+VkResult PresentPacer::present(VkQueue queue, const VkPresentInfoKHR &presentInfo, uint32 gpuFrames)
+{
+    assert(presentInfo.swapchainCount == 1);
+    presentId++;
+
+    VkPresentInfoKHR info = presentInfo;
+    VkPresentIdKHR idInfo{};
+    if(waitForPresent)
+    {
+        idInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        idInfo.pNext = info.pNext;
+        idInfo.swapchainCount = 1;
+        idInfo.pPresentIds = &presentId;
+        info.pNext = &idInfo;
+    }
+
+    VkResult res = vkQueuePresentKHR(queue, &info);
+
+    //without present wait, presents are only seen being queued
+    if(!settings.maxQueuedPresents) addInterval(Clock::now());
+
+    uint32 queuedPresents = settings.maxQueuedPresents ? (uint32)(presentId - presentsShown) : 0;
+    stats.presents++;
+    stats.queuedPresentsSum += queuedPresents;
+    stats.gpuFramesSum += gpuFrames;
+    if(queuedPresents > stats.maxQueuedPresents) stats.maxQueuedPresents = queuedPresents;
+    if(gpuFrames > stats.maxGpuFrames) stats.maxGpuFrames = gpuFrames;
+
+    return res;
+}
+
+double PresentPacer::predictPresentDelay(uint32 gpuFrames) const
+{
+    uint64 ahead = settings.maxQueuedPresents ? presentId - presentsShown : gpuFrames;
+    return (double)(ahead + 1) * smoothedIntervalMs * 0.001;
+}
+
+void PresentPacer::resetStats()
+{
+    stats = {};
+}
+
+void PresentPacer::addInterval(Clock::time_point now)
+{
+    if(hasLastPresent)
+    {
+        double ms = std::chrono::duration<double, std::milli>(now - lastPresent).count();
+        if(!stats.intervals || ms < stats.minIntervalMs) stats.minIntervalMs = ms;
+        if(!stats.intervals || ms > stats.maxIntervalMs) stats.maxIntervalMs = ms;
+        stats.intervalMsSum += ms;
+        stats.intervals++;
+
+        smoothedIntervalMs = smoothedIntervalMs ? 0.9 * smoothedIntervalMs + 0.1 * ms : ms;
+    }
+
+    lastPresent = now;
+    hasLastPresent = true;
+}
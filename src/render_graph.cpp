@@ -0,0 +1,808 @@
+#include <string.h>
+#include "render_graph.h"
+
+struct UsageInfo
+{
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    VkImageUsageFlags imageUsage;
+    bool reads;
+    bool writes;
+    bool attachment;
+};
+
+static const UsageInfo usageInfos[USAGE_COUNT] =
+{
+    //USAGE_NONE
+    {0, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, false, false, false},
+    //USAGE_SWAPCHAIN_ACQUIRE: the acquire semaphore is waited on at this stage
+    {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, false, false, false},
+    //USAGE_COLOR_ATTACHMENT
+    {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, false, true, true},
+    //USAGE_DEPTH_ATTACHMENT
+    {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, false, true, true},
+    //USAGE_DEPTH_READ
+    {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+     VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, false, true},
+    //USAGE_SAMPLED_FRAGMENT
+    {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, true, false, false},
+    //USAGE_SAMPLED_COMPUTE
+    {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, true, false, false},
+    //USAGE_STORAGE_READ_COMPUTE
+    {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false, false},
+    //USAGE_STORAGE_WRITE_COMPUTE
+    {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false, true, false},
+    //USAGE_STORAGE_READ_VERTEX
+    {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false, false},
+    //USAGE_VERTEX_BUFFER
+    {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+     VK_IMAGE_LAYOUT_UNDEFINED, 0, true, false, false},
+    //USAGE_TRANSFER_SRC
+    {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, true, false, false},
+    //USAGE_TRANSFER_DST
+    {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, false, true, false},
+    //USAGE_PRESENT: the present waits on a semaphore, nothing to make visible
+    {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, true, false, false},
+};
+
+//the access bits that make a write, the only ones worth a srcAccessMask
+static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT |
+                                          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                          VK_ACCESS_TRANSFER_WRITE_BIT |
+                                          VK_ACCESS_HOST_WRITE_BIT |
+                                          VK_ACCESS_MEMORY_WRITE_BIT;
+
+static VkImageAspectFlags aspectFromFormat(VkFormat format)
+{
+    switch(format)
+    {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+static bool accessReads(const RenderGraphAccess &a)
+{
+    //an attachment that isn't cleared is loaded
+    const UsageInfo &info = usageInfos[a.usage];
+    return info.reads || (info.attachment && !a.clear);
+}
+
+static bool accessWrites(const RenderGraphAccess &a)
+{
+    return usageInfos[a.usage].writes;
+}
+
+//============================ building ===============================
+
+static RenderGraphResource newResource(const char *name, bool isImage, bool imported)
+{
+    RenderGraphResource r{};
+    r.name = name;
+    r.isImage = isImage;
+    r.imported = imported;
+    r.finalQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+    r.firstPass = -1;
+    r.lastPass = -1;
+    r.memoryBlock = -1;
+    return r;
+}
+
+uint32 RenderGraph::importImage(const char *name, VkFormat format, uint32 width, uint32 height,
+                                uint32 initialUsage, uint32 finalUsage, uint32 finalQueueFamily)
+{
+    RenderGraphResource r = newResource(name, true, true);
+    r.format = format;
+    r.aspect = aspectFromFormat(format);
+    r.width = width;
+    r.height = height;
+    r.initialUsage = initialUsage;
+    r.finalUsage = finalUsage;
+    r.finalQueueFamily = finalQueueFamily;
+    r.output = finalUsage != USAGE_NONE;
+
+    resources.push_back(r);
+    return (uint32)resources.size() - 1;
+}
+
+uint32 RenderGraph::importBuffer(const char *name, VkDeviceSize size, uint32 initialUsage, uint32 finalUsage)
+{
+    RenderGraphResource r = newResource(name, false, true);
+    r.size = size;
+    r.initialUsage = initialUsage;
+    r.finalUsage = finalUsage;
+    r.output = finalUsage != USAGE_NONE;
+
+    resources.push_back(r);
+    return (uint32)resources.size() - 1;
+}
+
+uint32 RenderGraph::createImage(const char *name, VkFormat format, uint32 width, uint32 height)
+{
+    RenderGraphResource r = newResource(name, true, false);
+    r.format = format;
+    r.aspect = aspectFromFormat(format);
+    r.width = width;
+    r.height = height;
+
+    resources.push_back(r);
+    return (uint32)resources.size() - 1;
+}
+
+void RenderGraph::markOutput(uint32 resource)
+{
+    resources[resource].output = true;
+}
+
+uint32 RenderGraph::addPass(const char *name, RenderPassFunction function, void *data)
+{
+    RenderGraphPass p{};
+    p.name = name;
+    p.function = function;
+    p.data = data;
+
+    passes.push_back(p);
+    return (uint32)passes.size() - 1;
+}
+
+void RenderGraph::use(uint32 pass, uint32 resource, uint32 usage, const VkClearValue *clearValue)
+{
+    RenderGraphPass &p = passes[pass];
+
+    //one access per resource and pass: barriers can't go inside a pass
+    for(size_t i = 0; i < p.accesses.size(); i++) assert(p.accesses[i].resource != resource);
+    assert(usage != USAGE_NONE && usage != USAGE_SWAPCHAIN_ACQUIRE && usage != USAGE_PRESENT);
+    assert(!clearValue || usageInfos[usage].attachment);
+
+    RenderGraphAccess a{};
+    a.resource = resource;
+    a.usage = usage;
+    a.clear = clearValue != nullptr;
+    if(clearValue) a.clearValue = *clearValue;
+
+    p.accesses.push_back(a);
+    if(usageInfos[usage].attachment) p.graphics = true;
+}
+
+//============================ compiling ===============================
+
+void RenderGraph::cullPasses()
+{
+    std::vector<bool> needed(resources.size());
+    for(size_t r = 0; r < resources.size(); r++) needed[r] = resources[r].output;
+
+    for(size_t i = passes.size(); i-- > 0;)
+    {
+        RenderGraphPass &p = passes[i];
+
+        p.live = false;
+        for(size_t a = 0; a < p.accesses.size(); a++)
+        {
+            if(accessWrites(p.accesses[a]) && needed[p.accesses[a].resource]) p.live = true;
+        }
+        if(!p.live) continue;
+
+        //what it overwrites isn't needed from earlier passes, what it reads is
+        for(size_t a = 0; a < p.accesses.size(); a++)
+        {
+            if(accessWrites(p.accesses[a]) && !accessReads(p.accesses[a])) needed[p.accesses[a].resource] = false;
+        }
+        for(size_t a = 0; a < p.accesses.size(); a++)
+        {
+            if(accessReads(p.accesses[a])) needed[p.accesses[a].resource] = true;
+        }
+    }
+
+    livePasses.clear();
+    for(size_t i = 0; i < passes.size(); i++)
+    {
+        if(passes[i].live) livePasses.push_back((uint32)i);
+    }
+}
+
+void RenderGraph::allocateTransients(VulkanManager &vulkanManager)
+{
+    std::vector<uint32> transients;
+    std::vector<VkMemoryRequirements> requirements(resources.size());
+
+    for(size_t r = 0; r < resources.size(); r++)
+    {
+        RenderGraphResource &res = resources[r];
+        if(res.imported || res.firstPass < 0) continue;
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = res.format;
+        imageInfo.extent = {res.width, res.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = res.imageUsage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &res.image));
+        vkGetImageMemoryRequirements(device, res.image, &requirements[r]);
+
+        stats.transientBytes += requirements[r].size;
+        transients.push_back((uint32)r);
+    }
+
+    //biggest first, each into the first block it fits in: same memory type and no other
+    //image of the block alive at the same time. Every image is bound at offset 0.
+    for(size_t i = 1; i < transients.size(); i++)
+    {
+        uint32 t = transients[i];
+        size_t j = i;
+        for(; j > 0 && requirements[transients[j - 1]].size < requirements[t].size; j--) transients[j] = transients[j - 1];
+        transients[j] = t;
+    }
+
+    for(size_t i = 0; i < transients.size(); i++)
+    {
+        uint32 r = transients[i];
+        RenderGraphResource &res = resources[r];
+
+        for(size_t b = 0; b < memoryBlocks.size() && res.memoryBlock < 0; b++)
+        {
+            RenderGraphMemoryBlock &block = memoryBlocks[b];
+            if(!(block.memoryTypeBits & requirements[r].memoryTypeBits)) continue;
+
+            bool overlaps = false;
+            for(size_t o = 0; o < block.resources.size(); o++)
+            {
+                const RenderGraphResource &other = resources[block.resources[o]];
+                if(!(res.lastPass < other.firstPass || other.lastPass < res.firstPass)) overlaps = true;
+            }
+            if(overlaps) continue;
+
+            block.memoryTypeBits &= requirements[r].memoryTypeBits;
+            if(requirements[r].size > block.size) block.size = requirements[r].size;
+            block.resources.push_back(r);
+            res.memoryBlock = (int32)b;
+        }
+
+        if(res.memoryBlock < 0)
+        {
+            RenderGraphMemoryBlock block{};
+            block.size = requirements[r].size;
+            block.memoryTypeBits = requirements[r].memoryTypeBits;
+            block.resources.push_back(r);
+            memoryBlocks.push_back(block);
+            res.memoryBlock = (int32)memoryBlocks.size() - 1;
+        }
+    }
+
+    for(size_t b = 0; b < memoryBlocks.size(); b++)
+    {
+        RenderGraphMemoryBlock &block = memoryBlocks[b];
+
+        //in order of first use, for trackAccesses() to find who used the memory before
+        std::vector<uint32> &occupants = block.resources;
+        for(size_t i = 1; i < occupants.size(); i++)
+        {
+            uint32 t = occupants[i];
+            size_t j = i;
+            for(; j > 0 && resources[occupants[j - 1]].firstPass > resources[t].firstPass; j--) occupants[j] = occupants[j - 1];
+            occupants[j] = t;
+        }
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = block.size;
+        allocInfo.memoryTypeIndex = findMemoryTypeFromProperties(&vulkanManager.physicalDevice.memProperties,
+                                                                 block.memoryTypeBits,
+                                                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &block.memory));
+        stats.allocatedBytes += block.size;
+
+        for(size_t i = 0; i < occupants.size(); i++)
+        {
+            RenderGraphResource &res = resources[occupants[i]];
+            VK_CHECK(vkBindImageMemory(device, res.image, block.memory, 0));
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = res.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = res.format;
+            viewInfo.subresourceRange.aspectMask = res.aspect;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &res.view));
+        }
+    }
+}
+
+//Walks the live passes keeping every resource's RenderGraphState, and emits the barriers
+//each pass needs. A transient image starts as left by the previous user of its memory at
+//the end of the last walk, so compile() walks twice.
+void RenderGraph::trackAccesses()
+{
+    barriers.clear();
+    batches.clear();
+
+    std::vector<RenderGraphState> states(resources.size());
+    std::vector<int32> lastRead(resources.size(), -1);
+
+    for(size_t r = 0; r < resources.size(); r++)
+    {
+        const RenderGraphResource &res = resources[r];
+        RenderGraphState &s = states[r];
+        s = {};
+
+        if(res.imported)
+        {
+            const UsageInfo &info = usageInfos[res.initialUsage];
+            s.layout = info.layout;
+            s.writeStages = info.stages;
+            s.writeAccess = info.access & WRITE_ACCESS;
+            s.defined = !res.isImage || info.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+        else if(res.memoryBlock >= 0)
+        {
+            //wait for the previous user of the memory to be done with it, the last user
+            //of the previous frame for the first one
+            const std::vector<uint32> &occupants = memoryBlocks[res.memoryBlock].resources;
+            size_t k = 0;
+            while(occupants[k] != r) k++;
+            const RenderGraphState &prev = resources[occupants[(k + occupants.size() - 1) % occupants.size()]].endState;
+
+            s.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            s.writeStages = prev.writeStages | prev.readStages;
+            s.writeAccess = prev.writeAccess;
+        }
+    }
+
+    for(size_t k = 0; k <= livePasses.size(); k++)
+    {
+        RenderGraphBarrierBatch batch{};
+        batch.firstBarrier = (uint32)barriers.size();
+
+        if(k < livePasses.size())
+        {
+            RenderGraphPass &p = passes[livePasses[k]];
+            p.barrierBatch = (uint32)k;
+
+            for(size_t a = 0; a < p.accesses.size(); a++)
+            {
+                RenderGraphAccess &access = p.accesses[a];
+                const RenderGraphResource &res = resources[access.resource];
+                const UsageInfo &info = usageInfos[access.usage];
+                RenderGraphState &s = states[access.resource];
+
+                bool reads = accessReads(access);
+                bool writes = accessWrites(access);
+                bool layoutChange = res.isImage && s.layout != info.layout;
+
+                if(reads) lastRead[access.resource] = (int32)k;
+                access.load = s.defined;
+
+                if(writes || layoutChange)
+                {
+                    //wait for the last write and every read since, flush the write
+                    VkPipelineStageFlags src = s.writeStages | s.readStages;
+                    if(src || layoutChange || s.writeAccess)
+                    {
+                        RenderGraphBarrier b{};
+                        b.resource = access.resource;
+                        b.executionOnly = !layoutChange && !s.writeAccess;
+                        b.srcStages = src;
+                        b.dstStages = info.stages;
+                        b.srcAccess = s.writeAccess;
+                        b.dstAccess = info.access;
+                        //a cleared attachment has nothing to keep
+                        b.oldLayout = access.clear ? VK_IMAGE_LAYOUT_UNDEFINED : s.layout;
+                        b.newLayout = info.layout;
+                        b.srcQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                        b.dstQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                        barriers.push_back(b);
+                    }
+
+                    //a layout change is a write later accesses have to wait on as well
+                    s.defined = writes || (s.defined && s.layout != VK_IMAGE_LAYOUT_UNDEFINED && !access.clear);
+                    s.layout = info.layout;
+                    s.writeStages = info.stages;
+                    s.writeAccess = writes ? info.access & WRITE_ACCESS : 0;
+                    s.readStages = writes ? 0 : info.stages;
+                    s.visibleStages = info.stages;
+                    s.visibleAccess = info.access;
+                }
+                else
+                {
+                    //read in the same layout: only wait if the last write isn't visible yet
+                    bool visible = !(info.stages & ~s.visibleStages) && !(info.access & ~s.visibleAccess);
+                    if(s.writeStages && !visible)
+                    {
+                        RenderGraphBarrier b{};
+                        b.resource = access.resource;
+                        b.executionOnly = !s.writeAccess;
+                        b.srcStages = s.writeStages;
+                        b.dstStages = info.stages;
+                        b.srcAccess = s.writeAccess;
+                        b.dstAccess = info.access;
+                        b.oldLayout = s.layout;
+                        b.newLayout = s.layout;
+                        b.srcQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                        b.dstQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                        barriers.push_back(b);
+
+                        s.visibleStages |= info.stages;
+                        s.visibleAccess |= info.access;
+                    }
+                    s.readStages |= info.stages;
+                }
+            }
+        }
+        else
+        {
+            //imported resources to their final usage and queue family
+            for(size_t r = 0; r < resources.size(); r++)
+            {
+                const RenderGraphResource &res = resources[r];
+                if(!res.imported || res.finalUsage == USAGE_NONE) continue;
+
+                const UsageInfo &info = usageInfos[res.finalUsage];
+                RenderGraphState &s = states[r];
+
+                bool layoutChange = res.isImage && s.layout != info.layout;
+                bool familyChange = res.finalQueueFamily != VK_QUEUE_FAMILY_IGNORED && res.finalQueueFamily != queueFamily;
+                if(!layoutChange && !familyChange && !s.writeAccess) continue;
+
+                RenderGraphBarrier b{};
+                b.resource = (uint32)r;
+                b.srcStages = s.writeStages | s.readStages;
+                b.dstStages = info.stages;
+                b.srcAccess = s.writeAccess;
+                b.dstAccess = info.access;
+                b.oldLayout = s.layout;
+                b.newLayout = res.isImage ? info.layout : s.layout;
+                b.srcQueueFamily = familyChange ? queueFamily : VK_QUEUE_FAMILY_IGNORED;
+                b.dstQueueFamily = familyChange ? res.finalQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+                barriers.push_back(b);
+            }
+        }
+
+        batch.barrierCount = (uint32)barriers.size() - batch.firstBarrier;
+        batches.push_back(batch);
+    }
+
+    for(size_t r = 0; r < resources.size(); r++)
+    {
+        resources[r].endState = states[r];
+    }
+
+    //store attachments that a later pass reads or that are outputs
+    for(size_t k = 0; k < livePasses.size(); k++)
+    {
+        RenderGraphPass &p = passes[livePasses[k]];
+        for(size_t a = 0; a < p.accesses.size(); a++)
+        {
+            RenderGraphAccess &access = p.accesses[a];
+            access.store = resources[access.resource].output || lastRead[access.resource] > (int32)k;
+        }
+    }
+}
+
+bool RenderGraph::finalBarrier(uint32 resource, RenderGraphBarrier &barrier) const
+{
+    if(batches.empty()) return false;
+
+    const RenderGraphBarrierBatch &batch = batches.back();
+    for(uint32 i = batch.firstBarrier; i < batch.firstBarrier + batch.barrierCount; i++)
+    {
+        if(barriers[i].resource == resource)
+        {
+            barrier = barriers[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void RenderGraph::initRenderPass(RenderGraphPass &pass)
+{
+    VkAttachmentDescription descriptions[RENDER_GRAPH_MAX_ATTACHMENTS] = {};
+    VkAttachmentReference colorRefs[RENDER_GRAPH_MAX_ATTACHMENTS] = {};
+    VkAttachmentReference depthRef{};
+    uint32 colorCount = 0;
+    bool hasDepth = false;
+
+    pass.attachmentCount = 0;
+
+    //colors first, then the depth attachment
+    for(uint32 depth = 0; depth < 2; depth++)
+    {
+        for(size_t a = 0; a < pass.accesses.size(); a++)
+        {
+            const RenderGraphAccess &access = pass.accesses[a];
+            const UsageInfo &info = usageInfos[access.usage];
+            if(!info.attachment) continue;
+
+            bool isDepth = access.usage != USAGE_COLOR_ATTACHMENT;
+            if(isDepth != (depth == 1)) continue;
+
+            const RenderGraphResource &res = resources[access.resource];
+            uint32 i = pass.attachmentCount++;
+            assert(i < RENDER_GRAPH_MAX_ATTACHMENTS);
+
+            VkAttachmentLoadOp loadOp = access.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+                                        access.load  ? VK_ATTACHMENT_LOAD_OP_LOAD :
+                                                       VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            VkAttachmentStoreOp storeOp = access.store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            bool hasStencil = (res.aspect & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+
+            descriptions[i].format = res.format;
+            descriptions[i].samples = VK_SAMPLE_COUNT_1_BIT;
+            descriptions[i].loadOp = loadOp;
+            descriptions[i].storeOp = storeOp;
+            descriptions[i].stencilLoadOp = hasStencil ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            descriptions[i].stencilStoreOp = hasStencil ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            //the barriers before the pass do the layout changes
+            descriptions[i].initialLayout = info.layout;
+            descriptions[i].finalLayout = info.layout;
+
+            if(isDepth)
+            {
+                assert(!hasDepth);
+                hasDepth = true;
+                depthRef.attachment = i;
+                depthRef.layout = info.layout;
+            }
+            else
+            {
+                colorRefs[colorCount].attachment = i;
+                colorRefs[colorCount].layout = info.layout;
+                colorCount++;
+            }
+
+            pass.attachments[i] = access.resource;
+            pass.clearValues[i] = access.clearValue;
+            pass.width = res.width;
+            pass.height = res.height;
+        }
+    }
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = colorCount;
+    subpass.pColorAttachments = colorRefs;
+    subpass.pDepthStencilAttachment = hasDepth ? &depthRef : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = pass.attachmentCount;
+    renderPassInfo.pAttachments = descriptions;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &pass.renderPass));
+}
+
+void RenderGraph::compile(VulkanManager &vulkanManager)
+{
+    device = vulkanManager.logicalDevice.device;
+    queueFamily = vulkanManager.physicalDevice.graphicsQueueFamilyIndex;
+    cmdBarriers.init(vulkanManager.logicalDevice.cmdPipelineBarrier2);
+    stats = {};
+
+    cullPasses();
+
+    for(size_t k = 0; k < livePasses.size(); k++)
+    {
+        const RenderGraphPass &p = passes[livePasses[k]];
+        for(size_t a = 0; a < p.accesses.size(); a++)
+        {
+            RenderGraphResource &res = resources[p.accesses[a].resource];
+            if(res.firstPass < 0) res.firstPass = (int32)k;
+            res.lastPass = (int32)k;
+            res.imageUsage |= usageInfos[p.accesses[a].usage].imageUsage;
+        }
+    }
+
+    allocateTransients(vulkanManager);
+
+    trackAccesses();
+    trackAccesses();
+
+    //whether each attachment has contents to load, known once the passes before it are
+    for(size_t k = 0; k < livePasses.size(); k++)
+    {
+        RenderGraphPass &p = passes[livePasses[k]];
+        if(p.graphics) initRenderPass(p);
+    }
+
+    stats.passes = (uint32)passes.size();
+    stats.culledPasses = (uint32)(passes.size() - livePasses.size());
+    stats.barriers = (uint32)barriers.size();
+    for(size_t b = 0; b < batches.size(); b++)
+    {
+        if(batches[b].barrierCount) stats.barrierBatches++;
+    }
+}
+
+void RenderGraph::destroy()
+{
+    for(size_t i = 0; i < framebuffers.size(); i++)
+    {
+        vkDestroyFramebuffer(device, framebuffers[i].framebuffer, nullptr);
+    }
+
+    for(size_t i = 0; i < passes.size(); i++)
+    {
+        if(passes[i].renderPass != VK_NULL_HANDLE) vkDestroyRenderPass(device, passes[i].renderPass, nullptr);
+    }
+
+    for(size_t r = 0; r < resources.size(); r++)
+    {
+        if(resources[r].imported) continue;
+        if(resources[r].view != VK_NULL_HANDLE) vkDestroyImageView(device, resources[r].view, nullptr);
+        if(resources[r].image != VK_NULL_HANDLE) vkDestroyImage(device, resources[r].image, nullptr);
+    }
+
+    for(size_t b = 0; b < memoryBlocks.size(); b++)
+    {
+        vkFreeMemory(device, memoryBlocks[b].memory, nullptr);
+    }
+
+    //the graph is built again from scratch
+    resources.clear();
+    passes.clear();
+    livePasses.clear();
+    barriers.clear();
+    batches.clear();
+    memoryBlocks.clear();
+    framebuffers.clear();
+}
+
+//============================ executing ===============================
+
+void RenderGraph::setImage(uint32 resource, VkImage image, VkImageView view)
+{
+    assert(resources[resource].imported && resources[resource].isImage);
+    resources[resource].image = image;
+    resources[resource].view = view;
+}
+
+void RenderGraph::setBuffer(uint32 resource, VkBuffer buffer)
+{
+    assert(resources[resource].imported && !resources[resource].isImage);
+    resources[resource].buffer = buffer;
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(uint32 pass)
+{
+    const RenderGraphPass &p = passes[pass];
+
+    VkImageView views[RENDER_GRAPH_MAX_ATTACHMENTS] = {};
+    for(uint32 i = 0; i < p.attachmentCount; i++) views[i] = resources[p.attachments[i]].view;
+
+    //one per pass and set of imported views, e.g. per swapchain image
+    for(size_t f = 0; f < framebuffers.size(); f++)
+    {
+        if(framebuffers[f].pass == pass &&
+           memcmp(framebuffers[f].views, views, sizeof(views)) == 0) return framebuffers[f].framebuffer;
+    }
+
+    RenderGraphFramebuffer fb{};
+    fb.pass = pass;
+    memcpy(fb.views, views, sizeof(views));
+
+    VkFramebufferCreateInfo fbInfo{};
+    fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fbInfo.renderPass = p.renderPass;
+    fbInfo.attachmentCount = p.attachmentCount;
+    fbInfo.pAttachments = views;
+    fbInfo.width = p.width;
+    fbInfo.height = p.height;
+    fbInfo.layers = 1;
+
+    VK_CHECK(vkCreateFramebuffer(device, &fbInfo, nullptr, &fb.framebuffer));
+    framebuffers.push_back(fb);
+    return fb.framebuffer;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer cmd, const RenderGraphBarrierBatch &batch)
+{
+    for(uint32 i = batch.firstBarrier; i < batch.firstBarrier + batch.barrierCount; i++)
+    {
+        const RenderGraphBarrier &b = barriers[i];
+        const RenderGraphResource &res = resources[b.resource];
+
+        if(b.executionOnly)
+        {
+            cmdBarriers.execution(b.srcStages, b.dstStages);
+        }
+        else if(res.isImage)
+        {
+            VkImageMemoryBarrier2KHR imageBarrier{};
+            imageBarrier.srcStageMask = b.srcStages;
+            imageBarrier.srcAccessMask = b.srcAccess;
+            imageBarrier.dstStageMask = b.dstStages;
+            imageBarrier.dstAccessMask = b.dstAccess;
+            imageBarrier.oldLayout = b.oldLayout;
+            imageBarrier.newLayout = b.newLayout;
+            imageBarrier.srcQueueFamilyIndex = b.srcQueueFamily;
+            imageBarrier.dstQueueFamilyIndex = b.dstQueueFamily;
+            imageBarrier.image = res.image;
+            imageBarrier.subresourceRange.aspectMask = res.aspect;
+            imageBarrier.subresourceRange.baseMipLevel = 0;
+            imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            imageBarrier.subresourceRange.baseArrayLayer = 0;
+            imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+            cmdBarriers.imageBarrier(imageBarrier);
+        }
+        else
+        {
+            cmdBarriers.buffer(res.buffer,
+                               b.srcStages, b.srcAccess,
+                               b.dstStages, b.dstAccess,
+                               0, VK_WHOLE_SIZE,
+                               b.srcQueueFamily, b.dstQueueFamily);
+        }
+    }
+
+    cmdBarriers.flush(cmd);
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd)
+{
+    for(size_t k = 0; k < livePasses.size(); k++)
+    {
+        uint32 pass = livePasses[k];
+        const RenderGraphPass &p = passes[pass];
+
+        recordBarriers(cmd, batches[p.barrierBatch]);
+
+        RenderGraphContext context{};
+        context.graph = this;
+        context.cmd = cmd;
+
+        if(p.graphics)
+        {
+            context.renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            context.renderPassInfo.renderPass = p.renderPass;
+            context.renderPassInfo.framebuffer = getFramebuffer(pass);
+            context.renderPassInfo.renderArea.offset = {0, 0};
+            context.renderPassInfo.renderArea.extent.width = p.width;
+            context.renderPassInfo.renderArea.extent.height = p.height;
+            context.renderPassInfo.clearValueCount = p.attachmentCount;
+            context.renderPassInfo.pClearValues = p.clearValues;
+        }
+
+        p.function(context, p.data);
+    }
+
+    recordBarriers(cmd, batches.back());
+}
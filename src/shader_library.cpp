@@ -0,0 +1,357 @@
+#include "shader_library.h"
+#include "pipeline_cache.h"
+#include "hash.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static bool endsWith(const std::string &s, const char *suffix)
+{
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static shaderc_shader_kind shaderKind(const std::string &path)
+{
+    if(endsWith(path, ".vert")) return shaderc_vertex_shader;
+    if(endsWith(path, ".frag")) return shaderc_fragment_shader;
+    if(endsWith(path, ".comp")) return shaderc_compute_shader;
+    if(endsWith(path, ".geom")) return shaderc_geometry_shader;
+    if(endsWith(path, ".tesc")) return shaderc_tess_control_shader;
+    if(endsWith(path, ".tese")) return shaderc_tess_evaluation_shader;
+    return shaderc_glsl_infer_from_source;  //#pragma shader_stage(...)
+}
+
+static std::string directoryOf(const std::string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+}
+
+static bool readFile(const std::string &path, std::string &contents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()) return false;
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+void ShaderLibrary::init(const std::string &cacheDir, bool hotReload)
+{
+    this->cacheDir = cacheDir;
+    this->hotReload = hotReload;
+    quit = false;
+
+    compiler = shaderc_compiler_initialize();
+    if(!compiler)
+    {
+        LOGE_EXIT("Unable to initialize the shader compiler.");
+    }
+
+    //one level deep, the parent directory has the sources
+    if(!cacheDir.empty())
+    {
+#if defined(_WIN32)
+        CreateDirectoryA(cacheDir.c_str(), nullptr);
+#else
+        mkdir(cacheDir.c_str(), 0755);
+#endif
+    }
+
+    if(hotReload)
+    {
+        watcher = std::thread([this]() { watchLoop(); });
+    }
+}
+
+void ShaderLibrary::shutDown()
+{
+    quit = true;
+    if(watcher.joinable()) watcher.join();
+
+    shaderc_compiler_release(compiler);
+    sources.clear();
+    changed.clear();
+}
+
+bool ShaderLibrary::load(const char *path, std::vector<uint32> &spirv, uint64 &codeHash)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < sources.size(); i++)
+        {
+            if(sources[i].path == path)
+            {
+                //a source that didn't compile stays broken until scan() sees it change
+                if(sources[i].spirv.empty()) return false;
+
+                spirv = sources[i].spirv;
+                codeHash = sources[i].codeHash;
+                return true;
+            }
+        }
+    }
+
+    //compiled outside the lock, another thread may compile the same source meanwhile
+    ShaderSource shader;
+    shader.path = path;
+    shader.sourceHash = 0;
+    shader.codeHash = 0;
+
+    std::string contents;
+    bool loaded = readFile(shader.path, contents);
+    if(!loaded)
+    {
+        LOGE("Unable to open shader file {}.", shader.path);
+    }
+
+    if(endsWith(shader.path, ".spv"))
+    {
+        if(!loaded) return false;
+
+        shader.spirv.resize(contents.size() / sizeof(uint32));
+        memcpy(shader.spirv.data(), contents.data(), shader.spirv.size() * sizeof(uint32));
+    }
+    else
+    {
+        //kept even when it doesn't compile, or doesn't exist yet, so it is watched and scan()
+        //compiles it again once it changes
+        shader.sourceHash = hashBytes(contents.data(), contents.size());
+        loaded = loaded && compile(shader.path, contents, shader.spirv);
+        if(!loaded) shader.spirv.clear();
+    }
+
+    if(loaded)
+    {
+        shader.codeHash = hashBytes(shader.spirv.data(), shader.spirv.size() * sizeof(uint32));
+        spirv = shader.spirv;
+        codeHash = shader.codeHash;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for(size_t i = 0; i < sources.size(); i++)
+    {
+        if(sources[i].path == path) return loaded;
+    }
+    sources.push_back(std::move(shader));
+    return loaded;
+}
+
+void ShaderLibrary::takeChanged(std::vector<std::string> &paths)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    paths.swap(changed);
+    changed.clear();
+}
+
+bool ShaderLibrary::compile(const std::string &path, const std::string &source, std::vector<uint32> &spirv)
+{
+    shaderc_shader_kind kind = shaderKind(path);
+
+    //the same source compiled for the same stage with the same options is the same SPIR-V
+    uint32 version = SHADER_CACHE_VERSION;
+    uint64 key = hashBytes(source.data(), source.size());
+    key = hashBytes(&kind, sizeof(kind), key);
+    key = hashBytes(&version, sizeof(version), key);
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.spv", (unsigned long long)key);
+    std::string cachePath = cacheDir + name;
+
+    std::string cached;
+    if(!cacheDir.empty() && readFile(cachePath, cached) && !cached.empty() && cached.size() % sizeof(uint32) == 0)
+    {
+        spirv.resize(cached.size() / sizeof(uint32));
+        memcpy(spirv.data(), cached.data(), cached.size());
+        return true;
+    }
+
+    shaderc_compile_options_t options = shaderc_compile_options_initialize();
+    shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler,
+                                                                   source.data(), source.size(),
+                                                                   kind, path.c_str(), "main",
+                                                                   options);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    shaderc_compile_options_release(options);
+
+    bool compiled = shaderc_result_get_compilation_status(result) == shaderc_compilation_status_success;
+    if(compiled)
+    {
+        size_t size = shaderc_result_get_length(result);
+        spirv.resize(size / sizeof(uint32));
+        memcpy(spirv.data(), shaderc_result_get_bytes(result), size);
+
+        LOGI("Shader {}: compiled in {:.2f} ms", path, ms);
+        if(!cacheDir.empty()) writeFileAtomic(cachePath, spirv.data(), size);
+    }
+    else
+    {
+        LOGE("Shader {}:\n{}", path, shaderc_result_get_error_message(result));
+    }
+
+    shaderc_result_release(result);
+    return compiled;
+}
+
+void ShaderLibrary::watchLoop()
+{
+    //directories are watched as sources in them get loaded
+    std::vector<std::string> dirs;
+    std::vector<std::string> newDirs;
+    auto findNewDirs = [&]()
+    {
+        newDirs.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < sources.size(); i++)
+        {
+            if(!sources[i].sourceHash) continue;
+
+            std::string dir = directoryOf(sources[i].path);
+            bool known = false;
+            for(size_t d = 0; d < dirs.size() && !known; d++) known = dirs[d] == dir;
+            for(size_t d = 0; d < newDirs.size() && !known; d++) known = newDirs[d] == dir;
+            if(!known) newDirs.push_back(dir);
+        }
+    };
+
+#if defined(_WIN32)
+    std::vector<HANDLE> handles;
+    while(!quit)
+    {
+        findNewDirs();
+        for(size_t d = 0; d < newDirs.size() && handles.size() < MAXIMUM_WAIT_OBJECTS; d++)
+        {
+            HANDLE handle = FindFirstChangeNotificationA(newDirs[d].c_str(), FALSE,
+                                                         FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+            if(handle == INVALID_HANDLE_VALUE) continue;
+            handles.push_back(handle);
+            dirs.push_back(newDirs[d]);
+        }
+
+        if(handles.empty())
+        {
+            Sleep(100);
+            continue;
+        }
+
+        //the timeout is how long quit and new directories may wait
+        DWORD res = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, 100);
+        if(res >= WAIT_OBJECT_0 && res < WAIT_OBJECT_0 + handles.size())
+        {
+            Sleep(SHADER_RELOAD_SETTLE_MS);
+            for(size_t d = 0; d < handles.size(); d++)
+            {
+                if(WaitForSingleObject(handles[d], 0) == WAIT_OBJECT_0) FindNextChangeNotification(handles[d]);
+            }
+            scan();
+        }
+    }
+
+    for(size_t d = 0; d < handles.size(); d++)
+    {
+        FindCloseChangeNotification(handles[d]);
+    }
+#elif defined(__linux__)
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0)
+    {
+        LOGW("Shader hot reload: inotify unavailable");
+        return;
+    }
+
+    while(!quit)
+    {
+        findNewDirs();
+        for(size_t d = 0; d < newDirs.size(); d++)
+        {
+            //editors either write the file or rename a new one over it
+            if(inotify_add_watch(fd, newDirs[d].c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) >= 0)
+            {
+                dirs.push_back(newDirs[d]);
+            }
+        }
+
+        pollfd pfd{fd, POLLIN, 0};
+        if(poll(&pfd, 1, 100) > 0)
+        {
+            usleep(SHADER_RELOAD_SETTLE_MS * 1000);
+
+            //which files doesn't matter, scan() compares the contents
+            alignas(inotify_event) char buffer[4096];
+            while(read(fd, buffer, sizeof(buffer)) > 0) {}
+            scan();
+        }
+    }
+
+    close(fd);
+#else
+    while(!quit)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        scan();
+    }
+#endif
+}
+
+void ShaderLibrary::scan()
+{
+    std::vector<std::string> paths;
+    std::vector<uint64> hashes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < sources.size(); i++)
+        {
+            if(!sources[i].sourceHash) continue;
+            paths.push_back(sources[i].path);
+            hashes.push_back(sources[i].sourceHash);
+        }
+    }
+
+    for(size_t i = 0; i < paths.size(); i++)
+    {
+        std::string contents;
+        if(!readFile(paths[i], contents)) continue;
+
+        uint64 sourceHash = hashBytes(contents.data(), contents.size());
+        if(sourceHash == hashes[i]) continue;
+
+        std::vector<uint32> spirv;
+        bool compiled = compile(paths[i], contents, spirv);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t s = 0; s < sources.size(); s++)
+        {
+            if(sources[s].path != paths[i]) continue;
+
+            //a broken source isn't compiled again until it changes again
+            sources[s].sourceHash = sourceHash;
+            if(compiled)
+            {
+                sources[s].spirv.swap(spirv);
+                sources[s].codeHash = hashBytes(sources[s].spirv.data(), sources[s].spirv.size() * sizeof(uint32));
+                changed.push_back(paths[i]);
+                LOGI("Shader {}: reloaded", paths[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,307 @@
+#include "skinning.h"
+
+#include <string.h>
+#include <chrono>
+
+struct SkinningPushConstants
+{
+    uint32 vertexCount;
+    uint32 jointCount;
+};
+
+static const uint32 SKINNING_GROUP_SIZE = 64; //local_size_x of skinning.comp
+
+void GpuSkinning::init(VulkanManager &vulkanManager,
+                       VkCommandBuffer uploadCmd,
+                       const SkinnedVertex *vertices,
+                       uint32 vertexCount,
+                       uint32 jointCount,
+                       uint32 maxCharacters)
+{
+    VkDevice device = vulkanManager.logicalDevice.device;
+
+    this->vertexCount = vertexCount;
+    this->jointCount = jointCount;
+    this->maxCharacters = maxCharacters;
+
+    //-------- Bind pose --------
+    //read by every dispatch and never written, so it goes to device local memory once
+    VkDeviceSize bindPoseSize = vertexCount * sizeof(SkinnedVertex);
+
+    vulkanManager.initBuffer(bindPoseSize,
+                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             stagingBuffer,
+                             stagingMemory);
+
+    void *data;
+    VK_CHECK(vkMapMemory(device, stagingMemory, 0, bindPoseSize, 0, &data));
+    memcpy(data, vertices, bindPoseSize);
+    vkUnmapMemory(device, stagingMemory);
+
+    //uploaded on the graphics queue, then read by record() there or by recordAsync() on the
+    //compute queue. Never written again, so it is shared by both families instead of
+    //transferred to one of them
+    uint32 families[2] = {vulkanManager.physicalDevice.graphicsQueueFamilyIndex,
+                          vulkanManager.physicalDevice.computeQueueFamilyIndex};
+
+    vulkanManager.initBuffer(bindPoseSize,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             bindPoseBuffer,
+                             bindPoseMemory,
+                             families[0] != families[1] ? 2 : 0,
+                             families);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = bindPoseSize;
+    vkCmdCopyBuffer(uploadCmd, stagingBuffer, bindPoseBuffer, 1, &copyRegion);
+
+    //for the graphics queue's dispatches; the compute queue's are ordered after the upload by
+    //the semaphore wait of their submission, see recordAsync()
+    VkBufferMemoryBarrier uploadBarrier{};
+    uploadBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    uploadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    uploadBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    uploadBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    uploadBarrier.buffer = bindPoseBuffer;
+    uploadBarrier.offset = 0;
+    uploadBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(uploadCmd,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 1, &uploadBarrier, 0, nullptr);
+
+    //-------- Per frame buffers --------
+    //palettes are written by the CPU every frame and read once by the GPU, so they stay in
+    //host visible memory, persistently mapped
+    VkDeviceSize paletteSize = (VkDeviceSize)maxCharacters * jointCount * sizeof(mat4);
+    VkDeviceSize outputSize = (VkDeviceSize)maxCharacters * vertexCount * sizeof(SkinnedOutputVertex);
+
+    for(uint32 i = 0; i < MAX_FRAMES; i++)
+    {
+        vulkanManager.initBuffer(paletteSize,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 paletteBuffers[i],
+                                 paletteMemory[i]);
+
+        VK_CHECK(vkMapMemory(device, paletteMemory[i], 0, paletteSize, 0, (void**)&paletteMemoryPtr[i]));
+
+        vulkanManager.initBuffer(outputSize,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 outputBuffers[i],
+                                 outputMemory[i]);
+    }
+
+    //-------- Descriptors --------
+    VkDescriptorSetLayoutBinding layoutBindings[3] = {};
+    for(uint32 i = 0; i < 3; i++)
+    {
+        layoutBindings[i].binding = i;
+        layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[i].descriptorCount = 1;
+        layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        layoutBindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = layoutBindings;
+
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout));
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 3 * MAX_FRAMES;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = MAX_FRAMES;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool));
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+
+    for(uint32 i = 0; i < MAX_FRAMES; i++)
+    {
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
+
+        VkDescriptorBufferInfo bufferInfos[3] = {};
+        bufferInfos[0].buffer = paletteBuffers[i];
+        bufferInfos[0].range = VK_WHOLE_SIZE;
+        bufferInfos[1].buffer = bindPoseBuffer;
+        bufferInfos[1].range = VK_WHOLE_SIZE;
+        bufferInfos[2].buffer = outputBuffers[i];
+        bufferInfos[2].range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet writeDescriptorSets[3] = {};
+        for(uint32 b = 0; b < 3; b++)
+        {
+            writeDescriptorSets[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[b].dstSet = descriptorSets[i];
+            writeDescriptorSets[b].dstBinding = b;
+            writeDescriptorSets[b].descriptorCount = 1;
+            writeDescriptorSets[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writeDescriptorSets[b].pBufferInfo = &bufferInfos[b];
+        }
+
+        vkUpdateDescriptorSets(device, 3, writeDescriptorSets, 0, nullptr);
+    }
+
+    //-------- Pipeline --------
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(SkinningPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+    //compiled from the GLSL source like the graphics shaders. Not rebuilt on a reload: the
+    //compute pipeline isn't one of PipelineCompiler's
+    std::vector<uint32> code;
+    uint64 codeHash;
+    if(!vulkanManager.shaders.load("shaders/skinning/skinning.comp", code, codeHash))
+    {
+        LOGE_EXIT("Unable to compile the skinning shader.");
+    }
+
+    VkShaderModuleCreateInfo shaderCreateInfo{};
+    shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderCreateInfo.codeSize = code.size() * sizeof(uint32);
+    shaderCreateInfo.pCode = code.data();
+
+    VkShaderModule shaderModule;
+    VK_CHECK(vkCreateShaderModule(device, &shaderCreateInfo, nullptr, &shaderModule));
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+
+    //a compute pipeline has its one stage
+    PipelineFeedback feedback;
+    vulkanManager.pipelineCache.feedback(feedback, &pipelineInfo.pNext, 1);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    VK_CHECK(vkCreateComputePipelines(device,
+                                      vulkanManager.pipelineCache.cache,
+                                      1,
+                                      &pipelineInfo,
+                                      nullptr,
+                                      &pipeline));
+
+    vulkanManager.pipelineCache.created("skinning",
+                                        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                                        feedback);
+
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+void GpuSkinning::freeStaging(VulkanManager &vulkanManager)
+{
+    vkDestroyBuffer(vulkanManager.logicalDevice.device, stagingBuffer, nullptr);
+    vkFreeMemory(vulkanManager.logicalDevice.device, stagingMemory, nullptr);
+    stagingBuffer = VK_NULL_HANDLE;
+    stagingMemory = VK_NULL_HANDLE;
+}
+
+void GpuSkinning::destroy(VulkanManager &vulkanManager)
+{
+    VkDevice device = vulkanManager.logicalDevice.device;
+
+    if(stagingBuffer) freeStaging(vulkanManager);
+
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+    for(uint32 i = 0; i < MAX_FRAMES; i++)
+    {
+        vkUnmapMemory(device, paletteMemory[i]);
+        vkDestroyBuffer(device, paletteBuffers[i], nullptr);
+        vkFreeMemory(device, paletteMemory[i], nullptr);
+        vkDestroyBuffer(device, outputBuffers[i], nullptr);
+        vkFreeMemory(device, outputMemory[i], nullptr);
+    }
+
+    vkDestroyBuffer(device, bindPoseBuffer, nullptr);
+    vkFreeMemory(device, bindPoseMemory, nullptr);
+}
+
+void GpuSkinning::recordDispatch(VkCommandBuffer cmd, uint32 frame, uint32 characterCount)
+{
+    SkinningPushConstants pushConstants = {vertexCount, jointCount};
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout,
+                            0, 1, &descriptorSets[frame], 0, nullptr);
+    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(pushConstants), &pushConstants);
+
+    //one row of groups per character
+    vkCmdDispatch(cmd, (vertexCount + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, characterCount, 1);
+}
+
+void GpuSkinning::recordAsync(AsyncCompute &compute, uint32 frame, uint32 characterCount)
+{
+    if(characterCount == 0) return;
+
+    recordDispatch(compute.cmd(), frame, characterCount);
+
+    //the vertex stages only exist on the graphics queue, which waits for the output there
+    ComputeHandoff handoff{};
+    handoff.buffer = outputBuffers[frame];
+    handoff.offset = 0;
+    handoff.size = (VkDeviceSize)characterCount * vertexCount * sizeof(SkinnedOutputVertex);
+    handoff.srcStages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    handoff.srcAccess = VK_ACCESS_2_SHADER_WRITE_BIT_KHR;
+    handoff.dstStages = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT_KHR | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR;
+    handoff.dstAccess = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR | VK_ACCESS_2_SHADER_READ_BIT_KHR;
+    compute.handOff(handoff);
+}
+
+void GpuSkinning::record(VkCommandBuffer cmd, uint32 frame, uint32 characterCount)
+{
+    if(characterCount == 0) return;
+
+    recordDispatch(cmd, frame, characterCount);
+
+    //the output is read as vertex attributes, or as a storage buffer by a vertex shader
+    //that pulls its vertices
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = outputBuffers[frame];
+    barrier.offset = 0;
+    barrier.size = (VkDeviceSize)characterCount * vertexCount * sizeof(SkinnedOutputVertex);
+
+    vkCmdPipelineBarrier(cmd,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
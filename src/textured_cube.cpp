@@ -3,6 +3,20 @@
 
 #include "matrix.h"
 
+//draws per secondary command buffer: enough to amortize beginning one, few enough that
+//tens of thousands of draws spread over all the threads
+static const uint32 DRAWS_PER_BATCH = 256;
+
+//distance between the centers of neighbouring cubes in the field, in model space
+static const float CUBE_SPACING = 4.0f;
+
+//the skinned columns: joints one unit apart, rings of vertices between them
+static const uint32 COLUMN_JOINTS = 4;
+static const uint32 COLUMN_RINGS_PER_JOINT = 4;
+static const float COLUMN_HALF_WIDTH = 0.25f;
+static const float COLUMN_SPACING = 2.0f;
+static const uint32 SWAY_FRAMES = 61;     //2 seconds at 30 fps, the last one the first again
+static const float SWAY_ANGLE = 0.3f;     //radians, each joint relative to its parent
 
 const std::vector<float> vertices = 
 {
@@ -132,15 +146,36 @@ void Demo::startUp()
 
     this->width = 1280;
     this->height = 720;
+
+    //pick the widest batched math kernels the CPU supports
+    initMatrixKernels();
+    LOGI("Matrix kernels: {}", matrixKernelsName());
+    initCullingKernels();
+    LOGI("Culling kernels: {}", cullingKernelsName());
+    initPackingKernels();
+    LOGI("Packing kernels: {}", packingKernelsName());
+
+    jobs.startUp();
+    LOGI("Job system: {} threads", jobs.threadCount());
     
     //geometry data
     vertexData = vertices;
     uvData = texCoords; 
 
-    //load texture files
+    //decode the texture files on the workers while the window and Vulkan are initialized
     textures.resize(1);
     vulkanTextures.resize(1);
-    textures[0].load(std::string("textures/wooden_crate.png"));
+    textures[0].filepath = "textures/wooden_crate.png";
+
+    JobCounter texturesLoaded;
+    for(size_t i = 0; i < textures.size(); i++)
+    {
+        jobs.run([](void *data, size_t, size_t)
+        {
+            Texture *texture = (Texture*)data;
+            texture->load(texture->filepath);
+        }, &textures[i], texturesLoaded);
+    }
 
     //input
     input = {};
@@ -188,10 +223,24 @@ void Demo::startUp()
     
     // --- physical device features to enable ------
     vulkanConfig.physDeviceFeaturesToEnable.samplerAnisotropy = VK_TRUE;
+    vulkanConfig.useSynchronization2 = true;
+    vulkanConfig.useGraphicsPipelineLibrary = true;
 
     //--- formats ---
     vulkanConfig.preferredDepthFormat = VK_FORMAT_D32_SFLOAT;
-    vulkanConfig.preferredPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    vulkanConfig.latencyMode = LATENCY_LOW;
+    vulkanConfig.frameRateCap = 0.0f;
+    vulkanConfig.swapchainImageCount = 0;  //the latency mode's
+    vulkanConfig.framesInFlight = 2;
+    vulkanConfig.pipelineCacheFilePath = "pipeline_cache.bin";
+    vulkanConfig.pipelinePrewarmFilePath = "pipelines.bin";
+    vulkanConfig.pipelineCompileThreads = 2;
+    vulkanConfig.shaderCacheDir = "shaders/cache";
+#if defined(_DEBUG)
+    vulkanConfig.hotReloadShaders = true;  //a thread watching the sources, for development only
+#else
+    vulkanConfig.hotReloadShaders = false;
+#endif
     vulkanConfig.preferredSurfaceFormat.format = VK_FORMAT_B8G8R8A8_UNORM;
     vulkanConfig.preferredSurfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
     vulkanConfig.texFormat = VK_FORMAT_R8G8B8A8_UNORM;
@@ -213,11 +262,24 @@ void Demo::startUp()
     float n = 0.1f;
     float f = 100.0f;
 
-    modelMatrix = mat4(1.0f);
+    cubeTransform = transforms.add(NO_TRANSFORM, vec3(0.0f, 0.0f, 0.0f), quatIdentity(), vec3(1.0f, 1.0f, 1.0f));
+    transforms.update();
+    modelMatrix = transforms.getWorld(cubeTransform);
+    initCubeField();
+    initCharacters();
     
     viewMatrix = camera.getViewMatrix();
     
-    projMatrix = vulkanPerspective(aspect, yFov, n, f),
+    projMatrix = vulkanPerspective(aspect, yFov, n, f);
+
+    //culling comes before the camera is latched, which can turn it mouseSensitivity degrees
+    //each way, and before the prediction, clamped to as much again
+    cullProjMatrix = vulkanPerspective(aspect, yFov + 4.0f * mouseSensitivity, n, f);
+    cameraVelocity = vec3(0.0f, 0.0f, 0.0f);
+    lastLatch = std::chrono::steady_clock::now();
+
+    //prepare() uploads the textures
+    jobs.wait(texturesLoaded);
 
     isInitialized = true;
 }
@@ -227,11 +289,16 @@ void Demo::shutDown()
     isPrepared = false;
     vkDeviceWaitIdle(vulkanManager.logicalDevice.device);
 
+    recorder.destroy();
+    graph.destroy();
+    if(characterCount) skinning.destroy(vulkanManager);
+
     for(size_t i = 0; i < vulkanTextures.size(); i++)
     {
         vulkanManager.freeVulkanTexture(vulkanTextures[i]);
     } 
     
+    destroyCubeDataBuffers();
     vkDestroyDescriptorPool(vulkanManager.logicalDevice.device, 
                             descriptorPool, nullptr);
 
@@ -244,6 +311,8 @@ void Demo::shutDown()
     {
         vulkanManager.shutDown(); 
     }
+
+    jobs.shutDown();
 }
 
 void Demo::prepare()
@@ -270,7 +339,8 @@ void Demo::prepare()
                                                        vulkanManager.logicalDevice.device,
                                                        vulkanManager.surface,
                                                        vulkanManager.config.preferredSurfaceFormat,
-                                                       vulkanManager.config.preferredPresentMode,
+                                                       vulkanManager.config.latencyMode,
+                                                       vulkanManager.logicalDevice.waitForPresent != nullptr,
                                                        &this->width, &this->height);
     
     if(this->width == 0 || 
@@ -290,24 +360,18 @@ void Demo::prepare()
     }   
 
     vulkanManager.swapchain.createSwapchainAndImageResources(vulkanManager.surface,
-                                                             vulkanManager.logicalDevice.device);
-
-    vulkanManager.initDepthImage(vulkanManager.config.preferredDepthFormat,
-                                 this->width, this->height); 
+                                                             vulkanManager.logicalDevice.device,
+                                                             vulkanManager.config.swapchainImageCount);
+    vulkanManager.scheduler.initImages(vulkanManager.swapchain.imageCount);
+    vulkanManager.pacer.setSwapchain(vulkanManager.swapchain.swapchain, vulkanManager.swapchain.presentSettings);
 
     initStagingTexture();
     initTextures();
     initCubeDataBuffers();
     initDescriptorLayout();
-    initRenderPass();
+    initRenderGraph();
     initPipeline();
-
-    for(uint32 i = 0; i < vulkanManager.swapchain.imageCount; i++)
-    {
-        VK_CHECK(vkAllocateCommandBuffers(vulkanManager.logicalDevice.device,
-                                          &cmdAllocInfo,
-                                          &vulkanManager.swapchain.imageResources[i].cmd));
-    }
+    initSkinning();
 
     if(vulkanManager.physicalDevice.separatePresentQueue)
     {
@@ -338,18 +402,15 @@ void Demo::prepare()
     
     initDescriptorPool();
     initDescriptorSet();
-    initFramebuffers(); 
-    
-    for(uint32 i = 0; i < vulkanManager.swapchain.imageCount; i++)
-    {
-        currBufferIndex = i;
-        recordDrawCommands(vulkanManager.swapchain.imageResources[i].cmd);
-    } 
+
+    //the draw commands are recorded every frame, see updateAndRender()
+    recorder.init(vulkanManager, jobs.threadCount());
     
     //flush pipeline commands before beginning the render loop 
     flushInitCmd();
 
     vulkanManager.freeVulkanTexture(stagingTexture);
+    if(characterCount) skinning.freeStaging(vulkanManager);
     
     currBufferIndex = 0;
     isPrepared = true;
@@ -357,10 +418,13 @@ void Demo::prepare()
 
 void Demo::initStagingTexture()
 {
+    //every texture, back to back
     stagingTexture = {};
-    stagingTexture.width = textures[0].width;
-    stagingTexture.height = textures[0].height;
-    VkDeviceSize imgSize = stagingTexture.width* stagingTexture.height * 4;
+    VkDeviceSize imgSize = 0;
+    for(size_t i = 0; i < textures.size(); i++)
+    {
+        imgSize += (VkDeviceSize)textures[i].width * textures[i].height * 4;
+    }
     
     vulkanManager.initBuffer(imgSize,
                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -371,70 +435,83 @@ void Demo::initStagingTexture()
 
 void Demo::initTextures()
 {
-
-    assert((textures[0].pixels != nullptr) && (textures[0].height > 0) && (textures[0].width > 0));
     assert((stagingTexture.buffer != VK_NULL_HANDLE) && (stagingTexture.mem != nullptr));
 
-    //4 bytes per pixel;
-    uint32 texWidth = textures[0].width;
-    uint32 texHeight = textures[0].height;
-    uint8 *texPixels = textures[0].pixels;
-    VkDeviceSize imgSize = texWidth * texHeight * 4;
+    //copy texture data to staging buffer, 4 bytes per pixel
+    std::vector<VkDeviceSize> offsets(textures.size());
+    VkDeviceSize stagingSize = 0;
+    for(size_t i = 0; i < textures.size(); i++)
+    {
+        assert((textures[i].pixels != nullptr) && (textures[i].height > 0) && (textures[i].width > 0));
+        offsets[i] = stagingSize;
+        stagingSize += (VkDeviceSize)textures[i].width * textures[i].height * 4;
+    }
 
-    //copy texture data to staging buffer
-    void *data;
-    vkMapMemory(vulkanManager.logicalDevice.device, stagingTexture.mem, 0, imgSize, 0, &data);
-    memcpy(data, texPixels, (size_t)(imgSize));
+    uint8 *data;
+    vkMapMemory(vulkanManager.logicalDevice.device, stagingTexture.mem, 0, stagingSize, 0, (void **)&data);
+    for(size_t i = 0; i < textures.size(); i++)
+    {
+        memcpy(data + offsets[i], textures[i].pixels, (size_t)textures[i].width * textures[i].height * 4);
+    }
     vkUnmapMemory(vulkanManager.logicalDevice.device, stagingTexture.mem);
 
-    //init texture image 
-
-    VkMemoryPropertyFlags requiredImageProperties = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-    vulkanManager.initImage(texWidth, texHeight,
-                            vulkanManager.config.texFormat, VK_IMAGE_TILING_OPTIMAL,
-                            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
-                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_PREINITIALIZED,
-                            vulkanTextures[0].image, vulkanTextures[0].mem);
-
-    vulkanTextures[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    vulkanManager.setImageLayout(vulkanTextures[0].image,
-                                 VK_IMAGE_ASPECT_COLOR_BIT,
-                                 VK_IMAGE_LAYOUT_PREINITIALIZED,
-                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-                                 VK_ACCESS_NONE_KHR,
-                                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-    VkBufferImageCopy copyRegion{};
-    copyRegion.bufferOffset = 0; 
-    copyRegion.bufferRowLength = 0; //means texture is tighly packed
-    copyRegion.bufferImageHeight = 0; //means texture is tighly packed
-
-    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copyRegion.imageSubresource.mipLevel = 0;
-    copyRegion.imageSubresource.baseArrayLayer = 0;
-    copyRegion.imageSubresource.layerCount = 1;
-
-    copyRegion.imageOffset = {0, 0, 0};
-    copyRegion.imageExtent = {(uint32)texWidth, (uint32)texHeight, 1};
-
-    vkCmdCopyBufferToImage(vulkanManager.cmdBuffer, 
-                           stagingTexture.buffer, 
-                           vulkanTextures[0].image, 
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1,
-                           &copyRegion);
-
-    vulkanManager.setImageLayout(vulkanTextures[0].image,
-                                 VK_IMAGE_ASPECT_COLOR_BIT,
-                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                 vulkanTextures[0].imageLayout, 
-                                 VK_ACCESS_TRANSFER_WRITE_BIT,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    //init texture images, all of them go to TRANSFER_DST with one barrier call
+    BarrierBatch &barriers = vulkanManager.barriers;
+    for(size_t i = 0; i < textures.size(); i++)
+    {
+        vulkanManager.initImage(textures[i].width, textures[i].height,
+                                vulkanManager.config.texFormat, VK_IMAGE_TILING_OPTIMAL,
+                                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_PREINITIALIZED,
+                                vulkanTextures[i].image, vulkanTextures[i].mem);
+
+        vulkanTextures[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        barriers.trackImage(vulkanTextures[i].image, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, VK_IMAGE_LAYOUT_PREINITIALIZED);
+        barriers.image(vulkanTextures[i].image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+                       VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
+    }
+    barriers.flush(vulkanManager.cmdBuffer);
 
+    for(size_t i = 0; i < textures.size(); i++)
+    {
+        VkBufferImageCopy copyRegion{};
+        copyRegion.bufferOffset = offsets[i]; 
+        copyRegion.bufferRowLength = 0; //means texture is tighly packed
+        copyRegion.bufferImageHeight = 0; //means texture is tighly packed
+
+        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copyRegion.imageSubresource.mipLevel = 0;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = 1;
+
+        copyRegion.imageOffset = {0, 0, 0};
+        copyRegion.imageExtent = {(uint32)textures[i].width, (uint32)textures[i].height, 1};
+
+        vkCmdCopyBufferToImage(vulkanManager.cmdBuffer, 
+                               stagingTexture.buffer, 
+                               vulkanTextures[i].image, 
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               1,
+                               &copyRegion);
+
+        barriers.image(vulkanTextures[i].image,
+                       vulkanTextures[i].imageLayout,
+                       VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                       VK_ACCESS_2_SHADER_READ_BIT_KHR);
+    }
+    barriers.flush(vulkanManager.cmdBuffer);
+
+    for(size_t i = 0; i < textures.size(); i++)
+    {
+        initTextureSampler(vulkanTextures[i]);
+    }
+}
+
+void Demo::initTextureSampler(VulkanTexture &texture)
+{
     //--- sampler ---
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -461,12 +538,12 @@ void Demo::initTextures()
     samplerInfo.maxLod = 0.0f;
     
     VK_CHECK(vkCreateSampler(vulkanManager.logicalDevice.device, 
-                             &samplerInfo, nullptr, &vulkanTextures[0].sampler));
+                             &samplerInfo, nullptr, &texture.sampler));
 
     //--- image view ----
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = vulkanTextures[0].image;
+    viewInfo.image = texture.image;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format = vulkanManager.config.texFormat;
 
@@ -477,8 +554,123 @@ void Demo::initTextures()
     viewInfo.subresourceRange.layerCount = 1;
     
     VK_CHECK(vkCreateImageView(vulkanManager.logicalDevice.device, 
-                               &viewInfo, nullptr, &vulkanTextures[0].view));
+                               &viewInfo, nullptr, &texture.view));
+
+}
 
+void Demo::initCubeField()
+{
+    //a square grid on the XZ plane centered on the cube transform, one cube sits at the
+    //origin when drawCount is 1
+    uint32 side = 1;
+    while(side * side < drawCount) side++;
+    float center = 0.5f * (float)(side - 1);
+
+    cubeOffsets.resize(drawCount);
+    cubeBoundsX.resize(drawCount);
+    cubeBoundsY.resize(drawCount);
+    cubeBoundsZ.resize(drawCount);
+    cubeBoundsRadius.resize(drawCount);
+    visibleCubes.resize(drawCount);
+
+    for(uint32 i = 0; i < drawCount; i++)
+    {
+        float x = ((float)(i % side) - center) * CUBE_SPACING;
+        float z = ((float)(i / side) - center) * CUBE_SPACING;
+
+        cubeOffsets[i] = vec4(x, 0.0f, z, 0.0f);
+        cubeBoundsX[i] = x;
+        cubeBoundsY[i] = 0.0f;
+        cubeBoundsZ[i] = z;
+        cubeBoundsRadius[i] = 1.7320508f; //half diagonal of the [-1, 1] cube
+    }
+}
+
+//A bind pose vertex of the column, weighted between the joint below it and the one above.
+static SkinnedVertex columnVertex(float x, float y, float z, float nx, float nz)
+{
+    uint32 below = (uint32)y < COLUMN_JOINTS - 1 ? (uint32)y : COLUMN_JOINTS - 1;
+    uint32 above = below + 1 < COLUMN_JOINTS ? below + 1 : below;
+    uint32 weightAbove = below == above ? 0 : (uint32)((y - (float)below) * 255.0f + 0.5f);
+
+    SkinnedVertex vertex{};
+    vertex.position[0] = x;
+    vertex.position[1] = y;
+    vertex.position[2] = z;
+    vertex.position[3] = 1.0f;
+    vertex.normal[0] = nx;
+    vertex.normal[2] = nz;
+    vertex.joints = below | (above << 8);
+    vertex.weights = (255 - weightAbove) | (weightAbove << 8);
+    return vertex;
+}
+
+void Demo::initCharacters()
+{
+    //a chain of joints up the Y axis, the root at the origin
+    skeleton.parent.resize(COLUMN_JOINTS);
+    skeleton.inverseBind.resize(COLUMN_JOINTS);
+    for(uint32 j = 0; j < COLUMN_JOINTS; j++)
+    {
+        skeleton.parent[j] = j == 0 ? NO_JOINT : j - 1;
+        skeleton.inverseBind[j] = composeTRS(vec3(0.0f, -(float)j, 0.0f), quatIdentity(), vec3(1.0f, 1.0f, 1.0f));
+    }
+
+    //every joint sways about Z, a little after the one below it
+    swayClip.sampleRate = 30.0f;
+    swayClip.frameCount = SWAY_FRAMES;
+    swayClip.blockCount = (uint32)skeleton.blockCount();
+    for(uint32 f = 0; f < SWAY_FRAMES; f++)
+    {
+        float phase = 2.0f * M_PI * (float)f / (float)(SWAY_FRAMES - 1);
+        for(uint32 b = 0; b < swayClip.blockCount; b++)
+        {
+            vec3 t[4];
+            quat r[4];
+            for(uint32 i = 0; i < 4; i++)
+            {
+                uint32 j = b * 4 + i;
+                t[i] = vec3(0.0f, j == 0 ? 0.0f : 1.0f, 0.0f);
+                r[i] = quatAxisAngle(vec3(0.0f, 0.0f, 1.0f), SWAY_ANGLE * sinf(phase - 0.6f * (float)j));
+            }
+            swayClip.translations.push_back(vec3x4(t[0], t[1], t[2], t[3]));
+            swayClip.rotations.push_back(quatx4(r[0], r[1], r[2], r[3]));
+            swayClip.scales.push_back(vec3x4(vec3(1.0f, 1.0f, 1.0f)));
+        }
+    }
+
+    //a square tube around the chain, drawn as a plain triangle list
+    const float sides[4][2] = {{1.0f, 0.0f}, {0.0f, 1.0f}, {-1.0f, 0.0f}, {0.0f, -1.0f}};
+    float w = COLUMN_HALF_WIDTH;
+    columnVertices.clear();
+    for(uint32 k = 0; k < COLUMN_JOINTS * COLUMN_RINGS_PER_JOINT; k++)
+    {
+        float y0 = (float)k / (float)COLUMN_RINGS_PER_JOINT;
+        float y1 = (float)(k + 1) / (float)COLUMN_RINGS_PER_JOINT;
+        for(uint32 s = 0; s < 4; s++)
+        {
+            float nx = sides[s][0], nz = sides[s][1];
+            float x0 = w * (nx + nz), z0 = w * (nz - nx);  //the side's two corners
+            float x1 = w * (nx - nz), z1 = w * (nz + nx);
+
+            columnVertices.push_back(columnVertex(x0, y0, z0, nx, nz));
+            columnVertices.push_back(columnVertex(x1, y0, z1, nx, nz));
+            columnVertices.push_back(columnVertex(x1, y1, z1, nx, nz));
+            columnVertices.push_back(columnVertex(x0, y0, z0, nx, nz));
+            columnVertices.push_back(columnVertex(x1, y1, z1, nx, nz));
+            columnVertices.push_back(columnVertex(x0, y1, z0, nx, nz));
+        }
+    }
+
+    //in a row behind the field, standing on the cubes' bottom face, out of step
+    characters.resize(characterCount);
+    characterOffsets.resize(characterCount);
+    float back = (cubeBoundsZ.empty() ? 0.0f : cubeBoundsZ[0]) - CUBE_SPACING;
+    for(uint32 c = 0; c < characterCount; c++)
+    {
+        characters[c] = {&skeleton, &swayClip, 0.37f * (float)c, true, c * COLUMN_JOINTS};
+        characterOffsets[c] = vec4(((float)c - 0.5f * (float)(characterCount - 1)) * COLUMN_SPACING, -1.0f, back, 0.0f);
+    }
 }
 
 void Demo::initCubeDataBuffers()
@@ -505,20 +697,35 @@ void Demo::initCubeDataBuffers()
                             0.0f);
     }
 
-    for(size_t i = 0; i < vulkanManager.swapchain.imageResources.size(); i++) 
+    for(uint32 i = 0; i < vulkanManager.scheduler.framesInFlight; i++) 
     {
         vulkanManager.initBuffer(sizeof(data), 
                                  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                 vulkanManager.swapchain.imageResources[i].uniformBuffer, 
-                                 vulkanManager.swapchain.imageResources[i].uniformMemory);
+                                 uniformBuffers[i], 
+                                 uniformMemory[i]);
 
         VK_CHECK(vkMapMemory(vulkanManager.logicalDevice.device,
-                             vulkanManager.swapchain.imageResources[i].uniformMemory,
+                             uniformMemory[i],
                              0, VK_WHOLE_SIZE, 0, 
-                             &vulkanManager.swapchain.imageResources[i].uniformMemoryPtr));
+                             &uniformMemoryPtr[i]));
 
-        memcpy(vulkanManager.swapchain.imageResources[i].uniformMemoryPtr, &data, sizeof(data));
+        memcpy(uniformMemoryPtr[i], &data, sizeof(data));
+    }
+}
+
+void Demo::destroyCubeDataBuffers()
+{
+    //a minimized window's prepare() doesn't create them
+    for(uint32 i = 0; i < vulkanManager.scheduler.framesInFlight; i++) 
+    {
+        if(uniformMemory[i] == VK_NULL_HANDLE) continue;
+
+        vkUnmapMemory(vulkanManager.logicalDevice.device, uniformMemory[i]);
+        vkDestroyBuffer(vulkanManager.logicalDevice.device, uniformBuffers[i], nullptr);
+        vkFreeMemory(vulkanManager.logicalDevice.device, uniformMemory[i], nullptr);
+        uniformBuffers[i] = VK_NULL_HANDLE;
+        uniformMemory[i] = VK_NULL_HANDLE;
     }
 }
 
@@ -551,110 +758,39 @@ void Demo::initDescriptorLayout()
                                          &descriptorSetLayout));
 }
 
-void Demo::initRenderPass()
+void Demo::initRenderGraph()
 {
-    //Layout transitions:
-    //color attachment: 
-    //      -at the start of the render pass: UNDEFINED -> COLOR_ATTACHMENT_OPTIONAL.
-    //      -at the start of the subpass COLOR_ATTACHMENT_OPTIONAL -> PRESENT_SRC_KHR;
-    //
-    //depth attachment:
-    //      -at the start of the render pass: UNDEFINED -> DEPTH_STENCIL_ATTACHMENT_OPTIONAL.
-    //
-    //NOTE: This is all done as part ofthe renderpass, no barriers are necessary
-
-
-    //color attachment:
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = vulkanManager.swapchain.surfaceFormat.format; //must match swapchain format
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT; //not multisampled
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; //clear to black at frame start
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; //store the results when the frame ends
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; //not using a stencil buffer
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; //not using a stencil buffer
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; //image layout undefined at render pass start 
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;//transition layout to PRESENT_SRC_KHR 
-                                                                    //when render pass is complete
-
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0; //index of our single attachment
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    //depth attachment:
-    VkAttachmentDescription depthAttachment{};
-    depthAttachment.format = vulkanManager.config.preferredDepthFormat;
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference depthAttachmentRef{};
-    depthAttachmentRef.attachment = 1;
-    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment};
-
-    //-------- Subpass -------
-    //There will be a single subpass with a color and a depth attachment.
-
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-    subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-    //need to wait for the Window System Integration semaphore to signal
-    //"Only pipeline stages which depend on COLOR_ATTACHMENT_OUTPUT_BIT will
-    // actually wait for the semaphore, so we must also wait for that pipeline stage."
-    // src: official vulkan samples.
-
-
-    VkSubpassDependency attachmentDependencies[2] = {};
-    //[0]
-    {
-        // Depth buffer is shared between swapchain images
-        attachmentDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL,
-        attachmentDependencies[0].dstSubpass = 0,
-        attachmentDependencies[0].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | 
-                                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-
-        attachmentDependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | 
-                                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-
-        attachmentDependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-        attachmentDependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | 
-                                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-        attachmentDependencies[0].dependencyFlags = 0;
-    }
-    //[1]
-    {
-        attachmentDependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
-        attachmentDependencies[1].dstSubpass = 0;
-        attachmentDependencies[1].srcStageMask =  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        attachmentDependencies[1].srcAccessMask = 0;
-        attachmentDependencies[1].dstStageMask =  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        attachmentDependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    }
-
-    //create the render pass:
-    VkRenderPassCreateInfo renderPassCreateInfo{};
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount = (uint32)(sizeof(attachments) / sizeof(attachments[0])); 
-    renderPassCreateInfo.pAttachments = attachments;
-    renderPassCreateInfo.subpassCount = 1;
-    renderPassCreateInfo.pSubpasses = &subpass;
-    renderPassCreateInfo.dependencyCount = 2;
-    renderPassCreateInfo.pDependencies = attachmentDependencies;
-
-    VK_CHECK(vkCreateRenderPass(vulkanManager.logicalDevice.device, 
-                                &renderPassCreateInfo, 
-                                nullptr, 
-                                &vulkanManager.renderPass));
+    //The cubes are drawn into the swapchain image with a depth buffer that only lives during
+    //the frame. The render pass, the layout changes and the release of the image to the
+    //present queue all come from the graph.
+    uint32 presentFamily = vulkanManager.physicalDevice.separatePresentQueue ? 
+                           vulkanManager.physicalDevice.presentQueueFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+
+    backbuffer = graph.importImage("backbuffer", vulkanManager.swapchain.surfaceFormat.format,
+                                   this->width, this->height,
+                                   USAGE_SWAPCHAIN_ACQUIRE, USAGE_PRESENT, presentFamily);
+
+    uint32 depthBuffer = graph.createImage("depth", vulkanManager.config.preferredDepthFormat,
+                                           this->width, this->height);
+
+    VkClearValue clearColor{};
+    clearColor.color = {0.0f, 0.0f, 0.0f, 1.0f};
+    VkClearValue clearDepth{};
+    clearDepth.depthStencil = {0.0f, 0}; //reverse Z
+
+    mainPass = graph.addPass("cubes", [](const RenderGraphContext &context, void *data)
+                                      {
+                                          ((Demo *)data)->recordMainPass(context);
+                                      }, this);
+    graph.use(mainPass, backbuffer, USAGE_COLOR_ATTACHMENT, &clearColor);
+    graph.use(mainPass, depthBuffer, USAGE_DEPTH_ATTACHMENT, &clearDepth);
+
+    graph.compile(vulkanManager);
+
+    const RenderGraphStats &stats = graph.stats;
+    LOGI("Render graph: {} passes ({} culled), {} barriers in {} batches, {} KB of transient images in {} KB",
+         stats.passes, stats.culledPasses, stats.barriers, stats.barrierBatches,
+         stats.transientBytes / 1024, stats.allocatedBytes / 1024);
 }
 
 void Demo::initPipeline()
@@ -663,164 +799,59 @@ void Demo::initPipeline()
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+
+    //model space offset of the cube being drawn
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(vec4);
+
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
     
     VK_CHECK(vkCreatePipelineLayout(vulkanManager.logicalDevice.device, 
                                     &pipelineLayoutInfo, 
                                     nullptr, 
                                     &vulkanManager.pipelineLayout));
-    
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-    //specify triangle lists as topology to draw geometry
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{};
-    inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
-
-    //specify rasterization state
-    VkPipelineRasterizationStateCreateInfo rasterInfo{};
-    rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterInfo.depthClampEnable = VK_FALSE;
-    rasterInfo.rasterizerDiscardEnable = VK_FALSE;
-    rasterInfo.depthBiasEnable = VK_FALSE;
-    rasterInfo.lineWidth = 1.0f;
-
-    //attachment will write to all color channels
-    //no blending enabled
-    VkPipelineColorBlendAttachmentState blendAttachment{};
-    blendAttachment.colorWriteMask =    VK_COLOR_COMPONENT_R_BIT | 
-                                        VK_COLOR_COMPONENT_G_BIT |
-                                        VK_COLOR_COMPONENT_B_BIT |
-                                        VK_COLOR_COMPONENT_A_BIT;
-    blendAttachment.blendEnable = VK_FALSE;
-
-    VkPipelineColorBlendStateCreateInfo blendStateInfo{};
-    blendStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    blendStateInfo.attachmentCount = 1;
-    blendStateInfo.pAttachments = &blendAttachment;
-
-    //specify that one viewport and one scissor box will be used
-    VkPipelineViewportStateCreateInfo viewportInfo{};
-    viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportInfo.viewportCount = 1;
-    viewportInfo.scissorCount = 1;
-
-    //disable depth and stencil testing
-    VkPipelineDepthStencilStateCreateInfo depthInfo{};
-    depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthInfo.depthTestEnable = VK_TRUE;
-    depthInfo.depthWriteEnable = VK_TRUE;
-    depthInfo.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL ;
-    depthInfo.depthBoundsTestEnable = VK_FALSE;
-    depthInfo.minDepthBounds = 0.0f;
-    depthInfo.maxDepthBounds = 1.0f;
-    depthInfo.stencilTestEnable = VK_FALSE;
-    depthInfo.back.failOp = VK_STENCIL_OP_KEEP;
-    depthInfo.back.passOp = VK_STENCIL_OP_KEEP;
-    depthInfo.front = depthInfo.back;
-
-    //specify no multisampling
-    VkPipelineMultisampleStateCreateInfo multisampleInfo{};
-    multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-    //Specify that the viewport and scissor states will be dynamic.
-    std::vector<VkDynamicState> dynamicStates{VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-
-    VkPipelineDynamicStateCreateInfo dynamicStatesCreateInfo{};
-    dynamicStatesCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicStatesCreateInfo.pDynamicStates = dynamicStates.data();
-    dynamicStatesCreateInfo.dynamicStateCount = (uint32)(dynamicStates.size());
-
-    //Load shader modules
-    std::vector<char> vsBuffer;
-    std::vector<char> fsBuffer;
-    
-    std::string vsFilename = "shaders/textured_cube/textured_cube_vert.spv";
-    std::string fsFilename = "shaders/textured_cube/textured_cube_frag.spv";
-    
-    loadShaderModule(vsFilename, vsBuffer);
-    loadShaderModule(fsFilename, fsBuffer);
-
-    VkShaderModuleCreateInfo vertShaderCreateInfo{};
-    vertShaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    vertShaderCreateInfo.codeSize = vsBuffer.size();
-    vertShaderCreateInfo.pCode = reinterpret_cast<const uint32*>(vsBuffer.data());
-
-    VkShaderModuleCreateInfo fragShaderCreateInfo{};
-    fragShaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    fragShaderCreateInfo.codeSize = fsBuffer.size();
-    fragShaderCreateInfo.pCode = reinterpret_cast<const uint32*>(fsBuffer.data());
-    
-    //create shader modules 
-    VkShaderModule vertShaderModule;
-    VkShaderModule fragShaderModule;
-    
-    VK_CHECK(vkCreateShaderModule(vulkanManager.logicalDevice.device, 
-                                  &vertShaderCreateInfo, 
-                                  nullptr, 
-                                  &vertShaderModule));
-    VK_CHECK(vkCreateShaderModule(vulkanManager.logicalDevice.device, 
-                                  &fragShaderCreateInfo, 
-                                  nullptr, 
-                                  &fragShaderModule));
-
-    VkPipelineShaderStageCreateInfo vsInfo{};
-    vsInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vsInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vsInfo.module = vertShaderModule;
-    vsInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo fsInfo{};
-    fsInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fsInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fsInfo.module = fragShaderModule;
-    fsInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vsInfo, fsInfo};
-    
-    //init pipeline cache
-    VkPipelineCacheCreateInfo pipelineCacheInfo{};
-    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    VK_CHECK(vkCreatePipelineCache(vulkanManager.logicalDevice.device,
-                                   &pipelineCacheInfo,
-                                   nullptr,
-                                   &vulkanManager.pipelineCache));
-
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2; //2 -> vertex and shader stages
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
-    pipelineInfo.pRasterizationState = &rasterInfo;
-    pipelineInfo.pColorBlendState = &blendStateInfo;
-    pipelineInfo.pMultisampleState = &multisampleInfo;
-    pipelineInfo.pViewportState = &viewportInfo;
-    pipelineInfo.pDepthStencilState = &depthInfo;
-    pipelineInfo.pDynamicState = &dynamicStatesCreateInfo;
-    pipelineInfo.renderPass = vulkanManager.renderPass;
-    pipelineInfo.layout = vulkanManager.pipelineLayout;
-
-    VK_CHECK(vkCreateGraphicsPipelines(vulkanManager.logicalDevice.device, 
-                                       vulkanManager.pipelineCache, 
-                                       1, 
-                                       &pipelineInfo, 
-                                       nullptr, 
-                                       &vulkanManager.pipeline));
-
-    //shader modules are safe to destroy after the graphics pipeline is created
-    vkDestroyShaderModule(vulkanManager.logicalDevice.device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(vulkanManager.logicalDevice.device, vertShaderModule, nullptr);
+    //every pipeline draws into the main pass with this layout
+    vulkanManager.pipelines.begin(graph.renderPass(mainPass), vulkanManager.pipelineLayout);
+
+    //the generic pipeline, compiled now so there is something to draw with. Variants
+    //requested later fall back to it until they are compiled
+    GraphicsPipelineDesc cubeDesc = makePipelineDesc("shaders/textured_cube/textured_cube.vert",
+                                                     "shaders/textured_cube/textured_cube.frag");
+    cubePipeline = vulkanManager.pipelines.compile(cubeDesc);
+
+    //the skinned columns, from the skinning dispatch's output. Seen from all around as they
+    //sway, so no culling
+    GraphicsPipelineDesc skinnedDesc = makePipelineDesc("shaders/skinning/skinned.vert",
+                                                        "shaders/skinning/skinned.frag");
+    skinnedDesc.vertexInput = VERTEX_INPUT_SKINNED;
+    skinnedDesc.cullMode = VK_CULL_MODE_NONE;
+    skinnedPipeline = vulkanManager.pipelines.compile(skinnedDesc);
+}
+
+void Demo::initSkinning()
+{
+    if(characterCount == 0) return;
+
+    //the bind pose is uploaded with the textures, by the init command buffer
+    skinning.init(vulkanManager, vulkanManager.cmdBuffer,
+                  columnVertices.data(), (uint32)columnVertices.size(),
+                  (uint32)skeleton.jointCount(), characterCount);
 }
 
 void Demo::setupImageOwnership(int i)
 {
+    //the acquire half of the release recorded by the render graph: same families and layouts,
+    //so the layout change the graph started happens once
+    RenderGraphBarrier release{};
+    if(!graph.finalBarrier(backbuffer, release) || release.srcQueueFamily == release.dstQueueFamily)
+    {
+        LOGE_EXIT("The render graph doesn't release the swapchain image to the present queue.");
+    }
+
     VkCommandBufferBeginInfo cmdBeginInfo{};
     cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     cmdBeginInfo.pNext = nullptr;
@@ -833,11 +864,11 @@ void Demo::setupImageOwnership(int i)
     VkImageMemoryBarrier imageOwnershipBarrier{};
     imageOwnershipBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     imageOwnershipBarrier.srcAccessMask = 0;
-    imageOwnershipBarrier.dstAccessMask = 0;
-    imageOwnershipBarrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    imageOwnershipBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    imageOwnershipBarrier.srcQueueFamilyIndex = vulkanManager.physicalDevice.graphicsQueueFamilyIndex;
-    imageOwnershipBarrier.dstQueueFamilyIndex = vulkanManager.physicalDevice.presentQueueFamilyIndex;
+    imageOwnershipBarrier.dstAccessMask = release.dstAccess;
+    imageOwnershipBarrier.oldLayout = release.oldLayout;
+    imageOwnershipBarrier.newLayout = release.newLayout;
+    imageOwnershipBarrier.srcQueueFamilyIndex = release.srcQueueFamily;
+    imageOwnershipBarrier.dstQueueFamilyIndex = release.dstQueueFamily;
     imageOwnershipBarrier.image = vulkanManager.swapchain.imageResources[i].image;
     imageOwnershipBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     imageOwnershipBarrier.subresourceRange.baseMipLevel = 0;
@@ -861,17 +892,19 @@ void Demo::setupImageOwnership(int i)
 
 void Demo::initDescriptorPool()
 {
+    //a set per frame slot
+    uint32 framesInFlight = vulkanManager.scheduler.framesInFlight;
+
     VkDescriptorPoolSize poolSizes[2] = {};
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = vulkanManager.swapchain.imageCount;
+    poolSizes[0].descriptorCount = framesInFlight;
     
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = vulkanManager.swapchain.imageCount * 
-                                   (uint32)(textures.size());
+    poolSizes[1].descriptorCount = framesInFlight * (uint32)(textures.size());
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.maxSets = vulkanManager.swapchain.imageCount;
+    poolInfo.maxSets = framesInFlight;
     poolInfo.poolSizeCount = 2;
     poolInfo.pPoolSizes = poolSizes;
     
@@ -916,79 +949,95 @@ void Demo::initDescriptorSet()
     writeDescriptorSets[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     writeDescriptorSets[1].pImageInfo = texDescriptorInfos.data();
     
-    for(uint32 i = 0; i < vulkanManager.swapchain.imageCount; i++)
+    for(uint32 i = 0; i < vulkanManager.scheduler.framesInFlight; i++)
     {
         VK_CHECK(vkAllocateDescriptorSets(vulkanManager.logicalDevice.device,
                                           &allocInfo,
-                                          &vulkanManager.swapchain.imageResources[i].descriptorSet));
+                                          &descriptorSets[i]));
 
-        bufferInfo.buffer = vulkanManager.swapchain.imageResources[i].uniformBuffer;
-        writeDescriptorSets[0].dstSet = vulkanManager.swapchain.imageResources[i].descriptorSet;
-        writeDescriptorSets[1].dstSet = vulkanManager.swapchain.imageResources[i].descriptorSet;
+        bufferInfo.buffer = uniformBuffers[i];
+        writeDescriptorSets[0].dstSet = descriptorSets[i];
+        writeDescriptorSets[1].dstSet = descriptorSets[i];
 
         vkUpdateDescriptorSets(vulkanManager.logicalDevice.device, 2, writeDescriptorSets, 0, nullptr);
     }
 }
 
-void Demo::initFramebuffers()
+void Demo::recordDrawCommands(VkCommandBuffer cmdBuffer)
 {
-    VkImageView attachments[2] = {};
-    attachments[1] = vulkanManager.depth.view;
-
-    VkFramebufferCreateInfo fbInfo{}; 
-    fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    fbInfo.renderPass = vulkanManager.renderPass;
-    fbInfo.attachmentCount = 2;
-    fbInfo.pAttachments = attachments;
-    fbInfo.width = this->width;
-    fbInfo.height = this->height;
-    fbInfo.layers = 1;
+    graph.setImage(backbuffer, 
+                   vulkanManager.swapchain.imageResources[currBufferIndex].image,
+                   vulkanManager.swapchain.imageResources[currBufferIndex].view);
+
+    //the passes with their barriers, then the image to PRESENT_SRC_KHR and, with a separate
+    //present queue, its release to the present queue family
+    graph.execute(cmdBuffer);
     
-    for(uint32 i = 0; i < vulkanManager.swapchain.imageCount; i++)
+    VK_CHECK(vkEndCommandBuffer(cmdBuffer));
+}
+
+void Demo::recordMainPass(const RenderGraphContext &context)
+{
+    //only the visible cubes are drawn, in batches of cached secondary command buffers that
+    //are re-recorded on the job system threads when their hash changes. The skinned
+    //characters are one more draw, after the cubes
+    uint32 passDraws = visibleCount + (characterCount ? 1 : 0);
+    recorder.recordCachedRenderPass(jobs, frameIndex, context.cmd, context.renderPassInfo, 
+                                    passDraws, DRAWS_PER_BATCH,
+                                    [this](uint32 firstDraw, uint32 endDraw)
+                                    {
+                                        return hashDrawBatch(firstDraw, endDraw);
+                                    },
+                                    [this](VkCommandBuffer cmd, uint32 firstDraw, uint32 endDraw)
+                                    {
+                                        recordDrawBatch(cmd, firstDraw, endDraw);
+                                    });
+}
+
+uint64 Demo::hashDrawBatch(uint32 firstDraw, uint32 endDraw)
+{
+    //everything recordDrawBatch() reads. The cache is per frame slot, and so is the
+    //descriptor set: a swapchain image's would change with every frame the slot draws to
+    //another image, and the batch would never be reused
+    VkDescriptorSet descriptorSet = descriptorSets[frameIndex];
+
+    //the generation too: a replaced pipeline's handle may be reused by the next one
+    uint64 hash = hashValue(vulkanManager.pipelines.get(cubePipeline), 0xcbf29ce484222325ull);
+    hash = hashValue(vulkanManager.pipelines.generation, hash);
+    hash = hashValue(vulkanManager.pipelineLayout, hash);
+    hash = hashValue(descriptorSet, hash);
+    hash = hashValue(this->width, hash);
+    hash = hashValue(this->height, hash);
+    hash = hashValue(vertexData.size(), hash);
+
+    uint32 endCube = endDraw < visibleCount ? endDraw : visibleCount;
+    for(uint32 i = firstDraw; i < endCube; i++)
     {
-        attachments[0] = vulkanManager.swapchain.imageResources[i].view;
-        
-        VK_CHECK(vkCreateFramebuffer(vulkanManager.logicalDevice.device, 
-                            &fbInfo, 
-                            nullptr,
-                            &vulkanManager.swapchain.imageResources[i].framebuffer));
+        hash = hashValue(cubeOffsets[visibleCubes[i]], hash);
     }
+
+    if(endDraw > visibleCount)
+    {
+        hash = hashValue(vulkanManager.pipelines.get(skinnedPipeline), hash);
+        hash = hashValue(skinning.output(frameIndex), hash);
+        hash = hashValue(skinning.vertexCount, hash);
+        hash = hashBytes(characterOffsets.data(), characterOffsets.size() * sizeof(vec4), hash);
+    }
+    return hash;
 }
 
-void Demo::recordDrawCommands(VkCommandBuffer cmdBuffer)
+void Demo::recordDrawBatch(VkCommandBuffer cmdBuffer, uint32 firstDraw, uint32 endDraw)
 {
-    VkCommandBufferBeginInfo cmdBufferInfo{};
-    cmdBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdBufferInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-
-    VkClearValue clearValues[2] = {};
-    clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
-    clearValues[1].depthStencil = {0.0f, 0};
-
-    VkRenderPassBeginInfo rpBeginInfo{};
-    rpBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    rpBeginInfo.renderPass = vulkanManager.renderPass;
-    rpBeginInfo.framebuffer = vulkanManager.swapchain.imageResources[currBufferIndex].framebuffer;
-    rpBeginInfo.renderArea.offset = {0, 0};
-    rpBeginInfo.renderArea.extent.width = this->width;
-    rpBeginInfo.renderArea.extent.height = this->height;
-    rpBeginInfo.clearValueCount = (uint32)(sizeof(clearValues) / sizeof(clearValues[0]));
-    rpBeginInfo.pClearValues = clearValues;
-
-    VK_CHECK(vkBeginCommandBuffer(cmdBuffer, &cmdBufferInfo));
-    
-    vkCmdBeginRenderPass(cmdBuffer, &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
     vkCmdBindPipeline(cmdBuffer, 
                       VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                      vulkanManager.pipeline);
+                      vulkanManager.pipelines.get(cubePipeline));
     
     vkCmdBindDescriptorSets(cmdBuffer, 
                             VK_PIPELINE_BIND_POINT_GRAPHICS,
                             vulkanManager.pipelineLayout,
                             0, 
                             1,
-                            &vulkanManager.swapchain.imageResources[currBufferIndex].descriptorSet,
+                            &descriptorSets[frameIndex],
                             0,
                             nullptr);
     
@@ -1006,47 +1055,44 @@ void Demo::recordDrawCommands(VkCommandBuffer cmdBuffer)
     scissor.extent.height = this->height;
     vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
     
-    vkCmdDraw(cmdBuffer, (uint32)(vertexData.size()/3), 
-              1, 0, 0);
-
-    //NOTE(): Ending the render pass changes the image's layout from
-    //        COLOR_ATTACHMENT_OPTIMAL to PRESENT_SRC_KHR
-    vkCmdEndRenderPass(cmdBuffer);
+    uint32 endCube = endDraw < visibleCount ? endDraw : visibleCount;
+    for(uint32 i = firstDraw; i < endCube; i++)
+    {
+        vkCmdPushConstants(cmdBuffer, 
+                           vulkanManager.pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT,
+                           0, 
+                           sizeof(vec4),
+                           &cubeOffsets[visibleCubes[i]]);
+
+        vkCmdDraw(cmdBuffer, (uint32)(vertexData.size()/3), 
+                  1, 0, 0);
+    }
 
-    if(vulkanManager.physicalDevice.separatePresentQueue)
+    //the characters, skinned into this frame slot's output buffer by animateCharacters().
+    //Same layout, so the descriptor set stays bound
+    if(endDraw > visibleCount)
     {
-        //Transfer ownership from graphics queue family to present queue family.
-        //No need to transfer it back to graphics queue family.
-        //NOTE(): maybe do this with semaphores instead.
-        
-        VkImageMemoryBarrier imageOwnershipBarrier{};
-        imageOwnershipBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageOwnershipBarrier.srcAccessMask = 0;
-        imageOwnershipBarrier.dstAccessMask = 0;
-        imageOwnershipBarrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-        imageOwnershipBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-        imageOwnershipBarrier.srcQueueFamilyIndex = vulkanManager.physicalDevice.graphicsQueueFamilyIndex;
-        imageOwnershipBarrier.dstQueueFamilyIndex = vulkanManager.physicalDevice.presentQueueFamilyIndex ;
-        imageOwnershipBarrier.image = vulkanManager.swapchain.imageResources[currBufferIndex].image;
-        imageOwnershipBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageOwnershipBarrier.subresourceRange.baseMipLevel = 0;
-        imageOwnershipBarrier.subresourceRange.levelCount = 1;
-        imageOwnershipBarrier.subresourceRange.baseArrayLayer = 0;
-        imageOwnershipBarrier.subresourceRange.layerCount = 1;
-        
-        vkCmdPipelineBarrier(cmdBuffer, 
-                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                             0,
-                             0,
-                             nullptr,
-                             0,
-                             nullptr,
-                             1,
-                             &imageOwnershipBarrier);
+        vkCmdBindPipeline(cmdBuffer, 
+                          VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                          vulkanManager.pipelines.get(skinnedPipeline));
+
+        VkBuffer vertexBuffer = skinning.output(frameIndex);
+        VkDeviceSize vertexOffset = 0;
+        vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexBuffer, &vertexOffset);
+
+        for(uint32 c = 0; c < characterCount; c++)
+        {
+            vkCmdPushConstants(cmdBuffer, 
+                               vulkanManager.pipelineLayout,
+                               VK_SHADER_STAGE_VERTEX_BIT,
+                               0, 
+                               sizeof(vec4),
+                               &characterOffsets[c]);
+
+            vkCmdDraw(cmdBuffer, skinning.vertexCount, 1, c * skinning.vertexCount, 0);
+        }
     }
-    
-    VK_CHECK(vkEndCommandBuffer(cmdBuffer));
 }
 
 void Demo::flushInitCmd()
@@ -1057,32 +1103,12 @@ void Demo::flushInitCmd()
     if(vulkanManager.cmdBuffer == VK_NULL_HANDLE) return;
     
     VK_CHECK(vkEndCommandBuffer(vulkanManager.cmdBuffer));
-    
-    VkFence fence;
-
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO; 
 
-    VK_CHECK(vkCreateFence(vulkanManager.logicalDevice.device, &fenceInfo, nullptr, &fence));
-
-    VkCommandBuffer cmdBufs[] = {vulkanManager.cmdBuffer};
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount = 0;
-    submitInfo.pWaitSemaphores = nullptr;
-    submitInfo.pWaitDstStageMask = nullptr;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = cmdBufs;
-    submitInfo.signalSemaphoreCount = 0;
-    submitInfo.pSignalSemaphores = nullptr;
-
-    VK_CHECK(vkQueueSubmit(vulkanManager.logicalDevice.graphicsQueue, 1, &submitInfo, fence));
-    
-    VK_CHECK(vkWaitForFences(vulkanManager.logicalDevice.device, 1, &fence, VK_TRUE, UINT64_MAX));
+    //the uploads are ordered on the graphics timeline like everything else
+    initUploaded = vulkanManager.scheduler.submit(TIMELINE_GRAPHICS, vulkanManager.cmdBuffer);
+    vulkanManager.scheduler.wait({TIMELINE_GRAPHICS, initUploaded});
     
-    vkFreeCommandBuffers(vulkanManager.logicalDevice.device, vulkanManager.cmdPool, 1, cmdBufs);
-    
-    vkDestroyFence(vulkanManager.logicalDevice.device, fence, nullptr);
+    vkFreeCommandBuffers(vulkanManager.logicalDevice.device, vulkanManager.cmdPool, 1, &vulkanManager.cmdBuffer);
 
     vulkanManager.cmdBuffer = VK_NULL_HANDLE;
 }
@@ -1110,34 +1136,171 @@ void Demo::resize()
         vulkanManager.freeVulkanTexture(vulkanTextures[i]);
     } 
 
+    destroyCubeDataBuffers();
     vkDestroyDescriptorPool(vulkanManager.logicalDevice.device, 
                             descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(vulkanManager.logicalDevice.device, 
                                  descriptorSetLayout, nullptr);
+
+    if(characterCount) skinning.destroy(vulkanManager);
     
+    recorder.destroy();
+    graph.destroy();
     vulkanManager.prepareForResize();
     //prepare() will recreate them
     prepare();
 }
 
+void Demo::updateScene()
+{
+    transforms.update([this](size_t count, size_t chunkSize, auto &&fn) { jobs.parallelFor(count, chunkSize, fn); });
+    modelMatrix = transforms.getWorld(cubeTransform);
+
+    //how far ahead the latched camera will be extrapolated, at most a tenth of a second
+    cameraPrediction = 0.0f;
+    if(predictCamera)
+    {
+        double delay = vulkanManager.pacer.predictPresentDelay(vulkanManager.scheduler.framesPending());
+        cameraPrediction = delay < 0.1 ? (float)delay : 0.1f;
+    }
+
+    //the camera as it is now, the frustum widened for where it can be once latched
+    cullCubes(modelMatrix * camera.getViewMatrix() * cullProjMatrix);
+}
+
+void Demo::latchInput()
+{
+    using namespace std::chrono;
+
+    //the key presses that came in while the frame was being prepared, and the cursor as it is
+    //now. Only input messages, anything else waits for the main loop
+    MSG msg;
+    while(PeekMessage(&msg, window.handle, WM_KEYFIRST, WM_KEYLAST, PM_REMOVE))
+    {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+
+    POINT cursor;
+    if(GetCursorPos(&cursor) && ScreenToClient(window.handle, &cursor))
+    {
+        input.mouseX = (float)cursor.x;
+        input.mouseY = (float)cursor.y;
+    }
+
+    float yaw = camera.yaw;
+    float pitch = camera.pitch;
+
+    processKeyboardInput();
+    processMouseInput();
+    centerMouseCursor();
+    input.mouseLastX = (float)(window.width / 2);
+    input.mouseLastY = (float)(window.height / 2);
+
+    //the camera's motion, to extrapolate it with
+    float forward = (input.dirUp ? 1.0f : 0.0f) - (input.dirDown ? 1.0f : 0.0f);
+    float sideways = (input.dirRight ? 1.0f : 0.0f) - (input.dirLeft ? 1.0f : 0.0f);
+    cameraVelocity = movementSpeed * (forward * camera.fwd + sideways * camera.right);
+
+    steady_clock::time_point now = steady_clock::now();
+    float dt = duration<float>(now - lastLatch).count();
+    lastLatch = now;
+
+    float yawDelta = camera.yaw - yaw;
+    if(yawDelta > 180.0f) yawDelta -= 360.0f;
+    if(yawDelta < -180.0f) yawDelta += 360.0f;
+    yawRate = dt > 0.0f ? yawDelta / dt : 0.0f;
+    pitchRate = dt > 0.0f ? (camera.pitch - pitch) / dt : 0.0f;
+}
+
 void Demo::updateDataBuffer()
 {
-    viewMatrix = camera.getViewMatrix();
+    //the latched camera, extrapolated to when the frame is likely to be on screen. The turn is
+    //clamped to what culling allowed for
+    Camera view = camera;
+    if(cameraPrediction > 0.0f)
+    {
+        float yawTurn = yawRate * cameraPrediction;
+        float pitchTurn = pitchRate * cameraPrediction;
+        yawTurn = yawTurn > mouseSensitivity ? mouseSensitivity : (yawTurn < -mouseSensitivity ? -mouseSensitivity : yawTurn);
+        pitchTurn = pitchTurn > mouseSensitivity ? mouseSensitivity : (pitchTurn < -mouseSensitivity ? -mouseSensitivity : pitchTurn);
+
+        view.pos += cameraPrediction * cameraVelocity;
+        view.rotate(yawTurn, pitchTurn, 1.0f);
+    }
+
+    viewMatrix = view.getViewMatrix();
     mat4 mvp = modelMatrix * viewMatrix * projMatrix;
 
-    memcpy(vulkanManager.swapchain.imageResources[currBufferIndex].uniformMemoryPtr,
-           (const void *)&mvp, sizeof(mvp));
+    memcpy(uniformMemoryPtr[frameIndex], (const void *)&mvp, sizeof(mvp));
+}
+
+void Demo::cullCubes(const mat4 &mvp)
+{
+    //the cube offsets are in model space, so cull against model space planes
+    Frustum frustum = extractFrustum(mvp);
+
+    //keys held move the camera up to a frame's worth before the latch, and the prediction on
+    //top, diagonally at most sqrt(2) faster
+    expandFrustum(frustum, 1.5f * movementSpeed * (lastFrameTime + cameraPrediction));
+
+    BoundingSpheres spheres;
+    spheres.x = cubeBoundsX.data();
+    spheres.y = cubeBoundsY.data();
+    spheres.z = cubeBoundsZ.data();
+    spheres.radius = cubeBoundsRadius.data();
+    spheres.count = cubeBoundsX.size();
+
+    visibleCount = (uint32)cullSpheres(frustum, spheres, visibleCubes.data());
+}
+
+void Demo::animateCharacters()
+{
+    if(characterCount == 0) return;
+
+    FrameScheduler &scheduler = vulkanManager.scheduler;
+    AsyncCompute &compute = vulkanManager.compute;
+
+    for(uint32 c = 0; c < characterCount; c++)
+    {
+        characters[c].time = fmodf(characters[c].time + lastFrameTime, swayClip.duration());
+    }
+
+    //straight into the frame slot's mapped palettes, free again since beginFrame()
+    updateCharacters(characters.data(), characters.size(), skinning.palettes(frameIndex),
+                     [this](size_t count, size_t chunkSize, auto &&fn) { jobs.parallelFor(count, chunkSize, fn); });
+
+    //skinned on the compute queue, overlapping the previous frame's graphics, and handed to
+    //this frame's vertex input. The wait for the bind pose upload is long met after the
+    //first frame
+    compute.begin(frameIndex);
+    skinning.recordAsync(compute, frameIndex, characterCount);
+
+    SubmitWait uploaded{scheduler.timelines[TIMELINE_GRAPHICS].semaphore, initUploaded,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+    compute.submit(scheduler, &uploaded, 1);
+}
+
+void Demo::paceFrame()
+{
+    //before the frame samples its input, so the wait isn't added to the input's latency
+    if(isPrepared) vulkanManager.pacer.beginFrame();
 }
 
 void Demo::updateAndRender()
 {
     if(!isPrepared) return;
 
-    //Make sure that at most MAX_FRAMES rendering are happening at the same time.
-    vkWaitForFences(vulkanManager.logicalDevice.device, 1, 
-                    &vulkanManager.fences[frameIndex], VK_TRUE, UINT64_MAX);
-    vkResetFences(vulkanManager.logicalDevice.device, 1, 
-                  &vulkanManager.fences[frameIndex]);
+    //until late latching the input was sampled here, for the latency stats
+    frameStart = std::chrono::steady_clock::now();
+
+    FrameScheduler &scheduler = vulkanManager.scheduler;
+
+    //at most framesInFlight frames are queued: wait until this slot's previous frame is done
+    frameIndex = scheduler.beginFrame();
+
+    //pipelines compiled in the background are swapped in between frames only
+    vulkanManager.pipelines.update(scheduler.frameNumber, scheduler.framesInFlight);
     
     VkResult res;
     do
@@ -1147,7 +1310,7 @@ void Demo::updateAndRender()
         vkAcquireNextImageKHR(vulkanManager.logicalDevice.device, 
                               vulkanManager.swapchain.swapchain,
                               UINT64_MAX,
-                              vulkanManager.imageAcquiredSemaphores[frameIndex], 
+                              scheduler.acquireSemaphore(), 
                               VK_NULL_HANDLE, 
                               &currBufferIndex);
         
@@ -1174,69 +1337,96 @@ void Demo::updateAndRender()
         }
     } while (res != VK_SUCCESS);
 
-    updateDataBuffer();  //TODO
+    //the image's present command buffer and semaphore may still be used by the last frame
+    //that drew to it
+    scheduler.imageAcquired(currBufferIndex);
 
-    VkPipelineStageFlags pipelineStageFlags{}; 
-    pipelineStageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    //decides which cubes this frame draws, for wherever the camera is once latched
+    updateScene();
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = nullptr;
-    submitInfo.pWaitDstStageMask = &pipelineStageFlags;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &vulkanManager.imageAcquiredSemaphores[frameIndex];
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &vulkanManager.swapchain.imageResources[currBufferIndex].cmd;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &vulkanManager.drawCompleteSemaphores[frameIndex];
+    //the characters' compute work goes first, so it runs while this frame is recorded
+    animateCharacters();
 
-    VK_CHECK(vkQueueSubmit(vulkanManager.logicalDevice.graphicsQueue, 
-                           1, &submitInfo, 
-                           vulkanManager.fences[frameIndex]));
+    //the slot's previous frame is done, so its command pools can be reset and re-recorded
+    //with this frame's visible cubes
+    VkCommandBuffer cmdBuffer = recorder.beginFrame(frameIndex);
 
-    if(vulkanManager.physicalDevice.separatePresentQueue)
+    //whatever the compute queue handed over, the skinned vertices
+    vulkanManager.compute.acquire(cmdBuffer);
+    recordDrawCommands(cmdBuffer);
+
+    if(++frameCount % 1000 == 0)
     {
-        //if separate queues are being used, change image ownership to the present queue
-        //before presenting, waiting for the draw complete semaphore and signaling the 
-        //ownership released semaphore when finished
-
-        VkFence nullFence = VK_NULL_HANDLE; 
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = &vulkanManager.drawCompleteSemaphores[frameIndex];
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &vulkanManager.swapchain.imageResources[currBufferIndex].graphicsToPresentCmd;
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = &vulkanManager.imageOwnershipSemaphores[frameIndex];
-        
-        
-        VK_CHECK(vkQueueSubmit(vulkanManager.logicalDevice.presentQueue, 
-                               1, &submitInfo, 
-                               nullFence));
+        const CommandRecorderStats &stats = recorder.stats;
+        LOGI("Command recording: {:.3f} ms, {} of {} batches reused, {:.1f}% hit rate overall",
+             stats.recordMs, stats.cacheHits, stats.batches,
+             stats.totalBatches ? 100.0 * (double)stats.totalCacheHits / (double)stats.totalBatches : 0.0);
+
+        const PresentStats &present = vulkanManager.pacer.stats;
+        LOGI("Present: {:.2f} ms interval ({:.2f} to {:.2f}), {:.2f} presents queued (max {}), "
+             "{:.2f} frames on the GPU (max {})",
+             present.intervalMs(), present.minIntervalMs, present.maxIntervalMs,
+             present.queuedPresents(), present.maxQueuedPresents,
+             present.gpuFrames(), present.maxGpuFrames);
+        vulkanManager.pacer.resetStats();
+
+        LOGI("Input to submit: {:.3f} ms latched, {:.3f} ms sampled at the start of the frame",
+             latencySamples ? latchToSubmitMs / latencySamples : 0.0,
+             latencySamples ? frameStartToSubmitMs / latencySamples : 0.0);
+        latchToSubmitMs = 0.0;
+        frameStartToSubmitMs = 0.0;
+        latencySamples = 0;
     }
 
-    // if we are using separate queues we have to wait for image ownership
-    // otherwise wait for draw complete    
-    
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.waitSemaphoreCount = 1;
+    //the newest input, right before submit. The commands don't depend on the camera, only
+    //the frame slot's uniform buffer does, and the GPU reads it once the submission starts
+    latchInput();
+    updateDataBuffer();
+    std::chrono::steady_clock::time_point latched = std::chrono::steady_clock::now();
+
+    //the render pass waits for the acquire at COLOR_ATTACHMENT_OUTPUT, see initRenderGraph(),
+    //and the reads of compute results for the compute submission
+    SubmitWait waits[2];
+    waits[0] = {scheduler.acquireSemaphore(), 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    uint32 waitCount = vulkanManager.compute.takeGraphicsWait(waits[1]) ? 2 : 1;
 
     if(vulkanManager.physicalDevice.separatePresentQueue)
     {
-        presentInfo.pWaitSemaphores = &vulkanManager.imageOwnershipSemaphores[frameIndex];
+        //if separate queues are being used, change image ownership to the present queue
+        //before presenting, once the drawing is done on the graphics timeline
+        uint64 drawn = scheduler.submit(TIMELINE_GRAPHICS, cmdBuffer, waits, waitCount);
+
+        SubmitWait drawDone{scheduler.timelines[TIMELINE_GRAPHICS].semaphore, drawn, 
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        scheduler.submit(TIMELINE_PRESENT, 
+                         vulkanManager.swapchain.imageResources[currBufferIndex].graphicsToPresentCmd,
+                         &drawDone, 1, 
+                         scheduler.presentSemaphore());
     }
     else
     {
-        presentInfo.pWaitSemaphores = &vulkanManager.drawCompleteSemaphores[frameIndex];
+        scheduler.submit(TIMELINE_GRAPHICS, cmdBuffer, waits, waitCount, scheduler.presentSemaphore());
     }
 
+    std::chrono::steady_clock::time_point submitted = std::chrono::steady_clock::now();
+    latchToSubmitMs += std::chrono::duration<double, std::milli>(submitted - latched).count();
+    frameStartToSubmitMs += std::chrono::duration<double, std::milli>(submitted - frameStart).count();
+    latencySamples++;
+
+    //the slot and the image are reused once the last submission is done
+    scheduler.endFrame();
+
+    VkSemaphore presentWait = scheduler.presentSemaphore();
+
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &presentWait;
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &vulkanManager.swapchain.swapchain;
     presentInfo.pImageIndices = &currBufferIndex;
     
-    res = vkQueuePresentKHR(vulkanManager.logicalDevice.presentQueue, &presentInfo);
-    frameIndex += 1;
-    frameIndex %= MAX_FRAMES;
+    res = vulkanManager.pacer.present(vulkanManager.logicalDevice.presentQueue, presentInfo, scheduler.framesPending());
 
     if (res == VK_ERROR_OUT_OF_DATE_KHR)
     {
@@ -1258,6 +1448,9 @@ void Demo::updateAndRender()
     {
         VK_CHECK(res);
     }
+
+    //pipelines created since the last save, off the frame's critical path now it's presented
+    vulkanManager.pipelineCache.update();
 }
 
 //================== Texture =========================
@@ -1287,28 +1480,6 @@ void Texture::free()
     stbi_image_free(pixels);
 }
 
-//==================== Shaders =============================
-void loadShaderModule(std::string &filename, std::vector<char> &buffer)
-{
-    //start reading at the end of the file to be able to determine file size 
-    //spir-v files need to be read in binary mode
-    std::ifstream shaderFile(filename, std::ios::ate | std::ios::binary);
-
-    if(!shaderFile.is_open())
-    {
-        LOGE_EXIT("Unable to open vertex shader file.");
-    }
-
-    size_t filesize = (size_t)shaderFile.tellg();
-    buffer.resize(filesize);
-    
-    shaderFile.seekg(0);
-
-    shaderFile.read(buffer.data(), filesize);
-
-    shaderFile.close();
-}
-
 //====================== Input ============================
 
 void Demo::processKeyboardInput()
@@ -1550,6 +1721,8 @@ int WINAPI WinMain(HINSTANCE hInstance,
             }
         }
     
+        demo.paceFrame();
+
         PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE);
         if(msg.message == WM_QUIT)
         {
@@ -1561,13 +1734,7 @@ int WINAPI WinMain(HINSTANCE hInstance,
             DispatchMessage(&msg);
         }
 
-        demo.processKeyboardInput();
-        demo.processMouseInput();
-        float windowCenterY = (float)(demo.window.height/2);
-        float windowCenterX = (float)(demo.window.width/2);
-        demo.centerMouseCursor(); 
-        demo.input.mouseLastY = windowCenterY;
-        demo.input.mouseLastX = windowCenterX;
+        //the input is applied to the camera in updateAndRender(), right before submit
         demo.updateAndRender(); 
 
         LARGE_INTEGER endPerfCount{};
@@ -0,0 +1,195 @@
+#include "transforms.h"
+#include "matrix_kernels.h"
+#include "packing.h"
+
+#include <string.h>
+
+//local matrices built per run of changed nodes (4 KB on the stack)
+static const size_t LOCAL_BLOCK = 64;
+
+//composeTRS for count nodes starting at first, 4 at a time straight from the SoA arrays.
+static void localMatrices(const TransformHierarchy &h, size_t first, size_t count, mat4 *out)
+{
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        size_t k = first + i;
+        vec3x4 t(_mm_loadu_ps(&h.posX[k]), _mm_loadu_ps(&h.posY[k]), _mm_loadu_ps(&h.posZ[k]));
+        quatx4 r(_mm_loadu_ps(&h.rotX[k]), _mm_loadu_ps(&h.rotY[k]), _mm_loadu_ps(&h.rotZ[k]), _mm_loadu_ps(&h.rotW[k]));
+        vec3x4 s(_mm_loadu_ps(&h.scaleX[k]), _mm_loadu_ps(&h.scaleY[k]), _mm_loadu_ps(&h.scaleZ[k]));
+        composeTRS(t, r, s, out + i);
+    }
+
+    for(; i < count; i++)
+    {
+        size_t k = first + i;
+        out[i] = composeTRS(vec3(h.posX[k], h.posY[k], h.posZ[k]),
+                            quat(h.rotX[k], h.rotY[k], h.rotZ[k], h.rotW[k]),
+                            vec3(h.scaleX[k], h.scaleY[k], h.scaleZ[k]));
+    }
+}
+
+TransformId TransformHierarchy::add(TransformId parentId, vec3 t, quat r, vec3 s)
+{
+    uint32_t index = (uint32_t)world.size();
+    TransformId id = (TransformId)idToIndex.size();
+    uint32_t p = parentId == NO_TRANSFORM ? NO_TRANSFORM : idToIndex[parentId];
+    uint32_t d = p == NO_TRANSFORM ? 0 : depth[p] + 1;
+
+    posX.push_back(0.0f); posY.push_back(0.0f); posZ.push_back(0.0f);
+    rotX.push_back(0.0f); rotY.push_back(0.0f); rotZ.push_back(0.0f); rotW.push_back(1.0f);
+    scaleX.push_back(1.0f); scaleY.push_back(1.0f); scaleZ.push_back(1.0f);
+    parent.push_back(p);
+    depth.push_back(d);
+    dirty.push_back(0);
+    changed.push_back(0);
+    world.push_back(mat4(1.0f));
+    idToIndex.push_back(index);
+    indexToId.push_back(id);
+
+    //appending to the deepest level, or starting a new one, keeps the depth order
+    size_t levels = levelStart.empty() ? 0 : levelStart.size() - 1;
+    if(levelStart.empty()) levelStart.push_back(0);
+
+    if(d + 1 == levels)   levelStart.back() = index + 1;
+    else if(d == levels)  levelStart.push_back(index + 1);
+    else                  orderDirty = true;
+
+    setLocal(id, t, r, s);
+    return id;
+}
+
+void TransformHierarchy::setLocal(TransformId id, vec3 t, quat r, vec3 s)
+{
+    uint32_t i = idToIndex[id];
+    posX[i] = t.x(); posY[i] = t.y(); posZ[i] = t.z();
+    rotX[i] = r.x(); rotY[i] = r.y(); rotZ[i] = r.z(); rotW[i] = r.w();
+    scaleX[i] = s.x(); scaleY[i] = s.y(); scaleZ[i] = s.z();
+    dirty[i] = 1;
+}
+
+void TransformHierarchy::setPosition(TransformId id, vec3 t)
+{
+    uint32_t i = idToIndex[id];
+    posX[i] = t.x(); posY[i] = t.y(); posZ[i] = t.z();
+    dirty[i] = 1;
+}
+
+void TransformHierarchy::setRotation(TransformId id, quat r)
+{
+    uint32_t i = idToIndex[id];
+    rotX[i] = r.x(); rotY[i] = r.y(); rotZ[i] = r.z(); rotW[i] = r.w();
+    dirty[i] = 1;
+}
+
+void TransformHierarchy::update()
+{
+    update([](size_t count, size_t, auto &&fn) { fn(0, count); });
+}
+
+void TransformHierarchy::writeWorldMatrices(void *dst) const
+{
+    streamCopy(dst, world.data(), world.size() * sizeof(mat4));
+}
+
+template<typename T>
+static void permute(std::vector<T> &v, const std::vector<uint32_t> &newIndex)
+{
+    std::vector<T> r(v.size());
+    for(size_t i = 0; i < v.size(); i++) r[newIndex[i]] = v[i];
+    v.swap(r);
+}
+
+//Breadth first order: the roots in the order they were added, then their children, parent
+//by parent, and so on. Siblings end up next to each other, so a chunk reads few distinct
+//parent matrices.
+void TransformHierarchy::sortByDepth()
+{
+    size_t count = world.size();
+
+    //children of every node (by current index), in the order they were added
+    std::vector<uint32_t> childStart(count + 1, 0), children(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        if(parent[i] != NO_TRANSFORM) childStart[parent[i] + 1]++;
+    }
+    for(size_t i = 1; i <= count; i++) childStart[i] += childStart[i - 1];
+
+    std::vector<uint32_t> next(childStart.begin(), childStart.end() - 1);
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        if(parent[i] != NO_TRANSFORM) children[next[parent[i]]++] = (uint32_t)i;
+        else order.push_back((uint32_t)i);
+    }
+
+    for(size_t k = 0; k < order.size(); k++)
+    {
+        uint32_t n = order[k];
+        order.insert(order.end(), children.begin() + childStart[n], children.begin() + childStart[n + 1]);
+    }
+
+    std::vector<uint32_t> newIndex(count);
+    for(size_t k = 0; k < count; k++) newIndex[order[k]] = (uint32_t)k;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        if(parent[i] != NO_TRANSFORM) parent[i] = newIndex[parent[i]];
+    }
+
+    permute(posX, newIndex); permute(posY, newIndex); permute(posZ, newIndex);
+    permute(rotX, newIndex); permute(rotY, newIndex); permute(rotZ, newIndex); permute(rotW, newIndex);
+    permute(scaleX, newIndex); permute(scaleY, newIndex); permute(scaleZ, newIndex);
+    permute(parent, newIndex);
+    permute(depth, newIndex);
+    permute(dirty, newIndex);
+    permute(changed, newIndex);
+    permute(world, newIndex);
+    permute(indexToId, newIndex);
+
+    for(size_t i = 0; i < count; i++) idToIndex[indexToId[i]] = (uint32_t)i;
+
+    //breadth first order has the depths in increasing order
+    uint32_t maxDepth = count ? depth[count - 1] : 0;
+    levelStart.assign(maxDepth + 2, 0);
+    for(size_t i = 0; i < count; i++) levelStart[depth[i] + 1]++;
+    for(size_t d = 1; d < levelStart.size(); d++) levelStart[d] += levelStart[d - 1];
+    if(count == 0) levelStart.clear();
+
+    orderDirty = false;
+}
+
+//Nodes [begin, end) of a single depth.
+void TransformHierarchy::updateNodes(size_t begin, size_t end)
+{
+    //a node needs a new world matrix if its local transform changed or its parent's world did
+    for(size_t i = begin; i < end; i++)
+    {
+        uint32_t p = parent[i];
+        changed[i] = dirty[i] | (p != NO_TRANSFORM ? changed[p] : 0);
+        dirty[i] = 0;
+    }
+
+    //runs of consecutive changed nodes go through the batch kernel
+    mat4 local[LOCAL_BLOCK];
+    size_t i = begin;
+    while(i < end)
+    {
+        if(!changed[i])
+        {
+            i++;
+            continue;
+        }
+
+        size_t runEnd = i + 1;
+        while(runEnd < end && runEnd - i < LOCAL_BLOCK && changed[runEnd]) runEnd++;
+        size_t n = runEnd - i;
+
+        localMatrices(*this, i, n, local);
+        if(parent[i] == NO_TRANSFORM) memcpy(&world[i], local, n * sizeof(mat4));
+        else composeMatricesIndexed(local, world.data(), &parent[i], &world[i], n);
+
+        i = runEnd;
+    }
+}
@@ -1,4 +1,6 @@
 #include "vulkan_manager.h"
+#include "to_string.h"
+#include <string.h>
 
 void VulkanManager::startUp(Win32Window *window, 
                             VulkanConfig vulkanConfig, 
@@ -6,6 +8,8 @@ void VulkanManager::startUp(Win32Window *window,
                             uint32 *demoHeight)
 {
     this->config = vulkanConfig;
+    if(config.framesInFlight == 0) config.framesInFlight = 2;
+    if(config.framesInFlight > MAX_FRAMES) config.framesInFlight = MAX_FRAMES;
     displayInfo();
 
     //------ INSTANCE ---------
@@ -26,16 +30,36 @@ void VulkanManager::startUp(Win32Window *window,
     //---------- LOGICAL DEVICE AND QUEUES -------------
 
     logicalDevice.init(physicalDevice, config);
+    barriers.init(logicalDevice.cmdPipelineBarrier2);
+    LOGI("Barriers: {}", logicalDevice.cmdPipelineBarrier2 ? "VK_KHR_synchronization2" : "vkCmdPipelineBarrier");
+
+    //-------------- PIPELINE CACHE ----------------
+    pipelineCache.init(logicalDevice.device, physicalDevice.properties, config.pipelineCacheFilePath,
+                       logicalDevice.pipelineCreationFeedback);
+    shaders.init(config.shaderCacheDir, config.hotReloadShaders);
+    pipelines.init(logicalDevice.device,
+                   &pipelineCache,
+                   &shaders,
+                   logicalDevice.graphicsPipelineLibrary,
+                   config.pipelineCompileThreads,
+                   config.pipelinePrewarmFilePath);
 
     //-------------- SYNC PRIMITIVES ----------------
     initSyncPrimitives();
+    pacer.init(logicalDevice.device, logicalDevice.waitForPresent, config.frameRateCap);
+    compute.init(logicalDevice.device,
+                 physicalDevice.computeQueueFamilyIndex,
+                 physicalDevice.graphicsQueueFamilyIndex,
+                 config.framesInFlight,
+                 logicalDevice.cmdPipelineBarrier2);
 
     //--------------- SWAPCHAIN ------------------
     swapchain.swapchain = VK_NULL_HANDLE;
     swapchain.queryInfoAndChooseSettings(physicalDevice.device, 
                                          logicalDevice.device, surface, 
                                          config.preferredSurfaceFormat,
-                                         config.preferredPresentMode,
+                                         config.latencyMode,
+                                         logicalDevice.waitForPresent != nullptr,
                                          demoWidth, demoHeight);
 
     //--------------- COMMAND POOL ---------------
@@ -44,34 +68,17 @@ void VulkanManager::startUp(Win32Window *window,
 
 void VulkanManager::shutDown()
 {
-    //Wait for fences from present operations
-    for(uint32 i = 0; i < MAX_FRAMES; i++)
-    {
-        vkWaitForFences(logicalDevice.device, 1, 
-                        &fences[i], VK_TRUE, UINT64_MAX);
-
-        vkDestroyFence(logicalDevice.device, fences[i], nullptr);
-        vkDestroySemaphore(logicalDevice.device, imageAcquiredSemaphores[i], nullptr);
-        vkDestroySemaphore(logicalDevice.device, drawCompleteSemaphores[i], nullptr);
-        
-        if(physicalDevice.separatePresentQueue)
-        {
-            vkDestroySemaphore(logicalDevice.device, imageOwnershipSemaphores[i], nullptr);
-        }
-    }
+    //waits for every submission first
+    scheduler.destroy();
+    compute.destroy();
+    pipelines.shutDown();
+    shaders.shutDown();
+    pipelineCache.destroy();
 
     //if the window is minimized, prepareForResize() has already done some cleanup.
     if(!(*isMinimized))
     {
-        vkDestroyPipeline(logicalDevice.device, pipeline, nullptr);
-        vkDestroyPipelineCache(logicalDevice.device, pipelineCache, nullptr);
         vkDestroyPipelineLayout(logicalDevice.device, pipelineLayout, nullptr); 
-
-        vkDestroyRenderPass(logicalDevice.device, renderPass, nullptr);
-
-        vkDestroyImageView(logicalDevice.device, depth.view, nullptr);
-        vkDestroyImage(logicalDevice.device, depth.image, nullptr);
-        vkFreeMemory(logicalDevice.device, depth.mem, nullptr);
         
         swapchain.destroy(logicalDevice.device, cmdPool);
         
@@ -98,15 +105,9 @@ void VulkanManager::shutDown()
 
 void VulkanManager::prepareForResize()
 {
-    vkDestroyPipeline(logicalDevice.device, pipeline, nullptr);
-    vkDestroyPipelineCache(logicalDevice.device, pipelineCache, nullptr);
-    vkDestroyRenderPass(logicalDevice.device, renderPass, nullptr);
+    pipelines.reset();
     vkDestroyPipelineLayout(logicalDevice.device, pipelineLayout, nullptr); 
 
-    vkDestroyImageView(logicalDevice.device, depth.view, nullptr);
-    vkDestroyImage(logicalDevice.device, depth.image, nullptr);
-    vkFreeMemory(logicalDevice.device, depth.mem, nullptr);
-
     swapchain.destroy(logicalDevice.device, cmdPool);
     
     vkDestroyCommandPool(logicalDevice.device, cmdPool, nullptr);
@@ -345,103 +346,45 @@ uint32 findMemoryTypeFromProperties(const VkPhysicalDeviceMemoryProperties *pMem
     LOGE_EXIT("Unable to find suitable memory type from the given properties.");
 }
 
-void VulkanManager::initDepthImage(VkFormat depthFormat, uint32 width, uint32 height)
-{
-    //--- create image --- 
-
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.format = depthFormat;
-    imageInfo.extent = {width, height, 1};
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-    VK_CHECK(vkCreateImage(logicalDevice.device, &imageInfo, nullptr, &depth.image));
-
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements(logicalDevice.device, depth.image, &memReqs);
-
-    depth.memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    depth.memAlloc.pNext = nullptr;
-    depth.memAlloc.allocationSize = memReqs.size;
-    depth.memAlloc.memoryTypeIndex = findMemoryTypeFromProperties(&physicalDevice.memProperties,
-                                                                  memReqs.memoryTypeBits,
-                                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    // --- allocate memory ---
-    VK_CHECK(vkAllocateMemory(logicalDevice.device, &depth.memAlloc, nullptr, &depth.mem));
-
-    // --- bind memory ---
-    VK_CHECK(vkBindImageMemory(logicalDevice.device, depth.image, depth.mem, 0));
-
-    // --- create image view ---
-    VkImageViewCreateInfo viewInfo{};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = depth.image;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = depthFormat;
-
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
-
-    VK_CHECK(vkCreateImageView(logicalDevice.device, &viewInfo, nullptr, &depth.view));
-}
-
 void VulkanManager::initSyncPrimitives()
 {
-    //Create semaphores to sunchronize acquiring presentable buffers before rendering
-    //and waiting for drawaing to be complete before presenting
-    
-    VkSemaphoreCreateInfo semaphoreInfo{};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    
-    //Create fences that we can use to throttle if we get too far ahead of the image presents
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    
-    for(uint32 i = 0; i < MAX_FRAMES; i++)
+    //one timeline per queue orders the submissions, the swapchain's binary semaphores are
+    //the scheduler's too
+    scheduler.init(logicalDevice.device, config.framesInFlight);
+    scheduler.initTimeline(TIMELINE_GRAPHICS, logicalDevice.graphicsQueue);
+
+    if(physicalDevice.separatePresentQueue)
     {
-        VK_CHECK(vkCreateFence(logicalDevice.device, &fenceInfo, nullptr, &fences[i]));
+        scheduler.initTimeline(TIMELINE_PRESENT, logicalDevice.presentQueue);
+    }
 
-        VK_CHECK(vkCreateSemaphore(logicalDevice.device, 
-                                   &semaphoreInfo, 
-                                   nullptr, 
-                                   &imageAcquiredSemaphores[i]));
+    //a timeline of its own even on the graphics queue, so compute submissions look the same
+    //either way
+    scheduler.initTimeline(TIMELINE_COMPUTE, logicalDevice.computeQueue);
 
-        VK_CHECK(vkCreateSemaphore(logicalDevice.device, 
-                                   &semaphoreInfo, 
-                                   nullptr, 
-                                   &drawCompleteSemaphores[i]));
-        
-        if(physicalDevice.separatePresentQueue)
-        {
-            VK_CHECK(vkCreateSemaphore(logicalDevice.device, 
-                                       &semaphoreInfo, 
-                                       nullptr, 
-                                       &imageOwnershipSemaphores[i]));
-        }
-    }
+    LOGI("{} frames in flight, compute on {}", config.framesInFlight,
+         physicalDevice.separateComputeQueue ? "a compute-only queue" : "the graphics queue");
 }
 
 void VulkanManager::initBuffer(VkDeviceSize size, 
                                VkBufferUsageFlags usageFlags, 
                                VkMemoryPropertyFlags propertyFlags,
                                VkBuffer &buffer, 
-                               VkDeviceMemory &bufferMemory)
+                               VkDeviceMemory &bufferMemory,
+                               uint32 queueFamilyCount,
+                               const uint32 *queueFamilies)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usageFlags;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if(queueFamilyCount > 1)
+    {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = queueFamilyCount;
+        bufferInfo.pQueueFamilyIndices = queueFamilies;
+    }
 
     VK_CHECK(vkCreateBuffer(logicalDevice.device, &bufferInfo, nullptr, &buffer));
 
@@ -499,65 +442,6 @@ void VulkanManager::initImage(uint32 width, uint32 height,
     VK_CHECK(vkBindImageMemory(logicalDevice.device, image, imageMemory, 0));
 }
 
-void VulkanManager::setImageLayout(VkImage image, 
-                                   VkImageAspectFlags aspectMask,
-                                   VkImageLayout oldLayout, 
-                                   VkImageLayout newLayout, 
-                                   VkAccessFlagBits srcAccessMask, 
-                                   VkPipelineStageFlags srcStages, 
-                                   VkPipelineStageFlags destStages) 
-{
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.pNext = nullptr;
-    barrier.srcAccessMask = srcAccessMask;
-    barrier.dstAccessMask = 0;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = aspectMask;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    switch (newLayout) {
-        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-            /* Make sure anything that was copying from this image has completed */
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            break;
-
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            break;
-
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            break;
-
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
-            break;
-
-        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            break;
-
-        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
-            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-            break;
-
-        default:
-            barrier.dstAccessMask = 0;
-            break;
-    }
-
-    vkCmdPipelineBarrier(cmdBuffer, srcStages, destStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-}
-
 void VulkanManager::initVulkanTexture(uint8 *texPixels, 
                                       uint32 texWidth,
                                       uint32 texHeight,
@@ -594,13 +478,12 @@ void VulkanManager::initVulkanTexture(uint8 *texPixels,
     
     texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    setImageLayout(texture.image,
-                   VK_IMAGE_ASPECT_COLOR_BIT,
-                   VK_IMAGE_LAYOUT_UNDEFINED,
-                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-                   VK_ACCESS_NONE_KHR,
-                   VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                   VK_PIPELINE_STAGE_TRANSFER_BIT);
+    barriers.trackImage(texture.image, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+    barriers.image(texture.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+                   VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
+    barriers.flush(cmdBuffer);
 
     VkBufferImageCopy copyRegion{};
     copyRegion.bufferOffset = 0; 
@@ -622,13 +505,11 @@ void VulkanManager::initVulkanTexture(uint8 *texPixels,
                            1,
                            &copyRegion);
 
-    setImageLayout(texture.image,
-                   VK_IMAGE_ASPECT_COLOR_BIT,
-                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                   texture.imageLayout, 
-                   VK_ACCESS_TRANSFER_WRITE_BIT,
-                   VK_PIPELINE_STAGE_TRANSFER_BIT,
-                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    barriers.image(texture.image,
+                   texture.imageLayout,
+                   VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                   VK_ACCESS_2_SHADER_READ_BIT_KHR);
+    barriers.flush(cmdBuffer);
 
     //--- sampler ---
     VkSamplerCreateInfo samplerInfo{};
@@ -676,7 +557,11 @@ void VulkanManager::freeVulkanTexture(VulkanTexture &tex)
 {
     if(tex.sampler) vkDestroySampler(logicalDevice.device, tex.sampler, nullptr);
     if(tex.view) vkDestroyImageView(logicalDevice.device, tex.view, nullptr);
-    if(tex.image) vkDestroyImage(logicalDevice.device, tex.image, nullptr);
+    if(tex.image)
+    {
+        barriers.untrackImage(tex.image);
+        vkDestroyImage(logicalDevice.device, tex.image, nullptr);
+    }
     if(tex.buffer) vkDestroyBuffer(logicalDevice.device, tex.buffer, nullptr);
     if(tex.mem) vkFreeMemory(logicalDevice.device, tex.mem, nullptr);
 }
@@ -693,6 +578,96 @@ void PhysicalDevice::init(VkPhysicalDevice physicalDevice,
     vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
     enabledFeatures = featuresToEnable;
 
+    //optional extensions: each needs the extension and its feature
+    uint32 extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+    bool hasSync2Extension = false;
+    bool hasPresentIdExtension = false;
+    bool hasPresentWaitExtension = false;
+    bool hasPipelineLibraryExtension = false;
+    bool hasGraphicsPipelineLibraryExtension = false;
+    supportsPipelineCreationFeedback = false;
+    for(uint32 i = 0; i < extensionCount; i++)
+    {
+        if(strcmp(extensions[i].extensionName, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) == 0)
+        {
+            hasSync2Extension = true;
+        }
+        else if(strcmp(extensions[i].extensionName, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0)
+        {
+            hasPresentIdExtension = true;
+        }
+        else if(strcmp(extensions[i].extensionName, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0)
+        {
+            hasPresentWaitExtension = true;
+        }
+        else if(strcmp(extensions[i].extensionName, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0)
+        {
+            hasPipelineLibraryExtension = true;
+        }
+        else if(strcmp(extensions[i].extensionName, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) == 0)
+        {
+            hasGraphicsPipelineLibraryExtension = true;
+        }
+        else if(strcmp(extensions[i].extensionName, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) == 0)
+        {
+            //no features, the extension is enough
+            supportsPipelineCreationFeedback = true;
+        }
+    }
+    bool hasPresentWaitExtensions = hasPresentIdExtension && hasPresentWaitExtension;
+    bool hasGraphicsPipelineLibraryExtensions = hasPipelineLibraryExtension && hasGraphicsPipelineLibraryExtension;
+
+    //timeline semaphores are core in 1.2
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2Features{};
+    sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures{};
+    libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+    //only the features of extensions the device has may be queried
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &timelineFeatures;
+    void **next = &timelineFeatures.pNext;
+    if(hasSync2Extension)
+    {
+        *next = &sync2Features;
+        next = &sync2Features.pNext;
+    }
+    if(hasPresentWaitExtensions)
+    {
+        *next = &presentIdFeatures;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        next = &presentWaitFeatures.pNext;
+    }
+    if(hasGraphicsPipelineLibraryExtensions)
+    {
+        *next = &libraryFeatures;
+        next = &libraryFeatures.pNext;
+    }
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    supportsTimelineSemaphore = timelineFeatures.timelineSemaphore == VK_TRUE;
+    supportsSynchronization2 = hasSync2Extension && sync2Features.synchronization2 == VK_TRUE;
+    supportsPresentWait = hasPresentWaitExtensions && 
+                          presentIdFeatures.presentId == VK_TRUE &&
+                          presentWaitFeatures.presentWait == VK_TRUE;
+    supportsGraphicsPipelineLibrary = hasGraphicsPipelineLibraryExtensions &&
+                                      libraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+
     uint32 queueFamilyCount;
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
     queueFamilyProperties.resize(queueFamilyCount);
@@ -725,14 +700,21 @@ void PhysicalDevice::init(VkPhysicalDevice physicalDevice,
         }
     }
     
-    if(graphicsQueueFamilyIndex != presentQueueFamilyIndex)
-    {
-        separatePresentQueue = false;
-    }
-    else
+    separatePresentQueue = graphicsQueueFamilyIndex != presentQueueFamilyIndex;
+
+    //a family with compute but not graphics runs on hardware queues of its own, alongside
+    //the graphics work
+    computeQueueFamilyIndex = graphicsQueueFamilyIndex;
+    for(uint32 i = 0; i < (uint32)(queueFamilyProperties.size()); i++)
     {
-        separatePresentQueue = true;
+        VkQueueFlags flags = queueFamilyProperties[i].queueFlags;
+        if((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            computeQueueFamilyIndex = i;
+            break;
+        }
     }
+    separateComputeQueue = computeQueueFamilyIndex != graphicsQueueFamilyIndex;
 
 }
 
@@ -765,11 +747,84 @@ void LogicalDevice::init(PhysicalDevice &physicalDevice,
         queueCreateInfos.push_back(queueInfo);
     }
 
+    if(physicalDevice.separateComputeQueue &&
+       physicalDevice.computeQueueFamilyIndex != physicalDevice.presentQueueFamilyIndex)
+    {
+        queueInfo = {};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = physicalDevice.computeQueueFamilyIndex;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfos.push_back(queueInfo);
+    }
+
     VkDeviceCreateInfo deviceInfo{};
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceInfo.queueCreateInfoCount = (uint32)(queueCreateInfos.size());
     deviceInfo.pQueueCreateInfos = queueCreateInfos.data();
     deviceInfo.pEnabledFeatures = &physicalDevice.enabledFeatures;
+
+    //the frame scheduler is built on timeline semaphores
+    if(!physicalDevice.supportsTimelineSemaphore)
+    {
+        LOGE_EXIT("The device doesn't support timeline semaphores.");
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+    deviceInfo.pNext = &timelineFeatures;
+
+    void **next = &timelineFeatures.pNext;
+
+    bool synchronization2 = config.useSynchronization2 && physicalDevice.supportsSynchronization2;
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2Features{};
+    sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    sync2Features.synchronization2 = VK_TRUE;
+    if(synchronization2)
+    {
+        config.deviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        *next = &sync2Features;
+        next = &sync2Features.pNext;
+    }
+
+    //present ids and waits, for the pacing and stats of any latency mode
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.presentId = VK_TRUE;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.presentWait = VK_TRUE;
+    if(physicalDevice.supportsPresentWait)
+    {
+        config.deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        config.deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        *next = &presentIdFeatures;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        next = &presentWaitFeatures.pNext;
+    }
+
+    //pipelines compiled in parts and linked, see PipelineCompiler
+    graphicsPipelineLibrary = config.useGraphicsPipelineLibrary && physicalDevice.supportsGraphicsPipelineLibrary;
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures{};
+    libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+    libraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+    if(graphicsPipelineLibrary)
+    {
+        config.deviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+        config.deviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+        *next = &libraryFeatures;
+        next = &libraryFeatures.pNext;
+    }
+
+    //whether pipelines come from the pipeline cache, see PipelineCache::created()
+    pipelineCreationFeedback = physicalDevice.supportsPipelineCreationFeedback;
+    if(pipelineCreationFeedback)
+    {
+        config.deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    }
+
     deviceInfo.enabledExtensionCount = (uint32)(config.deviceExtensions.size());
     deviceInfo.ppEnabledExtensionNames = config.deviceExtensions.data();
 
@@ -782,9 +837,22 @@ void LogicalDevice::init(PhysicalDevice &physicalDevice,
     //create logical device
     VK_CHECK(vkCreateDevice(physicalDevice.device, &deviceInfo, nullptr, &device));
 
-    //get handles to the graphics  and presentation queues
+    //get handles to the graphics, presentation and compute queues
     vkGetDeviceQueue(device, physicalDevice.graphicsQueueFamilyIndex, 0, &graphicsQueue);
     vkGetDeviceQueue(device, physicalDevice.presentQueueFamilyIndex, 0, &presentQueue);
+    vkGetDeviceQueue(device, physicalDevice.computeQueueFamilyIndex, 0, &computeQueue);
+
+    cmdPipelineBarrier2 = nullptr;
+    if(synchronization2)
+    {
+        cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR");
+    }
+
+    waitForPresent = nullptr;
+    if(physicalDevice.supportsPresentWait)
+    {
+        waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+    }
 }
 
 void LogicalDevice::destroy()
@@ -836,7 +904,8 @@ void Swapchain::querySupportInfo(VkPhysicalDevice physicalDevice,
 }
 
 void Swapchain::chooseSettings(VkSurfaceFormatKHR preferredFormat,
-                               VkPresentModeKHR preferredPresentMode,
+                               uint32 latencyMode,
+                               bool presentWait,
                                uint32 *demoWidth, uint32 *demoHeight)
 {
     //select surface format:
@@ -860,25 +929,10 @@ void Swapchain::chooseSettings(VkSurfaceFormatKHR preferredFormat,
                 "VK_PRESENT_MODE_FIFO_KHR selected instead");
     }
 
-    //select present mode:
-    wasSelected = false;
-    for(VkPresentModeKHR mode : presentModes)
-    {
-        //select triple buffering if available
-        if(mode == preferredPresentMode)
-        {
-            presentMode = mode;
-            wasSelected = true;
-            break;
-        }
-    }
-    if(!wasSelected)
-    {
-        //this mode is guaranteed to be available
-        presentMode = VK_PRESENT_MODE_FIFO_KHR; 
-        LOGI("Preferred swapchain present mode isn't available. "
-                "VK_PRESENT_MODE_FIFO_KHR selected instead");
-    }
+    //select present mode and image count for the latency mode, falling back on what the
+    //surface supports
+    presentSettings = choosePresentSettings(latencyMode, presentModes, presentWait);
+    presentMode = presentSettings.presentMode;
 
     //select image extent
     if(surfaceCapabilities.currentExtent.width != 0xFFFFFFFF)
@@ -917,10 +971,11 @@ void Swapchain::chooseSettings(VkSurfaceFormatKHR preferredFormat,
 }
 
 void Swapchain::createSwapchainAndImageResources(VkSurfaceKHR surface, 
-                                                 VkDevice logicalDevice)
+                                                 VkDevice logicalDevice,
+                                                 uint32 desiredImageCount)
 {
     VkSwapchainKHR oldSwapchain = swapchain;
-    uint32 desiredNumImages = 3; //3 for triple-buffering
+    uint32 desiredNumImages = desiredImageCount ? desiredImageCount : presentSettings.imageCount;
 
     if(desiredNumImages < surfaceCapabilities.minImageCount)
     {
@@ -951,6 +1006,8 @@ void Swapchain::createSwapchainAndImageResources(VkSurfaceKHR surface,
     createInfo.clipped = VK_TRUE;
 
     VK_CHECK(vkCreateSwapchainKHR(logicalDevice, &createInfo, nullptr, &swapchain));
+    LOGI("Swapchain: {}, {} images{}", vulkanToString(presentMode), desiredNumImages,
+         presentSettings.maxQueuedPresents ? ", present wait" : "");
 
     
     // destroy the old swapchain if we are recreating the swapchain
@@ -998,54 +1055,19 @@ void Swapchain::queryInfoAndChooseSettings(VkPhysicalDevice physicalDevice,
                                            VkDevice logicalDevice,
                                            VkSurfaceKHR surface,
                                            VkSurfaceFormatKHR preferredFormat,
-                                           VkPresentModeKHR preferredPresentMode,
+                                           uint32 latencyMode,
+                                           bool presentWait,
                                            uint32 *demoWidth, uint32 *demoHeight)
 {
     querySupportInfo(physicalDevice, surface);
-    chooseSettings(preferredFormat, preferredPresentMode, demoWidth, demoHeight);
+    chooseSettings(preferredFormat, latencyMode, presentWait, demoWidth, demoHeight);
 }
 
 void Swapchain::destroy(VkDevice &device, VkCommandPool &cmdPool)
 {
     for(size_t i = 0; i < imageResources.size(); i++)
     {
-        vkDestroyFramebuffer(device, imageResources[i].framebuffer, nullptr);
-
         vkDestroyImageView(device, imageResources[i].view, nullptr);
-        
-        vkFreeCommandBuffers(device, cmdPool, 1, &imageResources[i].cmd);
-        
-        vkDestroyBuffer(device, imageResources[i].uniformBuffer, nullptr);
-        
-        vkUnmapMemory(device, imageResources[i].uniformMemory);
-        vkFreeMemory(device, imageResources[i].uniformMemory, nullptr);
     }
 }
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-